@@ -6,7 +6,8 @@ CREATE TABLE device_%deviceid_directories (
 CREATE TABLE device_%deviceid_subdirectories (
   directory INTEGER NOT NULL,
   path TEXT NOT NULL,
-  mtime INTEGER NOT NULL
+  mtime INTEGER NOT NULL,
+  digest TEXT NOT NULL DEFAULT ''
 );
 
 CREATE TABLE device_%deviceid_songs (
@@ -58,15 +59,20 @@ CREATE TABLE device_%deviceid_songs (
   etag TEXT,
 
   performer TEXT,
-  grouping TEXT
+  grouping TEXT,
+
+  content_hash TEXT,
+  fingerprint TEXT,
+  fingerprint_hash TEXT
 );
 
 CREATE INDEX idx_device_%deviceid_songs_album ON device_%deviceid_songs (album);
 
 CREATE INDEX idx_device_%deviceid_songs_comp_artist ON device_%deviceid_songs (effective_compilation, artist);
 
-CREATE VIRTUAL TABLE device_%deviceid_fts USING fts3(
+CREATE VIRTUAL TABLE device_%deviceid_fts USING fts4(
   ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment,
+  prefix="1,2,3",
   tokenize=unicode
 );
 
@@ -45,11 +45,16 @@ CREATE TABLE jamendo.songs (
   etag TEXT,
 
   performer TEXT,
-  grouping TEXT
+  grouping TEXT,
+
+  content_hash TEXT,
+  fingerprint TEXT,
+  fingerprint_hash TEXT
 );
 
-CREATE VIRTUAL TABLE jamendo.songs_fts USING fts3(
+CREATE VIRTUAL TABLE jamendo.songs_fts USING fts4(
   ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment,
+  prefix="1,2,3",
   tokenize=unicode
 );
 
@@ -0,0 +1,16 @@
+DELETE FROM %allsongstables_fts;
+
+DROP TABLE %allsongstables_fts;
+
+CREATE VIRTUAL TABLE %allsongstables_fts USING fts4(
+  ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment,
+  prefix="1,2,3",
+  tokenize=unicode
+);
+
+INSERT INTO %allsongstables_fts (ROWID, ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment)
+    SELECT ROWID, title, album, artist, albumartist, composer, performer, grouping, genre, comment
+    FROM %allsongstables;
+
+UPDATE schema_version SET version=47;
+
@@ -0,0 +1,4 @@
+ALTER TABLE subdirectories ADD COLUMN digest TEXT NOT NULL DEFAULT '';
+
+UPDATE schema_version SET version=48;
+
@@ -0,0 +1,26 @@
+DROP INDEX idx_comp_artist;
+
+CREATE INDEX idx_comp_album ON songs (effective_compilation, album, unavailable);
+
+DROP INDEX idx_album;
+
+CREATE INDEX idx_artist_available ON songs (artist, effective_compilation, unavailable);
+
+CREATE INDEX idx_albumartist_available ON songs (effective_albumartist, effective_compilation, unavailable);
+
+CREATE INDEX idx_album_available ON songs (album, effective_compilation, unavailable);
+
+CREATE INDEX idx_year_album_available ON songs (year, album, effective_compilation, unavailable);
+
+CREATE INDEX idx_genre_available ON songs (genre, effective_compilation, unavailable);
+
+CREATE INDEX idx_composer_available ON songs (composer, effective_compilation, unavailable);
+
+CREATE INDEX idx_performer_available ON songs (performer, effective_compilation, unavailable);
+
+CREATE INDEX idx_grouping_available ON songs (grouping, effective_compilation, unavailable);
+
+CREATE INDEX idx_filetype_available ON songs (filetype, effective_compilation, unavailable);
+
+UPDATE schema_version SET version=49;
+
@@ -0,0 +1,6 @@
+ALTER TABLE %allsongstables ADD COLUMN content_hash TEXT;
+
+CREATE INDEX idx_content_hash ON songs (content_hash);
+
+UPDATE schema_version SET version=50;
+
@@ -0,0 +1,4 @@
+ALTER TABLE %allsongstables ADD COLUMN fingerprint TEXT;
+
+UPDATE schema_version SET version=51;
+
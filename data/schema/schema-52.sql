@@ -0,0 +1,6 @@
+ALTER TABLE %allsongstables ADD COLUMN fingerprint_hash TEXT;
+
+UPDATE %allsongstables SET fingerprint_hash = content_hash WHERE fingerprint IS NOT NULL;
+
+UPDATE schema_version SET version=52;
+
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "database.h"
 #include "player.h"
+#include "startuptrace.h"
 #include "tagreaderclient.h"
 #include "taskmanager.h"
 #include "covers/albumcoverloader.h"
@@ -39,12 +40,51 @@
 #include "podcasts/podcastdownloader.h"
 #include "podcasts/podcastupdater.h"
 
+#include <QTimer>
+
+#include <boost/bind.hpp>
+
 #ifdef HAVE_MOODBAR
 # include "moodbar/moodbarcontroller.h"
 # include "moodbar/moodbarloader.h"
 #endif
 
 bool Application::kIsPortable = false;
+const int Application::kIdleServicesTimeoutMsec = 5000;
+
+template <typename T>
+T* Application::Create(const char* name) {
+  StartupTraceScope trace(name);
+  return new T(this, this);
+}
+
+NetworkRemote* Application::CreateNetworkRemote() {
+  StartupTraceScope trace("NetworkRemote");
+  NetworkRemote* ret = new NetworkRemote(this);
+  MoveToNewThread(ret);
+  return ret;
+}
+
+NetworkRemoteHelper* Application::CreateNetworkRemoteHelper() {
+  StartupTraceScope trace("NetworkRemoteHelper");
+  return new NetworkRemoteHelper(this);
+}
+
+MoodbarLoader* Application::CreateMoodbarLoader() {
+#ifdef HAVE_MOODBAR
+  return Create<MoodbarLoader>("MoodbarLoader");
+#else
+  return NULL;
+#endif
+}
+
+MoodbarController* Application::CreateMoodbarController() {
+#ifdef HAVE_MOODBAR
+  return Create<MoodbarController>("MoodbarController");
+#else
+  return NULL;
+#endif
+}
 
 Application::Application(QObject* parent)
   : QObject(parent),
@@ -59,24 +99,39 @@ Application::Application(QObject* parent)
     player_(NULL),
     playlist_manager_(NULL),
     current_art_loader_(NULL),
-    global_search_(NULL),
-    internet_model_(NULL),
     library_(NULL),
-    device_manager_(NULL),
-    podcast_updater_(NULL),
-    podcast_downloader_(NULL),
-    gpodder_sync_(NULL),
-    moodbar_loader_(NULL),
-    moodbar_controller_(NULL),
-    network_remote_(NULL),
-    network_remote_helper_(NULL)
+    global_search_(boost::bind(&Application::Create<GlobalSearch>, this,
+                               "GlobalSearch")),
+    internet_model_(boost::bind(&Application::Create<InternetModel>, this,
+                                "InternetModel")),
+    device_manager_(boost::bind(&Application::Create<DeviceManager>, this,
+                                "DeviceManager")),
+    podcast_updater_(boost::bind(&Application::Create<PodcastUpdater>, this,
+                                 "PodcastUpdater")),
+    podcast_downloader_(boost::bind(&Application::Create<PodcastDownloader>,
+                                    this, "PodcastDownloader")),
+    gpodder_sync_(boost::bind(&Application::Create<GPodderSync>, this,
+                              "GPodderSync")),
+    moodbar_loader_(boost::bind(&Application::CreateMoodbarLoader, this)),
+    moodbar_controller_(boost::bind(&Application::CreateMoodbarController, this)),
+    network_remote_(boost::bind(&Application::CreateNetworkRemote, this)),
+    network_remote_helper_(boost::bind(&Application::CreateNetworkRemoteHelper, this)),
+    idle_services_started_(false)
 {
-  tag_reader_client_ = new TagReaderClient(this);
-  MoveToNewThread(tag_reader_client_);
-  tag_reader_client_->Start();
+  StartupTraceScope trace("Application");
+
+  {
+    StartupTraceScope trace("TagReaderClient");
+    tag_reader_client_ = new TagReaderClient(this);
+    MoveToNewThread(tag_reader_client_);
+    tag_reader_client_->Start();
+  }
 
-  database_ = new Database(this, this);
-  MoveToNewThread(database_);
+  {
+    StartupTraceScope trace("Database");
+    database_ = new Database(this, this);
+    MoveToNewThread(database_);
+  }
 
   album_cover_loader_ = new AlbumCoverLoader(this);
   MoveToNewThread(album_cover_loader_);
@@ -90,42 +145,39 @@ Application::Application(QObject* parent)
   appearance_ = new Appearance(this);
   cover_providers_ = new CoverProviders(this);
   task_manager_ = new TaskManager(this);
-  player_ = new Player(this, this);
-  playlist_manager_ = new PlaylistManager(this, this);
-  current_art_loader_ = new CurrentArtLoader(this, this);
-  global_search_ = new GlobalSearch(this, this);
-  internet_model_ = new InternetModel(this, this);
-  library_ = new Library(this, this);
-  device_manager_ = new DeviceManager(this, this);
-  podcast_updater_ = new PodcastUpdater(this, this);
-  podcast_downloader_ = new PodcastDownloader(this, this);
-  gpodder_sync_ = new GPodderSync(this, this);
 
-#ifdef HAVE_MOODBAR
-  moodbar_loader_ = new MoodbarLoader(this, this);
-  moodbar_controller_ = new MoodbarController(this, this);
-#endif
+  {
+    StartupTraceScope trace("Player");
+    player_ = new Player(this, this);
+  }
 
-  // Network Remote
-  network_remote_ = new NetworkRemote(this);
-  MoveToNewThread(network_remote_);
+  {
+    StartupTraceScope trace("PlaylistManager");
+    playlist_manager_ = new PlaylistManager(this, this);
+  }
 
-  // This must be before libraray_->Init();
-  // In the constructor the helper waits for the signal PlaylistManagerInitialized
-  // to start the remote. Without the playlist manager clementine can
-  // crash when a client connects before the manager is initialized!
-  network_remote_helper_ = new NetworkRemoteHelper(this);
+  current_art_loader_ = new CurrentArtLoader(this, this);
 
-  library_->Init();
+  {
+    StartupTraceScope trace("Library");
+    library_ = new Library(this, this);
+    library_->Init();
+  }
 
   DoInAMinuteOrSo(database_, SLOT(DoBackup()));
+
+  // Start everything else once the main window is on the screen, or after a
+  // while anyway if it starts hidden.
+  connect(StartupTrace::Instance(), SIGNAL(FirstPaint()),
+          SLOT(StartIdleServices()), Qt::QueuedConnection);
+  QTimer::singleShot(kIdleServicesTimeoutMsec, this, SLOT(StartIdleServices()));
 }
 
 Application::~Application() {
   // It's important that the device manager is deleted before the database.
   // Deleting the database deletes all objects that have been created in its
   // thread, including some device library backends.
-  delete device_manager_; device_manager_ = NULL;
+  delete device_manager_.release();
 
   foreach (QObject* object, objects_in_threads_) {
     object->deleteLater();
@@ -140,9 +192,34 @@ Application::~Application() {
   }
 }
 
+void Application::StartIdleServices() {
+  if (idle_services_started_)
+    return;
+  idle_services_started_ = true;
+
+  // The main window won't be painted if it started hidden in the tray, so
+  // don't wait for that any longer.
+  StartupTrace::Instance()->ReportIfHidden();
+
+  StartupTraceScope trace("Idle services");
+
+  // Nothing else asks for these, but they have work to do in the background.
+  device_manager();
+  podcast_updater();
+  podcast_downloader();
+  gpodder_sync();
+  moodbar_controller();
+  network_remote_helper();
+
+  emit IdleServicesStarted();
+}
+
 void Application::MoveToNewThread(QObject* object) {
   QThread* thread = new QThread(this);
 
+  // Shows up in traces.
+  thread->setObjectName(object->metaObject()->className());
+
   MoveToThread(object, thread);
 
   thread->start();
@@ -18,6 +18,7 @@
 #ifndef APPLICATION_H
 #define APPLICATION_H
 
+#include "core/lazy.h"
 #include "ui/settingsdialog.h"
 
 #include <QObject>
@@ -73,17 +74,20 @@ public:
   Player* player() const { return player_; }
   PlaylistManager* playlist_manager() const { return playlist_manager_; }
   CurrentArtLoader* current_art_loader() const { return current_art_loader_; }
-  GlobalSearch* global_search() const { return global_search_; }
-  InternetModel* internet_model() const { return internet_model_; }
   Library* library() const { return library_; }
-  DeviceManager* device_manager() const { return device_manager_; }
-  PodcastUpdater* podcast_updater() const { return podcast_updater_; }
-  PodcastDownloader* podcast_downloader() const { return podcast_downloader_; }
-  GPodderSync* gpodder_sync() const { return gpodder_sync_; }
-  MoodbarLoader* moodbar_loader() const { return moodbar_loader_; }
-  MoodbarController* moodbar_controller() const { return moodbar_controller_; }
-  NetworkRemote* network_remote() const { return network_remote_; }
-  NetworkRemoteHelper* network_remote_helper() const { return network_remote_helper_; }
+
+  // These aren't needed to show the main window, so they're created the first
+  // time something asks for them, or when StartIdleServices() is called.
+  GlobalSearch* global_search() const { return global_search_.get(); }
+  InternetModel* internet_model() const { return internet_model_.get(); }
+  DeviceManager* device_manager() const { return device_manager_.get(); }
+  PodcastUpdater* podcast_updater() const { return podcast_updater_.get(); }
+  PodcastDownloader* podcast_downloader() const { return podcast_downloader_.get(); }
+  GPodderSync* gpodder_sync() const { return gpodder_sync_.get(); }
+  MoodbarLoader* moodbar_loader() const { return moodbar_loader_.get(); }
+  MoodbarController* moodbar_controller() const { return moodbar_controller_.get(); }
+  NetworkRemote* network_remote() const { return network_remote_.get(); }
+  NetworkRemoteHelper* network_remote_helper() const { return network_remote_helper_.get(); }
 
   LibraryBackend* library_backend() const;
   LibraryModel* library_model() const;
@@ -96,12 +100,27 @@ public slots:
   void ReloadSettings();
   void OpenSettingsDialogAtPage(SettingsDialog::Page page);
 
+  // Creates the services that work in the background without anything else
+  // asking for them.  Called once the main window has been painted.
+  void StartIdleServices();
+
 signals:
   void ErrorAdded(const QString& message);
   void SettingsChanged();
   void SettingsDialogRequested(SettingsDialog::Page page);
+  void IdleServicesStarted();
+
+private:
+  template <typename T>
+  T* Create(const char* name);
+  NetworkRemote* CreateNetworkRemote();
+  NetworkRemoteHelper* CreateNetworkRemoteHelper();
+  MoodbarLoader* CreateMoodbarLoader();
+  MoodbarController* CreateMoodbarController();
 
 private:
+  static const int kIdleServicesTimeoutMsec;
+
   QString language_name_;
 
   TagReaderClient* tag_reader_client_;
@@ -115,17 +134,20 @@ private:
   Player* player_;
   PlaylistManager* playlist_manager_;
   CurrentArtLoader* current_art_loader_;
-  GlobalSearch* global_search_;
-  InternetModel* internet_model_;
   Library* library_;
-  DeviceManager* device_manager_;
-  PodcastUpdater* podcast_updater_;
-  PodcastDownloader* podcast_downloader_;
-  GPodderSync* gpodder_sync_;
-  MoodbarLoader* moodbar_loader_;
-  MoodbarController* moodbar_controller_;
-  NetworkRemote* network_remote_;
-  NetworkRemoteHelper* network_remote_helper_;
+
+  Lazy<GlobalSearch> global_search_;
+  Lazy<InternetModel> internet_model_;
+  Lazy<DeviceManager> device_manager_;
+  Lazy<PodcastUpdater> podcast_updater_;
+  Lazy<PodcastDownloader> podcast_downloader_;
+  Lazy<GPodderSync> gpodder_sync_;
+  Lazy<MoodbarLoader> moodbar_loader_;
+  Lazy<MoodbarController> moodbar_controller_;
+  Lazy<NetworkRemote> network_remote_;
+  Lazy<NetworkRemoteHelper> network_remote_helper_;
+
+  bool idle_services_started_;
 
   QList<QObject*> objects_in_threads_;
   QList<QThread*> threads_;
@@ -60,7 +60,8 @@ const char* CommandlineOptions::kHelpText =
     "      --quiet               %27\n"
     "      --verbose             %28\n"
     "      --log-levels <levels> %29\n"
-    "      --version             %30\n";
+    "      --trace <filename>    %30\n"
+    "      --version             %31\n";
 
 const char* CommandlineOptions::kVersionText =
     "Clementine %1";
@@ -130,6 +131,7 @@ bool CommandlineOptions::Parse() {
     {"quiet",             no_argument,       0, Quiet},
     {"verbose",           no_argument,       0, Verbose},
     {"log-levels",        required_argument, 0, LogLevels},
+    {"trace",             required_argument, 0, Trace},
     {"version",           no_argument,       0, Version},
 
     {0, 0, 0, 0}
@@ -173,6 +175,7 @@ bool CommandlineOptions::Parse() {
             tr("Equivalent to --log-levels *:1"),
             tr("Equivalent to --log-levels *:3"),
             tr("Comma separated list of class:level, level is 0-3")).arg(
+            tr("Write a trace of this session to <filename>, to open in chrome://tracing"),
             tr("Print out version information"));
 
         std::cout << translated_help_text.toLocal8Bit().constData();
@@ -195,6 +198,7 @@ bool CommandlineOptions::Parse() {
       case Quiet:      log_levels_ = "1";               break;
       case Verbose:    log_levels_ = "3";               break;
       case LogLevels:  log_levels_ = QString(optarg);   break;
+      case Trace:      trace_filename_ = QFile::decodeName(optarg); break;
       case Version: {
         QString version_text = QString(kVersionText).arg(CLEMENTINE_VERSION_DISPLAY);
         std::cout << version_text.toLocal8Bit().constData() << std::endl;
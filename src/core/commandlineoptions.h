@@ -65,6 +65,7 @@ class CommandlineOptions {
   QList<QUrl> urls() const { return urls_; }
   QString language() const { return language_; }
   QString log_levels() const { return log_levels_; }
+  QString trace_filename() const { return trace_filename_; }
 
   QByteArray Serialize() const;
   void Load(const QByteArray& serialized);
@@ -83,7 +84,8 @@ class CommandlineOptions {
     Version,
     VolumeIncreaseBy,
     VolumeDecreaseBy,
-    RestartOrPrevious
+    RestartOrPrevious,
+    Trace
   };
 
   QString tr(const char* source_text);
@@ -109,6 +111,9 @@ class CommandlineOptions {
   QString log_levels_;
 
   QList<QUrl> urls_;
+
+  // Not serialised - this only affects the instance that's starting up.
+  QString trace_filename_;
 };
 
 QDataStream& operator<<(QDataStream& s, const CommandlineOptions& a);
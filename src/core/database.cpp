@@ -22,23 +22,37 @@
 #include "core/application.h"
 #include "core/logging.h"
 #include "core/taskmanager.h"
-
-#include <boost/scope_exit.hpp>
+#include "core/tracer.h"
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QFutureWatcher>
 #include <QLibrary>
 #include <QLibraryInfo>
 #include <QSqlDriver>
 #include <QSqlQuery>
+#include <QSqlRecord>
 #include <QtDebug>
 #include <QThread>
+#include <QTime>
+#include <QTimer>
 #include <QUrl>
 #include <QVariant>
+#include <QtConcurrentRun>
+
+// From newer versions of sqlite3.h.
+#ifndef SQLITE_TRACE_PROFILE
+# define SQLITE_TRACE_PROFILE 0x02
+# define SQLITE_TRACE_ROW 0x04
+#endif
 
 const char* Database::kDatabaseFilename = "clementine.db";
-const int Database::kSchemaVersion = 46;
+const int Database::kSchemaVersion = 52;
 const char* Database::kMagicAllSongsTables = "%allsongstables";
+const int Database::kBackupPagesPerStep = 512;
+const int Database::kBackupStepIntervalMs = 10;
+const int Database::kBackupRetryMs = 5 * 60 * 1000;
+const int Database::kMaxBackupRestarts = 3;
 
 int Database::sNextConnectionId = 1;
 QMutex Database::sNextConnectionIdMutex;
@@ -102,6 +116,12 @@ int (*Database::_sqlite3_backup_finish) (sqlite3_backup*) = NULL;
 int (*Database::_sqlite3_backup_pagecount) (sqlite3_backup*) = NULL;
 int (*Database::_sqlite3_backup_remaining) (sqlite3_backup*) = NULL;
 
+void* (*Database::_sqlite3_profile) (
+    sqlite3*, void (*) (void*, const char*, sqlite3_uint64), void*) = NULL;
+int (*Database::_sqlite3_trace_v2) (
+    sqlite3*, unsigned, int (*) (unsigned, void*, void*, void*), void*) = NULL;
+const char* (*Database::_sqlite3_sql) (sqlite3_stmt*) = NULL;
+
 bool Database::sStaticInitDone = false;
 bool Database::sLoadedSqliteSymbols = false;
 
@@ -151,7 +171,16 @@ int Database::FTSOpen(
       offset += 4;
     }*/
 
-    if (!data[i].isLetterOrNumber()) {
+    // Most tags are plain ASCII, so avoid looking up the character properties
+    // for those.
+    const bool ascii = unicode <= 0x007f;
+    const bool letter_or_number = ascii ?
+        (unicode >= 'a' && unicode <= 'z') ||
+        (unicode >= 'A' && unicode <= 'Z') ||
+        (unicode >= '0' && unicode <= '9') :
+        c.isLetterOrNumber();
+
+    if (!letter_or_number) {
       // Token finished.
       if (token.length() != 0) {
         tokens << Token(token, start_offset, offset - 1);
@@ -161,7 +190,9 @@ int Database::FTSOpen(
         ++start_offset;
       }
     } else {
-      if (data[i].decompositionTag() != QChar::NoDecomposition) {
+      if (ascii) {
+        token.push_back(c);
+      } else if (data[i].decompositionTag() != QChar::NoDecomposition) {
         token.push_back(data[i].decomposition()[0]);
       } else {
         token.push_back(data[i]);
@@ -198,21 +229,19 @@ int Database::FTSNext(
     int* position) {
   UnicodeTokenizerCursor* real_cursor = reinterpret_cast<UnicodeTokenizerCursor*>(cursor);
 
-  QList<Token> tokens = real_cursor->tokens;
-  if (real_cursor->position >= tokens.size()) {
+  if (real_cursor->position >= real_cursor->tokens.size()) {
     return SQLITE_DONE;
   }
 
-  Token t = tokens[real_cursor->position];
-  QByteArray utf8 = t.token.toUtf8();
-  *token = utf8.constData();
-  *bytes = utf8.size();
+  const Token& t = real_cursor->tokens.at(real_cursor->position);
+  real_cursor->current_utf8 = t.token.toUtf8();
+
+  *token = real_cursor->current_utf8.constData();
+  *bytes = real_cursor->current_utf8.size();
   *start_offset = t.start_offset;
   *end_offset = t.end_offset;
   *position = real_cursor->position++;
 
-  real_cursor->current_utf8 = utf8;
-
   return SQLITE_OK;
 }
 
@@ -249,6 +278,12 @@ void Database::StaticInit() {
   _sqlite3_backup_pagecount = sqlite3_backup_pagecount;
   _sqlite3_backup_remaining = sqlite3_backup_remaining;
 
+  _sqlite3_profile = sqlite3_profile;
+  _sqlite3_sql = sqlite3_sql;
+#if SQLITE_VERSION_NUMBER >= 3014000
+  _sqlite3_trace_v2 = sqlite3_trace_v2;
+#endif
+
   sLoadedSqliteSymbols = true;
   return;
 #else // HAVE_STATIC_SQLITE
@@ -290,6 +325,19 @@ void Database::StaticInit() {
   _sqlite3_backup_remaining = reinterpret_cast<int (*) (sqlite3_backup*)>(
       library.resolve("sqlite3_backup_remaining"));
 
+  // The profiler does without these if they're missing.
+  _sqlite3_profile = reinterpret_cast<
+      void* (*) (sqlite3*, void (*) (void*, const char*, sqlite3_uint64), void*)>(
+          library.resolve("sqlite3_profile"));
+  _sqlite3_trace_v2 = reinterpret_cast<
+      int (*) (sqlite3*, unsigned, int (*) (unsigned, void*, void*, void*), void*)>(
+          library.resolve("sqlite3_trace_v2"));
+  _sqlite3_sql = reinterpret_cast<const char* (*) (sqlite3_stmt*)>(
+      library.resolve("sqlite3_sql"));
+  if (!_sqlite3_sql) {
+    _sqlite3_trace_v2 = NULL;
+  }
+
   if (!_sqlite3_value_type ||
       !_sqlite3_value_int64 ||
       !_sqlite3_value_text ||
@@ -318,7 +366,14 @@ Database::Database(Application* app, QObject* parent, const QString& database_na
     mutex_(QMutex::Recursive),
     injected_database_name_(database_name),
     query_hash_(0),
-    startup_schema_version_(-1)
+    startup_schema_version_(-1),
+    backup_running_(false),
+    backup_source_(NULL),
+    backup_dest_(NULL),
+    backup_(NULL),
+    backup_task_id_(-1),
+    backup_restarts_(0),
+    backup_last_remaining_(-1)
 {
   {
     QMutexLocker l(&sNextConnectionIdMutex);
@@ -335,7 +390,17 @@ Database::Database(Application* app, QObject* parent, const QString& database_na
   Connect();
 }
 
+QMutex* Database::Mutex() {
+  if (profiler_.is_enabled())
+    profiler_.LockRequested();
+  return &mutex_;
+}
+
 QSqlDatabase Database::Connect() {
+  // Callers lock Mutex() just before they connect.
+  if (profiler_.is_enabled())
+    profiler_.LockAcquired();
+
   QMutexLocker l(&connect_mutex_);
 
   // Create the directory if it doesn't exist
@@ -352,9 +417,12 @@ QSqlDatabase Database::Connect() {
   // Try to find an existing connection for this thread
   QSqlDatabase db = QSqlDatabase::database(connection_id);
   if (db.isOpen()) {
+    UpdateProfiling(db, connection_id);
     return db;
   }
 
+  TraceScope trace("database", "Database::Connect");
+
   db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
 
   if (!injected_database_name_.isNull())
@@ -423,9 +491,103 @@ QSqlDatabase Database::Connect() {
     }
   }
 
+  UpdateProfiling(db, connection_id);
   return db;
 }
 
+void Database::UpdateProfiling(QSqlDatabase& db, const QString& connection_id) {
+  const bool enabled = profiler_.is_enabled();
+  if (enabled == profiled_connections_.contains(connection_id))
+    return;
+
+  QVariant handle = db.driver()->handle();
+  if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0)
+    return;
+
+  sqlite3* connection = *static_cast<sqlite3**>(handle.data());
+  if (!connection)
+    return;
+
+  if (_sqlite3_trace_v2) {
+    _sqlite3_trace_v2(connection,
+                      enabled ? SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW : 0,
+                      enabled ? &Database::SqliteTrace : NULL, this);
+  } else if (_sqlite3_profile) {
+    _sqlite3_profile(connection, enabled ? &Database::SqliteProfile : NULL, this);
+  } else {
+    return;
+  }
+
+  if (enabled) {
+    profiled_connections_.insert(connection_id);
+  } else {
+    profiled_connections_.remove(connection_id);
+  }
+}
+
+void Database::SqliteProfile(void* database, const char* sql,
+                             sqlite3_uint64 nsec) {
+  Database* self = reinterpret_cast<Database*>(database);
+  self->profiler_.AddQuery(QString::fromUtf8(sql), nsec / 1000, -1);
+}
+
+int Database::SqliteTrace(unsigned type, void* database, void* p, void* x) {
+  Database* self = reinterpret_cast<Database*>(database);
+  if (!self->profiler_.is_enabled())
+    return 0;
+
+  sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(p);
+
+  if (type == SQLITE_TRACE_ROW) {
+    self->profiler_.RowReturned(statement);
+  } else if (type == SQLITE_TRACE_PROFILE) {
+    const qint64 nsec = *reinterpret_cast<sqlite3_int64*>(x);
+    const char* sql = _sqlite3_sql(statement);
+    self->profiler_.AddQuery(QString::fromUtf8(sql ? sql : ""), nsec / 1000,
+                             self->profiler_.TakeRowCount(statement));
+  }
+  return 0;
+}
+
+SqlProfiler::QueryStatsList Database::ProfileResults() {
+  SqlProfiler::QueryStatsList ret = profiler_.Stats();
+
+  const qint64 slow_usec = qint64(profiler_.slow_query_msec()) * 1000;
+  for (int i=0 ; i<ret.count() ; ++i) {
+    if (ret[i].max_usec_ >= slow_usec)
+      ret[i].query_plan_ = ExplainQueryPlan(ret[i].slowest_sql_);
+  }
+
+  return ret;
+}
+
+QStringList Database::ExplainQueryPlan(const QString& sql) {
+  QRegExp explainable("^(SELECT|INSERT|UPDATE|DELETE|REPLACE)\\b",
+                      Qt::CaseInsensitive);
+  if (explainable.indexIn(sql.trimmed()) == -1)
+    return QStringList();
+
+  // The values that were bound to the statement are gone by now, but NULL
+  // gives the same plan in most cases.
+  QString statement(sql);
+  statement.replace(QRegExp("\\?\\d*|:[A-Za-z_]\\w*"), "NULL");
+
+  QMutexLocker l(&mutex_);
+  QSqlDatabase db(Connect());
+  QSqlQuery query(db);
+  if (!query.exec("EXPLAIN QUERY PLAN " + statement)) {
+    return QStringList() << "EXPLAIN QUERY PLAN failed: " +
+                            query.lastError().text();
+  }
+
+  // The last column describes each step of the plan.
+  QStringList ret;
+  while (query.next()) {
+    ret << query.value(query.record().count() - 1).toString();
+  }
+  return ret;
+}
+
 void Database::UpdateMainSchema(QSqlDatabase* db) {
   // Get the database's schema version
   int schema_version = 0;
@@ -519,6 +681,7 @@ void Database::DetachDatabase(const QString& database_name) {
 }
 
 void Database::UpdateDatabaseSchema(int version, QSqlDatabase &db) {
+  TraceScope trace("database", "Database::UpdateDatabaseSchema");
   QString filename;
   if (version == 0)
     filename = ":/schema/schema.sql";
@@ -542,6 +705,22 @@ void Database::UpdateDatabaseSchema(int version, QSqlDatabase &db) {
                 << "from" << filename;
     ExecSchemaCommandsFromFile(db, filename, version - 1, true);
     t.Commit();
+  } else if (version == 48) {
+    // The subdirectories tables of devices aren't covered by %allsongstables.
+    ScopedTransaction t(&db);
+
+    foreach (const QString& table, db.tables()) {
+      if (table.startsWith("device_") && table.endsWith("_subdirectories")) {
+        QSqlQuery query(db.exec(QString("ALTER TABLE %1 ADD COLUMN digest TEXT"
+                                        " NOT NULL DEFAULT ''").arg(table)));
+        if (CheckErrors(query))
+          qFatal("Unable to update music library database");
+      }
+    }
+    qLog(Debug) << "Applying database schema update" << version
+                << "from" << filename;
+    ExecSchemaCommandsFromFile(db, filename, version - 1, true);
+    t.Commit();
   } else {
     qLog(Debug) << "Applying database schema update" << version
                 << "from" << filename;
@@ -684,13 +863,17 @@ bool Database::CheckErrors(const QSqlQuery& query) {
 }
 
 bool Database::IntegrityCheck(QSqlDatabase db) {
+  TraceScope trace("database", "Database::IntegrityCheck");
   qLog(Debug) << "Starting database integrity check";
   int task_id = app_->task_manager()->StartTask(tr("Integrity check"));
+  QTime time;
+  time.start();
 
   bool ok = false;
   bool error_reported = false;
-  // Ask for 10 error messages at most.
-  QSqlQuery q(QString("PRAGMA integrity_check(10)"), db);
+  // Ask for 10 error messages at most.  quick_check doesn't check that the
+  // indexes match their tables, but it's a lot faster than integrity_check.
+  QSqlQuery q(QString("PRAGMA quick_check(10)"), db);
   while (q.next()) {
     QString message = q.value(0).toString();
 
@@ -709,21 +892,56 @@ bool Database::IntegrityCheck(QSqlDatabase db) {
     }
   }
 
+  qLog(Debug) << "Database integrity check finished in" << time.elapsed()
+              << "ms";
   app_->task_manager()->SetTaskFinished(task_id);
 
   return ok;
 }
 
-void Database::DoBackup() {
-  QSqlDatabase db(this->Connect());
+bool Database::CheckBackupIntegrity(const QString& filename) {
+  // Called in a worker thread, so it gets a connection of its own.
+  const QString connection_name =
+      QString("%1_integrity_check").arg(connection_id_);
+  bool ok = false;
 
-  // Before we overwrite anything, make sure the database is not corrupt
-  QMutexLocker l(&mutex_);
-  const bool ok = IntegrityCheck(db);
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection_name);
+    db.setDatabaseName(filename);
+    if (db.open()) {
+      ok = IntegrityCheck(db);
+    } else {
+      qLog(Error) << "Failed to open database backup for checking:"
+                  << filename << db.lastError().text();
+    }
+    db.close();
+  }
+
+  QSqlDatabase::removeDatabase(connection_name);
+  return ok;
+}
+
+bool Database::IsIdle() {
+  foreach (const TaskManager::Task& task, app_->task_manager()->GetTasks()) {
+    if (task.id != backup_task_id_)
+      return false;
+  }
+  return true;
+}
+
+void Database::DoBackup() {
+  if (backup_running_)
+    return;
 
-  if (ok) {
-    BackupFile(db.databaseName());
+  // Don't compete with library scans and the like.
+  if (!IsIdle()) {
+    qLog(Debug) << "Postponing database backup, something else is running";
+    QTimer::singleShot(kBackupRetryMs, this, SLOT(DoBackup()));
+    return;
   }
+
+  backup_running_ = true;
+  StartBackup(Connect().databaseName());
 }
 
 bool Database::OpenDatabase(const QString& filename, sqlite3** connection) const {
@@ -743,51 +961,145 @@ bool Database::OpenDatabase(const QString& filename, sqlite3** connection) const
   return true;
 }
 
-void Database::BackupFile(const QString& filename) {
+void Database::StartBackup(const QString& filename) {
   qLog(Debug) << "Starting database backup";
-  QString dest_filename = QString("%1.bak").arg(filename);
-  const int task_id = app_->task_manager()->StartTask(tr("Backing up database"));
 
-  sqlite3* source_connection = NULL;
-  sqlite3* dest_connection = NULL;
+  // The copy goes to a temporary file first.  It's checked for corruption
+  // before it replaces the previous backup, so the live database never has to
+  // be locked for the whole check.
+  backup_filename_ = QString("%1.bak").arg(filename);
+  const QString temp_filename = backup_filename_ + ".tmp";
+  QFile::remove(temp_filename);
 
-  BOOST_SCOPE_EXIT((source_connection)(dest_connection)(task_id)(app_)) {
-    // Harmless to call sqlite3_close() with a NULL pointer.
-    _sqlite3_close(source_connection);
-    _sqlite3_close(dest_connection);
-    app_->task_manager()->SetTaskFinished(task_id);
-  } BOOST_SCOPE_EXIT_END
+  if (!OpenDatabase(filename, &backup_source_) ||
+      !OpenDatabase(temp_filename, &backup_dest_)) {
+    FinishBackup(false);
+    return;
+  }
 
-  bool success = OpenDatabase(filename, &source_connection);
-  if (!success) {
+  backup_ = _sqlite3_backup_init(backup_dest_, "main", backup_source_, "main");
+  if (!backup_) {
+    const char* error_message = _sqlite3_errmsg(backup_dest_);
+    qLog(Error) << "Failed to start database backup:" << error_message;
+    FinishBackup(false);
     return;
   }
 
-  success = OpenDatabase(dest_filename, &dest_connection);
-  if (!success) {
+  backup_task_id_ = app_->task_manager()->StartTask(tr("Backing up database"));
+  backup_restarts_ = 0;
+  backup_last_remaining_ = -1;
+  backup_time_.start();
+
+  QTimer::singleShot(0, this, SLOT(BackupStep()));
+}
+
+void Database::BackupStep() {
+  if (!backup_)
     return;
+
+  // Only hold the lock for one bounded step at a time, so other queries can
+  // run in between.
+  int ret = SQLITE_OK;
+  QTime step_time;
+  step_time.start();
+  {
+    QMutexLocker l(&mutex_);
+    ret = _sqlite3_backup_step(backup_, kBackupPagesPerStep);
+  }
+  const int step_ms = step_time.elapsed();
+
+  const int page_count = _sqlite3_backup_pagecount(backup_);
+  const int remaining = _sqlite3_backup_remaining(backup_);
+  app_->task_manager()->SetTaskProgress(
+      backup_task_id_, page_count - remaining, page_count);
+
+  // SQLite starts the backup again from the beginning if the database was
+  // changed through another connection since the last step.
+  if (backup_last_remaining_ != -1 && remaining > backup_last_remaining_) {
+    if (++backup_restarts_ > kMaxBackupRestarts) {
+      qLog(Debug) << "The database keeps changing, postponing backup";
+      FinishBackup(false);
+      QTimer::singleShot(kBackupRetryMs, this, SLOT(DoBackup()));
+      return;
+    }
   }
+  backup_last_remaining_ = remaining;
 
-  sqlite3_backup* backup = _sqlite3_backup_init(
-      dest_connection, "main",
-      source_connection, "main");
-  if (!backup) {
-    const char* error_message = _sqlite3_errmsg(dest_connection);
-    qLog(Error) << "Failed to start database backup:" << error_message;
+  if (step_ms > kBackupStepIntervalMs) {
+    qLog(Debug) << "Database backup step of" << kBackupPagesPerStep
+                << "pages took" << step_ms << "ms";
+  }
+
+  switch (ret) {
+    case SQLITE_OK:
+    case SQLITE_BUSY:
+    case SQLITE_LOCKED:
+      QTimer::singleShot(kBackupStepIntervalMs, this, SLOT(BackupStep()));
+      break;
+
+    case SQLITE_DONE: {
+      const int elapsed_ms = qMax(1, backup_time_.elapsed());
+      qLog(Debug) << "Copied" << page_count << "database pages in"
+                  << elapsed_ms << "ms ("
+                  << (qint64(page_count) * 1000 / elapsed_ms) << "pages/s)";
+      FinishBackup(true);
+      break;
+    }
+
+    default:
+      qLog(Error) << "Database backup failed:" << _sqlite3_errmsg(backup_dest_);
+      FinishBackup(false);
+      break;
+  }
+}
+
+void Database::FinishBackup(bool success) {
+  if (backup_) {
+    _sqlite3_backup_finish(backup_);
+    backup_ = NULL;
+  }
+
+  // Harmless to call sqlite3_close() with a NULL pointer.
+  _sqlite3_close(backup_source_);
+  _sqlite3_close(backup_dest_);
+  backup_source_ = NULL;
+  backup_dest_ = NULL;
+
+  if (backup_task_id_ != -1) {
+    app_->task_manager()->SetTaskFinished(backup_task_id_);
+    backup_task_id_ = -1;
+  }
+
+  const QString temp_filename = backup_filename_ + ".tmp";
+  if (!success) {
+    QFile::remove(temp_filename);
+    backup_running_ = false;
     return;
   }
 
-  int ret = SQLITE_OK;
-  do {
-    ret = _sqlite3_backup_step(backup, 16);
-    const int page_count = _sqlite3_backup_pagecount(backup);
-    app_->task_manager()->SetTaskProgress(
-        task_id, page_count - _sqlite3_backup_remaining(backup), page_count);
-  } while (ret == SQLITE_OK);
+  // Check the copy in a worker thread.  The copy has exactly the same pages as
+  // the database, so it has the same corruption if there is any.
+  QFuture<bool> future = QtConcurrent::run(
+      this, &Database::CheckBackupIntegrity, temp_filename);
+  QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+  watcher->setFuture(future);
+  connect(watcher, SIGNAL(finished()), SLOT(BackupChecked()));
+}
 
-  if (ret != SQLITE_DONE) {
-    qLog(Error) << "Database backup failed";
+void Database::BackupChecked() {
+  QFutureWatcher<bool>* watcher = static_cast<QFutureWatcher<bool>*>(sender());
+  watcher->deleteLater();
+  backup_running_ = false;
+
+  const QString temp_filename = backup_filename_ + ".tmp";
+  if (!watcher->result()) {
+    // Keep the previous backup, it's probably the last good one.
+    QFile::remove(temp_filename);
+    return;
   }
 
-  _sqlite3_backup_finish(backup);
+  QFile::remove(backup_filename_);
+  if (!QFile::rename(temp_filename, backup_filename_)) {
+    qLog(Error) << "Couldn't replace the database backup" << backup_filename_;
+  }
 }
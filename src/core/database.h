@@ -21,13 +21,16 @@
 #include <QMap>
 #include <QMutex>
 #include <QObject>
+#include <QSet>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QStringList>
+#include <QTime>
 
 #include <sqlite3.h>
 
 #include "gtest/gtest_prod.h"
+#include "sqlprofiler.h"
 
 extern "C" {
 
@@ -60,9 +63,25 @@ class Database : public QObject {
   static const char* kDatabaseFilename;
   static const char* kMagicAllSongsTables;
 
+  // Backups copy this many pages at a time, and let other queries run for a
+  // while in between.
+  static const int kBackupPagesPerStep;
+  static const int kBackupStepIntervalMs;
+
+  // Backups are postponed this long if something else is busy, or if the
+  // database keeps changing while it's being copied.
+  static const int kBackupRetryMs;
+  static const int kMaxBackupRestarts;
+
   QSqlDatabase Connect();
   bool CheckErrors(const QSqlQuery& query);
-  QMutex* Mutex() { return &mutex_; }
+  QMutex* Mutex();
+
+  // Disabled until something calls profiler()->Start().
+  SqlProfiler* profiler() { return &profiler_; }
+
+  // The profiler's statistics, with query plans for the slow queries.
+  SqlProfiler::QueryStatsList ProfileResults();
 
   void RecreateAttachedDb(const QString& database_name);
   void ExecSchemaCommands(QSqlDatabase& db,
@@ -83,8 +102,14 @@ class Database : public QObject {
   void Error(const QString& message);
 
  public slots:
+  // Copies the database to clementine.db.bak once nothing else is running.
+  // The previous backup is only replaced if the copy isn't corrupt.
   void DoBackup();
 
+ private slots:
+  void BackupStep();
+  void BackupChecked();
+
  private:
   void UpdateMainSchema(QSqlDatabase* db);
 
@@ -100,9 +125,19 @@ class Database : public QObject {
   void UrlEncodeFilenameColumn(const QString& table, QSqlDatabase& db);
   QStringList SongsTables(QSqlDatabase& db, int schema_version) const;
   bool IntegrityCheck(QSqlDatabase db);
-  void BackupFile(const QString& filename);
+  bool CheckBackupIntegrity(const QString& filename);
+  bool IsIdle();
+  void StartBackup(const QString& filename);
+  void FinishBackup(bool success);
   bool OpenDatabase(const QString& filename, sqlite3** connection) const;
 
+  void UpdateProfiling(QSqlDatabase& db, const QString& connection_id);
+  QStringList ExplainQueryPlan(const QString& sql);
+
+  static void SqliteProfile(void* database, const char* sql,
+                            sqlite3_uint64 nsec);
+  static int SqliteTrace(unsigned type, void* database, void* p, void* x);
+
   Application* app_;
 
   // Alias -> filename
@@ -112,6 +147,12 @@ class Database : public QObject {
   QMutex connect_mutex_;
   QMutex mutex_;
 
+  SqlProfiler profiler_;
+
+  // Connections that have the profiling callback registered.  Guarded by
+  // connect_mutex_.
+  QSet<QString> profiled_connections_;
+
   // This ID makes the QSqlDatabase name unique to the object as well as the
   // thread
   int connection_id_;
@@ -128,6 +169,18 @@ class Database : public QObject {
   // This is the schema version of Clementine's DB from the app's last run.
   int startup_schema_version_;
 
+  // The backup that's in progress, if any.  It's only touched in the
+  // database's thread.
+  bool backup_running_;
+  QString backup_filename_;
+  sqlite3* backup_source_;
+  sqlite3* backup_dest_;
+  sqlite3_backup* backup_;
+  int backup_task_id_;
+  int backup_restarts_;
+  int backup_last_remaining_;
+  QTime backup_time_;
+
   FRIEND_TEST(DatabaseTest, FTSOpenParsesSimpleInput);
   FRIEND_TEST(DatabaseTest, FTSOpenParsesUTF8Input);
   FRIEND_TEST(DatabaseTest, FTSOpenParsesMultipleTokens);
@@ -161,6 +214,14 @@ class Database : public QObject {
   static int (*_sqlite3_backup_pagecount) (sqlite3_backup*);
   static int (*_sqlite3_backup_remaining) (sqlite3_backup*);
 
+  // These are used by the profiler.  sqlite3_trace_v2 is only in newer
+  // versions of SQLite and can be NULL - it's the only way to count rows.
+  static void* (*_sqlite3_profile) (
+      sqlite3*, void (*) (void*, const char*, sqlite3_uint64), void*);
+  static int (*_sqlite3_trace_v2) (
+      sqlite3*, unsigned, int (*) (unsigned, void*, void*, void*), void*);
+  static const char* (*_sqlite3_sql) (sqlite3_stmt*);
+
   static bool sStaticInitDone;
   static bool sLoadedSqliteSymbols;
 
@@ -29,10 +29,19 @@ class FileSystemWatcherInterface : public QObject {
   virtual void RemovePath(const QString& path) = 0;
   virtual void Clear() = 0;
 
+  // Returns true if every change inside this directory will be reported
+  // through PathChanged for as long as it's watched, so it doesn't need to be
+  // looked at again until then.
+  virtual bool IsReliablyWatched(const QString& path) const { return false; }
+
   static FileSystemWatcherInterface* Create(QObject* parent = 0);
 
  signals:
   void PathChanged(const QString& path);
+
+  // Emitted when some changes might not have been reported through
+  // PathChanged, for example because the kernel's event queue overflowed.
+  void EventsLost();
 };
 
 #endif
@@ -0,0 +1,186 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "inotifyfslistener.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include <QFile>
+#include <QSocketNotifier>
+
+#include "core/logging.h"
+
+const int InotifyFSListener::kReadBufferSize = 64 * 1024;
+
+namespace {
+
+// Anything that adds, removes or rewrites an entry of the directory.
+const uint32_t kEventMask = IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE |
+                            IN_DELETE | IN_DELETE_SELF | IN_MOVED_FROM |
+                            IN_MOVED_TO | IN_MOVE_SELF;
+
+// Values of statfs::f_type, from linux/magic.h.
+const quint32 kRemoteFilesystemTypes[] = {
+  0x6969,      // NFS
+  0x517b,      // SMB
+  0xff534d42,  // CIFS
+  0xfe534d42,  // SMB2
+  0x564c,      // NCP
+  0x73757245,  // Coda
+  0x5346414f,  // AFS
+  0x01021997,  // 9P
+  0x65735546,  // FUSE, which is often sshfs
+  0
+};
+
+}  // namespace
+
+InotifyFSListener::InotifyFSListener(QObject* parent)
+  : FileSystemWatcherInterface(parent),
+    fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+    notifier_(NULL),
+    warned_about_watch_limit_(false)
+{
+  if (fd_ == -1) {
+    qLog(Warning) << "inotify isn't available:" << strerror(errno);
+    return;
+  }
+
+  buffer_.resize(kReadBufferSize);
+
+  notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+  connect(notifier_, SIGNAL(activated(int)), SLOT(ReadEvents()));
+}
+
+InotifyFSListener::~InotifyFSListener() {
+  if (fd_ != -1)
+    close(fd_);
+}
+
+bool InotifyFSListener::IsRemoteFilesystem(const QString& path) {
+  struct statfs info;
+  if (statfs(QFile::encodeName(path).constData(), &info) != 0)
+    return true;
+
+  for (int i=0 ; kRemoteFilesystemTypes[i] ; ++i) {
+    if (quint32(info.f_type) == kRemoteFilesystemTypes[i])
+      return true;
+  }
+  return false;
+}
+
+void InotifyFSListener::AddPath(const QString& path) {
+  if (!is_valid() || watches_.contains(path))
+    return;
+
+  const int wd = inotify_add_watch(fd_, QFile::encodeName(path).constData(),
+                                   kEventMask);
+  if (wd == -1) {
+    if (errno != ENOSPC) {
+      qLog(Warning) << "Couldn't watch" << path << strerror(errno);
+    } else if (!warned_about_watch_limit_) {
+      qLog(Warning) << "Ran out of inotify watches while watching" << path
+                    << "- increase fs.inotify.max_user_watches to monitor"
+                       " the whole library";
+      warned_about_watch_limit_ = true;
+    }
+    return;
+  }
+
+  // Another path to the same directory, through a symlink or a bind mount.
+  if (paths_.contains(wd))
+    return;
+
+  paths_[wd] = path;
+  watches_[path] = wd;
+  if (IsRemoteFilesystem(path))
+    remote_paths_ << path;
+}
+
+void InotifyFSListener::RemovePath(const QString& path) {
+  if (!watches_.contains(path))
+    return;
+
+  const int wd = watches_.take(path);
+  paths_.remove(wd);
+  remote_paths_.remove(path);
+  inotify_rm_watch(fd_, wd);
+}
+
+void InotifyFSListener::Clear() {
+  foreach (int wd, paths_.keys()) {
+    inotify_rm_watch(fd_, wd);
+  }
+  paths_.clear();
+  watches_.clear();
+  remote_paths_.clear();
+}
+
+bool InotifyFSListener::IsReliablyWatched(const QString& path) const {
+  return watches_.contains(path) && !remote_paths_.contains(path);
+}
+
+void InotifyFSListener::ReadEvents() {
+  QSet<QString> changed_paths;
+  bool events_lost = false;
+
+  forever {
+    const ssize_t length = read(fd_, buffer_.data(), buffer_.size());
+    if (length <= 0)
+      break;
+
+    ssize_t offset = 0;
+    while (offset < length) {
+      const inotify_event* event =
+          reinterpret_cast<const inotify_event*>(buffer_.constData() + offset);
+      offset += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        events_lost = true;
+        continue;
+      }
+
+      const QString path = paths_.value(event->wd);
+      if (path.isEmpty())
+        continue;
+
+      // Several events usually arrive for the same directory at once.
+      changed_paths << path;
+
+      if (event->mask & IN_IGNORED) {
+        // The directory was deleted or unmounted, and the kernel dropped the
+        // watch.
+        paths_.remove(event->wd);
+        watches_.remove(path);
+        remote_paths_.remove(path);
+      }
+    }
+  }
+
+  if (events_lost) {
+    qLog(Warning) << "The inotify event queue overflowed";
+    emit EventsLost();
+  }
+
+  foreach (const QString& path, changed_paths) {
+    emit PathChanged(path);
+  }
+}
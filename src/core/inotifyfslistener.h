@@ -0,0 +1,71 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INOTIFYFSLISTENER_H
+#define INOTIFYFSLISTENER_H
+
+#include "filesystemwatcherinterface.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+
+class QSocketNotifier;
+
+// Watches directories with inotify directly.  Unlike QFileSystemWatcher this
+// also reports files that were modified in place, and it never falls back to
+// polling when we run out of inotify watches - the library watcher's
+// incremental scans look at those directories instead.
+class InotifyFSListener : public FileSystemWatcherInterface {
+  Q_OBJECT
+
+ public:
+  InotifyFSListener(QObject* parent = 0);
+  ~InotifyFSListener();
+
+  static const int kReadBufferSize;
+
+  // False if inotify isn't available on this system.
+  bool is_valid() const { return fd_ != -1; }
+
+  void AddPath(const QString& path);
+  void RemovePath(const QString& path);
+  void Clear();
+  bool IsReliablyWatched(const QString& path) const;
+
+ private slots:
+  void ReadEvents();
+
+ private:
+  static bool IsRemoteFilesystem(const QString& path);
+
+ private:
+  int fd_;
+  QSocketNotifier* notifier_;
+  QByteArray buffer_;
+
+  QHash<int, QString> paths_;
+  QHash<QString, int> watches_;
+
+  // Paths on network filesystems are watched too, but changes made by other
+  // machines aren't reported.
+  QSet<QString> remote_paths_;
+
+  bool warned_about_watch_limit_;
+};
+
+#endif // INOTIFYFSLISTENER_H
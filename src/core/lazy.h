@@ -0,0 +1,56 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <boost/function.hpp>
+
+// Calls the factory function to create the object the first time it's used.
+// The object isn't owned by the Lazy - usually the factory gives it a QObject
+// parent.  Not thread-safe, so only use it from one thread.
+template <typename T>
+class Lazy {
+ public:
+  typedef boost::function<T* ()> Factory;
+
+  explicit Lazy(Factory factory) : factory_(factory), ptr_(NULL) {}
+
+  T* get() const {
+    if (!ptr_)
+      ptr_ = factory_();
+    return ptr_;
+  }
+
+  T* operator ->() const { return get(); }
+
+  bool is_created() const { return ptr_ != NULL; }
+
+  // Forgets about the object without creating it.  Returns NULL if it hadn't
+  // been created yet.
+  T* release() {
+    T* ret = ptr_;
+    ptr_ = NULL;
+    return ret;
+  }
+
+ private:
+  Factory factory_;
+  mutable T* ptr_;
+};
+
+#endif // LAZY_H
@@ -20,6 +20,7 @@
 #include "taskmanager.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
+#include "transcoder/transcodedfilecache.h"
 
 #include <QDir>
 #include <QFileInfo>
@@ -39,6 +40,7 @@ Organise::Organise(TaskManager* task_manager,
                      : thread_(NULL),
                        task_manager_(task_manager),
                        transcoder_(new Transcoder(this)),
+                       transcode_cache_(TranscodedFileCache::Instance()),
                        destination_(destination),
                        format_(format),
                        copy_(copy),
@@ -96,6 +98,7 @@ void Organise::ProcessSomeFiles() {
     }
 
     UpdateProgress();
+    transcode_cache_->SaveIndex();
 
     destination_->FinishCopy(files_with_errors_.isEmpty());
     if (eject_after_)
@@ -142,21 +145,8 @@ void Organise::ProcessSomeFiles() {
     if (!song.is_valid())
       continue;
 
-    // Maybe this file is one that's been transcoded already?
-    if (!task.transcoded_filename_.isEmpty()) {
-      qLog(Debug) << "This file has already been transcoded";
-
-      // Set the new filetype on the song so the formatter gets it right
-      song.set_filetype(task.new_filetype_);
-
-      // Fiddle the filename extension as well to match the new type
-      song.set_url(QUrl::fromLocalFile(FiddleFileExtension(song.url().toLocalFile(), task.new_extension_)));
-      song.set_basefilename(FiddleFileExtension(song.basefilename(), task.new_extension_));
-
-      // Have to set this to the size of the new file or else funny stuff happens
-      song.set_filesize(QFileInfo(task.transcoded_filename_).size());
-    } else {
-      // Figure out if we need to transcode it
+    // Figure out if we need to transcode it
+    if (task.transcoded_filename_.isEmpty()) {
       Song::FileType dest_type = CheckTranscode(song.filetype());
       if (dest_type != Song::Type_Unknown) {
         // Get the preset
@@ -168,17 +158,40 @@ void Organise::ProcessSomeFiles() {
                                     QString::number(transcode_suffix_++);
         task.new_extension_ = preset.extension_;
         task.new_filetype_ = dest_type;
-        tasks_transcoding_[task.filename_] = task;
+        task.cache_key_ = TranscodedFileCache::KeyForFile(task.filename_, preset);
+
+        // We might have transcoded this file with the same settings before,
+        // in which case we can skip the transcoder altogether.
+        if (transcode_cache_->CopyTo(task.cache_key_, task.transcoded_filename_)) {
+          qLog(Debug) << "Using cached transcode of" << task.filename_;
+        } else {
+          tasks_transcoding_[task.filename_] = task;
+
+          qLog(Debug) << "Transcoding to" << task.transcoded_filename_;
+
+          // Start the transcoding - this will happen in the background and
+          // FileTranscoded() will get called when it's done.  At that point the
+          // task will get re-added to the pending queue with the new filename.
+          transcoder_->AddJob(task.filename_, preset, task.transcoded_filename_);
+          transcoder_->Start();
+          continue;
+        }
+      }
+    }
 
-        qLog(Debug) << "Transcoding to" << task.transcoded_filename_;
+    // Maybe this file is one that's been transcoded already?
+    if (!task.transcoded_filename_.isEmpty()) {
+      qLog(Debug) << "This file has already been transcoded";
 
-        // Start the transcoding - this will happen in the background and
-        // FileTranscoded() will get called when it's done.  At that point the
-        // task will get re-added to the pending queue with the new filename.
-        transcoder_->AddJob(task.filename_, preset, task.transcoded_filename_);
-        transcoder_->Start();
-        continue;
-      }
+      // Set the new filetype on the song so the formatter gets it right
+      song.set_filetype(task.new_filetype_);
+
+      // Fiddle the filename extension as well to match the new type
+      song.set_url(QUrl::fromLocalFile(FiddleFileExtension(song.url().toLocalFile(), task.new_extension_)));
+      song.set_basefilename(FiddleFileExtension(song.basefilename(), task.new_extension_));
+
+      // Have to set this to the size of the new file or else funny stuff happens
+      song.set_filesize(QFileInfo(task.transcoded_filename_).size());
     }
 
     MusicStorage::CopyJob job;
@@ -281,6 +294,7 @@ void Organise::FileTranscoded(const QString& filename, bool success) {
   if (!success) {
     files_with_errors_ << filename;
   } else {
+    transcode_cache_->Insert(task.cache_key_, task.transcoded_filename_);
     tasks_pending_ << task;
   }
   QTimer::singleShot(0, this, SLOT(ProcessSomeFiles()));
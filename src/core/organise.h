@@ -29,6 +29,7 @@
 
 class MusicStorage;
 class TaskManager;
+class TranscodedFileCache;
 
 class Organise : public QObject {
   Q_OBJECT
@@ -72,12 +73,14 @@ private:
     QString transcoded_filename_;
     QString new_extension_;
     Song::FileType new_filetype_;
+    QString cache_key_;
   };
 
   QThread* thread_;
   QThread* original_thread_;
   TaskManager* task_manager_;
   Transcoder* transcoder_;
+  TranscodedFileCache* transcode_cache_;
   boost::shared_ptr<MusicStorage> destination_;
   QList<Song::FileType> supported_filetypes_;
 
@@ -26,11 +26,14 @@
 #include "playlist/playlist.h"
 #include "playlist/playlistitem.h"
 #include "playlist/playlistmanager.h"
+#include "playlist/playlistsequence.h"
+#include "playlist/queue.h"
 
 #ifdef HAVE_LIBLASTFM
 #  include "internet/lastfmservice.h"
 #endif
 
+#include <QTimer>
 #include <QtDebug>
 #include <QtConcurrentRun>
 
@@ -38,6 +41,8 @@
 
 using boost::shared_ptr;
 
+const int Player::kStandbyDelayMs = 1000;
+
 
 Player::Player(Application* app, QObject* parent)
   : PlayerInterface(parent),
@@ -46,10 +51,17 @@ Player::Player(Application* app, QObject* parent)
     engine_(new GstEngine(app_->task_manager())),
     stream_change_type_(Engine::First),
     last_state_(Engine::Empty),
+    standby_timer_(new QTimer(this)),
     volume_before_mute_(50)
 {
   settings_.beginGroup("Player");
 
+  // Wait for things to settle down before preparing the next track - a new
+  // track has just started or the playlist is being edited.
+  standby_timer_->setSingleShot(true);
+  standby_timer_->setInterval(kStandbyDelayMs);
+  connect(standby_timer_, SIGNAL(timeout()), SLOT(UpdateStandby()));
+
   SetVolume(settings_.value("volume", 50).toInt());
 
   connect(engine_.get(), SIGNAL(Error(QString)), SIGNAL(Error(QString)));
@@ -73,6 +85,11 @@ void Player::Init() {
 
   engine_->SetVolume(settings_.value("volume", 50).toInt());
 
+  connect(app_->playlist_manager(), SIGNAL(ActiveChanged(Playlist*)),
+          SLOT(ActivePlaylistChanged(Playlist*)));
+  connect(app_->playlist_manager(), SIGNAL(CurrentSongChanged(Song)),
+          SLOT(ScheduleStandbyUpdate()));
+
 #ifdef HAVE_LIBLASTFM
   lastfm_ = InternetModel::Service<LastFMService>();
 #endif
@@ -283,6 +300,8 @@ void Player::EngineStateChanged(Engine::State state) {
     case Engine::Idle: emit Stopped(); break;
   }
   last_state_ = state;
+
+  ScheduleStandbyUpdate();
 }
 
 void Player::SetVolume(int value) {
@@ -537,6 +556,78 @@ void Player::TrackAboutToEnd() {
                            next_item->Metadata().end_nanosec());
 }
 
+void Player::ActivePlaylistChanged(Playlist* playlist) {
+  // Anything that changes what next_row() returns: the order of the items,
+  // the queue, the shuffle and repeat modes and "stop after this track",
+  // which only shows up as a dataChanged.
+  connect(playlist, SIGNAL(PlaylistChanged()), SLOT(ScheduleStandbyUpdate()),
+          Qt::UniqueConnection);
+  connect(playlist, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+          SLOT(ScheduleStandbyUpdate()), Qt::UniqueConnection);
+  connect(playlist->queue(), SIGNAL(rowsInserted(QModelIndex,int,int)),
+          SLOT(ScheduleStandbyUpdate()), Qt::UniqueConnection);
+  connect(playlist->queue(), SIGNAL(rowsRemoved(QModelIndex,int,int)),
+          SLOT(ScheduleStandbyUpdate()), Qt::UniqueConnection);
+  connect(playlist->queue(), SIGNAL(layoutChanged()),
+          SLOT(ScheduleStandbyUpdate()), Qt::UniqueConnection);
+
+  PlaylistSequence* sequence = app_->playlist_manager()->sequence();
+  if (sequence) {
+    connect(sequence, SIGNAL(ShuffleModeChanged(PlaylistSequence::ShuffleMode)),
+            SLOT(ScheduleStandbyUpdate()), Qt::UniqueConnection);
+    connect(sequence, SIGNAL(RepeatModeChanged(PlaylistSequence::RepeatMode)),
+            SLOT(ScheduleStandbyUpdate()), Qt::UniqueConnection);
+  }
+
+  ScheduleStandbyUpdate();
+}
+
+void Player::ScheduleStandbyUpdate() {
+  // Don't restart the timer if it's already running, otherwise a steady
+  // stream of changes would stop it from ever firing.
+  if (!standby_timer_->isActive())
+    standby_timer_->start();
+}
+
+void Player::UpdateStandby() {
+  Playlist* playlist = app_->playlist_manager()->active();
+
+  if (!playlist || !current_item_ ||
+      (last_state_ != Engine::Playing && last_state_ != Engine::Paused)) {
+    engine_->ClearStandby();
+    return;
+  }
+
+  // We're going to stop instead of playing the next track.
+  if (playlist->stop_after_current()) {
+    engine_->ClearStandby();
+    return;
+  }
+
+  // URL handlers decide what plays next themselves, and can't be asked for a
+  // media URL without side effects.
+  if (url_handlers_.contains(current_item_->Url().scheme())) {
+    engine_->ClearStandby();
+    return;
+  }
+
+  // This is what Next() would play - it takes the queue and the shuffle order
+  // into account, and manual skips ignore "Repeat track".
+  const int next_row = playlist->next_row(true);
+  PlaylistItemPtr next_item;
+  if (next_row != -1)
+    next_item = playlist->item_at(next_row);
+
+  if (!next_item || url_handlers_.contains(next_item->Url().scheme())) {
+    engine_->ClearStandby();
+    return;
+  }
+
+  engine_->PrepareStandby(next_item->Url(),
+                          next_item->Metadata().has_cue(),
+                          next_item->Metadata().end_nanosec());
+}
+
 void Player::ValidSongRequested(const QUrl& url) {
   emit SongChangeRequestProcessed(url, true);
 }
@@ -32,6 +32,9 @@
 
 class Application;
 class LastFMService;
+class Playlist;
+
+class QTimer;
 
 
 class PlayerInterface : public QObject {
@@ -122,6 +125,8 @@ public:
 
   const UrlHandler* HandlerForUrl(const QUrl& url) const;
 
+  static const int kStandbyDelayMs;
+
 public slots:
   void ReloadSettings();
 
@@ -165,6 +170,12 @@ public slots:
   void UrlHandlerDestroyed(QObject* object);
   void HandleLoadResult(const UrlHandler::LoadResult& result);
 
+  // Keeps the engine's standby pipeline prepared for the track that Next()
+  // would play.
+  void ActivePlaylistChanged(Playlist* playlist);
+  void ScheduleStandbyUpdate();
+  void UpdateStandby();
+
  private:
   // Returns true if we were supposed to stop after this track.
   bool HandleStopAfter();
@@ -184,6 +195,8 @@ public slots:
 
   QUrl loading_async_;
 
+  QTimer* standby_timer_;
+
   int volume_before_mute_;
 };
 
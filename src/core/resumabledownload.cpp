@@ -0,0 +1,401 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "resumabledownload.h"
+#include "core/logging.h"
+
+#include <QNetworkAccessManager>
+#include <QRegExp>
+#include <QTimer>
+
+const char* ResumableDownload::kPartialSuffix = ".part";
+const char* ResumableDownload::kValidatorSuffix = ".validator";
+const int ResumableDownload::kMaxRedirects = 5;
+const int ResumableDownload::kMaxRetries = 5;
+const int ResumableDownload::kRetryDelayMsec = 2000;
+const int ResumableDownload::kReadBufferSize = 64 * 1024;
+const int ResumableDownload::kLimitedReadIntervalMsec = 100;
+
+
+BandwidthLimiter::BandwidthLimiter()
+  : bytes_per_sec_(0),
+    available_(0)
+{
+}
+
+void BandwidthLimiter::set_bytes_per_sec(int bytes_per_sec) {
+  bytes_per_sec_ = bytes_per_sec;
+  available_ = 0;
+  clock_.start();
+}
+
+qint64 BandwidthLimiter::Take(qint64 wanted) {
+  if (!is_limited())
+    return wanted;
+
+  // Never let more than a second's worth build up, otherwise a download that
+  // starts after a quiet period would get a big burst.
+  const int elapsed_msec = clock_.restart();
+  available_ = qMin(qint64(bytes_per_sec_),
+                    available_ + qint64(elapsed_msec) * bytes_per_sec_ / 1000);
+
+  const qint64 ret = qMin(wanted, available_);
+  available_ -= ret;
+  return ret;
+}
+
+
+ResumableDownload::ResumableDownload(QNetworkAccessManager* network,
+                                     const QUrl& url, const QString& filename,
+                                     QObject* parent)
+  : QObject(parent),
+    network_(network),
+    limiter_(NULL),
+    url_(url),
+    filename_(filename),
+    current_url_(url),
+    reply_(NULL),
+    offset_(0),
+    total_(-1),
+    response_checked_(false),
+    read_scheduled_(false),
+    finish_pending_(false),
+    redirects_remaining_(kMaxRedirects),
+    failures_(0),
+    retry_delay_msec_(kRetryDelayMsec)
+{
+}
+
+ResumableDownload::~ResumableDownload() {
+  // The partial file is left behind so the download can be resumed later.
+  AbortReply();
+}
+
+void ResumableDownload::Start() {
+  file_.setFileName(partial_filename());
+  if (!file_.open(QIODevice::ReadWrite)) {
+    Fail(tr("Could not open %1 for writing").arg(file_.fileName()), false);
+    return;
+  }
+
+  offset_ = file_.size();
+  if (offset_ > 0) {
+    QFile validator_file(validator_filename());
+    if (validator_file.open(QIODevice::ReadOnly))
+      validator_ = validator_file.readAll().trimmed();
+
+    if (validator_.isEmpty()) {
+      // There's no way to tell whether the partial file belongs to the same
+      // version of the file on the server, so don't trust it.
+      qLog(Info) << "Discarding partial download of" << url_
+                 << "- the server's validator is unknown";
+      file_.resize(0);
+      offset_ = 0;
+    } else {
+      qLog(Info) << "Resuming download of" << url_ << "from byte" << offset_;
+    }
+  }
+  file_.seek(offset_);
+
+  SendRequest();
+}
+
+void ResumableDownload::SendRequest() {
+  QNetworkRequest req(current_url_);
+  if (offset_ > 0) {
+    req.setRawHeader("Range", "bytes=" + QByteArray::number(offset_) + "-");
+
+    // The server sends the whole file instead if it changed since we started.
+    if (!validator_.isEmpty())
+      req.setRawHeader("If-Range", validator_);
+  }
+
+  response_checked_ = false;
+  finish_pending_ = false;
+
+  reply_ = network_->get(req);
+  reply_->setReadBufferSize(kReadBufferSize);
+  connect(reply_, SIGNAL(readyRead()), SLOT(ReadAvailable()));
+  connect(reply_, SIGNAL(finished()), SLOT(ReplyFinished()));
+}
+
+void ResumableDownload::AbortReply() {
+  if (!reply_)
+    return;
+
+  reply_->disconnect(this);
+  reply_->abort();
+  reply_->deleteLater();
+  reply_ = NULL;
+}
+
+bool ResumableDownload::CheckResponse() {
+  const int status =
+      reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+  if (status == 206) {
+    QRegExp re("bytes (\\d+)-(\\d+)/(\\d+|\\*)");
+    if (re.indexIn(reply_->rawHeader("Content-Range")) == -1 ||
+        re.cap(1).toLongLong() != offset_) {
+      // Not the part we asked for, so start again from the beginning.
+      qLog(Warning) << "Unexpected Content-Range"
+                    << reply_->rawHeader("Content-Range") << "when resuming"
+                    << url_ << "from byte" << offset_;
+      AbortReply();
+
+      file_.resize(0);
+      file_.seek(0);
+      offset_ = 0;
+      SetValidator(QByteArray());
+      Retry(tr("Unexpected Content-Range"));
+      return false;
+    }
+    total_ = re.cap(3) == "*" ? -1 : re.cap(3).toLongLong();
+  } else if (status == 200) {
+    if (offset_ > 0) {
+      qLog(Info) << "Can't resume" << url_ << "- downloading it again";
+      file_.resize(0);
+      file_.seek(0);
+      offset_ = 0;
+    }
+
+    const QVariant length = reply_->header(QNetworkRequest::ContentLengthHeader);
+    total_ = length.isValid() ? length.toLongLong() : -1;
+  } else {
+    // A redirect or an error page, ReplyFinished() deals with those.
+    return false;
+  }
+
+  if (reply_->hasRawHeader("ETag")) {
+    SetValidator(reply_->rawHeader("ETag"));
+  } else {
+    SetValidator(reply_->rawHeader("Last-Modified"));
+  }
+
+  response_checked_ = true;
+  return true;
+}
+
+void ResumableDownload::ScheduledRead() {
+  read_scheduled_ = false;
+  ReadAvailable();
+}
+
+void ResumableDownload::ReadAvailable() {
+  // Wait for the timer if the bandwidth limiter is holding us back.
+  if (!reply_ || read_scheduled_)
+    return;
+
+  if (!response_checked_ && !CheckResponse()) {
+    // Throw away the body of anything we don't want to keep.
+    if (reply_)
+      reply_->readAll();
+    return;
+  }
+
+  bool limited = false;
+  while (reply_->bytesAvailable() > 0) {
+    qint64 bytes = reply_->bytesAvailable();
+    if (limiter_) {
+      bytes = limiter_->Take(bytes);
+      if (bytes == 0) {
+        limited = true;
+        break;
+      }
+    }
+
+    const QByteArray data = reply_->read(bytes);
+    if (file_.write(data) != data.size()) {
+      Fail(tr("Could not write to %1").arg(file_.fileName()), true);
+      return;
+    }
+
+    offset_ += data.size();
+    failures_ = 0;
+  }
+
+  emit Progress(offset_, total_);
+
+  if (limited) {
+    // The rest of the data stays in the reply's buffer, which stops Qt reading
+    // any more from the socket until we make room for it.
+    read_scheduled_ = true;
+    QTimer::singleShot(kLimitedReadIntervalMsec, this, SLOT(ScheduledRead()));
+  } else if (finish_pending_) {
+    ReplyFinished();
+  }
+}
+
+void ResumableDownload::ReplyFinished() {
+  if (!reply_)
+    return;
+
+  const QVariant redirect =
+      reply_->attribute(QNetworkRequest::RedirectionTargetAttribute);
+  if (redirect.isValid()) {
+    const QUrl target = reply_->url().resolved(redirect.toUrl());
+    reply_->deleteLater();
+    reply_ = NULL;
+
+    if (redirects_remaining_-- <= 0) {
+      Fail(tr("Too many redirects"), true);
+      return;
+    }
+
+    current_url_ = target;
+    SendRequest();
+    return;
+  }
+
+  const QNetworkReply::NetworkError error = reply_->error();
+  if (error == QNetworkReply::NoError) {
+    // If there was no body ReadAvailable() was never called.
+    if (!response_checked_ && !CheckResponse()) {
+      if (reply_) {
+        Fail(tr("Unexpected HTTP status %1").arg(
+            reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()),
+             true);
+      }
+      return;
+    }
+
+    if (reply_->bytesAvailable() > 0) {
+      // The bandwidth limiter is holding back the rest of the data.
+      finish_pending_ = true;
+      return;
+    }
+  }
+
+  const int status =
+      reply_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  const QString error_string = reply_->errorString();
+  reply_->deleteLater();
+  reply_ = NULL;
+
+  if (status == 416 && offset_ > 0) {
+    // The partial file is bigger than the one on the server - it must have
+    // changed since.  Start again from the beginning.
+    file_.resize(0);
+    file_.seek(0);
+    offset_ = 0;
+    SetValidator(QByteArray());
+    Retry(error_string);
+    return;
+  }
+
+  if (error != QNetworkReply::NoError) {
+    if (IsTransientError(error)) {
+      Retry(error_string);
+    } else {
+      // Qt doesn't count 5xx responses as transient, but the server might
+      // well be back later, so keep what we have.
+      Fail(error_string, status >= 500);
+    }
+    return;
+  }
+
+  if (total_ != -1 && offset_ < total_) {
+    Retry(tr("The connection was closed after %1 of %2 bytes")
+          .arg(offset_).arg(total_));
+    return;
+  }
+
+  Complete();
+}
+
+void ResumableDownload::Retry(const QString& error_string) {
+  if (++failures_ > kMaxRetries) {
+    Fail(error_string, true);
+    return;
+  }
+
+  file_.flush();
+
+  const int delay_msec = retry_delay_msec_ * failures_;
+  qLog(Info) << "Download of" << url_ << "was interrupted at byte" << offset_
+             << "(" << error_string << ") - retrying in" << delay_msec << "ms";
+
+  // Redirects often point at short-lived URLs, so go back to the original.
+  current_url_ = url_;
+  redirects_remaining_ = kMaxRedirects;
+  QTimer::singleShot(delay_msec, this, SLOT(SendRequest()));
+}
+
+void ResumableDownload::Complete() {
+  file_.close();
+
+  if (!QFile::rename(partial_filename(), filename_)) {
+    Fail(tr("Could not rename %1 to %2").arg(partial_filename(), filename_),
+         true);
+    return;
+  }
+  QFile::remove(validator_filename());
+
+  emit Finished(true);
+}
+
+void ResumableDownload::Fail(const QString& error_string, bool keep_partial) {
+  qLog(Warning) << "Download of" << url_ << "failed:" << error_string;
+
+  error_string_ = error_string;
+  AbortReply();
+
+  file_.close();
+  if (!keep_partial)
+    RemovePartial();
+
+  emit Finished(false);
+}
+
+void ResumableDownload::SetValidator(const QByteArray& validator) {
+  if (validator == validator_)
+    return;
+  validator_ = validator;
+
+  if (validator_.isEmpty()) {
+    QFile::remove(validator_filename());
+    return;
+  }
+
+  QFile validator_file(validator_filename());
+  if (!validator_file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Could not write" << validator_filename();
+    return;
+  }
+  validator_file.write(validator_);
+}
+
+void ResumableDownload::RemovePartial() {
+  QFile::remove(partial_filename());
+  QFile::remove(validator_filename());
+}
+
+bool ResumableDownload::IsTransientError(QNetworkReply::NetworkError error) {
+  switch (error) {
+    case QNetworkReply::ConnectionRefusedError:
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::ProxyConnectionClosedError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::UnknownNetworkError:
+      return true;
+
+    default:
+      return false;
+  }
+}
@@ -0,0 +1,136 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RESUMABLEDOWNLOAD_H
+#define RESUMABLEDOWNLOAD_H
+
+#include <QFile>
+#include <QNetworkReply>
+#include <QObject>
+#include <QTime>
+#include <QUrl>
+
+class QNetworkAccessManager;
+
+// Shares a download rate between any number of ResumableDownloads.
+class BandwidthLimiter {
+ public:
+  BandwidthLimiter();
+
+  // 0 means unlimited.
+  void set_bytes_per_sec(int bytes_per_sec);
+  bool is_limited() const { return bytes_per_sec_ > 0; }
+
+  // Returns how many of the wanted bytes can be read right now.
+  qint64 Take(qint64 wanted);
+
+ private:
+  int bytes_per_sec_;
+  qint64 available_;
+  QTime clock_;
+};
+
+
+// Downloads a URL to a file.  The data is written to filename.part first and
+// only renamed when it's complete, so a download that was interrupted - even
+// by quitting Clementine - carries on from where it stopped next time, using
+// an HTTP Range request.  The server's ETag or Last-Modified header is kept in
+// filename.part.validator and sent with If-Range, so a partial file is never
+// resumed against a file that has changed.  Dropped connections are retried a
+// few times.
+class ResumableDownload : public QObject {
+  Q_OBJECT
+
+ public:
+  ResumableDownload(QNetworkAccessManager* network, const QUrl& url,
+                    const QString& filename, QObject* parent = 0);
+  ~ResumableDownload();
+
+  static const char* kPartialSuffix;
+  static const char* kValidatorSuffix;
+  static const int kMaxRedirects;
+  static const int kMaxRetries;
+  static const int kRetryDelayMsec;
+  static const int kReadBufferSize;
+  static const int kLimitedReadIntervalMsec;
+
+  const QUrl& url() const { return url_; }
+  const QString& filename() const { return filename_; }
+  QString partial_filename() const { return filename_ + kPartialSuffix; }
+  QString validator_filename() const { return partial_filename() + kValidatorSuffix; }
+  const QString& error_string() const { return error_string_; }
+
+  qint64 bytes_received() const { return offset_; }
+  qint64 bytes_total() const { return total_; }
+
+  // Not owned.  Can be NULL for no limit.
+  void set_bandwidth_limiter(BandwidthLimiter* limiter) { limiter_ = limiter; }
+
+  // The delay before the first retry.  Each retry after that waits longer.
+  void set_retry_delay_msec(int msec) { retry_delay_msec_ = msec; }
+
+ public slots:
+  void Start();
+
+ signals:
+  void Progress(qint64 received, qint64 total);
+  void Finished(bool success);
+
+ private slots:
+  void SendRequest();
+  void ReadAvailable();
+  void ScheduledRead();
+  void ReplyFinished();
+
+ private:
+  void AbortReply();
+  bool CheckResponse();
+  void Retry(const QString& error_string);
+  void Complete();
+  void Fail(const QString& error_string, bool keep_partial);
+
+  void SetValidator(const QByteArray& validator);
+  void RemovePartial();
+
+  static bool IsTransientError(QNetworkReply::NetworkError error);
+
+ private:
+  QNetworkAccessManager* network_;
+  BandwidthLimiter* limiter_;
+
+  const QUrl url_;
+  const QString filename_;
+
+  QUrl current_url_;
+  QNetworkReply* reply_;
+  QFile file_;
+
+  qint64 offset_;
+  qint64 total_;
+  QByteArray validator_;
+
+  bool response_checked_;
+  bool read_scheduled_;
+  bool finish_pending_;
+  int redirects_remaining_;
+  int failures_;
+  int retry_delay_msec_;
+
+  QString error_string_;
+};
+
+#endif // RESUMABLEDOWNLOAD_H
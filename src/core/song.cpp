@@ -54,6 +54,7 @@
 #include "core/logging.h"
 #include "core/messagehandler.h"
 #include "core/mpris_common.h"
+#include "core/stringpool.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
@@ -86,6 +87,8 @@ const QStringList Song::kFtsColumns = QStringList()
 const QString Song::kFtsColumnSpec = Song::kFtsColumns.join(", ");
 const QString Song::kFtsBindSpec = Utilities::Prepend(":", Song::kFtsColumns).join(", ");
 const QString Song::kFtsUpdateSpec = Utilities::Updateify(Song::kFtsColumns).join(", ");
+const QString Song::kFtsSourceColumnSpec =
+    "title, album, artist, albumartist, composer, performer, grouping, genre, comment";
 
 const QString Song::kManuallyUnsetCover = "(unset)";
 const QString Song::kEmbeddedCover = "(embedded)";
@@ -94,9 +97,26 @@ const QString Song::kEmbeddedCover = "(embedded)";
 struct Song::Private : public QSharedData {
   Private();
 
-  bool valid_;
-  int id_;
+  // The members are ordered by size, with the flags packed into bitfields at
+  // the end, so there's no padding between them.  There are a lot of these in
+  // memory when big playlists are open.
 
+  // The beginning of the song in seconds. In case of single-part media
+  // streams, this will equal to 0. In case of multi-part streams on the
+  // other hand, this will mark the beginning of a section represented by
+  // this Song object. This is always greater than 0.
+  qint64 beginning_;
+  // The end of the song in seconds. In case of single-part media
+  // streams, this will equal to the song's length. In case of multi-part
+  // streams on the other hand, this will mark the end of a section
+  // represented by this Song object.
+  // This may be negative indicating that the length of this song is
+  // unknown.
+  qint64 end_;
+
+  // Strings that are often the same in lots of songs (artist, album, genre,
+  // paths to art and CUE sheets...) are interned by InitFromQuery and
+  // InitFromProtobuf so that all the songs share one copy.
   QString title_;
   QString album_;
   QString artist_;
@@ -104,16 +124,28 @@ struct Song::Private : public QSharedData {
   QString composer_;
   QString performer_;
   QString grouping_;
+  QString genre_;
+  QString comment_;
+
+  QUrl url_;
+  QString basefilename_;
+
+  // If the song has a CUE, this contains it's path.
+  QString cue_path_;
+
+  // Filenames to album art for this song.
+  QString art_automatic_; // Guessed by LibraryWatcher
+  QString art_manual_;    // Set by the user - should take priority
+
+  QImage image_;
+
+  QString etag_;
+
+  int id_;
   int track_;
   int disc_;
   float bpm_;
   int year_;
-  QString genre_;
-  QString comment_;
-  bool compilation_;            // From the file tag
-  bool sampler_;                // From the library scanner
-  bool forced_compilation_on_;  // Set by the user
-  bool forced_compilation_off_; // Set by the user
 
   // A unique album ID 
   // Used to distinguish between albums from providers that have multiple
@@ -128,71 +160,46 @@ struct Song::Private : public QSharedData {
   int lastplayed_;
   int score_;
 
-  // The beginning of the song in seconds. In case of single-part media
-  // streams, this will equal to 0. In case of multi-part streams on the
-  // other hand, this will mark the beginning of a section represented by
-  // this Song object. This is always greater than 0.
-  qint64 beginning_;
-  // The end of the song in seconds. In case of single-part media
-  // streams, this will equal to the song's length. In case of multi-part
-  // streams on the other hand, this will mark the end of a section
-  // represented by this Song object.
-  // This may be negative indicating that the length of this song is
-  // unknown.
-  qint64 end_;
-
   int bitrate_;
   int samplerate_;
 
   int directory_id_;
-  QUrl url_;
-  QString basefilename_;
   int mtime_;
   int ctime_;
   int filesize_;
   FileType filetype_;
 
-  // If the song has a CUE, this contains it's path.
-  QString cue_path_;
-
-  // Filenames to album art for this song.
-  QString art_automatic_; // Guessed by LibraryWatcher
-  QString art_manual_;    // Set by the user - should take priority
-
-  QImage image_;
+  bool valid_ : 1;
+  bool compilation_ : 1;            // From the file tag
+  bool sampler_ : 1;                // From the library scanner
+  bool forced_compilation_on_ : 1;  // Set by the user
+  bool forced_compilation_off_ : 1; // Set by the user
 
   // Whether this song was loaded from a file using taglib.
-  bool init_from_file_;
+  bool init_from_file_ : 1;
   // Whether our encoding guesser thinks these tags might be incorrectly encoded.
-  bool suspicious_tags_;
+  bool suspicious_tags_ : 1;
 
   // Whether the song does not exist on the file system anymore, but is still
   // stored in the database so as to remember the user's metadata.
-  bool unavailable_;
-
-  QString etag_;
+  bool unavailable_ : 1;
 };
 
 
 Song::Private::Private()
-  : valid_(false),
+  : beginning_(0),
+    end_(-1),
     id_(-1),
     track_(-1),
     disc_(-1),
     bpm_(-1),
     year_(-1),
-    compilation_(false),
-    sampler_(false),
-    forced_compilation_on_(false),
-    forced_compilation_off_(false),
     album_id_(-1),
     rating_(-1.0),
     playcount_(0),
     skipcount_(0),
     lastplayed_(-1),
     score_(0),
-    beginning_(0),
-    end_(-1),
     bitrate_(-1),
     samplerate_(-1),
     directory_id_(-1),
@@ -200,6 +207,11 @@ Song::Private::Private()
     ctime_(-1),
     filesize_(-1),
     filetype_(Type_Unknown),
+    valid_(false),
+    compilation_(false),
+    sampler_(false),
+    forced_compilation_on_(false),
+    forced_compilation_off_(false),
     init_from_file_(false),
     suspicious_tags_(false),
     unavailable_(false)
@@ -207,6 +219,13 @@ Song::Private::Private()
 }
 
 
+namespace {
+
+StringPool sStringPool;
+
+}  // namespace
+
+
 Song::Song()
   : d(new Private)
 {
@@ -406,17 +425,17 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
   d->init_from_file_ = true;
   d->valid_ = pb.valid();
   d->title_ = QStringFromStdString(pb.title());
-  d->album_ = QStringFromStdString(pb.album());
-  d->artist_ = QStringFromStdString(pb.artist());
-  d->albumartist_ = QStringFromStdString(pb.albumartist());
-  d->composer_ = QStringFromStdString(pb.composer());
-  d->performer_ = QStringFromStdString(pb.performer());
-  d->grouping_ = QStringFromStdString(pb.grouping());
+  d->album_ = sStringPool.Intern(QStringFromStdString(pb.album()));
+  d->artist_ = sStringPool.Intern(QStringFromStdString(pb.artist()));
+  d->albumartist_ = sStringPool.Intern(QStringFromStdString(pb.albumartist()));
+  d->composer_ = sStringPool.Intern(QStringFromStdString(pb.composer()));
+  d->performer_ = sStringPool.Intern(QStringFromStdString(pb.performer()));
+  d->grouping_ = sStringPool.Intern(QStringFromStdString(pb.grouping()));
   d->track_ = pb.track();
   d->disc_ = pb.disc();
   d->bpm_ = pb.bpm();
   d->year_ = pb.year();
-  d->genre_ = QStringFromStdString(pb.genre());
+  d->genre_ = sStringPool.Intern(QStringFromStdString(pb.genre()));
   d->comment_ = QStringFromStdString(pb.comment());
   d->compilation_ = pb.compilation();
   d->playcount_ = pb.playcount();
@@ -436,7 +455,8 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
   d->etag_ = QStringFromStdString(pb.etag());
 
   if (pb.has_art_automatic()) {
-    d->art_automatic_ = QStringFromStdString(pb.art_automatic());
+    d->art_automatic_ = sStringPool.Intern(
+        QStringFromStdString(pb.art_automatic()));
   }
 
   if (pb.has_rating()) {
@@ -489,18 +509,19 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
   #define toint(n)      (q.value(n).isNull() ? -1 : q.value(n).toInt())
   #define tolonglong(n) (q.value(n).isNull() ? -1 : q.value(n).toLongLong())
   #define tofloat(n)    (q.value(n).isNull() ? -1 : q.value(n).toDouble())
+  #define tointerned(n) (sStringPool.Intern(tostr(n)))
 
   d->id_ = toint(col + 0);
   d->title_ = tostr(col + 1);
-  d->album_ = tostr(col + 2);
-  d->artist_ = tostr(col + 3);
-  d->albumartist_ = tostr(col + 4);
-  d->composer_ = tostr(col + 5);
+  d->album_ = tointerned(col + 2);
+  d->artist_ = tointerned(col + 3);
+  d->albumartist_ = tointerned(col + 4);
+  d->composer_ = tointerned(col + 5);
   d->track_ = toint(col + 6);
   d->disc_ = toint(col + 7);
   d->bpm_ = tofloat(col + 8);
   d->year_ = toint(col + 9);
-  d->genre_ = tostr(col + 10);
+  d->genre_ = tointerned(col + 10);
   d->comment_ = tostr(col + 11);
   d->compilation_ = q.value(col + 12).toBool();
 
@@ -516,8 +537,8 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
 
   d->sampler_ = q.value(col + 20).toBool();
 
-  d->art_automatic_ = q.value(col + 21).toString();
-  d->art_manual_ = q.value(col + 22).toString();
+  d->art_automatic_ = sStringPool.Intern(q.value(col + 21).toString());
+  d->art_manual_ = sStringPool.Intern(q.value(col + 22).toString());
 
   d->filetype_ = FileType(q.value(col + 23).toInt());
   d->playcount_ = q.value(col + 24).isNull() ? 0 : q.value(col + 24).toInt();
@@ -537,19 +558,20 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
   d->beginning_ = q.value(col + 32).isNull() ? 0 : q.value(col + 32).toLongLong();
   set_length_nanosec(tolonglong(col + 33));
 
-  d->cue_path_ = tostr(col + 34);
+  d->cue_path_ = tointerned(col + 34);
   d->unavailable_ = q.value(col + 35).toBool();
 
   // effective_albumartist = 36
   // etag = 37
 
-  d->performer_ = tostr(col + 38);
-  d->grouping_ = tostr(col + 39);
+  d->performer_ = tointerned(col + 38);
+  d->grouping_ = tointerned(col + 39);
 
   #undef tostr
   #undef toint
   #undef tolonglong
   #undef tofloat
+  #undef tointerned
 }
 
 void Song::InitFromFilePartial(const QString& filename) {
@@ -69,6 +69,10 @@ class Song {
   static const QString kFtsBindSpec;
   static const QString kFtsUpdateSpec;
 
+  // The songs table columns that the FTS columns are built from, in the same
+  // order as kFtsColumns.
+  static const QString kFtsSourceColumnSpec;
+
   static const QString kManuallyUnsetCover;
   static const QString kEmbeddedCover;
 
@@ -42,7 +42,7 @@
 #include "library/librarybackend.h"
 #include "library/sqlrow.h"
 #include "playlistparsers/parserbase.h"
-#include "playlistparsers/cueparser.h"
+#include "playlistparsers/cuecache.h"
 #include "playlistparsers/playlistparser.h"
 #include "podcasts/podcastparser.h"
 #include "podcasts/podcastservice.h"
@@ -57,7 +57,6 @@ SongLoader::SongLoader(LibraryBackendInterface* library, QObject *parent)
     timeout_timer_(new QTimer(this)),
     playlist_parser_(new PlaylistParser(library, this)),
     podcast_parser_(new PodcastParser),
-    cue_parser_(new CueParser(library, this)),
     timeout_(kDefaultTimeout),
     state_(WaitingForType),
     success_(false),
@@ -278,10 +277,7 @@ SongLoader::Result SongLoader::LoadLocal(const QString& filename) {
 
     if (QFile::exists(matching_cue)) {
       // it's a cue - create virtual tracks
-      QFile cue(matching_cue);
-      cue.open(QIODevice::ReadOnly);
-
-      song_list = cue_parser_->Load(&cue, matching_cue, QDir(filename.section('/', 0, -2)));
+      song_list = CueCache::Instance()->Load(matching_cue, library_);
     } else {
       // it's a normal media file, load it asynchronously.
       TagReaderReply* reply = TagReaderClient::Instance()->ReadFile(filename);
@@ -30,7 +30,6 @@
 
 #include <gst/gst.h>
 
-class CueParser;
 class LibraryBackendInterface;
 class ParserBase;
 class PlaylistParser;
@@ -119,7 +118,6 @@ private:
   QTimer* timeout_timer_;
   PlaylistParser* playlist_parser_;
   PodcastParser* podcast_parser_;
-  CueParser* cue_parser_;
 
   // For async loads
   int timeout_;
@@ -0,0 +1,276 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sqlprofiler.h"
+#include "core/logging.h"
+#include "core/tracer.h"
+
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QtAlgorithms>
+
+#include <qjson/serializer.h>
+
+const int SqlProfiler::kHistogramLimitsUsec[] = {
+  100, 1000, 10000, 100000, 1000000
+};
+const int SqlProfiler::kHistogramBucketCount =
+    sizeof(kHistogramLimitsUsec) / sizeof(kHistogramLimitsUsec[0]) + 1;
+
+const int SqlProfiler::kDefaultSlowQueryMsec = 50;
+const int SqlProfiler::kMaxNormalizedCacheSize = 10000;
+
+namespace {
+
+bool CompareTotalTime(const SqlProfiler::QueryStats& a,
+                      const SqlProfiler::QueryStats& b) {
+  return a.total_usec_ > b.total_usec_;
+}
+
+QString FormatMsec(qint64 usec) {
+  return QString::number(double(usec) / 1000, 'f', 1);
+}
+
+}  // namespace
+
+
+SqlProfiler::QueryStats::QueryStats()
+  : calls_(0),
+    total_usec_(0),
+    max_usec_(0),
+    rows_(0),
+    total_wait_usec_(0),
+    max_wait_usec_(0)
+{
+  for (int i=0 ; i<kHistogramBucketCount ; ++i) {
+    histogram_ << 0;
+  }
+}
+
+
+SqlProfiler::SqlProfiler()
+  : enabled_(false),
+    slow_query_msec_(kDefaultSlowQueryMsec)
+{
+}
+
+void SqlProfiler::Start() {
+  QMutexLocker l(&mutex_);
+  stats_.clear();
+  enabled_ = true;
+  qLog(Info) << "SQL profiling started";
+}
+
+void SqlProfiler::Stop() {
+  QMutexLocker l(&mutex_);
+  enabled_ = false;
+  normalized_cache_.clear();
+  qLog(Info) << "SQL profiling stopped";
+}
+
+SqlProfiler::ThreadState* SqlProfiler::CurrentThreadState() {
+  if (!thread_state_.hasLocalData()) {
+    thread_state_.setLocalData(new ThreadState);
+  }
+  return thread_state_.localData();
+}
+
+void SqlProfiler::LockRequested() {
+  CurrentThreadState()->lock_requested_usec_ = Tracer::NowUsec();
+}
+
+void SqlProfiler::LockAcquired() {
+  ThreadState* state = CurrentThreadState();
+  if (state->lock_requested_usec_ == -1)
+    return;
+
+  state->pending_wait_usec_ += Tracer::NowUsec() - state->lock_requested_usec_;
+  state->lock_requested_usec_ = -1;
+}
+
+void SqlProfiler::RowReturned(const void* statement) {
+  CurrentThreadState()->row_counts_[statement] ++;
+}
+
+qint64 SqlProfiler::TakeRowCount(const void* statement) {
+  return CurrentThreadState()->row_counts_.take(statement);
+}
+
+QString SqlProfiler::Normalize(const QString& sql) {
+  QString ret = sql.simplified();
+
+  // String literals first, so numbers inside them don't get matched.
+  ret.replace(QRegExp("'([^']|'')*'"), "?");
+  ret.replace(QRegExp("\\b\\d+(\\.\\d+)?\\b"), "?");
+
+  // Named placeholders, so they look the same as positional ones.
+  ret.replace(QRegExp(":[A-Za-z_]\\w*"), "?");
+
+  // Lists of IDs vary in length.
+  ret.replace(QRegExp("\\(\\s*\\?(\\s*,\\s*\\?)+\\s*\\)"), "(?, ...)");
+
+  return ret;
+}
+
+void SqlProfiler::AddQuery(const QString& sql, qint64 usec, qint64 rows) {
+  if (!enabled_)
+    return;
+
+  ThreadState* state = CurrentThreadState();
+  const qint64 wait_usec = state->pending_wait_usec_;
+  state->pending_wait_usec_ = 0;
+
+  QMutexLocker l(&mutex_);
+
+  // Our own EXPLAIN queries would only get in the way.
+  if (sql.startsWith("EXPLAIN ", Qt::CaseInsensitive))
+    return;
+
+  QHash<QString, QString>::const_iterator cached =
+      normalized_cache_.constFind(sql);
+  QString normalized;
+  if (cached != normalized_cache_.constEnd()) {
+    normalized = cached.value();
+  } else {
+    normalized = Normalize(sql);
+    if (normalized_cache_.count() >= kMaxNormalizedCacheSize)
+      normalized_cache_.clear();
+    normalized_cache_[sql] = normalized;
+  }
+
+  QueryStats& stats = stats_[normalized];
+  if (stats.calls_ == 0)
+    stats.normalized_sql_ = normalized;
+
+  stats.calls_ ++;
+  stats.total_usec_ += usec;
+  stats.total_wait_usec_ += wait_usec;
+  stats.max_wait_usec_ = qMax(stats.max_wait_usec_, wait_usec);
+
+  if (rows == -1 || stats.rows_ == -1) {
+    stats.rows_ = -1;
+  } else {
+    stats.rows_ += rows;
+  }
+
+  if (usec >= stats.max_usec_) {
+    stats.max_usec_ = usec;
+    stats.slowest_sql_ = sql;
+  }
+
+  int bucket = 0;
+  while (bucket < kHistogramBucketCount - 1 &&
+         usec >= kHistogramLimitsUsec[bucket]) {
+    bucket ++;
+  }
+  stats.histogram_[bucket] ++;
+}
+
+SqlProfiler::QueryStatsList SqlProfiler::Stats() const {
+  QueryStatsList ret;
+  {
+    QMutexLocker l(&mutex_);
+    ret = stats_.values();
+  }
+
+  qSort(ret.begin(), ret.end(), CompareTotalTime);
+  return ret;
+}
+
+QString SqlProfiler::FormatReport(const QueryStatsList& stats,
+                                  int slow_query_msec) {
+  int calls = 0;
+  qint64 total_usec = 0;
+  foreach (const QueryStats& query, stats) {
+    calls += query.calls_;
+    total_usec += query.total_usec_;
+  }
+
+  QStringList lines;
+  lines << QString("%1 queries (%2 different) took %3 ms")
+           .arg(calls).arg(stats.count()).arg(FormatMsec(total_usec));
+  lines << QString();
+  lines << "calls\ttotal ms\tmean ms\tmax ms\trows\twait ms\tquery";
+
+  foreach (const QueryStats& query, stats) {
+    lines << QString("%1\t%2\t%3\t%4\t%5\t%6\t%7").arg(
+               QString::number(query.calls_),
+               FormatMsec(query.total_usec_),
+               FormatMsec(query.total_usec_ / query.calls_),
+               FormatMsec(query.max_usec_),
+               query.rows_ == -1 ? QString("?") : QString::number(query.rows_),
+               FormatMsec(query.total_wait_usec_),
+               query.normalized_sql_);
+  }
+
+  foreach (const QueryStats& query, stats) {
+    if (query.max_usec_ < qint64(slow_query_msec) * 1000)
+      continue;
+
+    lines << QString();
+    lines << QString("Slowest call took %1 ms: %2")
+             .arg(FormatMsec(query.max_usec_), query.slowest_sql_);
+    foreach (const QString& step, query.query_plan_) {
+      lines << "  " + step;
+    }
+  }
+
+  return lines.join("\n");
+}
+
+QByteArray SqlProfiler::ToJson(const QueryStatsList& stats,
+                               int slow_query_msec) {
+  QVariantList limits;
+  for (int i=0 ; i<kHistogramBucketCount - 1 ; ++i) {
+    limits << kHistogramLimitsUsec[i];
+  }
+
+  QVariantList queries;
+  foreach (const QueryStats& query, stats) {
+    QVariantList histogram;
+    foreach (int count, query.histogram_) {
+      histogram << count;
+    }
+
+    QVariantMap q;
+    q["sql"] = query.normalized_sql_;
+    q["calls"] = query.calls_;
+    q["total_usec"] = query.total_usec_;
+    q["max_usec"] = query.max_usec_;
+    q["rows"] = query.rows_;
+    q["total_wait_usec"] = query.total_wait_usec_;
+    q["max_wait_usec"] = query.max_wait_usec_;
+    q["histogram"] = histogram;
+
+    if (query.max_usec_ >= qint64(slow_query_msec) * 1000) {
+      q["slowest_sql"] = query.slowest_sql_;
+      q["query_plan"] = query.query_plan_;
+    }
+
+    queries << q;
+  }
+
+  QVariantMap root;
+  root["slow_query_msec"] = slow_query_msec;
+  root["histogram_limits_usec"] = limits;
+  root["queries"] = queries;
+
+  QJson::Serializer serializer;
+  return serializer.serialize(root);
+}
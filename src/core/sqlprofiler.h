@@ -0,0 +1,117 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SQLPROFILER_H
+#define SQLPROFILER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadStorage>
+
+// Collects statistics about every SQL statement that's run, grouped by the
+// statement's text with any literal values taken out.  Database feeds it from
+// SQLite's profiling callback while it's enabled.  Thread-safe.
+class SqlProfiler {
+ public:
+  SqlProfiler();
+
+  // Upper bounds of the latency histogram's buckets.  There's one more bucket
+  // after these for anything slower.
+  static const int kHistogramLimitsUsec[];
+  static const int kHistogramBucketCount;
+
+  static const int kDefaultSlowQueryMsec;
+  static const int kMaxNormalizedCacheSize;
+
+  struct QueryStats {
+    QueryStats();
+
+    QString normalized_sql_;
+
+    // The slowest call, with its literal values still in.
+    QString slowest_sql_;
+
+    int calls_;
+    qint64 total_usec_;
+    qint64 max_usec_;
+
+    // -1 if this version of SQLite can't tell us.
+    qint64 rows_;
+
+    // Time spent waiting for Database::Mutex() before the query.
+    qint64 total_wait_usec_;
+    qint64 max_wait_usec_;
+
+    QList<int> histogram_;
+
+    // Filled in by Database::ProfileResults() for slow queries.
+    QStringList query_plan_;
+  };
+  typedef QList<QueryStats> QueryStatsList;
+
+  bool is_enabled() const { return enabled_; }
+  void Start();
+  void Stop();
+
+  int slow_query_msec() const { return slow_query_msec_; }
+  void set_slow_query_msec(int msec) { slow_query_msec_ = msec; }
+
+  // Called on the thread that's about to lock Database::Mutex(), and when the
+  // lock has been acquired.  The time in between is added to the next query
+  // on that thread.
+  void LockRequested();
+  void LockAcquired();
+
+  // Counts the rows returned by a statement that's still running.
+  void RowReturned(const void* statement);
+  qint64 TakeRowCount(const void* statement);
+
+  // Called by Database after each statement finishes.  rows is -1 if unknown.
+  void AddQuery(const QString& sql, qint64 usec, qint64 rows);
+
+  // Sorted by total time, slowest first.
+  QueryStatsList Stats() const;
+
+  static QString Normalize(const QString& sql);
+
+  static QString FormatReport(const QueryStatsList& stats, int slow_query_msec);
+  static QByteArray ToJson(const QueryStatsList& stats, int slow_query_msec);
+
+ private:
+  struct ThreadState {
+    ThreadState() : lock_requested_usec_(-1), pending_wait_usec_(0) {}
+
+    qint64 lock_requested_usec_;
+    qint64 pending_wait_usec_;
+    QHash<const void*, qint64> row_counts_;
+  };
+
+  ThreadState* CurrentThreadState();
+
+  bool enabled_;
+  int slow_query_msec_;
+
+  mutable QMutex mutex_;
+  QHash<QString, QueryStats> stats_;
+  QHash<QString, QString> normalized_cache_;
+
+  QThreadStorage<ThreadState*> thread_state_;
+};
+
+#endif // SQLPROFILER_H
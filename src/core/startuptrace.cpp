@@ -0,0 +1,153 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "startuptrace.h"
+#include "core/logging.h"
+#include "core/tracer.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QThread>
+#include <QTimer>
+#include <QWidget>
+
+#include <cstdio>
+#include <cstdlib>
+
+const char* StartupTrace::kBenchmarkEnvironmentVariable =
+    "CLEMENTINE_STARTUP_BENCHMARK";
+
+StartupTrace* StartupTrace::Instance() {
+  static StartupTrace* sInstance = NULL;
+  if (!sInstance) {
+    sInstance = new StartupTrace;
+  }
+  return sInstance;
+}
+
+StartupTrace::StartupTrace()
+  : painted_(false)
+{
+  clock_.start();
+}
+
+void StartupTrace::Start() {
+  clock_.start();
+  components_.clear();
+  open_components_.clear();
+  painted_ = false;
+}
+
+bool StartupTrace::IsGuiThread() const {
+  // There might not be a QCoreApplication yet this early in main().
+  return !QCoreApplication::instance() ||
+         QThread::currentThread() == QCoreApplication::instance()->thread();
+}
+
+void StartupTrace::Begin(const char* name) {
+  if (!IsGuiThread())
+    return;
+
+  Component component;
+  component.name_ = name;
+  component.depth_ = open_components_.count();
+  component.start_msec_ = clock_.elapsed();
+  component.start_usec_ = Tracer::is_enabled() ? Tracer::NowUsec() : -1;
+  component.total_msec_ = 0;
+  component.children_msec_ = 0;
+
+  open_components_.push(components_.count());
+  components_ << component;
+}
+
+void StartupTrace::End() {
+  if (!IsGuiThread() || open_components_.isEmpty())
+    return;
+
+  const int index = open_components_.pop();
+  Component& component = components_[index];
+  component.total_msec_ = clock_.elapsed() - component.start_msec_;
+
+  if (component.start_usec_ != -1)
+    Tracer::AddEvent("startup", component.name_, component.start_usec_);
+
+  if (!open_components_.isEmpty()) {
+    components_[open_components_.top()].children_msec_ += component.total_msec_;
+  }
+
+  if (painted_ && open_components_.isEmpty()) {
+    // Things that are created after the window has been shown are logged on
+    // their own.
+    qLog(Debug) << "Started" << component.name_ << "in"
+                << component.total_msec_ << "ms after the first paint";
+    components_.erase(components_.begin() + index, components_.end());
+  }
+}
+
+void StartupTrace::WatchForFirstPaint(QWidget* widget) {
+  widget_ = widget;
+  widget->installEventFilter(this);
+}
+
+void StartupTrace::ReportIfHidden() {
+  if (painted_ || !widget_ || widget_->isVisible())
+    return;
+
+  widget_->removeEventFilter(this);
+  painted_ = true;
+  Report(false);
+}
+
+bool StartupTrace::eventFilter(QObject* object, QEvent* event) {
+  if (event->type() == QEvent::Paint && !painted_) {
+    object->removeEventFilter(this);
+    painted_ = true;
+    Report(true);
+    emit FirstPaint();
+  }
+  return QObject::eventFilter(object, event);
+}
+
+void StartupTrace::Report(bool painted) {
+  const int first_paint_msec = clock_.elapsed();
+
+  qLog(Debug) << "Startup trace (total / own time):";
+  foreach (const Component& component, components_) {
+    qLog(Debug) << QString(component.depth_ * 2, ' ') + component.name_
+                << component.total_msec_ << "ms /"
+                << (component.total_msec_ - component.children_msec_) << "ms";
+  }
+  if (painted) {
+    qLog(Info) << "First paint after" << first_paint_msec << "ms";
+  } else {
+    qLog(Info) << "Main window is hidden after" << first_paint_msec << "ms";
+  }
+
+  components_.clear();
+
+  if (getenv(kBenchmarkEnvironmentVariable)) {
+    if (painted) {
+      printf("time_to_first_paint_msec %d\n", first_paint_msec);
+      fflush(stdout);
+      QTimer::singleShot(0, QCoreApplication::instance(), SLOT(quit()));
+    } else {
+      // Otherwise the benchmark would never finish.
+      fprintf(stderr, "The main window started hidden, so it wasn't painted\n");
+      QCoreApplication::exit(1);
+    }
+  }
+}
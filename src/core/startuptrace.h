@@ -0,0 +1,98 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QStack>
+#include <QTime>
+
+class QWidget;
+
+// Records how long each component takes to initialise while Clementine starts
+// up, and logs a report when the main window is first painted.  Components
+// are also added to the Tracer if it's running.
+//
+// If the CLEMENTINE_STARTUP_BENCHMARK environment variable is set Clementine
+// prints the time to first paint on stdout and exits straight away, which is
+// handy for measuring startup time in automated tests.  If the window started
+// hidden in the tray it exits with an error instead, since there's nothing to
+// measure.
+class StartupTrace : public QObject {
+  Q_OBJECT
+
+ public:
+  static StartupTrace* Instance();
+
+  static const char* kBenchmarkEnvironmentVariable;
+
+  // Starts the clock.  Call this as early as possible in main().
+  void Start();
+  int elapsed_msec() const { return clock_.elapsed(); }
+
+  // Marks the start and end of a component's initialisation.  These can be
+  // nested - time spent in a nested component isn't counted in its parent's
+  // own time.  Calls from threads other than the GUI thread are ignored.
+  void Begin(const char* name);
+  void End();
+
+  // Reports the trace the first time this widget is painted.
+  void WatchForFirstPaint(QWidget* widget);
+  bool has_painted() const { return painted_; }
+
+  // Reports the trace now if the widget is hidden and so won't be painted.
+  void ReportIfHidden();
+
+ signals:
+  void FirstPaint();
+
+ protected:
+  bool eventFilter(QObject* object, QEvent* event);
+
+ private:
+  StartupTrace();
+  bool IsGuiThread() const;
+  void Report(bool painted);
+
+  struct Component {
+    const char* name_;
+    int depth_;
+    int start_msec_;
+    qint64 start_usec_;
+    int total_msec_;
+    int children_msec_;
+  };
+
+  QTime clock_;
+  QList<Component> components_;
+  QStack<int> open_components_;
+
+  QPointer<QWidget> widget_;
+  bool painted_;
+};
+
+// Times the enclosing scope as a component in the startup trace.
+class StartupTraceScope {
+ public:
+  StartupTraceScope(const char* name) { StartupTrace::Instance()->Begin(name); }
+  ~StartupTraceScope() { StartupTrace::Instance()->End(); }
+};
+
+#endif // STARTUPTRACE_H
@@ -0,0 +1,69 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stringpool.h"
+
+#include <QMutexLocker>
+
+const int StringPool::kMinPurgeSize = 1024;
+
+StringPool::StringPool()
+  : purge_size_(kMinPurgeSize)
+{
+}
+
+QString StringPool::Intern(const QString& s) {
+  // The null and empty strings are shared by Qt already.
+  if (s.isEmpty())
+    return s;
+
+  QMutexLocker l(&mutex_);
+
+  QSet<QString>::const_iterator it = strings_.constFind(s);
+  if (it != strings_.constEnd())
+    return *it;
+
+  if (strings_.count() >= purge_size_) {
+    PurgeLocked();
+    purge_size_ = qMax(kMinPurgeSize, strings_.count() * 2);
+  }
+
+  strings_.insert(s);
+  return s;
+}
+
+void StringPool::Purge() {
+  QMutexLocker l(&mutex_);
+  PurgeLocked();
+}
+
+void StringPool::PurgeLocked() {
+  QSet<QString>::iterator it = strings_.begin();
+  while (it != strings_.end()) {
+    // A detached string has a reference count of 1, so it's only in the pool.
+    if (it->isDetached()) {
+      it = strings_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+int StringPool::count() const {
+  QMutexLocker l(&mutex_);
+  return strings_.count();
+}
@@ -0,0 +1,56 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+// Interns strings so that equal values share a single implicitly shared
+// buffer.  Useful for things like artist and album names, where the same few
+// thousand strings are repeated in hundreds of thousands of songs.
+//
+// Strings that nothing outside the pool refers to any more are dropped every
+// time the pool doubles in size.  All methods are thread-safe.
+class StringPool {
+ public:
+  StringPool();
+
+  static const int kMinPurgeSize;
+
+  // Returns a string equal to s that shares its data with any other string
+  // previously returned for the same value.
+  QString Intern(const QString& s);
+
+  // Forgets about strings that are only referenced by the pool.
+  void Purge();
+
+  int count() const;
+
+ private:
+  Q_DISABLE_COPY(StringPool);
+
+  void PurgeLocked();
+
+  mutable QMutex mutex_;
+  QSet<QString> strings_;
+  int purge_size_;
+};
+
+#endif // STRINGPOOL_H
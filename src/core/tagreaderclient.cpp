@@ -16,6 +16,7 @@
 */
 
 #include "tagreaderclient.h"
+#include "core/tracer.h"
 
 #include <QCoreApplication>
 #include <QFile>
@@ -43,6 +44,15 @@ void TagReaderClient::Start() {
   worker_pool_->Start();
 }
 
+TagReaderReply* TagReaderClient::SendRequest(pb::tagreader::Message* message,
+                                             const char* name,
+                                             const QString& detail) {
+  TagReaderReply* reply = worker_pool_->SendMessageWithReply(message);
+  Tracer::AddEventUntil(reply, SIGNAL(Finished(bool)), "tagreader", name,
+                        detail);
+  return reply;
+}
+
 void TagReaderClient::WorkerFailedToStart() {
   qLog(Error) << "The" << kWorkerExecutableName << "executable was not found"
               << "in the current directory or on the PATH.  Clementine will"
@@ -55,7 +65,7 @@ TagReaderReply* TagReaderClient::ReadFile(const QString& filename) {
 
   req->set_filename(DataCommaSizeFromQString(filename));
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return SendRequest(&message, "TagReaderClient::ReadFile", filename);
 }
 
 TagReaderReply* TagReaderClient::SaveFile(const QString& filename, const Song& metadata) {
@@ -65,7 +75,7 @@ TagReaderReply* TagReaderClient::SaveFile(const QString& filename, const Song& m
   req->set_filename(DataCommaSizeFromQString(filename));
   metadata.ToProtobuf(req->mutable_metadata());
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return SendRequest(&message, "TagReaderClient::SaveFile", filename);
 }
 
 TagReaderReply* TagReaderClient::UpdateSongStatistics(const Song& metadata) {
@@ -76,7 +86,8 @@ TagReaderReply* TagReaderClient::UpdateSongStatistics(const Song& metadata) {
   req->set_filename(DataCommaSizeFromQString(metadata.url().toLocalFile()));
   metadata.ToProtobuf(req->mutable_metadata());
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return SendRequest(&message, "TagReaderClient::UpdateSongStatistics",
+                     metadata.url().toLocalFile());
 }
 
 void TagReaderClient::UpdateSongsStatistics(const SongList& songs) {
@@ -94,7 +105,8 @@ TagReaderReply* TagReaderClient::UpdateSongRating(const Song& metadata) {
   req->set_filename(DataCommaSizeFromQString(metadata.url().toLocalFile()));
   metadata.ToProtobuf(req->mutable_metadata());
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return SendRequest(&message, "TagReaderClient::UpdateSongRating",
+                     metadata.url().toLocalFile());
 }
 
 void TagReaderClient::UpdateSongsRating(const SongList& songs) {
@@ -110,7 +122,7 @@ TagReaderReply* TagReaderClient::IsMediaFile(const QString& filename) {
 
   req->set_filename(DataCommaSizeFromQString(filename));
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return SendRequest(&message, "TagReaderClient::IsMediaFile", filename);
 }
 
 TagReaderReply* TagReaderClient::LoadEmbeddedArt(const QString& filename) {
@@ -119,7 +131,7 @@ TagReaderReply* TagReaderClient::LoadEmbeddedArt(const QString& filename) {
 
   req->set_filename(DataCommaSizeFromQString(filename));
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return SendRequest(&message, "TagReaderClient::LoadEmbeddedArt", filename);
 }
 
 TagReaderReply* TagReaderClient::ReadCloudFile(const QUrl& download_url,
@@ -138,7 +150,7 @@ TagReaderReply* TagReaderClient::ReadCloudFile(const QUrl& download_url,
   req->set_mime_type(DataCommaSizeFromQString(mime_type));
   req->set_authorisation_header(DataCommaSizeFromQString(authorisation_header));
 
-  return worker_pool_->SendMessageWithReply(&message);
+  return SendRequest(&message, "TagReaderClient::ReadCloudFile", title);
 }
 
 void TagReaderClient::ReadFileBlocking(const QString& filename, Song* song) {
@@ -74,6 +74,9 @@ private slots:
   void WorkerFailedToStart();
 
 private:
+  ReplyType* SendRequest(pb::tagreader::Message* message, const char* name,
+                         const QString& detail);
+
   static TagReaderClient* sInstance;
 
   WorkerPool<HandlerType>* worker_pool_;
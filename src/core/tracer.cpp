@@ -0,0 +1,336 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tracer.h"
+#include "core/logging.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+
+#ifdef Q_OS_WIN32
+# include <windows.h>
+#else
+# include <sys/time.h>
+#endif
+
+const int Tracer::kMaxEvents = 1000000;
+
+QAtomicInt Tracer::sEnabled(0);
+
+namespace {
+
+struct Event {
+  char phase_;
+  const char* category_;
+  const char* name_;
+  QString detail_;
+  qint64 start_usec_;
+  qint64 duration_usec_;
+  int thread_;
+  int async_id_;
+};
+
+struct TraceData {
+  TraceData() : start_usec_(0), next_async_id_(1), dropped_(0) {}
+
+  QMutex mutex_;
+  qint64 start_usec_;
+  QList<Event> events_;
+  QHash<QThread*, int> thread_ids_;
+  QStringList thread_names_;
+  int next_async_id_;
+  int dropped_;
+};
+
+TraceData* Data() {
+  static TraceData* sData = new TraceData;
+  return sData;
+}
+
+// Must be called with the mutex locked.
+int CurrentThreadId(TraceData* data) {
+  QThread* thread = QThread::currentThread();
+
+  QHash<QThread*, int>::const_iterator it = data->thread_ids_.constFind(thread);
+  if (it != data->thread_ids_.constEnd())
+    return it.value();
+
+  const int id = data->thread_names_.count();
+  QString name = thread->objectName();
+  if (QCoreApplication::instance() &&
+      thread == QCoreApplication::instance()->thread()) {
+    name = "Main thread";
+  } else if (name.isEmpty()) {
+    name = QString("Thread %1").arg(id);
+  }
+
+  data->thread_ids_[thread] = id;
+  data->thread_names_ << name;
+  return id;
+}
+
+// Must be called with the mutex locked.
+void AddLocked(TraceData* data, const Event& event) {
+  if (data->events_.count() >= Tracer::kMaxEvents) {
+    data->dropped_ ++;
+    return;
+  }
+  data->events_ << event;
+}
+
+QString Escape(const QString& s) {
+  QString ret;
+  ret.reserve(s.length());
+  foreach (const QChar& c, s) {
+    switch (c.unicode()) {
+      case '"':  ret += "\\\""; break;
+      case '\\': ret += "\\\\"; break;
+      case '\n': ret += "\\n";  break;
+      case '\r': ret += "\\r";  break;
+      case '\t': ret += "\\t";  break;
+      default:
+        if (c.unicode() < 0x20) {
+          ret += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        } else {
+          ret += c;
+        }
+    }
+  }
+  return ret;
+}
+
+void WriteEvent(QTextStream& s, char phase, const Event& event, qint64 ts,
+                qint64 pid) {
+  s << "{\"ph\":\"" << phase << "\","
+    << "\"cat\":\"" << event.category_ << "\","
+    << "\"name\":\"" << event.name_ << "\","
+    << "\"ts\":" << ts << ","
+    << "\"pid\":" << pid << ","
+    << "\"tid\":" << event.thread_;
+
+  if (phase == 'X')
+    s << ",\"dur\":" << event.duration_usec_;
+  if (phase == 'i')
+    s << ",\"s\":\"t\"";
+  if (event.async_id_)
+    s << ",\"id\":" << event.async_id_;
+  if (!event.detail_.isEmpty())
+    s << ",\"args\":{\"detail\":\"" << Escape(event.detail_) << "\"}";
+
+  s << "}";
+}
+
+}  // namespace
+
+
+qint64 Tracer::NowUsec() {
+#ifdef Q_OS_WIN32
+  static LARGE_INTEGER sFrequency;
+  if (sFrequency.QuadPart == 0)
+    QueryPerformanceFrequency(&sFrequency);
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return now.QuadPart * 1000000 / sFrequency.QuadPart;
+#else
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return qint64(tv.tv_sec) * 1000000 + tv.tv_usec;
+#endif
+}
+
+void Tracer::Start() {
+  TraceData* data = Data();
+  QMutexLocker l(&data->mutex_);
+
+  data->events_.clear();
+  data->thread_ids_.clear();
+  data->thread_names_.clear();
+  data->dropped_ = 0;
+  data->start_usec_ = NowUsec();
+  sEnabled.fetchAndStoreOrdered(1);
+
+  qLog(Info) << "Tracing started";
+}
+
+void Tracer::Stop() {
+  TraceData* data = Data();
+  QMutexLocker l(&data->mutex_);
+
+  sEnabled.fetchAndStoreOrdered(0);
+  qLog(Info) << "Tracing stopped after" << data->events_.count() << "events";
+}
+
+int Tracer::event_count() {
+  TraceData* data = Data();
+  QMutexLocker l(&data->mutex_);
+  return data->events_.count();
+}
+
+void Tracer::AddEvent(const char* category, const char* name,
+                      qint64 start_usec, const QString& detail) {
+  Event event;
+  event.phase_ = 'X';
+  event.category_ = category;
+  event.name_ = name;
+  event.detail_ = detail;
+  event.start_usec_ = start_usec;
+  event.duration_usec_ = NowUsec() - start_usec;
+  event.async_id_ = 0;
+
+  TraceData* data = Data();
+  QMutexLocker l(&data->mutex_);
+
+  // Tracing might have been stopped since the event started.
+  if (!is_enabled())
+    return;
+
+  event.thread_ = CurrentThreadId(data);
+  AddLocked(data, event);
+}
+
+void Tracer::AddInstantEvent(const char* category, const char* name,
+                             const QString& detail) {
+  if (!is_enabled())
+    return;
+
+  Event event;
+  event.phase_ = 'i';
+  event.category_ = category;
+  event.name_ = name;
+  event.detail_ = detail;
+  event.start_usec_ = NowUsec();
+  event.duration_usec_ = 0;
+  event.async_id_ = 0;
+
+  TraceData* data = Data();
+  QMutexLocker l(&data->mutex_);
+  if (!is_enabled())
+    return;
+
+  event.thread_ = CurrentThreadId(data);
+  AddLocked(data, event);
+}
+
+void Tracer::AddEventUntil(QObject* object, const char* signal,
+                           const char* category, const char* name,
+                           const QString& detail) {
+  if (!is_enabled())
+    return;
+
+  TraceUntilHelper* helper = new TraceUntilHelper(category, name, detail);
+  helper->moveToThread(object->thread());
+
+  // The signal is often emitted from a different thread.  A direct connection
+  // means the event finishes then, not when that thread gets round to it.
+  QObject::connect(object, signal, helper, SLOT(Finished()),
+                   Qt::DirectConnection);
+  QObject::connect(object, SIGNAL(destroyed()), helper, SLOT(deleteLater()));
+}
+
+void Tracer::AddAsyncEvent(const char* category, const char* name,
+                           qint64 start_usec, const QString& detail) {
+  Event event;
+  event.phase_ = 'b';
+  event.category_ = category;
+  event.name_ = name;
+  event.detail_ = detail;
+  event.start_usec_ = start_usec;
+  event.duration_usec_ = NowUsec() - start_usec;
+
+  TraceData* data = Data();
+  QMutexLocker l(&data->mutex_);
+  if (!is_enabled())
+    return;
+
+  event.thread_ = CurrentThreadId(data);
+  event.async_id_ = data->next_async_id_ ++;
+  AddLocked(data, event);
+}
+
+bool Tracer::Save(const QString& filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't write trace to" << filename << file.errorString();
+    return false;
+  }
+
+  TraceData* data = Data();
+  QMutexLocker l(&data->mutex_);
+
+  const qint64 pid = QCoreApplication::applicationPid();
+
+  QTextStream s(&file);
+  s.setCodec("UTF-8");
+  s << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+  for (int i=0 ; i<data->thread_names_.count() ; ++i) {
+    s << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+      << ",\"tid\":" << i
+      << ",\"args\":{\"name\":\"" << Escape(data->thread_names_[i]) << "\"}},\n";
+  }
+
+  foreach (const Event& event, data->events_) {
+    const qint64 ts = event.start_usec_ - data->start_usec_;
+
+    if (event.phase_ == 'b') {
+      // Async events are written as a begin and end pair.
+      WriteEvent(s, 'b', event, ts, pid);
+      s << ",\n";
+      WriteEvent(s, 'e', event, ts + event.duration_usec_, pid);
+    } else {
+      WriteEvent(s, event.phase_, event, ts, pid);
+    }
+    s << ",\n";
+  }
+
+  // Chrome doesn't mind an empty object at the end, and it saves keeping
+  // track of the commas.
+  s << "{}]}\n";
+  s.flush();
+
+  if (data->dropped_) {
+    qLog(Warning) << "The trace was full," << data->dropped_
+                  << "events were dropped";
+  }
+  qLog(Info) << "Wrote" << data->events_.count() << "trace events to"
+             << filename;
+
+  return file.error() == QFile::NoError;
+}
+
+
+TraceUntilHelper::TraceUntilHelper(const char* category, const char* name,
+                                   const QString& detail)
+  : category_(category),
+    name_(name),
+    detail_(detail),
+    start_usec_(Tracer::NowUsec())
+{
+}
+
+void TraceUntilHelper::Finished() {
+  Tracer::AddAsyncEvent(category_, name_, start_usec_, detail_);
+  deleteLater();
+}
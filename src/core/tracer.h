@@ -0,0 +1,127 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QString>
+
+// Records how long things take while Clementine is running, and writes them
+// out in Chrome's trace event format.  Open the file in chrome://tracing to
+// see what every thread was doing.
+//
+// Nothing is recorded until Start() is called, and while it's stopped a
+// TraceScope costs no more than reading an int.  Events can be added from any
+// thread.
+class Tracer {
+ public:
+  static const int kMaxEvents;
+
+  // Check this before building an expensive detail string.
+  static bool is_enabled() { return sEnabled != 0; }
+
+  // Start() throws away anything that was recorded before.
+  static void Start();
+  static void Stop();
+
+  // Writes everything recorded so far.  Returns false on error.
+  static bool Save(const QString& filename);
+  static int event_count();
+
+  // Microseconds from some arbitrary point in the past.
+  static qint64 NowUsec();
+
+  // Records something that started at start_usec and finished now, on the
+  // current thread.  Events on the same thread must nest properly.
+  static void AddEvent(const char* category, const char* name,
+                       qint64 start_usec, const QString& detail = QString());
+
+  // Records something that happened at this moment.
+  static void AddInstantEvent(const char* category, const char* name,
+                              const QString& detail = QString());
+
+  // Records something that lasts until the object emits the signal, like an
+  // RPC or a reply from another thread.  These can overlap with each other.
+  static void AddEventUntil(QObject* object, const char* signal,
+                            const char* category, const char* name,
+                            const QString& detail = QString());
+
+ private:
+  static void AddAsyncEvent(const char* category, const char* name,
+                            qint64 start_usec, const QString& detail);
+
+  friend class TraceUntilHelper;
+
+  // Set by Start() and Stop() and read by every thread without the lock.
+  static QAtomicInt sEnabled;
+};
+
+
+// Used by Tracer::AddEventUntil() to wait for the signal.
+class TraceUntilHelper : public QObject {
+  Q_OBJECT
+
+ public:
+  TraceUntilHelper(const char* category, const char* name,
+                   const QString& detail);
+
+ public slots:
+  void Finished();
+
+ private:
+  const char* category_;
+  const char* name_;
+  const QString detail_;
+  const qint64 start_usec_;
+};
+
+
+// Records an event from when it's created until it goes out of scope.  The
+// category and name must be string literals.
+class TraceScope {
+ public:
+  TraceScope(const char* category, const char* name)
+    : category_(category),
+      name_(name),
+      start_usec_(Tracer::is_enabled() ? Tracer::NowUsec() : -1) {}
+
+  ~TraceScope() {
+    if (start_usec_ != -1)
+      Tracer::AddEvent(category_, name_, start_usec_, detail_);
+  }
+
+  // Check this before building an expensive detail string.
+  bool is_recording() const { return start_usec_ != -1; }
+
+  // Shown alongside the event, for example a filename or SQL query.
+  void set_detail(const QString& detail) {
+    if (start_usec_ != -1)
+      detail_ = detail;
+  }
+
+ private:
+  Q_DISABLE_COPY(TraceScope);
+
+  const char* category_;
+  const char* name_;
+  const qint64 start_usec_;
+  QString detail_;
+};
+
+#endif // TRACER_H
@@ -336,6 +336,9 @@ QString GetConfigPath(ConfigPath config) {
     case Path_MoodbarCache:
       return GetConfigPath(Path_CacheRoot) + "/moodbarcache";
 
+    case Path_TranscodeCache:
+      return GetConfigPath(Path_CacheRoot) + "/transcodecache";
+
     case Path_GstreamerRegistry:
       return GetConfigPath(Path_Root) +
           QString("/gst-registry-%1-bin").arg(QCoreApplication::applicationVersion());
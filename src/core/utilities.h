@@ -120,6 +120,7 @@ namespace Utilities {
     Path_LocalSpotifyBlob,
     Path_MoodbarCache,
     Path_CacheRoot,
+    Path_TranscodeCache,
   };
   QString GetConfigPath(ConfigPath config);
 
@@ -27,6 +27,7 @@
 #include "albumcoverfetcher.h"
 #include "coverprovider.h"
 #include "coverproviders.h"
+#include "coverproviderscheduler.h"
 #include "core/closure.h"
 #include "core/logging.h"
 #include "core/network.h"
@@ -35,15 +36,19 @@ const int AlbumCoverFetcherSearch::kSearchTimeoutMs = 10000;
 const int AlbumCoverFetcherSearch::kImageLoadTimeoutMs = 2500;
 const int AlbumCoverFetcherSearch::kTargetSize = 500;
 const float AlbumCoverFetcherSearch::kGoodScore = 1.85;
+const int AlbumCoverFetcherSearch::kMaxProvidersInFlight = 2;
 
 AlbumCoverFetcherSearch::AlbumCoverFetcherSearch(const CoverSearchRequest& request,
                                                  QNetworkAccessManager* network,
                                                  QObject* parent)
   : QObject(parent),
     request_(request),
+    cover_providers_(NULL),
+    scheduler_(NULL),
     image_load_timeout_(new NetworkTimeouts(kImageLoadTimeoutMs, this)),
     network_(network),
-    cancel_requested_(false)
+    cancel_requested_(false),
+    finished_(false)
 {
   // we will terminate the search after kSearchTimeoutMs miliseconds if we are not
   // able to find all of the results before that point in time
@@ -52,37 +57,81 @@ AlbumCoverFetcherSearch::AlbumCoverFetcherSearch(const CoverSearchRequest& reque
 
 void AlbumCoverFetcherSearch::TerminateSearch() {
   foreach (int id, pending_requests_.keys()) {
-    pending_requests_.take(id)->CancelSearch(id);
+    scheduler_->SearchTimedOut(id);
   }
+  pending_requests_.clear();
+  waiting_providers_.clear();
 
   AllProvidersFinished();
 }
 
 void AlbumCoverFetcherSearch::Start(CoverProviders* cover_providers) {
-  foreach(CoverProvider* provider, cover_providers->List()) {
-    connect(provider, SIGNAL(SearchFinished(int,QList<CoverSearchResult>)),
-            SLOT(ProviderSearchFinished(int,QList<CoverSearchResult>)));
-    const int id = cover_providers->NextId();
-    const bool success = provider->StartSearch(
-          request_.artist, request_.album, id);
-
-    if (success) {
-      pending_requests_[id] = provider;
-      statistics_.network_requests_made_ ++;
-    }
+  cover_providers_ = cover_providers;
+  scheduler_ = cover_providers->scheduler();
+  connect(scheduler_, SIGNAL(SearchFinished(int,QList<CoverSearchResult>)),
+          SLOT(ProviderSearchFinished(int,QList<CoverSearchResult>)));
+
+  waiting_providers_ = scheduler_->RankProviders(cover_providers->List());
+  for (int i=0 ; i<waiting_providers_.count() ; ++i) {
+    provider_rank_[waiting_providers_[i]->name()] = i;
   }
 
+  StartMoreProviders();
+
   // end this search before it even began if there are no providers...
   if(pending_requests_.isEmpty()) {
     TerminateSearch();
   }
 }
 
-static bool CompareProviders(const CoverSearchResult& a,
-                             const CoverSearchResult& b) {
-  return a.provider < b.provider;
+void AlbumCoverFetcherSearch::StartMoreProviders() {
+  // Interactive searches want everything at once.  If we're only fetching the
+  // best cover, a provider whose first image is still loading counts as busy
+  // so the next one is only asked if that image turns out not to be good
+  // enough.
+  while (!waiting_providers_.isEmpty() && !finished_ &&
+         (request_.search ||
+          pending_requests_.count() + pending_image_loads_.count() <
+              kMaxProvidersInFlight)) {
+    CoverProvider* provider = waiting_providers_.takeFirst();
+    const int id = cover_providers_->NextId();
+
+    pending_requests_[id] = provider;
+    statistics_.network_requests_made_ ++;
+    scheduler_->QueueSearch(provider, request_.artist, request_.album, id);
+  }
 }
 
+void AlbumCoverFetcherSearch::StopSearching() {
+  foreach (int id, pending_requests_.keys()) {
+    scheduler_->CancelSearch(id);
+  }
+  pending_requests_.clear();
+  waiting_providers_.clear();
+
+  // Aborting a reply emits its finished signal, so forget about them first.
+  const QList<RedirectFollower*> replies = pending_image_loads_.keys();
+  pending_image_loads_.clear();
+  foreach (RedirectFollower* reply, replies) {
+    reply->abort();
+  }
+}
+
+namespace {
+
+struct CompareProviders {
+  CompareProviders(const QMap<QString, int>& rank) : rank_(rank) {}
+
+  bool operator ()(const CoverSearchResult& a,
+                   const CoverSearchResult& b) const {
+    return rank_.value(a.provider) < rank_.value(b.provider);
+  }
+
+  const QMap<QString, int>& rank_;
+};
+
+}  // namespace
+
 void AlbumCoverFetcherSearch::ProviderSearchFinished(
     int id, const QList<CoverSearchResult>& results) {
   if (!pending_requests_.contains(id))
@@ -96,12 +145,21 @@ void AlbumCoverFetcherSearch::ProviderSearchFinished(
     results_copy[i].provider = provider->name();
   }
 
+  // Start loading this provider's best guess straight away - if it's good
+  // enough there's no need to wait for the other providers.
+  if (!request_.search && !finished_ && !results_copy.isEmpty()) {
+    LoadImage(results_copy.takeFirst());
+  }
+
   // Add results from the current provider to our pool
   results_.append(results_copy);
   statistics_.total_images_by_provider_[provider->name()] ++;
 
+  StartMoreProviders();
+
   // do we have more providers left?
-  if(!pending_requests_.isEmpty()) {
+  if (!pending_requests_.isEmpty() || !waiting_providers_.isEmpty() ||
+      !pending_image_loads_.isEmpty()) {
     return;
   }
 
@@ -109,20 +167,22 @@ void AlbumCoverFetcherSearch::ProviderSearchFinished(
 }
 
 void AlbumCoverFetcherSearch::AllProvidersFinished() {
-  if (cancel_requested_) {
+  if (cancel_requested_ || finished_) {
     return;
   }
 
+  qStableSort(results_.begin(), results_.end(),
+              CompareProviders(provider_rank_));
+
   // if we only wanted to do the search then we're done
   if (request_.search) {
+    finished_ = true;
     emit SearchFinished(request_.id, results_);
     return;
   }
 
-  // no results?
-  if (results_.isEmpty()) {
-    statistics_.missing_images_ ++;
-    emit AlbumCoverFetched(request_.id, QImage());
+  // The first images from each provider are still loading.
+  if (!pending_image_loads_.isEmpty()) {
     return;
   }
 
@@ -131,10 +191,22 @@ void AlbumCoverFetcherSearch::AllProvidersFinished() {
   // from each category and use some heuristics to score them.  If no images
   // are good enough we'll keep loading more images until we find one that is
   // or we run out of results.
-  qStableSort(results_.begin(), results_.end(), CompareProviders);
   FetchMoreImages();
 }
 
+void AlbumCoverFetcherSearch::LoadImage(const CoverSearchResult& result) {
+  qLog(Debug) << "Loading" << result.image_url << "from" << result.provider;
+
+  RedirectFollower* image_reply = new RedirectFollower(
+      network_->get(QNetworkRequest(result.image_url)));
+  NewClosure(image_reply, SIGNAL(finished()), this,
+             SLOT(ProviderCoverFetchFinished(RedirectFollower*)), image_reply);
+  pending_image_loads_[image_reply] = result.provider;
+  image_load_timeout_->AddReply(image_reply);
+
+  statistics_.network_requests_made_ ++;
+}
+
 void AlbumCoverFetcherSearch::FetchMoreImages() {
   // Try the first one in each category.
   QString last_provider;
@@ -146,16 +218,7 @@ void AlbumCoverFetcherSearch::FetchMoreImages() {
     CoverSearchResult result = results_.takeAt(i--);
     last_provider = result.provider;
 
-    qLog(Debug) << "Loading" << result.image_url << "from" << result.provider;
-
-    RedirectFollower* image_reply = new RedirectFollower(
-        network_->get(QNetworkRequest(result.image_url)));
-    NewClosure(image_reply, SIGNAL(finished()), this,
-               SLOT(ProviderCoverFetchFinished(RedirectFollower*)), image_reply);
-    pending_image_loads_[image_reply] = result.provider;
-    image_load_timeout_->AddReply(image_reply);
-
-    statistics_.network_requests_made_ ++;
+    LoadImage(result);
   }
 
   if (pending_image_loads_.isEmpty()) {
@@ -166,11 +229,17 @@ void AlbumCoverFetcherSearch::FetchMoreImages() {
 
 void AlbumCoverFetcherSearch::ProviderCoverFetchFinished(RedirectFollower* reply) {
   reply->deleteLater();
+
+  // We stopped caring about this one when the search was cancelled or another
+  // image was good enough.
+  if (!pending_image_loads_.contains(reply)) {
+    return;
+  }
   const QString provider = pending_image_loads_.take(reply);
 
   statistics_.bytes_transferred_ += reply->bytesAvailable();
 
-  if (cancel_requested_) {
+  if (cancel_requested_ || finished_) {
     return;
   }
 
@@ -188,21 +257,28 @@ void AlbumCoverFetcherSearch::ProviderCoverFetchFinished(RedirectFollower* reply
     }
   }
 
-  if (pending_image_loads_.isEmpty()) {
-    // We've fetched everything we wanted to fetch for now, check if we have an
-    // image that's good enough.
-    float best_score = 0.0;
+  float best_score = 0.0;
+  if (!candidate_images_.isEmpty()) {
+    best_score = candidate_images_.keys().last();
+  }
 
-    if (!candidate_images_.isEmpty()) {
-      best_score = candidate_images_.keys().last();
-    }
+  if (best_score >= kGoodScore) {
+    // Good enough - any providers that haven't replied yet are skipped.
+    qLog(Debug) << "Found an image with a score of" << best_score
+                << "- not waiting for any more providers";
+    StopSearching();
+    SendBestImage();
+    return;
+  }
+
+  StartMoreProviders();
 
+  if (pending_requests_.isEmpty() && waiting_providers_.isEmpty() &&
+      pending_image_loads_.isEmpty()) {
+    // We've fetched everything we wanted to fetch for now and nothing was
+    // good enough, so try the next images.
     qLog(Debug) << "Best image so far has a score of" << best_score;
-    if (best_score >= kGoodScore) {
-      SendBestImage();
-    } else {
-      FetchMoreImages();
-    }
+    AllProvidersFinished();
   }
 }
 
@@ -224,6 +300,7 @@ float AlbumCoverFetcherSearch::ScoreImage(const QImage& image) const {
 
 void AlbumCoverFetcherSearch::SendBestImage() {
   QImage image;
+  finished_ = true;
 
   if (!candidate_images_.isEmpty()) {
     const CandidateImage best_image = candidate_images_.values().back();
@@ -242,13 +319,5 @@ void AlbumCoverFetcherSearch::SendBestImage() {
 
 void AlbumCoverFetcherSearch::Cancel() {
   cancel_requested_ = true;
-
-  if (!pending_requests_.isEmpty()) {
-    TerminateSearch();
-  } else if (!pending_image_loads_.isEmpty()) {
-    foreach (RedirectFollower* reply, pending_image_loads_.keys()) {
-      reply->abort();
-    }
-    pending_image_loads_.clear();
-  }
+  StopSearching();
 }
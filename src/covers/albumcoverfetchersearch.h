@@ -24,6 +24,7 @@
 #include <QObject>
 
 class CoverProvider;
+class CoverProviderScheduler;
 class CoverProviders;
 class NetworkTimeouts;
 class NetworkAccessManager;
@@ -33,6 +34,10 @@ class RedirectFollower;
 // AlbumCoverFetcher. The search engages all of the known cover providers.
 // AlbumCoverFetcherSearch signals search results to an interested
 // AlbumCoverFetcher when all of the providers have done their part.
+//
+// When we only want to fetch the best cover the providers are asked one or two
+// at a time, best ranked first, and the search stops as soon as one of them
+// finds an image that's good enough.
 class AlbumCoverFetcherSearch : public QObject {
   Q_OBJECT
 
@@ -61,8 +66,11 @@ private slots:
   void TerminateSearch();
 
 private:
+  void StartMoreProviders();
+  void StopSearching();
   void AllProvidersFinished();
 
+  void LoadImage(const CoverSearchResult& result);
   void FetchMoreImages();
   float ScoreImage(const QImage& image) const;
   void SendBestImage();
@@ -72,6 +80,7 @@ private:
   static const int kImageLoadTimeoutMs;
   static const int kTargetSize;
   static const float kGoodScore;
+  static const int kMaxProvidersInFlight;
 
   CoverSearchStatistics statistics_;
 
@@ -81,6 +90,13 @@ private:
   // Complete results (from all of the available providers).
   CoverSearchResults results_;
 
+  CoverProviders* cover_providers_;
+  CoverProviderScheduler* scheduler_;
+
+  // Providers that haven't been asked yet, best ranked first.
+  QList<CoverProvider*> waiting_providers_;
+  QMap<QString, int> provider_rank_;
+
   QMap<int, CoverProvider*> pending_requests_;
   QMap<RedirectFollower*, QString> pending_image_loads_;
   NetworkTimeouts* image_load_timeout_;
@@ -92,6 +108,7 @@ private:
   QNetworkAccessManager* network_;
 
   bool cancel_requested_;
+  bool finished_;
 };
 
 #endif  // ALBUMCOVERFETCHERSEARCH_H
@@ -28,6 +28,7 @@
 #include "core/logging.h"
 #include "core/network.h"
 #include "core/tagreaderclient.h"
+#include "core/tracer.h"
 #include "core/utilities.h"
 #include "internet/internetmodel.h"
 #include "internet/spotifyservice.h"
@@ -108,6 +109,10 @@ void AlbumCoverLoader::ProcessTasks() {
 }
 
 void AlbumCoverLoader::ProcessTask(Task *task) {
+  TraceScope trace("covers", "AlbumCoverLoader::ProcessTask");
+  trace.set_detail(task->state == State_TryingManual ? task->art_manual
+                                                     : task->art_automatic);
+
   TryLoadResult result = TryLoadImage(*task);
   if (result.started_async) {
     // The image is being loaded from a remote URL, we'll carry on later
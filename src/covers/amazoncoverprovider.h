@@ -38,6 +38,10 @@ public:
 
   bool StartSearch(const QString& artist, const QString& album, int id);
 
+  // The Product Advertising API allows one request per second.
+  int max_concurrent_searches() const { return 1; }
+  float searches_per_second() const { return 1.0; }
+
 private slots:
   void QueryFinished(QNetworkReply* reply, int id);
 
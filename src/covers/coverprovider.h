@@ -44,6 +44,11 @@ public:
 
   virtual void CancelSearch(int id) {}
 
+  // Limits used by the CoverProviderScheduler.  Override these if the online
+  // service has stricter rules about how often it can be queried.
+  virtual int max_concurrent_searches() const { return 2; }
+  virtual float searches_per_second() const { return 2.0; }
+
 signals:
   void SearchFinished(int id, const QList<CoverSearchResult>& results);
 
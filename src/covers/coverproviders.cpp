@@ -18,10 +18,13 @@
 #include "config.h"
 #include "coverprovider.h"
 #include "coverproviders.h"
+#include "coverproviderscheduler.h"
 #include "core/logging.h"
 
 CoverProviders::CoverProviders(QObject* parent)
-  : QObject(parent) {
+  : QObject(parent),
+    scheduler_(new CoverProviderScheduler(
+        CoverProviderScheduler::kSettingsGroup, this)) {
 }
 
 void CoverProviders::AddProvider(CoverProvider* provider) {
@@ -24,6 +24,7 @@
 
 class AlbumCoverFetcherSearch;
 class CoverProvider;
+class CoverProviderScheduler;
 
 // This is a repository for cover providers.
 // Providers are automatically unregistered from the repository when they are
@@ -46,6 +47,10 @@ public:
 
   int NextId();
 
+  // Shared by all searches so the providers' rate limits apply across them.
+  // Unlike the rest of this class it must only be used from the main thread.
+  CoverProviderScheduler* scheduler() const { return scheduler_; }
+
 private slots:
   void ProviderDestroyed();
 
@@ -56,6 +61,8 @@ private:
   QMutex mutex_;
 
   QAtomicInt next_id_;
+
+  CoverProviderScheduler* scheduler_;
 };
 
 #endif // COVERPROVIDERS_H
@@ -0,0 +1,319 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "coverprovider.h"
+#include "coverproviderscheduler.h"
+
+#include <cmath>
+
+#include <QSettings>
+#include <QStringList>
+#include <QTimer>
+
+#include "core/logging.h"
+
+const char* CoverProviderScheduler::kSettingsGroup = "CoverProviderScheduler";
+const int CoverProviderScheduler::kLatencyPenaltyMs = 2000;
+const int CoverProviderScheduler::kMaxHistory = 500;
+const int CoverProviderScheduler::kChangesBetweenSaves = 20;
+
+CoverProviderScheduler::CoverProviderScheduler(const QString& settings_group,
+                                               QObject* parent)
+  : QObject(parent),
+    settings_group_(settings_group),
+    start_timer_(new QTimer(this)),
+    unsaved_changes_(0)
+{
+  clock_.start();
+
+  start_timer_->setSingleShot(true);
+  connect(start_timer_, SIGNAL(timeout()), SLOT(StartSearches()));
+
+  LoadStatistics();
+}
+
+CoverProviderScheduler::~CoverProviderScheduler() {
+  if (unsaved_changes_)
+    SaveStatistics();
+}
+
+CoverProviderScheduler::ProviderState* CoverProviderScheduler::State(
+    CoverProvider* provider) {
+  if (!providers_.contains(provider)) {
+    connect(provider, SIGNAL(SearchFinished(int,QList<CoverSearchResult>)),
+            SLOT(ProviderSearchFinished(int,QList<CoverSearchResult>)));
+    connect(provider, SIGNAL(destroyed(QObject*)),
+            SLOT(ProviderDestroyed(QObject*)));
+
+    // Start with a full bucket so the first few searches go out immediately.
+    ProviderState& state = providers_[provider];
+    state.tokens_ = qMax(1, provider->max_concurrent_searches());
+    state.last_refill_ms_ = clock_.elapsed();
+  }
+  return &providers_[provider];
+}
+
+void CoverProviderScheduler::QueueSearch(CoverProvider* provider,
+                                         const QString& artist,
+                                         const QString& album, int id) {
+  PendingSearch search;
+  search.artist_ = artist;
+  search.album_ = album;
+  search.id_ = id;
+
+  State(provider)->queue_.enqueue(search);
+  StartSearches();
+}
+
+void CoverProviderScheduler::RefillTokens(CoverProvider* provider,
+                                          ProviderState* state) {
+  const int now = clock_.elapsed();
+  const double capacity = qMax(1, provider->max_concurrent_searches());
+
+  // QTime wraps around after a day.
+  const int elapsed_ms = qMax(0, now - state->last_refill_ms_);
+
+  state->tokens_ = qMin(capacity, state->tokens_ +
+      elapsed_ms * provider->searches_per_second() / 1000);
+  state->last_refill_ms_ = now;
+}
+
+void CoverProviderScheduler::StartSearches() {
+  int next_token_ms = -1;
+
+  foreach (CoverProvider* provider, providers_.keys()) {
+    ProviderState* state = &providers_[provider];
+    RefillTokens(provider, state);
+
+    while (!state->queue_.isEmpty() &&
+           state->in_flight_ < provider->max_concurrent_searches() &&
+           state->tokens_ >= 1.0) {
+      state->tokens_ -= 1.0;
+      StartSearch(provider, state->queue_.dequeue());
+
+      // StartSearch might have emitted a signal that removed this provider.
+      if (!providers_.contains(provider))
+        break;
+    }
+
+    if (!providers_.contains(provider) || state->queue_.isEmpty() ||
+        state->in_flight_ >= provider->max_concurrent_searches())
+      continue;
+
+    // We're only waiting for the bucket to fill up again.
+    const int wait_ms = int(std::ceil(
+        (1.0 - state->tokens_) * 1000 / provider->searches_per_second()));
+    if (next_token_ms == -1 || wait_ms < next_token_ms)
+      next_token_ms = wait_ms;
+  }
+
+  if (next_token_ms != -1) {
+    start_timer_->start(next_token_ms);
+  }
+}
+
+void CoverProviderScheduler::StartSearch(CoverProvider* provider,
+                                         const PendingSearch& search) {
+  InFlightSearch in_flight;
+  in_flight.provider_ = provider;
+  in_flight.started_ms_ = clock_.elapsed();
+
+  in_flight_[search.id_] = in_flight;
+  providers_[provider].in_flight_ ++;
+
+  if (!provider->StartSearch(search.artist_, search.album_, search.id_)) {
+    qLog(Debug) << provider->name() << "refused to search for"
+                << search.artist_ << search.album_;
+    Finished(search.id_);
+    emit SearchFinished(search.id_, CoverSearchResults());
+  }
+}
+
+void CoverProviderScheduler::Finished(int id) {
+  const InFlightSearch search = in_flight_.take(id);
+  if (providers_.contains(search.provider_)) {
+    providers_[search.provider_].in_flight_ --;
+  }
+
+  // Something might be waiting for this slot.
+  QTimer::singleShot(0, this, SLOT(StartSearches()));
+}
+
+void CoverProviderScheduler::ProviderSearchFinished(
+    int id, const QList<CoverSearchResult>& results) {
+  if (!in_flight_.contains(id))
+    return;
+
+  const InFlightSearch& search = in_flight_[id];
+  RecordResult(search.provider_->name(), !results.isEmpty(),
+               clock_.elapsed() - search.started_ms_);
+
+  Finished(id);
+  emit SearchFinished(id, results);
+}
+
+void CoverProviderScheduler::CancelSearch(int id) {
+  if (in_flight_.contains(id)) {
+    CoverProvider* provider = in_flight_[id].provider_;
+    Finished(id);
+    provider->CancelSearch(id);
+    return;
+  }
+
+  for (QMap<CoverProvider*, ProviderState>::iterator it = providers_.begin() ;
+       it != providers_.end() ; ++it) {
+    QQueue<PendingSearch>& queue = it.value().queue_;
+    for (int i=0 ; i<queue.count() ; ++i) {
+      if (queue[i].id_ == id) {
+        queue.removeAt(i);
+        return;
+      }
+    }
+  }
+}
+
+void CoverProviderScheduler::SearchTimedOut(int id) {
+  if (in_flight_.contains(id)) {
+    const InFlightSearch& search = in_flight_[id];
+    RecordResult(search.provider_->name(), false,
+                 clock_.elapsed() - search.started_ms_);
+  }
+
+  CancelSearch(id);
+}
+
+void CoverProviderScheduler::ProviderDestroyed(QObject* object) {
+  CoverProvider* provider = static_cast<CoverProvider*>(object);
+  if (!providers_.contains(provider))
+    return;
+
+  // Nothing will ever reply to these searches now.
+  QList<int> ids;
+  foreach (const PendingSearch& search, providers_[provider].queue_) {
+    ids << search.id_;
+  }
+  foreach (int id, in_flight_.keys()) {
+    if (in_flight_[id].provider_ == provider) {
+      in_flight_.remove(id);
+      ids << id;
+    }
+  }
+
+  providers_.remove(provider);
+
+  foreach (int id, ids) {
+    emit SearchFinished(id, CoverSearchResults());
+  }
+}
+
+float CoverProviderScheduler::Score(const QString& provider_name) const {
+  const ProviderStatistics stats = statistics_.value(provider_name);
+
+  // Pretend every provider found something for one search out of two before
+  // we knew anything about it, so new providers get a chance.
+  const float hit_rate = (stats.hits_ + 1) / (stats.searches_ + 2);
+  const float latency_ms =
+      stats.searches_ > 0 ? stats.total_latency_ms_ / stats.searches_ : 0;
+
+  return hit_rate / (1.0 + latency_ms / kLatencyPenaltyMs);
+}
+
+namespace {
+
+struct CompareScores {
+  CompareScores(const CoverProviderScheduler* scheduler)
+    : scheduler_(scheduler) {}
+
+  bool operator ()(CoverProvider* a, CoverProvider* b) const {
+    return scheduler_->Score(a->name()) > scheduler_->Score(b->name());
+  }
+
+  const CoverProviderScheduler* scheduler_;
+};
+
+}  // namespace
+
+QList<CoverProvider*> CoverProviderScheduler::RankProviders(
+    QList<CoverProvider*> providers) const {
+  qStableSort(providers.begin(), providers.end(), CompareScores(this));
+  return providers;
+}
+
+void CoverProviderScheduler::RecordResult(const QString& provider_name,
+                                          bool hit, int latency_ms) {
+  ProviderStatistics& stats = statistics_[provider_name];
+
+  // Halve the history every now and then so the ranking follows providers
+  // that get better or worse over time.
+  if (stats.searches_ >= kMaxHistory) {
+    stats.searches_ /= 2;
+    stats.hits_ /= 2;
+    stats.total_latency_ms_ /= 2;
+  }
+
+  stats.searches_ += 1;
+  stats.hits_ += hit ? 1 : 0;
+  stats.total_latency_ms_ += qMax(0, latency_ms);
+
+  if (++unsaved_changes_ >= kChangesBetweenSaves)
+    SaveStatistics();
+}
+
+void CoverProviderScheduler::LoadStatistics() {
+  if (settings_group_.isEmpty())
+    return;
+
+  QSettings s;
+  s.beginGroup(settings_group_);
+
+  foreach (const QString& name, s.childGroups()) {
+    s.beginGroup(name);
+    ProviderStatistics& stats = statistics_[name];
+    stats.searches_ = s.value("searches", 0).toDouble();
+    stats.hits_ = s.value("hits", 0).toDouble();
+    stats.total_latency_ms_ = s.value("total_latency_ms", 0).toDouble();
+    s.endGroup();
+  }
+
+  unsaved_changes_ = 0;
+}
+
+void CoverProviderScheduler::SaveStatistics() {
+  unsaved_changes_ = 0;
+  if (settings_group_.isEmpty())
+    return;
+
+  QSettings s;
+  s.beginGroup(settings_group_);
+
+  foreach (const QString& name, statistics_.keys()) {
+    const ProviderStatistics& stats = statistics_[name];
+    s.beginGroup(name);
+    s.setValue("searches", stats.searches_);
+    s.setValue("hits", stats.hits_);
+    s.setValue("total_latency_ms", stats.total_latency_ms_);
+    s.endGroup();
+  }
+}
+
+int CoverProviderScheduler::queued_count(CoverProvider* provider) const {
+  return providers_.value(provider).queue_.count();
+}
+
+int CoverProviderScheduler::in_flight_count(CoverProvider* provider) const {
+  return providers_.value(provider).in_flight_;
+}
@@ -0,0 +1,138 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COVERPROVIDERSCHEDULER_H
+#define COVERPROVIDERSCHEDULER_H
+
+#include "albumcoverfetcher.h"
+
+#include <QMap>
+#include <QObject>
+#include <QQueue>
+#include <QTime>
+
+class CoverProvider;
+
+class QTimer;
+
+// Decides when searches are sent to each cover provider.  Every provider gets
+// a limit on the number of searches it can have in flight and a token bucket
+// that limits how many it can start per second, so fetching the covers for a
+// whole library doesn't get us throttled or banned by the online services.
+//
+// The scheduler also remembers how often each provider found something and how
+// long it took, and ranks the providers by that so the most useful ones are
+// asked first.  It lives in the main thread, like the providers themselves.
+class CoverProviderScheduler : public QObject {
+  Q_OBJECT
+
+ public:
+  // The statistics used for ranking the providers are kept in this settings
+  // group.  If it's empty they are forgotten when the scheduler is deleted.
+  CoverProviderScheduler(const QString& settings_group, QObject* parent = NULL);
+  ~CoverProviderScheduler();
+
+  static const char* kSettingsGroup;
+  static const int kLatencyPenaltyMs;
+  static const int kMaxHistory;
+  static const int kChangesBetweenSaves;
+
+  // Queues a search on this provider.  SearchFinished is emitted with the same
+  // id when the provider replies, or straight away with no results if it
+  // refuses to start the search.
+  void QueueSearch(CoverProvider* provider, const QString& artist,
+                   const QString& album, int id);
+
+  // Forgets about a search that was queued or started earlier.  No
+  // SearchFinished signal will be emitted for it.
+  void CancelSearch(int id);
+
+  // Like CancelSearch, but counts the search as a failure of the provider.
+  void SearchTimedOut(int id);
+
+  // Returns the providers sorted from the most useful to the least useful.
+  QList<CoverProvider*> RankProviders(QList<CoverProvider*> providers) const;
+  float Score(const QString& provider_name) const;
+
+  // Updates the ranking.  Called when a provider replies to a search.
+  void RecordResult(const QString& provider_name, bool hit, int latency_ms);
+
+  void SaveStatistics();
+
+  int queued_count(CoverProvider* provider) const;
+  int in_flight_count(CoverProvider* provider) const;
+
+ signals:
+  void SearchFinished(int id, const QList<CoverSearchResult>& results);
+
+ private slots:
+  void ProviderSearchFinished(int id, const QList<CoverSearchResult>& results);
+  void ProviderDestroyed(QObject* object);
+  void StartSearches();
+
+ private:
+  struct PendingSearch {
+    QString artist_;
+    QString album_;
+    int id_;
+  };
+
+  struct ProviderState {
+    ProviderState() : in_flight_(0), tokens_(0), last_refill_ms_(0) {}
+
+    QQueue<PendingSearch> queue_;
+    int in_flight_;
+
+    double tokens_;
+    int last_refill_ms_;
+  };
+
+  struct InFlightSearch {
+    InFlightSearch() : provider_(NULL), started_ms_(0) {}
+
+    CoverProvider* provider_;
+    int started_ms_;
+  };
+
+  struct ProviderStatistics {
+    ProviderStatistics() : searches_(0), hits_(0), total_latency_ms_(0) {}
+
+    double searches_;
+    double hits_;
+    double total_latency_ms_;
+  };
+
+  ProviderState* State(CoverProvider* provider);
+  void RefillTokens(CoverProvider* provider, ProviderState* state);
+  void StartSearch(CoverProvider* provider, const PendingSearch& search);
+  void Finished(int id);
+  void LoadStatistics();
+
+ private:
+  QString settings_group_;
+
+  QTime clock_;
+  QTimer* start_timer_;
+
+  QMap<CoverProvider*, ProviderState> providers_;
+  QMap<int, InFlightSearch> in_flight_;
+  QMap<QString, ProviderStatistics> statistics_;
+
+  int unsaved_changes_;
+};
+
+#endif // COVERPROVIDERSCHEDULER_H
@@ -56,6 +56,11 @@ public:
   bool StartSearch(const QString& artist, const QString& album, int id);
   void CancelSearch(int id);
 
+  // Each search makes a couple of requests and unauthenticated clients are
+  // allowed about one a second.
+  int max_concurrent_searches() const { return 1; }
+  float searches_per_second() const { return 0.5; }
+
 private slots:
   void HandleSearchReply(QNetworkReply* reply, int id);
 
@@ -83,6 +83,12 @@ void MusicbrainzCoverProvider::ReleaseSearchFinished(
     }
   }
 
+  if (releases.isEmpty()) {
+    cover_names_.remove(id);
+    emit SearchFinished(id, QList<CoverSearchResult>());
+    return;
+  }
+
   foreach (const QString& release_id, releases) {
     QUrl url(QString(kAlbumCoverUrl).arg(release_id));
     QNetworkReply* reply = network_->head(QNetworkRequest(url));
@@ -125,4 +131,5 @@ void MusicbrainzCoverProvider::CancelSearch(int id) {
     reply->deleteLater();
   }
   image_checks_.remove(id);
+  cover_names_.remove(id);
 }
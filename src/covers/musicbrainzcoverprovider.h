@@ -34,6 +34,10 @@ class MusicbrainzCoverProvider : public CoverProvider {
   virtual bool StartSearch(const QString& artist, const QString& album, int id);
   virtual void CancelSearch(int id);
 
+  // MusicBrainz blocks clients that make more than one request per second.
+  virtual int max_concurrent_searches() const { return 1; }
+  virtual float searches_per_second() const { return 1.0; }
+
  private slots:
   void ReleaseSearchFinished(QNetworkReply* reply, int id);
   void ImageCheckFinished(int id);
@@ -0,0 +1,134 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "devicelibraryupdater.h"
+#include "core/logging.h"
+#include "core/taskmanager.h"
+#include "library/librarybackend.h"
+
+#include <QDateTime>
+
+const int DeviceLibraryUpdater::kBatchSize = 250;
+const int DeviceLibraryUpdater::kDirectoryId = 1;
+
+DeviceLibraryUpdater::DeviceLibraryUpdater(LibraryBackend* backend,
+                                           TaskManager* task_manager,
+                                           int task_id)
+  : backend_(backend),
+    task_manager_(task_manager),
+    task_id_(task_id),
+    progress_(0),
+    progress_max_(0)
+{
+}
+
+bool DeviceLibraryUpdater::IsUpToDate(const QString& generation) {
+  if (generation.isEmpty())
+    return false;
+
+  // These devices don't have any subdirectories, so the device's only
+  // subdirectory entry is used to remember the generation it was loaded from.
+  foreach (const Subdirectory& subdir,
+           backend_->SubdirsInDirectory(kDirectoryId)) {
+    if (subdir.digest == generation)
+      return true;
+  }
+  return false;
+}
+
+void DeviceLibraryUpdater::Start(int song_count) {
+  progress_ = 0;
+  progress_max_ = song_count;
+  UpdateProgress();
+
+  old_songs_.clear();
+  foreach (const Song& song, backend_->FindSongsInDirectory(kDirectoryId)) {
+    old_songs_[song.url().toEncoded()] = song;
+  }
+}
+
+void DeviceLibraryUpdater::AddSong(Song song) {
+  song.set_directory_id(kDirectoryId);
+
+  QHash<QByteArray, Song>::iterator it =
+      old_songs_.find(song.url().toEncoded());
+  if (it != old_songs_.end()) {
+    const Song old_song = it.value();
+    old_songs_.erase(it);
+
+    // Don't touch the songs that haven't changed at all.
+    if (!old_song.is_unavailable() &&
+        old_song.IsMetadataEqual(song) &&
+        old_song.filesize() == song.filesize() &&
+        old_song.playcount() == song.playcount() &&
+        old_song.rating() == song.rating()) {
+      progress_ ++;
+      if (progress_ % kBatchSize == 0)
+        UpdateProgress();
+      return;
+    }
+
+    song.set_id(old_song.id());
+  }
+
+  pending_songs_ << song;
+  if (pending_songs_.count() >= kBatchSize)
+    Flush();
+}
+
+void DeviceLibraryUpdater::Flush() {
+  if (pending_songs_.isEmpty())
+    return;
+
+  backend_->AddOrUpdateSongs(pending_songs_);
+  progress_ += pending_songs_.count();
+  pending_songs_.clear();
+
+  UpdateProgress();
+}
+
+void DeviceLibraryUpdater::Finish(const QString& generation) {
+  Flush();
+
+  // Anything we didn't see isn't on the device any more.
+  if (!old_songs_.isEmpty()) {
+    qLog(Debug) << old_songs_.count() << "songs were removed from the device";
+    backend_->DeleteSongs(old_songs_.values());
+    old_songs_.clear();
+  }
+
+  // Replace the generation we had before.
+  SubdirectoryList subdirs = backend_->SubdirsInDirectory(kDirectoryId);
+  for (int i=0 ; i<subdirs.count() ; ++i) {
+    subdirs[i].mtime = 0;
+  }
+
+  if (!generation.isEmpty()) {
+    Subdirectory subdir;
+    subdir.directory_id = kDirectoryId;
+    subdir.path = "/";
+    subdir.mtime = QDateTime::currentDateTime().toTime_t();
+    subdir.digest = generation;
+    subdirs << subdir;
+  }
+
+  backend_->AddOrUpdateSubdirs(subdirs);
+}
+
+void DeviceLibraryUpdater::UpdateProgress() {
+  task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
+}
@@ -0,0 +1,73 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEVICELIBRARYUPDATER_H
+#define DEVICELIBRARYUPDATER_H
+
+#include <QByteArray>
+#include <QHash>
+
+#include "core/song.h"
+
+class LibraryBackend;
+class TaskManager;
+
+// Used by the loaders of devices that keep their own track database, like MTP
+// devices and iPods, to replace the songs in the device's library with the ones
+// read from the device.
+//
+// The songs are written a batch at a time, and songs that were in the library
+// already keep their IDs, so the library stays browsable while a big device is
+// loading.  Songs that aren't on the device any more are removed at the end.
+class DeviceLibraryUpdater {
+ public:
+  DeviceLibraryUpdater(LibraryBackend* backend, TaskManager* task_manager,
+                       int task_id);
+
+  static const int kBatchSize;
+  static const int kDirectoryId;
+
+  // The generation is any string that changes whenever the songs on the device
+  // change.  Returns true if the library was loaded from the device the last
+  // time it had this generation, so nothing needs to be loaded now.
+  bool IsUpToDate(const QString& generation);
+
+  // Must be called before the songs are added.
+  void Start(int song_count);
+  void AddSong(Song song);
+
+  // Removes the songs that weren't added and remembers the generation.
+  void Finish(const QString& generation);
+
+ private:
+  void Flush();
+  void UpdateProgress();
+
+ private:
+  LibraryBackend* backend_;
+  TaskManager* task_manager_;
+  int task_id_;
+
+  int progress_;
+  int progress_max_;
+
+  // Songs that were in the library before, indexed by URL.
+  QHash<QByteArray, Song> old_songs_;
+  SongList pending_songs_;
+};
+
+#endif // DEVICELIBRARYUPDATER_H
@@ -16,6 +16,7 @@
 */
 
 #include "connecteddevice.h"
+#include "devicelibraryupdater.h"
 #include "gpodloader.h"
 #include "core/logging.h"
 #include "core/song.h"
@@ -24,7 +25,10 @@
 
 #include <gpod/itdb.h>
 
+#include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
+#include <QStringList>
 #include <QtDebug>
 
 GPodLoader::GPodLoader(const QString& mount_point, TaskManager* task_manager,
@@ -65,31 +69,57 @@ void GPodLoader::LoadDatabase() {
     return;
   }
 
-  // Convert all the tracks from libgpod structs into Song classes
-  const QString prefix = path_prefix_.isEmpty()
-      ? QDir::fromNativeSeparators(mount_point_) : path_prefix_;
-
-  SongList songs;
-  for (GList* tracks = db->tracks ; tracks != NULL ; tracks = tracks->next) {
-    Itdb_Track* track = static_cast<Itdb_Track*>(tracks->data);
-
-    Song song;
-    song.InitFromItdb(track, prefix);
-    song.set_directory_id(1);
-
-    if (type_ != Song::Type_Unknown)
-      song.set_filetype(type_);
-    songs << song;
+  // We still need the parsed database to copy songs to the iPod, but the
+  // library doesn't need updating if the database hasn't changed since the
+  // last time it was loaded.
+  DeviceLibraryUpdater updater(backend_, task_manager_, task_id);
+  const QString generation = Generation();
+
+  if (updater.IsUpToDate(generation)) {
+    qLog(Info) << "iPod database at" << mount_point_ << "hasn't changed";
+  } else {
+    // Convert all the tracks from libgpod structs into Song classes, and add
+    // them to the library a few at a time
+    const QString prefix = path_prefix_.isEmpty()
+        ? QDir::fromNativeSeparators(mount_point_) : path_prefix_;
+
+    updater.Start(itdb_tracks_number(db));
+    for (GList* tracks = db->tracks ; tracks != NULL ; tracks = tracks->next) {
+      Itdb_Track* track = static_cast<Itdb_Track*>(tracks->data);
+
+      Song song;
+      song.InitFromItdb(track, prefix);
+
+      if (type_ != Song::Type_Unknown)
+        song.set_filetype(type_);
+      updater.AddSong(song);
+    }
+    updater.Finish(generation);
   }
 
-  // Need to remove all the existing songs in the database first
-  backend_->DeleteSongs(backend_->FindSongsInDirectory(1));
-
-  // Add the songs we've just loaded
-  backend_->AddOrUpdateSongs(songs);
-
   moveToThread(original_thread_);
 
   task_manager_->SetTaskFinished(task_id);
   emit LoadFinished(db);
 }
+
+QString GPodLoader::Generation() const {
+  gchar* itunes_dir = itdb_get_itunes_dir(
+      QDir::toNativeSeparators(mount_point_).toLocal8Bit().constData());
+  if (!itunes_dir)
+    return QString();
+
+  const QDir dir(QString::fromLocal8Bit(itunes_dir));
+  g_free(itunes_dir);
+
+  // Newer iPods keep their database in iTunesCDB, and older ones in iTunesDB.
+  // libgpod rewrites the whole file whenever anything changes.
+  foreach (const QString& filename, QStringList() << "iTunesCDB" << "iTunesDB") {
+    const QFileInfo info(dir.filePath(filename));
+    if (info.exists()) {
+      return QString("%1:%2:%3:%4").arg(filename).arg(info.size())
+          .arg(info.lastModified().toTime_t()).arg(path_prefix_);
+    }
+  }
+  return QString();
+}
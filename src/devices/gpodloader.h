@@ -48,6 +48,10 @@ signals:
   void TaskStarted(int task_id);
   void LoadFinished(Itdb_iTunesDB* db);
 
+private:
+  // Changes whenever the iPod's database is rewritten.
+  QString Generation() const;
+
 private:
   boost::shared_ptr<ConnectedDevice> device_;
   QThread* original_thread_;
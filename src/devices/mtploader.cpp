@@ -16,14 +16,18 @@
 */
 
 #include "connecteddevice.h"
+#include "devicelibraryupdater.h"
 #include "mtpconnection.h"
 #include "mtploader.h"
+#include "core/logging.h"
 #include "core/song.h"
 #include "core/taskmanager.h"
 #include "library/librarybackend.h"
 
 #include <libmtp.h>
 
+#include <QStringList>
+
 MtpLoader::MtpLoader(const QUrl& url, TaskManager* task_manager,
                      LibraryBackend* backend, boost::shared_ptr<ConnectedDevice> device)
   : QObject(NULL),
@@ -42,7 +46,7 @@ void MtpLoader::LoadDatabase() {
   int task_id = task_manager_->StartTask(tr("Loading MTP device"));
   emit TaskStarted(task_id);
 
-  TryLoad();
+  TryLoad(task_id);
 
   moveToThread(original_thread_);
 
@@ -50,33 +54,55 @@ void MtpLoader::LoadDatabase() {
   emit LoadFinished();
 }
 
-bool MtpLoader::TryLoad() {
+QString MtpLoader::Generation(LIBMTP_mtpdevice_struct* device) {
+  // MTP devices don't tell us when their contents last changed, but adding or
+  // removing a track always changes the free space on one of the storages.
+  QStringList ret;
+  for (LIBMTP_devicestorage_t* storage = device->storage ; storage ;
+       storage = storage->next) {
+    ret << QString("%1:%2").arg(storage->id).arg(storage->FreeSpaceInBytes);
+  }
+  return ret.join(",");
+}
+
+bool MtpLoader::TryLoad(int task_id) {
   MtpConnection dev(url_);
   if (!dev.is_valid()) {
     emit Error(tr("Error connecting MTP device"));
     return false;
   }
 
+  DeviceLibraryUpdater updater(backend_, task_manager_, task_id);
+
+  // Getting the track listing takes a long time, so don't do it if nothing
+  // changed since we last connected to this device.
+  const QString generation = Generation(dev.device());
+  if (updater.IsUpToDate(generation)) {
+    qLog(Info) << "MTP device" << url_.host() << "hasn't changed";
+    return true;
+  }
+
   // Load the list of songs on the device
-  SongList songs;
   LIBMTP_track_t* tracks = LIBMTP_Get_Tracklisting_With_Callback(dev.device(), NULL, NULL);
+
+  int count = 0;
+  for (LIBMTP_track_t* track = tracks ; track ; track = track->next) {
+    count ++;
+  }
+
+  // Add the songs to the library a few at a time
+  updater.Start(count);
   while (tracks) {
     LIBMTP_track_t* track = tracks;
 
     Song song;
     song.InitFromMTP(track, url_.host());
-    song.set_directory_id(1);
-    songs << song;
+    updater.AddSong(song);
 
     tracks = tracks->next;
     LIBMTP_destroy_track_t(track);
   }
-
-  // Need to remove all the existing songs in the database first
-  backend_->DeleteSongs(backend_->FindSongsInDirectory(1));
-
-  // Add the songs we've just loaded
-  backend_->AddOrUpdateSongs(songs);
+  updater.Finish(generation);
 
   return true;
 }
@@ -27,6 +27,8 @@ class ConnectedDevice;
 class LibraryBackend;
 class TaskManager;
 
+struct LIBMTP_mtpdevice_struct;
+
 class MtpLoader : public QObject {
   Q_OBJECT
 
@@ -44,7 +46,9 @@ signals:
   void LoadFinished();
 
 private:
-  bool TryLoad();
+  static QString Generation(LIBMTP_mtpdevice_struct* device);
+
+  bool TryLoad(int task_id);
 
 private:
   boost::shared_ptr<ConnectedDevice> device_;
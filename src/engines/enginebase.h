@@ -48,6 +48,11 @@ class Base : public QObject, boost::noncopyable {
   virtual bool Init() = 0;
 
   virtual void StartPreloading(const QUrl&, bool, qint64, qint64) {}
+
+  // Engines that can prepare a track in advance to start it without a gap
+  // when it's loaded later.  Preparing another URL replaces the previous one.
+  virtual void PrepareStandby(const QUrl&, bool, qint64) {}
+  virtual void ClearStandby() {}
   virtual bool Play(quint64 offset_nanosec) = 0;
   virtual void Stop() = 0;
   virtual void Pause() = 0;
@@ -24,6 +24,7 @@
 #include "gstenginepipeline.h"
 #include "core/logging.h"
 #include "core/taskmanager.h"
+#include "core/tracer.h"
 #include "core/utilities.h"
 
 #ifdef HAVE_MOODBAR
@@ -70,6 +71,8 @@ GstEngine::GstEngine(TaskManager* task_manager)
   : Engine::Base(),
     task_manager_(task_manager),
     buffering_task_id_(-1),
+    standby_end_nanosec_(0),
+    loaded_from_standby_(false),
     latest_buffer_(NULL),
     equalizer_enabled_(false),
     stereo_balance_(0.0f),
@@ -96,6 +99,7 @@ GstEngine::~GstEngine() {
   EnsureInitialised();
 
   current_pipeline_.reset();
+  standby_pipeline_.reset();
 
   // Save configuration
   gst_deinit();
@@ -134,6 +138,9 @@ void GstEngine::ReloadSettings() {
   buffer_duration_nanosec_ = s.value("bufferduration", 4000).toLongLong() * kNsecPerMsec;
 
   mono_playback_ = s.value("monoplayback", false).toBool();
+
+  // The standby pipeline was created with the old output settings.
+  ClearStandby();
 }
 
 
@@ -235,6 +242,63 @@ void GstEngine::StartPreloading(const QUrl& url, bool force_stop_at_end,
         force_stop_at_end ? end_nanosec : 0);
 }
 
+void GstEngine::PrepareStandby(const QUrl& url, bool force_stop_at_end,
+                               qint64 end_nanosec) {
+  EnsureInitialised();
+
+  const QUrl gst_url = FixupUrl(url);
+  const qint64 stop_nanosec = force_stop_at_end ? end_nanosec : 0;
+
+  if (standby_pipeline_ && standby_pipeline_->url() == gst_url &&
+      standby_end_nanosec_ == stop_nanosec) {
+    // We're already prepared for this one.
+    return;
+  }
+
+  ClearStandby();
+
+  standby_pipeline_ = CreatePipeline(gst_url, stop_nanosec);
+  if (!standby_pipeline_)
+    return;
+  standby_end_nanosec_ = stop_nanosec;
+
+  // Nobody should see the buffers of this pipeline until it's swapped in.
+  standby_pipeline_->RemoveAllBufferConsumers();
+
+  // Going to PAUSED opens the source, finds the decoder and fills the buffer,
+  // which is most of the work Play() would have to do later.
+  standby_pipeline_->SetState(GST_STATE_PAUSED);
+  qLog(Debug) << "Prepared standby pipeline for" << gst_url;
+}
+
+void GstEngine::ClearStandby() {
+  if (!standby_pipeline_)
+    return;
+
+  qLog(Debug) << "Dropping standby pipeline for" << standby_pipeline_->url();
+  standby_pipeline_.reset();
+  standby_end_nanosec_ = 0;
+}
+
+shared_ptr<GstEnginePipeline> GstEngine::TakeStandbyPipeline(
+    const QUrl& url, qint64 end_nanosec) {
+  shared_ptr<GstEnginePipeline> ret;
+  if (!standby_pipeline_ || standby_pipeline_->url() != url ||
+      standby_end_nanosec_ != end_nanosec)
+    return ret;
+
+  ret = standby_pipeline_;
+  standby_pipeline_.reset();
+  standby_end_nanosec_ = 0;
+
+  ret->AddBufferConsumer(this);
+  foreach (BufferConsumer* consumer, buffer_consumers_) {
+    ret->AddBufferConsumer(consumer);
+  }
+
+  return ret;
+}
+
 QUrl GstEngine::FixupUrl(const QUrl& url) {
   QUrl copy = url;
 
@@ -252,6 +316,10 @@ QUrl GstEngine::FixupUrl(const QUrl& url) {
 bool GstEngine::Load(const QUrl& url, Engine::TrackChangeFlags change,
                      bool force_stop_at_end,
                      quint64 beginning_nanosec, qint64 end_nanosec) {
+  TraceScope trace("engine", "GstEngine::Load");
+  if (trace.is_recording())
+    trace.set_detail(url.toString());
+
   EnsureInitialised();
 
   Engine::Base::Load(url, change, force_stop_at_end, beginning_nanosec, end_nanosec);
@@ -272,8 +340,14 @@ bool GstEngine::Load(const QUrl& url, Engine::TrackChangeFlags change,
     return true;
   }
 
-  shared_ptr<GstEnginePipeline> pipeline = CreatePipeline(gst_url,
-      force_stop_at_end ? end_nanosec : 0);
+  load_time_.start();
+
+  const qint64 stop_nanosec = force_stop_at_end ? end_nanosec : 0;
+  shared_ptr<GstEnginePipeline> pipeline =
+      TakeStandbyPipeline(gst_url, stop_nanosec);
+  loaded_from_standby_ = pipeline.get() != NULL;
+  if (!pipeline)
+    pipeline = CreatePipeline(gst_url, stop_nanosec);
   if (!pipeline)
     return false;
 
@@ -336,6 +410,10 @@ bool GstEngine::Play(quint64 offset_nanosec) {
         PlayFutureWatcherArg(offset_nanosec, current_pipeline_->id()), this);
   watcher->setFuture(future);
   connect(watcher, SIGNAL(finished()), SLOT(PlayDone()));
+  if (Tracer::is_enabled()) {
+    Tracer::AddEventUntil(watcher, SIGNAL(finished()), "engine",
+                          "Set pipeline to PLAYING", url_.toString());
+  }
 
   if (is_fading_out_to_pause_) {
     current_pipeline_->SetState(GST_STATE_PAUSED);
@@ -373,6 +451,15 @@ void GstEngine::PlayDone() {
   }
 
   StartTimers();
+  if (Tracer::is_enabled())
+    Tracer::AddInstantEvent("engine", "Track change", url_.toString());
+
+  if (!load_time_.isNull()) {
+    qLog(Debug) << "Started playing" << url_ << "after"
+                << load_time_.elapsed() << "ms"
+                << (loaded_from_standby_ ? "(from the standby pipeline)" : "");
+    load_time_ = QTime();
+  }
 
   // initial offset
   if(offset_nanosec != 0 || beginning_nanosec_ != 0) {
@@ -395,6 +482,7 @@ void GstEngine::Stop() {
     StartFadeout();
 
   current_pipeline_.reset();
+  ClearStandby();
   BufferingFinished();
   emit StateChanged(Engine::Empty);
 }
@@ -566,6 +654,13 @@ void GstEngine::timerEvent(QTimerEvent* e) {
 
 void GstEngine::HandlePipelineError(int pipeline_id, const QString& message,
                                     int domain, int error_code) {
+  if (standby_pipeline_ && standby_pipeline_->id() == pipeline_id) {
+    // Leave it to Load() to report the error if this track is played.
+    qLog(Debug) << "Standby pipeline failed:" << message;
+    ClearStandby();
+    return;
+  }
+
   if (!current_pipeline_.get() || current_pipeline_->id() != pipeline_id)
     return;
 
@@ -32,6 +32,7 @@
 #include <QList>
 #include <QString>
 #include <QStringList>
+#include <QTime>
 #include <QTimerEvent>
 
 #include <gst/gst.h>
@@ -90,6 +91,9 @@ class GstEngine : public Engine::Base, public BufferConsumer {
  public slots:
   void StartPreloading(const QUrl& url, bool force_stop_at_end,
                        qint64 beginning_nanosec, qint64 end_nanosec);
+  void PrepareStandby(const QUrl& url, bool force_stop_at_end,
+                      qint64 end_nanosec);
+  void ClearStandby();
   bool Load(const QUrl&, Engine::TrackChangeFlags change,
             bool force_stop_at_end,
             quint64 beginning_nanosec, qint64 end_nanosec);
@@ -149,6 +153,11 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   boost::shared_ptr<GstEnginePipeline> CreatePipeline();
   boost::shared_ptr<GstEnginePipeline> CreatePipeline(const QUrl& url, qint64 end_nanosec);
 
+  // Returns the standby pipeline if it was prepared for this URL, ready to
+  // become the current pipeline, or a null pointer otherwise.
+  boost::shared_ptr<GstEnginePipeline> TakeStandbyPipeline(const QUrl& url,
+                                                           qint64 end_nanosec);
+
   void UpdateScope();
 
   int AddBackgroundStream(boost::shared_ptr<GstEnginePipeline> pipeline);
@@ -176,6 +185,15 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   boost::shared_ptr<GstEnginePipeline> fadeout_pause_pipeline_;
   QUrl preloaded_url_;
 
+  // A pipeline for the track that's expected to play next, already prerolled
+  // in the PAUSED state so it can start straight away.
+  boost::shared_ptr<GstEnginePipeline> standby_pipeline_;
+  qint64 standby_end_nanosec_;
+
+  // Used to measure how long it takes to hear a track after it was loaded.
+  QTime load_time_;
+  bool loaded_from_standby_;
+
   QList<BufferConsumer*> buffer_consumers_;
 
   GstBuffer* latest_buffer_;
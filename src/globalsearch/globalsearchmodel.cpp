@@ -146,6 +146,7 @@ QStandardItem* GlobalSearchModel::BuildContainers(
     break;
 
   case LibraryModel::GroupBy_None:
+  case LibraryModel::GroupBy_IdenticalAudio:
     return parent;
   }
 
@@ -0,0 +1,423 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "catalogueimporter.h"
+
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QNetworkReply>
+#include <QRegExp>
+#include <QSqlQuery>
+#include <QWaitCondition>
+#include <QXmlStreamReader>
+#include <QtConcurrentRun>
+
+#include "qtiocompressor.h"
+
+#include "core/application.h"
+#include "core/database.h"
+#include "core/logging.h"
+#include "core/scopedtransaction.h"
+#include "core/taskmanager.h"
+#include "library/librarybackend.h"
+
+const int CatalogueImporter::kBatchSize = 1000;
+const char* CatalogueImporter::kShadowSuffix = "_import";
+
+
+// A read-only device that the main thread appends downloaded data to.  Reads
+// from the worker thread block until more data arrives or the download ends.
+class CatalogueImporter::StreamingBuffer : public QIODevice {
+ public:
+  StreamingBuffer() : read_pos_(0), finished_(false), error_(false) {}
+
+  bool isSequential() const { return true; }
+
+  void Append(const QByteArray& data) {
+    QMutexLocker l(&mutex_);
+    buffer_.append(data);
+    wait_condition_.wakeAll();
+  }
+
+  void Finish(bool error) {
+    QMutexLocker l(&mutex_);
+    finished_ = true;
+    error_ = error;
+    wait_condition_.wakeAll();
+  }
+
+  bool has_error() const {
+    QMutexLocker l(&mutex_);
+    return error_;
+  }
+
+ protected:
+  qint64 readData(char* data, qint64 max_size) {
+    QMutexLocker l(&mutex_);
+    while (read_pos_ >= buffer_.size() && !finished_) {
+      wait_condition_.wait(&mutex_);
+    }
+
+    if (read_pos_ >= buffer_.size()) {
+      return error_ ? -1 : 0;
+    }
+
+    const qint64 bytes = qMin(max_size, qint64(buffer_.size() - read_pos_));
+    memcpy(data, buffer_.constData() + read_pos_, bytes);
+    read_pos_ += bytes;
+
+    // Throw away the data we've read once there's enough of it.
+    if (read_pos_ > buffer_.size() / 2) {
+      buffer_.remove(0, read_pos_);
+      read_pos_ = 0;
+    }
+
+    return bytes;
+  }
+
+  qint64 writeData(const char*, qint64) {
+    return -1;
+  }
+
+ private:
+  mutable QMutex mutex_;
+  QWaitCondition wait_condition_;
+
+  QByteArray buffer_;
+  int read_pos_;
+  bool finished_;
+  bool error_;
+};
+
+
+CatalogueImporter::CatalogueImporter(Application* app, LibraryBackend* backend,
+                                     QObject* parent)
+  : QObject(parent),
+    app_(app),
+    backend_(backend),
+    songs_table_(backend->songs_table()),
+    fts_table_(backend->fts_table()),
+    reply_(NULL),
+    buffer_(NULL),
+    task_id_(0),
+    imported_count_(0),
+    fts_rowid_(0)
+{
+}
+
+CatalogueImporter::~CatalogueImporter() {
+  if (reply_) {
+    disconnect(reply_, 0, this, 0);
+    reply_->abort();
+    delete reply_;
+  }
+
+  if (buffer_) {
+    // Make the worker thread give up and wait for it.
+    buffer_->Finish(true);
+    future_.waitForFinished();
+    delete buffer_;
+  }
+}
+
+void CatalogueImporter::AddExtraTable(const QString& table) {
+  extra_tables_ << table;
+}
+
+QString CatalogueImporter::ShadowTable(const QString& table) {
+  return table + kShadowSuffix;
+}
+
+QString CatalogueImporter::SchemaName(const QString& table) {
+  if (table.contains('.'))
+    return table.section('.', 0, 0);
+  return "main";
+}
+
+QString CatalogueImporter::BaseName(const QString& table) {
+  return table.section('.', -1, -1);
+}
+
+QString CatalogueImporter::ShadowIndex(const QString& index) {
+  // The old table's indexes still exist while the shadow table is filled, so
+  // the shadow indexes need different names.  They keep them after the swap,
+  // so the names alternate between imports.
+  if (index.endsWith(kShadowSuffix))
+    return index.left(index.length() - qstrlen(kShadowSuffix));
+  return index + kShadowSuffix;
+}
+
+void CatalogueImporter::Start(QNetworkReply* reply, const QString& task_name,
+                              ParseFunction parse) {
+  if (is_running()) {
+    reply->abort();
+    reply->deleteLater();
+    return;
+  }
+
+  delete buffer_;
+  buffer_ = new StreamingBuffer;
+  buffer_->open(QIODevice::ReadOnly);
+
+  reply_ = reply;
+  connect(reply, SIGNAL(readyRead()), SLOT(ReplyReadyRead()));
+  connect(reply, SIGNAL(finished()), SLOT(ReplyFinished()));
+  connect(reply, SIGNAL(downloadProgress(qint64,qint64)),
+          SLOT(DownloadProgress(qint64,qint64)));
+
+  task_id_ = app_->task_manager()->StartTask(task_name);
+  imported_count_ = 0;
+
+  future_ = QtConcurrent::run(this, &CatalogueImporter::Import, parse);
+  QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+  watcher->setFuture(future_);
+  connect(watcher, SIGNAL(finished()), SLOT(ImportFinished()));
+}
+
+void CatalogueImporter::ReplyReadyRead() {
+  buffer_->Append(reply_->readAll());
+}
+
+void CatalogueImporter::ReplyFinished() {
+  const bool error = reply_->error() != QNetworkReply::NoError;
+  if (error) {
+    qLog(Warning) << "Failed to download catalogue" << reply_->errorString();
+  } else {
+    buffer_->Append(reply_->readAll());
+  }
+
+  buffer_->Finish(error);
+  reply_->deleteLater();
+  reply_ = NULL;
+}
+
+void CatalogueImporter::DownloadProgress(qint64 received, qint64 total) {
+  if (total <= 0)
+    return;
+
+  const float progress = float(received) / total;
+  app_->task_manager()->SetTaskProgress(task_id_, int(progress * 100), 100);
+}
+
+void CatalogueImporter::ImportFinished() {
+  QFutureWatcher<bool>* watcher = static_cast<QFutureWatcher<bool>*>(sender());
+  watcher->deleteLater();
+
+  app_->task_manager()->SetTaskFinished(task_id_);
+  task_id_ = 0;
+
+  emit Finished(watcher->result());
+}
+
+bool CatalogueImporter::Import(ParseFunction parse) {
+  if (!CreateShadowTables()) {
+    DropShadowTables();
+    return false;
+  }
+
+  QtIOCompressor gzip(buffer_);
+  gzip.setStreamFormat(QtIOCompressor::GzipFormat);
+  if (!gzip.open(QIODevice::ReadOnly)) {
+    qLog(Warning) << "Catalogue not in gzip format";
+    DropShadowTables();
+    return false;
+  }
+
+  QXmlStreamReader reader(&gzip);
+  parse(&reader, this);
+  FlushSongs();
+
+  if (reader.hasError() || buffer_->has_error()) {
+    qLog(Warning) << "Failed to import catalogue into" << songs_table_
+                  << reader.errorString();
+    DropShadowTables();
+    return false;
+  }
+
+  qLog(Info) << "Imported" << imported_count_ << "songs into" << songs_table_;
+  if (!SwapShadowTables()) {
+    DropShadowTables();
+    return false;
+  }
+
+  backend_->UpdateTotalSongCount();
+  return true;
+}
+
+void CatalogueImporter::AddSongs(const SongList& songs) {
+  pending_songs_ << songs;
+  if (pending_songs_.count() >= kBatchSize)
+    FlushSongs();
+}
+
+void CatalogueImporter::FlushSongs() {
+  if (pending_songs_.isEmpty())
+    return;
+
+  {
+    QMutexLocker l(backend_->db()->Mutex());
+    QSqlDatabase db(backend_->db()->Connect());
+
+    QSqlQuery insert(QString("INSERT INTO %1 (" + Song::kColumnSpec + ")"
+                             " VALUES (" + Song::kBindSpec + ")")
+                     .arg(ShadowTable(songs_table_)), db);
+
+    ScopedTransaction t(&db);
+    qint64 last_rowid = fts_rowid_;
+    foreach (const Song& song, pending_songs_) {
+      song.BindToQuery(&insert);
+      insert.exec();
+      if (!backend_->db()->CheckErrors(insert))
+        last_rowid = qMax(last_rowid, insert.lastInsertId().toLongLong());
+    }
+
+    // Index this batch with one statement, so the swap doesn't have to index
+    // the whole catalogue.
+    QSqlQuery fts(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ")"
+                          " SELECT ROWID, " + Song::kFtsSourceColumnSpec +
+                          " FROM %2 WHERE ROWID > :rowid")
+                  .arg(ShadowTable(fts_table_), ShadowTable(songs_table_)), db);
+    fts.bindValue(":rowid", fts_rowid_);
+    fts.exec();
+    backend_->db()->CheckErrors(fts);
+
+    t.Commit();
+    fts_rowid_ = last_rowid;
+  }
+
+  imported_count_ += pending_songs_.count();
+  pending_songs_.clear();
+}
+
+void CatalogueImporter::AddRows(const QString& table, const QString& column,
+                                const QVariantList& values) {
+  QMutexLocker l(backend_->db()->Mutex());
+  QSqlDatabase db(backend_->db()->Connect());
+
+  QSqlQuery insert(QString("INSERT INTO %1 (%2) VALUES (:value)")
+                   .arg(ShadowTable(table), column), db);
+
+  ScopedTransaction t(&db);
+  foreach (const QVariant& value, values) {
+    insert.bindValue(":value", value);
+    insert.exec();
+    backend_->db()->CheckErrors(insert);
+  }
+  t.Commit();
+}
+
+bool CatalogueImporter::Exec(const QString& sql, QSqlDatabase& db) {
+  QSqlQuery q(db);
+  q.exec(sql);
+  return !backend_->db()->CheckErrors(q);
+}
+
+bool CatalogueImporter::CreateShadowTables() {
+  QMutexLocker l(backend_->db()->Mutex());
+  QSqlDatabase db(backend_->db()->Connect());
+
+  // Copy the CREATE statement of each table so the shadow tables get exactly
+  // the same columns and FTS tokenizer.  The indexes are copied too, while the
+  // tables are still empty, so they're filled in batches along with the rows.
+  QRegExp create_re("^(CREATE\\s+(?:VIRTUAL\\s+)?TABLE\\s+)(\"[^\"]+\"|[^\\s(]+)",
+                    Qt::CaseInsensitive);
+  QRegExp index_re("^(CREATE\\s+(?:UNIQUE\\s+)?INDEX\\s+"
+                   "(?:IF\\s+NOT\\s+EXISTS\\s+)?)(?:[^\\s.]+\\.)?([^\\s.]+)"
+                   "\\s+ON\\s+[^\\s(]+", Qt::CaseInsensitive);
+
+  const QStringList tables =
+      QStringList() << songs_table_ << fts_table_ << extra_tables_;
+
+  ScopedTransaction t(&db);
+  foreach (const QString& table, tables) {
+    const QString schema = SchemaName(table);
+
+    if (!Exec("DROP TABLE IF EXISTS " + ShadowTable(table), db))
+      return false;
+
+    QSqlQuery q(QString("SELECT type, sql FROM %1.sqlite_master"
+                        " WHERE tbl_name = :name AND sql NOT NULL"
+                        " ORDER BY type = 'index'").arg(schema), db);
+    q.bindValue(":name", BaseName(table));
+    q.exec();
+    if (backend_->db()->CheckErrors(q) || !q.next() ||
+        q.value(0).toString() != "table") {
+      qLog(Warning) << "Couldn't find the schema of" << table;
+      return false;
+    }
+
+    QStringList statements;
+    do {
+      QString sql = q.value(1).toString();
+      if (q.value(0).toString() == "table") {
+        sql.replace(create_re, "\\1" + ShadowTable(table));
+      } else if (index_re.indexIn(sql) != -1) {
+        const QString prefix = schema == "main" ? QString() : schema + ".";
+        sql.replace(0, index_re.matchedLength(),
+                    index_re.cap(1) + prefix + ShadowIndex(index_re.cap(2)) +
+                    " ON " + BaseName(ShadowTable(table)));
+      } else {
+        qLog(Warning) << "Couldn't copy index" << sql;
+        return false;
+      }
+      statements << sql;
+    } while (q.next());
+    q.finish();
+
+    foreach (const QString& sql, statements) {
+      if (!Exec(sql, db))
+        return false;
+    }
+  }
+  t.Commit();
+
+  fts_rowid_ = 0;
+  return true;
+}
+
+void CatalogueImporter::DropShadowTables() {
+  QMutexLocker l(backend_->db()->Mutex());
+  QSqlDatabase db(backend_->db()->Connect());
+
+  const QStringList tables =
+      QStringList() << songs_table_ << fts_table_ << extra_tables_;
+
+  foreach (const QString& table, tables) {
+    Exec("DROP TABLE IF EXISTS " + ShadowTable(table), db);
+  }
+}
+
+bool CatalogueImporter::SwapShadowTables() {
+  QMutexLocker l(backend_->db()->Mutex());
+  QSqlDatabase db(backend_->db()->Connect());
+
+  // Everything was indexed while it was imported, so this only renames the
+  // tables and doesn't keep the database locked for long.
+  const QStringList tables =
+      QStringList() << songs_table_ << fts_table_ << extra_tables_;
+
+  ScopedTransaction t(&db);
+  foreach (const QString& table, tables) {
+    if (!Exec("DROP TABLE " + table, db) ||
+        !Exec(QString("ALTER TABLE %1 RENAME TO %2")
+              .arg(ShadowTable(table), BaseName(table)), db))
+      return false;
+  }
+
+  t.Commit();
+  return true;
+}
@@ -0,0 +1,132 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CATALOGUEIMPORTER_H
+#define CATALOGUEIMPORTER_H
+
+#include <QFuture>
+#include <QObject>
+#include <QStringList>
+#include <QVariantList>
+
+#include <boost/function.hpp>
+
+#include "gtest/gtest_prod.h"
+
+#include "core/song.h"
+
+class Application;
+class LibraryBackend;
+
+class QNetworkReply;
+class QSqlDatabase;
+class QXmlStreamReader;
+
+// Imports the gzipped XML catalogue of an internet service (like Jamendo or
+// Magnatune) into its songs table.
+//
+// The catalogue is decompressed and parsed in a worker thread while it's still
+// being downloaded.  Songs are written in small batches to a shadow copy of the
+// songs table, along with their FTS and index entries, so the database mutex is
+// only held for a short time and the old catalogue can still be browsed.  At
+// the end the shadow tables are renamed to replace the real ones in a single
+// transaction.
+class CatalogueImporter : public QObject {
+  Q_OBJECT
+
+ public:
+  CatalogueImporter(Application* app, LibraryBackend* backend,
+                    QObject* parent = 0);
+  ~CatalogueImporter();
+
+  static const int kBatchSize;
+  static const char* kShadowSuffix;
+
+  // Reads songs from the XML and passes them to AddSongs.  Called in the worker
+  // thread.
+  typedef boost::function<void (QXmlStreamReader*, CatalogueImporter*)>
+      ParseFunction;
+
+  // Other tables that belong to the catalogue and are rebuilt along with the
+  // songs, like Jamendo's track IDs.
+  void AddExtraTable(const QString& table);
+
+  // Starts importing the response to this request.  Takes ownership of the
+  // reply.
+  void Start(QNetworkReply* reply, const QString& task_name,
+             ParseFunction parse);
+
+  bool is_running() const { return future_.isRunning(); }
+
+  // These are called by the ParseFunction from the worker thread.
+  void AddSongs(const SongList& songs);
+  void AddRows(const QString& table, const QString& column,
+               const QVariantList& values);
+
+ signals:
+  // Emitted in the main thread.  If the import failed the old catalogue is
+  // left untouched.
+  void Finished(bool success);
+
+ private slots:
+  void ReplyReadyRead();
+  void ReplyFinished();
+  void DownloadProgress(qint64 received, qint64 total);
+  void ImportFinished();
+
+ private:
+  class StreamingBuffer;
+
+  static QString ShadowTable(const QString& table);
+  static QString SchemaName(const QString& table);
+  static QString BaseName(const QString& table);
+  static QString ShadowIndex(const QString& index);
+
+  bool Import(ParseFunction parse);
+
+  void FlushSongs();
+  bool CreateShadowTables();
+  void DropShadowTables();
+  bool SwapShadowTables();
+  bool Exec(const QString& sql, QSqlDatabase& db);
+
+ private:
+  Application* app_;
+  LibraryBackend* backend_;
+
+  QString songs_table_;
+  QString fts_table_;
+  QStringList extra_tables_;
+
+  QNetworkReply* reply_;
+  StreamingBuffer* buffer_;
+  QFuture<bool> future_;
+  int task_id_;
+
+  // Only touched in the worker thread.
+  SongList pending_songs_;
+  int imported_count_;
+
+  // The last ROWID of the shadow songs table that's in the shadow FTS table.
+  qint64 fts_rowid_;
+
+  FRIEND_TEST(CatalogueImporterTest, OldCatalogueUntilSwap);
+  FRIEND_TEST(CatalogueImporterTest, FtsMatchesSongs);
+  FRIEND_TEST(CatalogueImporterTest, KeepsIndexes);
+};
+
+#endif // CATALOGUEIMPORTER_H
@@ -42,12 +42,12 @@ InternetPlaylistItem::InternetPlaylistItem(InternetService* service, const Song&
 }
 
 bool InternetPlaylistItem::InitFromQuery(const SqlRow& query) {
-  // The song tables gets joined first, plus one each for the song ROWIDs
+  // The library song and the item's own song come first, with their ROWIDs
   const int row = (Song::kColumns.count() + 1) * PlaylistBackend::kSongTableJoins;
 
   service_name_ = query.value(row + 1).toString();
 
-  metadata_.InitFromQuery(query, false, (Song::kColumns.count() + 1) * 3);
+  metadata_.InitFromQuery(query, false, Song::kColumns.count() + 1);
   InitMetadata();
 
   return true;
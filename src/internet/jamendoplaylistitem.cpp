@@ -29,8 +29,8 @@ JamendoPlaylistItem::JamendoPlaylistItem(const Song& song)
 }
 
 bool JamendoPlaylistItem::InitFromQuery(const SqlRow& query) {
-  // Rows from the songs tables come first
-  song_.InitFromQuery(query, true, (Song::kColumns.count() + 1) * 2);
+  // The row from the songs table comes first
+  song_.InitFromQuery(query, true);
 
   return song_.is_valid();
 }
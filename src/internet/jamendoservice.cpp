@@ -17,6 +17,7 @@
 
 #include "jamendoservice.h"
 
+#include "catalogueimporter.h"
 #include "jamendodynamicplaylist.h"
 #include "jamendoplaylistitem.h"
 #include "internetmodel.h"
@@ -25,7 +26,6 @@
 #include "core/logging.h"
 #include "core/mergedproxymodel.h"
 #include "core/network.h"
-#include "core/scopedtransaction.h"
 #include "core/taskmanager.h"
 #include "core/timeconstants.h"
 #include "globalsearch/globalsearch.h"
@@ -38,14 +38,13 @@
 #include "ui/iconloader.h"
 
 #include <QDesktopServices>
-#include <QFutureWatcher>
 #include <QMenu>
 #include <QMessageBox>
 #include <QNetworkReply>
 #include <QSortFilterProxyModel>
-#include <QtConcurrentRun>
 #include <QXmlStreamReader>
-#include "qtiocompressor.h"
+
+#include <boost/bind.hpp>
 
 const char* JamendoService::kServiceName = "Jamendo";
 const char* JamendoService::kDirectoryUrl =
@@ -67,8 +66,7 @@ const char* JamendoService::kTrackIdsColumn = "track_id";
 
 const char* JamendoService::kSettingsGroup = "Jamendo";
 
-const int JamendoService::kBatchSize = 10000;
-const int JamendoService::kApproxDatabaseSize = 300000;
+const int JamendoService::kBatchSize = 1000;
 
 JamendoService::JamendoService(Application* app, InternetModel* parent)
     : InternetService(kServiceName, app, parent, parent),
@@ -79,7 +77,7 @@ JamendoService::JamendoService(Application* app, InternetModel* parent)
       library_model_(NULL),
       library_sort_model_(new QSortFilterProxyModel(this)),
       search_provider_(NULL),
-      load_database_task_id_(0),
+      importer_(NULL),
       total_song_count_(0),
       accepted_download_(false) {
   library_backend_ = new LibraryBackend;
@@ -89,6 +87,10 @@ JamendoService::JamendoService(Application* app, InternetModel* parent)
   connect(library_backend_, SIGNAL(TotalSongCountUpdated(int)),
           SLOT(UpdateTotalSongCount(int)));
 
+  importer_ = new CatalogueImporter(app_, library_backend_, this);
+  importer_->AddExtraTable(kTrackIdsTable);
+  connect(importer_, SIGNAL(Finished(bool)), SLOT(ImportFinished(bool)));
+
   using smart_playlists::Generator;
   using smart_playlists::GeneratorPtr;
   using smart_playlists::QueryGenerator;
@@ -146,7 +148,7 @@ QStandardItem* JamendoService::CreateRootItem() {
 void JamendoService::LazyPopulate(QStandardItem* item) {
   switch (item->data(InternetModel::Role_Type).toInt()) {
     case InternetModel::Type_Service: {
-      if (total_song_count_ == 0 && !load_database_task_id_) {
+      if (total_song_count_ == 0 && !importer_->is_running()) {
         DownloadDirectory();
       }
       model()->merged_model()->AddSubModel(item->index(), library_sort_model_);
@@ -166,6 +168,9 @@ void JamendoService::UpdateTotalSongCount(int count) {
 }
 
 void JamendoService::DownloadDirectory() {
+  if (importer_->is_running())
+    return;
+
   //don't ask if we're refreshing the database
   if (total_song_count_ == 0) {
     if (QMessageBox::question(context_menu_, tr("Jamendo database"), tr("This action will create a database which could be as big as 150 MB.\n"
@@ -177,115 +182,44 @@ void JamendoService::DownloadDirectory() {
   req.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                    QNetworkRequest::AlwaysNetwork);
 
-  QNetworkReply* reply = network_->get(req);
-  connect(reply, SIGNAL(finished()), SLOT(DownloadDirectoryFinished()));
-  connect(reply, SIGNAL(downloadProgress(qint64,qint64)),
-                 SLOT(DownloadDirectoryProgress(qint64,qint64)));
-
-  if (!load_database_task_id_) {
-    load_database_task_id_ = app_->task_manager()->StartTask(
-        tr("Downloading Jamendo catalogue"));
-  }
-}
-
-void JamendoService::DownloadDirectoryProgress(qint64 received, qint64 total) {
-  float progress = float(received) / total;
-  app_->task_manager()->SetTaskProgress(load_database_task_id_,
-                                                  int(progress * 100), 100);
-}
-
-void JamendoService::DownloadDirectoryFinished() {
-  QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-  Q_ASSERT(reply);
-
-  app_->task_manager()->SetTaskFinished(load_database_task_id_);
-  load_database_task_id_ = 0;
-
-  // TODO: Not leak reply.
-  QtIOCompressor* gzip = new QtIOCompressor(reply);
-  gzip->setStreamFormat(QtIOCompressor::GzipFormat);
-  if (!gzip->open(QIODevice::ReadOnly)) {
-    qLog(Warning) << "Jamendo library not in gzip format";
-    delete gzip;
-    return;
-  }
-
-  load_database_task_id_ = app_->task_manager()->StartTask(
-      tr("Parsing Jamendo catalogue"));
-
-  QFuture<void> future = QtConcurrent::run(
-      this, &JamendoService::ParseDirectory, gzip);
-  QFutureWatcher<void>* watcher = new QFutureWatcher<void>();
-  watcher->setFuture(future);
-  connect(watcher, SIGNAL(finished()), SLOT(ParseDirectoryFinished()));
+  // The catalogue is parsed and imported while it's downloading.
+  importer_->Start(network_->get(req), tr("Downloading Jamendo catalogue"),
+                   boost::bind(&JamendoService::ParseDirectory, this, _1, _2));
 }
 
-void JamendoService::ParseDirectory(QIODevice* device) const {
-  int total_count = 0;
-
-  // Bit of a hack: don't update the model while we're parsing the xml
-  disconnect(library_backend_, SIGNAL(SongsDiscovered(SongList)),
-             library_model_, SLOT(SongsDiscovered(SongList)));
-  disconnect(library_backend_, SIGNAL(TotalSongCountUpdated(int)),
-             this, SLOT(UpdateTotalSongCount(int)));
-
-  // Delete the database and recreate it.  This is faster than dropping tables
-  // or removing rows.
-  library_backend_->db()->RecreateAttachedDb("jamendo");
-
+void JamendoService::ParseDirectory(QXmlStreamReader* reader,
+                                    CatalogueImporter* importer) const {
   TrackIdList track_ids;
   SongList songs;
-  QXmlStreamReader reader(device);
-  while (!reader.atEnd()) {
-    reader.readNext();
-    if (reader.tokenType() == QXmlStreamReader::StartElement &&
-        reader.name() == "artist") {
-      songs << ReadArtist(&reader, &track_ids);
+  while (!reader->atEnd()) {
+    reader->readNext();
+    if (reader->tokenType() == QXmlStreamReader::StartElement &&
+        reader->name() == "artist") {
+      songs << ReadArtist(reader, &track_ids);
     }
 
     if (songs.count() >= kBatchSize) {
       // Add the songs to the database in batches
-      library_backend_->AddOrUpdateSongs(songs);
-      InsertTrackIds(track_ids);
+      importer->AddSongs(songs);
+      InsertTrackIds(track_ids, importer);
 
-      total_count += songs.count();
       songs.clear();
       track_ids.clear();
-
-      // Update progress info
-      app_->task_manager()->SetTaskProgress(
-            load_database_task_id_, total_count, kApproxDatabaseSize);
     }
   }
 
-  library_backend_->AddOrUpdateSongs(songs);
-  InsertTrackIds(track_ids);
-
-  connect(library_backend_, SIGNAL(SongsDiscovered(SongList)),
-          library_model_, SLOT(SongsDiscovered(SongList)));
-  connect(library_backend_, SIGNAL(TotalSongCountUpdated(int)),
-          SLOT(UpdateTotalSongCount(int)));
-
-  library_backend_->UpdateTotalSongCount();
+  importer->AddSongs(songs);
+  InsertTrackIds(track_ids, importer);
 }
 
-void JamendoService::InsertTrackIds(const TrackIdList& ids) const {
-  QMutexLocker l(library_backend_->db()->Mutex());
-  QSqlDatabase db(library_backend_->db()->Connect());
-
-  ScopedTransaction t(&db);
-
-  QSqlQuery insert(QString("INSERT INTO %1 (%2) VALUES (:id)")
-                   .arg(kTrackIdsTable, kTrackIdsColumn), db);
-
+void JamendoService::InsertTrackIds(const TrackIdList& ids,
+                                    CatalogueImporter* importer) const {
+  QVariantList values;
   foreach (int id, ids) {
-    insert.bindValue(":id", id);
-    if (!insert.exec()) {
-      qLog(Warning) << "Query failed" << insert.lastQuery();
-    }
+    values << id;
   }
 
-  t.Commit();
+  importer->AddRows(kTrackIdsTable, kTrackIdsColumn, values);
 }
 
 SongList JamendoService::ReadArtist(QXmlStreamReader* reader,
@@ -393,16 +327,13 @@ Song JamendoService::ReadTrack(const QString& artist,
   return song;
 }
 
-void JamendoService::ParseDirectoryFinished() {
-  QFutureWatcher<void>* watcher = static_cast<QFutureWatcher<void>*>(sender());
-  delete watcher;
+void JamendoService::ImportFinished(bool success) {
+  if (!success)
+    return;
 
   //show smart playlists
   library_model_->set_show_smart_playlists(true);
   library_model_->Reset();
-
-  app_->task_manager()->SetTaskFinished(load_database_task_id_);
-  load_database_task_id_ = 0;
 }
 
 void JamendoService::EnsureMenuCreated() {
@@ -24,6 +24,7 @@
 
 #include "core/song.h"
 
+class CatalogueImporter;
 class LibraryBackend;
 class LibraryFilterWidget;
 class LibraryModel;
@@ -31,7 +32,6 @@ class LibrarySearchProvider;
 class NetworkAccessManager;
 class SearchProvider;
 
-class QIODevice;
 class QMenu;
 class QSortFilterProxyModel;
 
@@ -67,10 +67,10 @@ class JamendoService : public InternetService {
   static const char* kSettingsGroup;
 
   static const int kBatchSize;
-  static const int kApproxDatabaseSize;
 
  private:
-  void ParseDirectory(QIODevice* device) const;
+  void ParseDirectory(QXmlStreamReader* reader,
+                      CatalogueImporter* importer) const;
 
   typedef QList<int> TrackIdList;
 
@@ -83,15 +83,14 @@ class JamendoService : public InternetService {
                  int album_id,
                  QXmlStreamReader* reader,
                  TrackIdList* track_ids) const;
-  void InsertTrackIds(const TrackIdList& ids) const;
+  void InsertTrackIds(const TrackIdList& ids,
+                      CatalogueImporter* importer) const;
 
   void EnsureMenuCreated();
 
  private slots:
   void DownloadDirectory();
-  void DownloadDirectoryProgress(qint64 received, qint64 total);
-  void DownloadDirectoryFinished();
-  void ParseDirectoryFinished();
+  void ImportFinished(bool success);
   void UpdateTotalSongCount(int count);
 
   void AlbumInfo();
@@ -114,7 +113,7 @@ class JamendoService : public InternetService {
   QSortFilterProxyModel* library_sort_model_;
   LibrarySearchProvider* search_provider_;
 
-  int load_database_task_id_;
+  CatalogueImporter* importer_;
 
   int total_song_count_;
 
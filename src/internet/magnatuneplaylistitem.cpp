@@ -30,8 +30,8 @@ MagnatunePlaylistItem::MagnatunePlaylistItem(const Song& song)
 }
 
 bool MagnatunePlaylistItem::InitFromQuery(const SqlRow& query) {
-  // Rows from the songs tables come first
-  song_.InitFromQuery(query, true, Song::kColumns.count() + 1);
+  // The row from the songs table comes first
+  song_.InitFromQuery(query, true);
 
   return song_.is_valid();
 }
@@ -15,6 +15,7 @@
    along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "catalogueimporter.h"
 #include "magnatunedownloaddialog.h"
 #include "magnatuneplaylistitem.h"
 #include "magnatuneservice.h"
@@ -37,8 +38,6 @@
 #include "ui/iconloader.h"
 #include "ui/settingsdialog.h"
 
-#include "qtiocompressor.h"
-
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
@@ -51,6 +50,8 @@
 
 #include <QtDebug>
 
+#include <boost/bind.hpp>
+
 using boost::shared_ptr;
 
 const char* MagnatuneService::kServiceName = "Magnatune";
@@ -75,7 +76,7 @@ MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
     library_model_(NULL),
     library_filter_(NULL),
     library_sort_model_(new QSortFilterProxyModel(this)),
-    load_database_task_id_(0),
+    importer_(NULL),
     membership_(Membership_None),
     format_(Format_Ogg),
     total_song_count_(0),
@@ -91,6 +92,9 @@ MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
   connect(library_backend_, SIGNAL(TotalSongCountUpdated(int)),
           SLOT(UpdateTotalSongCount(int)));
 
+  importer_ = new CatalogueImporter(app_, library_backend_, this);
+  connect(importer_, SIGNAL(Finished(bool)), SLOT(ImportFinished(bool)));
+
   library_sort_model_->setSourceModel(library_model_);
   library_sort_model_->setSortRole(LibraryModel::Role_SortText);
   library_sort_model_->setDynamicSortFilter(true);
@@ -130,7 +134,7 @@ void MagnatuneService::LazyPopulate(QStandardItem* item) {
   switch (item->data(InternetModel::Role_Type).toInt()) {
     case InternetModel::Type_Service:
       library_model_->Init();
-      if (total_song_count_ == 0 && !load_database_task_id_) {
+      if (total_song_count_ == 0 && !importer_->is_running()) {
         ReloadDatabase();
       }
       model()->merged_model()->AddSubModel(item->index(), library_sort_model_);
@@ -146,58 +150,38 @@ void MagnatuneService::UpdateTotalSongCount(int count) {
 }
 
 void MagnatuneService::ReloadDatabase() {
+  if (importer_->is_running())
+    return;
+
   QNetworkRequest request = QNetworkRequest(QUrl(kDatabaseUrl));
   request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                        QNetworkRequest::AlwaysNetwork);
 
-  QNetworkReply* reply = network_->get(request);
-  connect(reply, SIGNAL(finished()), SLOT(ReloadDatabaseFinished()));
-  
-  if (!load_database_task_id_)
-    load_database_task_id_ = app_->task_manager()->StartTask(
-        tr("Downloading Magnatune catalogue"));
+  // The catalogue is parsed and imported while it's downloading.
+  importer_->Start(network_->get(request),
+                   tr("Downloading Magnatune catalogue"),
+                   boost::bind(&MagnatuneService::ParseDatabase, this, _1, _2));
 }
 
-void MagnatuneService::ReloadDatabaseFinished() {
-  QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+void MagnatuneService::ParseDatabase(QXmlStreamReader* reader,
+                                     CatalogueImporter* importer) {
+  while (!reader->atEnd()) {
+    reader->readNext();
 
-  app_->task_manager()->SetTaskFinished(load_database_task_id_);
-  load_database_task_id_ = 0;
+    if (reader->tokenType() == QXmlStreamReader::StartElement &&
+        reader->name() == "Track") {
+      importer->AddSongs(SongList() << ReadTrack(*reader));
+    }
+  }
+}
 
-  if (reply->error() != QNetworkReply::NoError) {
-    // TODO: Error handling
-    qLog(Error) << reply->errorString();
+void MagnatuneService::ImportFinished(bool success) {
+  if (!success)
     return;
-  }
 
   if (root_->hasChildren())
     root_->removeRows(0, root_->rowCount());
 
-  // The XML file is compressed
-  QtIOCompressor gzip(reply);
-  gzip.setStreamFormat(QtIOCompressor::GzipFormat);
-  if (!gzip.open(QIODevice::ReadOnly)) {
-    qLog(Warning) << "Error opening gzip stream";
-    return;
-  }
-
-  // Remove all existing songs in the database
-  library_backend_->DeleteAll();
-
-  // Parse the XML we got from Magnatune
-  QXmlStreamReader reader(&gzip);
-  SongList songs;
-  while (!reader.atEnd()) {
-    reader.readNext();
-
-    if (reader.tokenType() == QXmlStreamReader::StartElement &&
-        reader.name() == "Track") {
-      songs << ReadTrack(reader);
-    }
-  }
-
-  // Add the songs to the database
-  library_backend_->AddOrUpdateSongs(songs);
   library_model_->Reset();
 }
 
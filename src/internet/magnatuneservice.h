@@ -26,6 +26,7 @@ class QNetworkAccessManager;
 class QSortFilterProxyModel;
 class QMenu;
 
+class CatalogueImporter;
 class LibraryBackend;
 class LibraryModel;
 class MagnatuneUrlHandler;
@@ -92,7 +93,7 @@ class MagnatuneService : public InternetService {
  private slots:
   void UpdateTotalSongCount(int count);
   void ReloadDatabase();
-  void ReloadDatabaseFinished();
+  void ImportFinished(bool success);
 
   void Download();
   void Homepage();
@@ -101,6 +102,7 @@ class MagnatuneService : public InternetService {
  private:
   void EnsureMenuCreated();
 
+  void ParseDatabase(QXmlStreamReader* reader, CatalogueImporter* importer);
   Song ReadTrack(QXmlStreamReader& reader);
 
  private:
@@ -115,7 +117,7 @@ class MagnatuneService : public InternetService {
   LibraryModel* library_model_;
   LibraryFilterWidget* library_filter_;
   QSortFilterProxyModel* library_sort_model_;
-  int load_database_task_id_;
+  CatalogueImporter* importer_;
 
   MembershipType membership_;
   QString username_;
@@ -46,6 +46,10 @@ struct Subdirectory {
   int directory_id;
   QString path;
   uint mtime;
+
+  // Summary of the directory's entries when it was last scanned, made by
+  // DirectoryDigest in librarywatcher.cpp.  Empty if it's not known.
+  QString digest;
 };
 Q_DECLARE_METATYPE(Subdirectory)
 
@@ -0,0 +1,377 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "duplicatefinder.h"
+#include "librarybackend.h"
+#include "core/logging.h"
+#include "core/taskmanager.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFuture>
+#include <QtConcurrentMap>
+#include <QtEndian>
+
+const int DuplicateFinder::kBatchSize = 100;
+
+namespace {
+
+const int kReadBufferSize = 64 * 1024;
+
+const uchar* Bytes(const QByteArray& data) {
+  return reinterpret_cast<const uchar*>(data.constData());
+}
+
+QByteArray ReadAt(QFile* file, qint64 offset, int length) {
+  if (!file->seek(offset))
+    return QByteArray();
+  return file->read(length);
+}
+
+bool HashRange(QFile* file, qint64 start, qint64 end,
+               QCryptographicHash* hash) {
+  if (end <= start || !file->seek(start))
+    return false;
+
+  qint64 remaining = end - start;
+  while (remaining > 0) {
+    const QByteArray data = file->read(qMin<qint64>(remaining, kReadBufferSize));
+    if (data.isEmpty())
+      return false;
+
+    hash->addData(data);
+    remaining -= data.size();
+  }
+  return true;
+}
+
+// Returns the position after any ID3v2 tags at the start of the file.
+qint64 SkipId3v2(QFile* file, qint64 pos) {
+  forever {
+    const QByteArray header = ReadAt(file, pos, 10);
+    if (header.size() < 10 || !header.startsWith("ID3"))
+      return pos;
+
+    // The size has 7 bits in each byte, and doesn't include the header.
+    const uchar* p = Bytes(header);
+    qint64 size = (qint64(p[6] & 0x7f) << 21) | ((p[7] & 0x7f) << 14) |
+                  ((p[8] & 0x7f) << 7) | (p[9] & 0x7f);
+    size += 10;
+    if (p[5] & 0x10)
+      size += 10; // There's a footer too
+
+    pos += size;
+  }
+}
+
+// Returns the end of the file without any ID3v1 or APEv2 tags.
+qint64 SkipTrailingTags(QFile* file, qint64 start, qint64 end) {
+  if (end - start >= 128 && ReadAt(file, end - 128, 3) == "TAG")
+    end -= 128;
+
+  if (end - start >= 32) {
+    const QByteArray footer = ReadAt(file, end - 32, 32);
+    if (footer.startsWith("APETAGEX")) {
+      // The size includes the footer but not the optional header.
+      qint64 size = qFromLittleEndian<quint32>(Bytes(footer) + 12);
+      if (qFromLittleEndian<quint32>(Bytes(footer) + 20) & 0x80000000)
+        size += 32;
+      end = qMax(start, end - size);
+    }
+  }
+
+  return end;
+}
+
+// MP3, and anything else that's a stream of frames with ID3 or APE tags
+// stuck on the ends.
+bool HashTaggedStream(QFile* file, QCryptographicHash* hash) {
+  const qint64 start = SkipId3v2(file, 0);
+  return HashRange(file, start, SkipTrailingTags(file, start, file->size()),
+                   hash);
+}
+
+bool HashFlac(QFile* file, QCryptographicHash* hash) {
+  qint64 pos = SkipId3v2(file, 0);
+  if (ReadAt(file, pos, 4) != "fLaC")
+    return false;
+  pos += 4;
+
+  // Skip the metadata blocks, which hold the tags and pictures.
+  forever {
+    const QByteArray header = ReadAt(file, pos, 4);
+    if (header.size() < 4)
+      return false;
+
+    const uchar* p = Bytes(header);
+    pos += 4 + ((qint64(p[1]) << 16) | (p[2] << 8) | p[3]);
+
+    if (p[0] & 0x80)
+      break; // That was the last one
+  }
+
+  return HashRange(file, pos, SkipTrailingTags(file, pos, file->size()), hash);
+}
+
+bool HashOgg(QFile* file, QCryptographicHash* hash) {
+  // The header packets, including the comments, come first in pages with a
+  // granule position of 0, or -1 if no packet ends on that page.  Only the
+  // contents of the pages after them are hashed, because the page headers
+  // have sequence numbers and checksums that change with the comments.
+  qint64 pos = 0;
+  bool in_audio = false;
+
+  forever {
+    const QByteArray header = ReadAt(file, pos, 27);
+    if (header.size() < 27 || !header.startsWith("OggS"))
+      break;
+
+    const uchar* p = Bytes(header);
+    const qint64 granule = qFromLittleEndian<qint64>(p + 6);
+    const int segments = p[26];
+
+    const QByteArray lacing = ReadAt(file, pos + 27, segments);
+    if (lacing.size() < segments)
+      return false;
+
+    qint64 payload = 0;
+    for (int i=0 ; i<segments ; ++i) {
+      payload += Bytes(lacing)[i];
+    }
+
+    const qint64 payload_start = pos + 27 + segments;
+    if (granule != 0 && granule != -1)
+      in_audio = true;
+
+    if (in_audio && payload > 0 &&
+        !HashRange(file, payload_start, payload_start + payload, hash)) {
+      return false;
+    }
+
+    pos = payload_start + payload;
+  }
+
+  return in_audio;
+}
+
+bool HashMp4(QFile* file, QCryptographicHash* hash) {
+  // The audio is in the "mdat" boxes and the tags are in "moov".
+  const qint64 file_size = file->size();
+  qint64 pos = 0;
+  bool found_audio = false;
+
+  while (pos + 8 <= file_size) {
+    const QByteArray header = ReadAt(file, pos, 16);
+    if (header.size() < 8)
+      return false;
+
+    const uchar* p = Bytes(header);
+    qint64 size = qFromBigEndian<quint32>(p);
+    int header_size = 8;
+    if (size == 1) {
+      // 64-bit size
+      if (header.size() < 16)
+        return false;
+      size = qFromBigEndian<quint64>(p + 8);
+      header_size = 16;
+    } else if (size == 0) {
+      // Goes to the end of the file
+      size = file_size - pos;
+    }
+
+    if (size < header_size)
+      return false;
+
+    if (header.mid(4, 4) == "mdat") {
+      if (size > header_size &&
+          !HashRange(file, pos + header_size, qMin(file_size, pos + size), hash)) {
+        return false;
+      }
+      found_audio = true;
+    }
+
+    pos += size;
+  }
+
+  return found_audio;
+}
+
+// WAV and AIFF files are a list of chunks.  The audio is in one of them, and
+// tags can be in any of the others.
+bool HashChunks(QFile* file, const char* audio_chunk, bool big_endian,
+                QCryptographicHash* hash) {
+  const qint64 file_size = file->size();
+  qint64 pos = 12;
+
+  while (pos + 8 <= file_size) {
+    const QByteArray header = ReadAt(file, pos, 8);
+    if (header.size() < 8)
+      return false;
+
+    const uchar* p = Bytes(header);
+    const qint64 size = big_endian ? qFromBigEndian<quint32>(p + 4)
+                                   : qFromLittleEndian<quint32>(p + 4);
+
+    if (header.startsWith(audio_chunk)) {
+      return HashRange(file, pos + 8, qMin(file_size, pos + 8 + size), hash);
+    }
+
+    // Chunks are padded to an even length.
+    pos += 8 + size + (size & 1);
+  }
+
+  return false;
+}
+
+}  // namespace
+
+
+DuplicateFinder::DuplicateFinder(LibraryBackend* backend,
+                                 TaskManager* task_manager, QObject* parent)
+  : QObject(parent),
+    backend_(backend),
+    task_manager_(task_manager),
+    watcher_(NULL),
+    stop_requested_(false),
+    task_id_(-1),
+    progress_(0),
+    progress_max_(0)
+{
+}
+
+QByteArray DuplicateFinder::HashAudio(const QString& filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return QByteArray();
+
+  const QByteArray magic = file.read(12);
+  const QByteArray form = magic.mid(8, 4);
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  bool ok = false;
+
+  if (magic.startsWith("OggS")) {
+    ok = HashOgg(&file, &hash);
+  } else if (magic.startsWith("RIFF") && form == "WAVE") {
+    ok = HashChunks(&file, "data", false, &hash);
+  } else if (magic.startsWith("FORM") && (form == "AIFF" || form == "AIFC")) {
+    ok = HashChunks(&file, "SSND", true, &hash);
+  } else if (magic.mid(4, 4) == "ftyp") {
+    ok = HashMp4(&file, &hash);
+  } else if (ReadAt(&file, SkipId3v2(&file, 0), 4) == "fLaC") {
+    ok = HashFlac(&file, &hash);
+  } else {
+    ok = HashTaggedStream(&file, &hash);
+  }
+
+  if (!ok)
+    return QByteArray();
+  return hash.result();
+}
+
+QString DuplicateFinder::HashSong(const Song& song) {
+  // Songs from a CUE sheet share a file with the rest of the album.
+  if (song.url().scheme() != "file" || song.has_cue())
+    return QString();
+
+  return HashAudio(song.url().toLocalFile()).toHex();
+}
+
+void DuplicateFinder::Start() {
+  if (watcher_)
+    return;
+
+  stop_requested_ = false;
+  hashed_ids_.clear();
+
+  progress_ = 0;
+  progress_max_ = backend_->CountSongsWithoutContentHash();
+  if (progress_max_ == 0) {
+    emit Finished();
+    return;
+  }
+
+  qLog(Info) << "Hashing" << progress_max_ << "songs";
+  task_id_ = task_manager_->StartTask(tr("Looking for duplicate songs"));
+
+  StartBatch();
+}
+
+void DuplicateFinder::Stop() {
+  stop_requested_ = true;
+
+  // The files that are being read now are finished, BatchFinished saves them.
+  if (watcher_)
+    watcher_->cancel();
+}
+
+void DuplicateFinder::StartBatch() {
+  batch_ = backend_->GetSongsWithoutContentHash(kBatchSize);
+
+  // Songs come back again if their hashes couldn't be saved.
+  SongList::iterator it = batch_.begin();
+  while (it != batch_.end()) {
+    if (hashed_ids_.contains(it->id()))
+      it = batch_.erase(it);
+    else
+      ++it;
+  }
+
+  if (batch_.isEmpty() || stop_requested_) {
+    Finish();
+    return;
+  }
+
+  QFuture<QString> future = QtConcurrent::mapped(batch_, HashSong);
+  watcher_ = new QFutureWatcher<QString>(this);
+  watcher_->setFuture(future);
+  connect(watcher_, SIGNAL(finished()), SLOT(BatchFinished()));
+}
+
+void DuplicateFinder::BatchFinished() {
+  QFutureWatcher<QString>* watcher = watcher_;
+  watcher_ = NULL;
+  watcher->deleteLater();
+
+  // Some songs won't have been hashed if the batch was cancelled.
+  const QFuture<QString> future = watcher->future();
+  QMap<int, QString> hashes;
+  for (int i=0 ; i<batch_.count() ; ++i) {
+    if (!future.isResultReadyAt(i))
+      continue;
+
+    hashes[batch_[i].id()] = future.resultAt(i);
+    hashed_ids_.insert(batch_[i].id());
+  }
+  backend_->SetContentHashes(hashes);
+
+  progress_ += hashes.count();
+  task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
+
+  StartBatch();
+}
+
+void DuplicateFinder::Finish() {
+  batch_.clear();
+  hashed_ids_.clear();
+
+  task_manager_->SetTaskFinished(task_id_);
+  task_id_ = -1;
+
+  qLog(Info) << "Finished hashing songs";
+  emit Finished();
+}
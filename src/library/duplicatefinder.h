@@ -0,0 +1,89 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DUPLICATEFINDER_H
+#define DUPLICATEFINDER_H
+
+#include "core/song.h"
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QSet>
+
+class LibraryBackend;
+class TaskManager;
+
+// Finds songs in the library that are copies of each other, even if they have
+// different tags or are in different places.  The audio data in each file is
+// hashed in the background, a batch of songs at a time and using all the
+// cores, and the hashes are kept in the songs table.  The hash is cleared
+// when a file changes, so only new or changed files get hashed next time.
+// Songs with the same hash are shown by QueryMode_IdenticalAudio.
+class DuplicateFinder : public QObject {
+  Q_OBJECT
+
+ public:
+  DuplicateFinder(LibraryBackend* backend, TaskManager* task_manager,
+                  QObject* parent = 0);
+
+  static const int kBatchSize;
+
+  // Hashes the audio data in a file, leaving out the tags.  Returns an empty
+  // array if the file couldn't be read.
+  static QByteArray HashAudio(const QString& filename);
+
+  bool is_running() const { return watcher_ != NULL; }
+
+ public slots:
+  // Hashes all the songs that haven't been hashed yet.  Does nothing if it's
+  // already running.
+  void Start();
+
+  // Skips the songs in the current batch that haven't been started yet and
+  // doesn't start another.  The songs that were hashed are still saved, so
+  // Start() will carry on where it left off.
+  void Stop();
+
+ signals:
+  void Finished();
+
+ private slots:
+  void BatchFinished();
+
+ private:
+  static QString HashSong(const Song& song);
+
+  void StartBatch();
+  void Finish();
+
+  LibraryBackend* backend_;
+  TaskManager* task_manager_;
+
+  QFutureWatcher<QString>* watcher_;
+  SongList batch_;
+  bool stop_requested_;
+
+  // Songs that have already been hashed in this run, in case their hashes
+  // couldn't be saved.
+  QSet<int> hashed_ids_;
+
+  int task_id_;
+  int progress_;
+  int progress_max_;
+};
+
+#endif // DUPLICATEFINDER_H
@@ -17,6 +17,7 @@
 
 #include "library.h"
 
+#include "duplicatefinder.h"
 #include "librarymodel.h"
 #include "librarybackend.h"
 #include "core/application.h"
@@ -27,12 +28,14 @@
 #include "smartplaylists/querygenerator.h"
 #include "smartplaylists/search.h"
 
+#include <QSettings>
 #include <QThread>
 
 const char* Library::kSongsTable = "songs";
 const char* Library::kDirsTable = "directories";
 const char* Library::kSubdirsTable = "subdirectories";
 const char* Library::kFtsTable = "songs_fts";
+const char* Library::kSettingsGroup = "Library";
 
 Library::Library(Application* app, QObject *parent)
   : QObject(parent),
@@ -40,7 +43,9 @@ Library::Library(Application* app, QObject *parent)
     backend_(NULL),
     model_(NULL),
     watcher_(NULL),
-    watcher_thread_(NULL)
+    watcher_thread_(NULL),
+    duplicate_finder_(NULL),
+    find_duplicates_(false)
 {
   backend_ = new LibraryBackend;
   backend()->moveToThread(app->database()->thread());
@@ -101,6 +106,10 @@ Library::Library(Application* app, QObject *parent)
 }
 
 Library::~Library() {
+  // Don't start hashing any more files while we're shutting down.
+  if (duplicate_finder_)
+    duplicate_finder_->Stop();
+
   watcher_->deleteLater();
   watcher_thread_->exit();
   watcher_thread_->wait(5000 /* five seconds */);
@@ -132,6 +141,16 @@ void Library::Init() {
           backend_, SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
   connect(watcher_, SIGNAL(CompilationsNeedUpdating()),
           backend_, SLOT(UpdateCompilations()));
+  connect(watcher_, SIGNAL(CompilationsNeedUpdating()),
+          SLOT(ScanFinished()));
+
+  duplicate_finder_ = new DuplicateFinder(backend_, app_->task_manager(), this);
+  connect(duplicate_finder_, SIGNAL(Finished()),
+          model_, SLOT(ContentHashesChanged()));
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  find_duplicates_ = s.value("find_duplicates", false).toBool();
 
   // This will start the watcher checking for updates
   backend_->LoadDirectoriesAsync();
@@ -145,6 +164,28 @@ void Library::FullScan() {
   watcher_->FullScanAsync();
 }
 
+void Library::RebuildSearchIndex() {
+  backend_->RebuildFtsAsync();
+}
+
+void Library::FindDuplicates() {
+  if (!find_duplicates_) {
+    find_duplicates_ = true;
+
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    s.setValue("find_duplicates", true);
+  }
+
+  duplicate_finder_->Start();
+}
+
+void Library::ScanFinished() {
+  // Hash any new songs that were found.
+  if (find_duplicates_)
+    duplicate_finder_->Start();
+}
+
 void Library::PauseWatcher() {
   watcher_->SetRescanPausedAsync(true);
 }
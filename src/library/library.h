@@ -25,6 +25,7 @@
 
 class Application;
 class Database;
+class DuplicateFinder;
 class LibraryBackend;
 class LibraryModel;
 class LibraryWatcher;
@@ -41,11 +42,13 @@ class Library : public QObject {
   static const char* kDirsTable;
   static const char* kSubdirsTable;
   static const char* kFtsTable;
+  static const char* kSettingsGroup;
 
   void Init();
 
   LibraryBackend* backend() const { return backend_; }
   LibraryModel* model() const { return model_; }
+  DuplicateFinder* duplicate_finder() const { return duplicate_finder_; }
 
   QString full_rescan_reason(int schema_version) const { return full_rescan_revisions_.value(schema_version, QString()); }
 
@@ -58,9 +61,15 @@ class Library : public QObject {
   void ResumeWatcher();
 
   void FullScan();
+  void RebuildSearchIndex();
+
+  // Hashes every song in the library so songs with identical audio can be
+  // found, and keeps hashing new songs after each scan from now on.
+  void FindDuplicates();
 
  private slots:
   void IncrementalScan();
+  void ScanFinished();
 
  private:
   Application* app_;
@@ -70,6 +79,9 @@ class Library : public QObject {
   LibraryWatcher* watcher_;
   QThread* watcher_thread_;
 
+  DuplicateFinder* duplicate_finder_;
+  bool find_duplicates_;
+
   // DB schema versions which should trigger a full library rescan (each of those with
   // a short reason why).
   QHash<int, QString> full_rescan_revisions_;
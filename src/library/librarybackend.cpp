@@ -20,8 +20,10 @@
 #include "sqlrow.h"
 #include "core/application.h"
 #include "core/database.h"
+#include "core/logging.h"
 #include "core/scopedtransaction.h"
 #include "core/tagreaderclient.h"
+#include "core/tracer.h"
 #include "core/utilities.h"
 #include "smartplaylists/search.h"
 
@@ -30,6 +32,8 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QSettings>
+#include <QTime>
+#include <QTimer>
 #include <QVariant>
 #include <QtDebug>
 
@@ -40,11 +44,20 @@ const char* LibraryBackend::kNewScoreSql =
     "     else (score * (playcount + skipcount) + %1 * 100) / (playcount + skipcount + 1)"
     " end";
 
+const int LibraryBackend::kUrlsPerQuery = 500;
+const int LibraryBackend::kFtsMergeDelayMs = 30000;
+const int LibraryBackend::kFtsMergePages = 200;
+
 LibraryBackend::LibraryBackend(QObject *parent)
   : LibraryBackendInterface(parent),
     save_statistics_in_file_(false),
-    save_ratings_in_file_(false)
+    save_ratings_in_file_(false),
+    fts_merge_timer_(new QTimer(this)),
+    all_compilations_checked_(false)
 {
+  fts_merge_timer_->setSingleShot(true);
+  fts_merge_timer_->setInterval(kFtsMergeDelayMs);
+  connect(fts_merge_timer_, SIGNAL(timeout()), SLOT(MergeFts()));
 }
 
 void LibraryBackend::Init(Database* db, const QString& songs_table,
@@ -161,7 +174,7 @@ SubdirectoryList LibraryBackend::SubdirsInDirectory(int id) {
 }
 
 SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase &db) {
-  QSqlQuery q(QString("SELECT path, mtime FROM %1"
+  QSqlQuery q(QString("SELECT path, mtime, digest FROM %1"
                       " WHERE directory = :dir").arg(subdirs_table_), db);
   q.bindValue(":dir", id);
   q.exec();
@@ -173,6 +186,7 @@ SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase &db) {
     subdir.directory_id = id;
     subdir.path = q.value(0).toString();
     subdir.mtime = q.value(1).toUInt();
+    subdir.digest = q.value(2).toString();
     subdirs << subdir;
   }
 
@@ -266,15 +280,18 @@ SongList LibraryBackend::FindSongsInDirectory(int id) {
 }
 
 void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
+  TraceScope trace("database", "LibraryBackend::AddOrUpdateSubdirs");
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
   QSqlQuery find_query(QString("SELECT ROWID FROM %1"
                                " WHERE directory = :id AND path = :path")
                        .arg(subdirs_table_), db);
-  QSqlQuery add_query(QString("INSERT INTO %1 (directory, path, mtime)"
-                              " VALUES (:id, :path, :mtime)")
+  QSqlQuery add_query(QString("INSERT INTO %1"
+                              " (directory, path, mtime, digest)"
+                              " VALUES (:id, :path, :mtime, :digest)")
                       .arg(subdirs_table_), db);
-  QSqlQuery update_query(QString("UPDATE %1 SET mtime = :mtime"
+  QSqlQuery update_query(QString("UPDATE %1"
+                                 " SET mtime = :mtime, digest = :digest"
                                  " WHERE directory = :id AND path = :path")
                          .arg(subdirs_table_), db);
   QSqlQuery delete_query(QString("DELETE FROM %1"
@@ -298,6 +315,7 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
 
       if (find_query.next()) {
         update_query.bindValue(":mtime", subdir.mtime);
+        update_query.bindValue(":digest", subdir.digest);
         update_query.bindValue(":id", subdir.directory_id);
         update_query.bindValue(":path", subdir.path);
         update_query.exec();
@@ -306,6 +324,7 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
         add_query.bindValue(":id", subdir.directory_id);
         add_query.bindValue(":path", subdir.path);
         add_query.bindValue(":mtime", subdir.mtime);
+        add_query.bindValue(":digest", subdir.digest);
         add_query.exec();
         db_->CheckErrors(add_query);
       }
@@ -314,7 +333,24 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
   transaction.Commit();
 }
 
+namespace {
+
+bool FtsColumnsChanged(const Song& a, const Song& b) {
+  return a.title() != b.title() ||
+         a.album() != b.album() ||
+         a.artist() != b.artist() ||
+         a.albumartist() != b.albumartist() ||
+         a.composer() != b.composer() ||
+         a.performer() != b.performer() ||
+         a.grouping() != b.grouping() ||
+         a.genre() != b.genre() ||
+         a.comment() != b.comment();
+}
+
+}  // namespace
+
 void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
+  TraceScope trace("database", "LibraryBackend::AddOrUpdateSongs");
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
@@ -330,11 +366,21 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
                          .arg(fts_table_), db);
   QSqlQuery update_song_fts(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec +
                                     " WHERE ROWID = :id").arg(fts_table_), db);
+  // The fingerprint survives until the file is hashed again, and is only used
+  // again if the audio turns out to be the same.  If we don't know which audio
+  // it was made from it can't be checked, so it goes now.
+  QSqlQuery clear_content_hash(QString("UPDATE %1 SET content_hash = NULL,"
+                                       " fingerprint = CASE"
+                                       "   WHEN fingerprint_hash IS NULL"
+                                       "     OR fingerprint_hash = '' THEN NULL"
+                                       "   ELSE fingerprint END"
+                                       " WHERE ROWID = :id").arg(songs_table_), db);
 
   ScopedTransaction transaction(&db);
 
   SongList added_songs;
   SongList deleted_songs;
+  bool fts_changed = false;
 
   foreach (const Song& song, songs) {
     // Do a sanity check first - make sure the song's directory still exists
@@ -365,10 +411,12 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
       song.BindToFtsQuery(&add_song_fts);
       add_song_fts.exec();
       if (db_->CheckErrors(add_song_fts)) continue;
+      fts_changed = true;
 
       Song copy(song);
       copy.set_id(id);
       added_songs << copy;
+      compilation_albums_changed_.insert(song.album());
     } else {
       // Get the previous song data first
       Song old_song(GetSongById(song.id()));
@@ -381,18 +429,36 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
       update_song.exec();
       if (db_->CheckErrors(update_song)) continue;
 
-      song.BindToFtsQuery(&update_song_fts);
-      update_song_fts.bindValue(":id", song.id());
-      update_song_fts.exec();
-      if (db_->CheckErrors(update_song_fts)) continue;
+      // The file's contents might have changed, so it needs hashing again.
+      if (old_song.mtime() != song.mtime() ||
+          old_song.filesize() != song.filesize()) {
+        clear_content_hash.bindValue(":id", song.id());
+        clear_content_hash.exec();
+        if (db_->CheckErrors(clear_content_hash)) continue;
+      }
+
+      // Most rescans only change things like the mtime or the bitrate, so
+      // don't touch the FTS index unless one of the indexed columns changed.
+      if (FtsColumnsChanged(old_song, song)) {
+        song.BindToFtsQuery(&update_song_fts);
+        update_song_fts.bindValue(":id", song.id());
+        update_song_fts.exec();
+        if (db_->CheckErrors(update_song_fts)) continue;
+        fts_changed = true;
+      }
 
       deleted_songs << old_song;
       added_songs << song;
+      compilation_albums_changed_.insert(old_song.album());
+      compilation_albums_changed_.insert(song.album());
     }
   }
 
   transaction.Commit();
 
+  if (fts_changed)
+    ScheduleFtsMerge();
+
   if (!deleted_songs.isEmpty())
     emit SongsDeleted(deleted_songs);
 
@@ -403,6 +469,7 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
 }
 
 void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
+  TraceScope trace("database", "LibraryBackend::UpdateMTimesOnly");
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
@@ -420,6 +487,7 @@ void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
 }
 
 void LibraryBackend::DeleteSongs(const SongList &songs) {
+  TraceScope trace("database", "LibraryBackend::DeleteSongs");
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
@@ -437,15 +505,20 @@ void LibraryBackend::DeleteSongs(const SongList &songs) {
     remove_fts.bindValue(":id", song.id());
     remove_fts.exec();
     db_->CheckErrors(remove_fts);
+
+    compilation_albums_changed_.insert(song.album());
   }
   transaction.Commit();
 
+  ScheduleFtsMerge();
+
   emit SongsDeleted(songs);
 
   UpdateTotalSongCountAsync();
 }
 
 void LibraryBackend::MarkSongsUnavailable(const SongList &songs) {
+  TraceScope trace("database", "LibraryBackend::MarkSongsUnavailable");
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
@@ -457,6 +530,8 @@ void LibraryBackend::MarkSongsUnavailable(const SongList &songs) {
     remove.bindValue(":id", song.id());
     remove.exec();
     db_->CheckErrors(remove);
+
+    compilation_albums_changed_.insert(song.album());
   }
   transaction.Commit();
 
@@ -626,6 +701,41 @@ Song LibraryBackend::GetSongByUrl(const QUrl& url, qint64 beginning) {
   return song;
 }
 
+SongList LibraryBackend::GetSongsByUrls(const QList<QUrl>& urls) {
+  SongList ret;
+
+  for (int i=0 ; i<urls.count() ; i += kUrlsPerQuery) {
+    const QList<QUrl> batch = urls.mid(i, kUrlsPerQuery);
+
+    QStringList placeholders;
+    for (int j=0 ; j<batch.count() ; ++j) {
+      placeholders << "?";
+    }
+
+    // Take the lock for each batch separately so other threads aren't kept
+    // waiting while a huge playlist is loaded.
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db(db_->Connect());
+
+    QSqlQuery q(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1"
+                        " WHERE filename IN (%2) AND unavailable = 0")
+                .arg(songs_table_, placeholders.join(",")), db);
+    foreach (const QUrl& url, batch) {
+      q.addBindValue(url.toEncoded());
+    }
+    q.exec();
+    if (db_->CheckErrors(q)) return ret;
+
+    while (q.next()) {
+      Song song;
+      song.InitFromQuery(q, true);
+      ret << song;
+    }
+  }
+
+  return ret;
+}
+
 SongList LibraryBackend::GetSongsByUrl(const QUrl& url) {
   LibraryQuery query;
   query.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
@@ -666,11 +776,61 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album, const QueryOp
 }
 
 void LibraryBackend::UpdateCompilations() {
+  TraceScope trace("database", "LibraryBackend::UpdateCompilations");
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  // Look for albums that have songs by more than one 'effective album artist' in the same
-  // directory
+  // The albums that changed are only kept in memory, so they're lost if
+  // Clementine quits after a scan but before this runs.
+  if (!all_compilations_checked_) {
+    UpdateAllCompilations();
+    return;
+  }
+
+  // Songs without an album are never compilations.
+  compilation_albums_changed_.remove(QString());
+
+  const QStringList albums = compilation_albums_changed_.toList();
+  compilation_albums_changed_.clear();
+  if (albums.isEmpty())
+    return;
+
+  if (trace.is_recording())
+    trace.set_detail(QString("%1 albums").arg(albums.count()));
+
+  // Whether an album is a compilation depends only on its own songs, so just
+  // look at the ones that have changed.
+  QMap<QString, CompilationInfo> compilation_info;
+  for (int i=0 ; i<albums.count() ; i += kUrlsPerQuery) {
+    const QStringList batch = albums.mid(i, kUrlsPerQuery);
+
+    QStringList placeholders;
+    for (int j=0 ; j<batch.count() ; ++j) {
+      placeholders << "?";
+    }
+
+    QSqlQuery q(QString("SELECT effective_albumartist, album, filename, sampler "
+                        "FROM %1 WHERE album IN (%2) AND unavailable = 0")
+                .arg(songs_table_, placeholders.join(",")), db);
+    foreach (const QString& album, batch) {
+      q.addBindValue(album);
+    }
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+
+    AddCompilationInfo(q, &compilation_info);
+  }
+
+  UpdateCompilations(compilation_info, db);
+}
+
+void LibraryBackend::UpdateAllCompilations() {
+  TraceScope trace("database", "LibraryBackend::UpdateAllCompilations");
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  compilation_albums_changed_.clear();
+  all_compilations_checked_ = true;
 
   QSqlQuery q(QString("SELECT effective_albumartist, album, filename, sampler "
     "FROM %1 WHERE unavailable = 0 ORDER BY album").arg(songs_table_), db);
@@ -678,6 +838,15 @@ void LibraryBackend::UpdateCompilations() {
   if (db_->CheckErrors(q)) return;
 
   QMap<QString, CompilationInfo> compilation_info;
+  AddCompilationInfo(q, &compilation_info);
+
+  UpdateCompilations(compilation_info, db);
+}
+
+void LibraryBackend::AddCompilationInfo(QSqlQuery& q,
+                                        QMap<QString, CompilationInfo>* info) {
+  // Look for albums that have songs by more than one 'effective album artist' in the same
+  // directory
   while (q.next()) {
     QString artist = q.value(0).toString();
     QString album = q.value(1).toString();
@@ -693,13 +862,16 @@ void LibraryBackend::UpdateCompilations() {
     if (last_separator == -1)
       continue;
 
-    CompilationInfo& info = compilation_info[album];
-    info.artists.insert(artist);
-    info.directories.insert(filename.left(last_separator));
-    if (sampler) info.has_samplers = true;
-    else         info.has_not_samplers = true;
+    CompilationInfo& album_info = (*info)[album];
+    album_info.artists.insert(artist);
+    album_info.directories.insert(filename.left(last_separator));
+    if (sampler) album_info.has_samplers = true;
+    else         album_info.has_not_samplers = true;
   }
+}
 
+void LibraryBackend::UpdateCompilations(
+    const QMap<QString, CompilationInfo>& compilation_info, QSqlDatabase& db) {
   // Now mark the songs that we think are in compilations
   QSqlQuery update(QString("UPDATE %1"
                            " SET sampler = :sampler,"
@@ -981,6 +1153,125 @@ SongList LibraryBackend::GetAllSongs() {
       smart_playlists::Search::Sort_FieldAsc, smart_playlists::SearchTerm::Field_Artist, -1));
 }
 
+SongList LibraryBackend::GetSongsWithoutContentHash(int limit) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1"
+                      " WHERE content_hash IS NULL AND unavailable = 0"
+                      " LIMIT %2").arg(songs_table_).arg(limit), db);
+  q.exec();
+  if (db_->CheckErrors(q)) return SongList();
+
+  SongList ret;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    ret << song;
+  }
+  return ret;
+}
+
+int LibraryBackend::CountSongsWithoutContentHash() {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(QString("SELECT COUNT(*) FROM %1"
+                      " WHERE content_hash IS NULL AND unavailable = 0")
+              .arg(songs_table_), db);
+  q.exec();
+  if (db_->CheckErrors(q) || !q.next()) return 0;
+
+  return q.value(0).toInt();
+}
+
+void LibraryBackend::SetContentHashes(const QMap<int, QString>& hashes) {
+  TraceScope trace("database", "LibraryBackend::SetContentHashes");
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  // A fingerprint with no hash was made since the file last changed, so it's
+  // from this audio.  Otherwise it's only kept if the audio is the same as it
+  // was when the fingerprint was made.
+  QSqlQuery q(QString("UPDATE %1 SET content_hash = :hash,"
+                      " fingerprint = CASE"
+                      "   WHEN fingerprint_hash IS NULL"
+                      "     OR fingerprint_hash = :old_hash THEN fingerprint"
+                      "   ELSE NULL END,"
+                      " fingerprint_hash = :fingerprint_hash"
+                      " WHERE ROWID = :id").arg(songs_table_), db);
+
+  ScopedTransaction transaction(&db);
+  for (QMap<int, QString>::const_iterator it = hashes.constBegin() ;
+       it != hashes.constEnd() ; ++it) {
+    // Bind an empty string rather than a null one, so the song isn't tried
+    // again.
+    const QString hash = it.value().isNull() ? QString("") : it.value();
+    q.bindValue(":hash", hash);
+    q.bindValue(":old_hash", hash);
+    q.bindValue(":fingerprint_hash", hash);
+    q.bindValue(":id", it.key());
+    q.exec();
+    db_->CheckErrors(q);
+  }
+  transaction.Commit();
+}
+
+QHash<QUrl, QString> LibraryBackend::GetFingerprints(const QList<QUrl>& urls) {
+  QHash<QUrl, QString> ret;
+
+  for (int i=0 ; i<urls.count() ; i += kUrlsPerQuery) {
+    const QList<QUrl> batch = urls.mid(i, kUrlsPerQuery);
+
+    QStringList placeholders;
+    for (int j=0 ; j<batch.count() ; ++j) {
+      placeholders << "?";
+    }
+
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db(db_->Connect());
+
+    // Fingerprints of files that changed since they were last hashed might
+    // be out of date.
+    QSqlQuery q(QString("SELECT filename, fingerprint FROM %1"
+                        " WHERE filename IN (%2) AND fingerprint != ''"
+                        "   AND (content_hash IS NOT NULL"
+                        "     OR fingerprint_hash IS NULL)")
+                .arg(songs_table_, placeholders.join(",")), db);
+    foreach (const QUrl& url, batch) {
+      q.addBindValue(url.toEncoded());
+    }
+    q.exec();
+    if (db_->CheckErrors(q)) return ret;
+
+    while (q.next()) {
+      ret[QUrl::fromEncoded(q.value(0).toByteArray())] = q.value(1).toString();
+    }
+  }
+
+  return ret;
+}
+
+void LibraryBackend::SetFingerprintAsync(const QUrl& url,
+                                         const QString& fingerprint) {
+  metaObject()->invokeMethod(this, "SetFingerprint", Qt::QueuedConnection,
+                             Q_ARG(QUrl, url), Q_ARG(QString, fingerprint));
+}
+
+void LibraryBackend::SetFingerprint(const QUrl& url, const QString& fingerprint) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  // Remember which audio the fingerprint was made from, if it's been hashed.
+  QSqlQuery q(QString("UPDATE %1 SET fingerprint = :fingerprint,"
+                      " fingerprint_hash = content_hash"
+                      " WHERE filename = :filename").arg(songs_table_), db);
+  q.bindValue(":fingerprint", fingerprint);
+  q.bindValue(":filename", url.toEncoded());
+  q.exec();
+  db_->CheckErrors(q);
+}
+
 void LibraryBackend::IncrementPlayCount(int id) {
   if (id == -1)
     return;
@@ -1087,6 +1378,91 @@ void LibraryBackend::ReloadSettingsAsync() {
   QMetaObject::invokeMethod(this, "ReloadSettings", Qt::QueuedConnection);
 }
 
+void LibraryBackend::RebuildFtsAsync() {
+  QMetaObject::invokeMethod(this, "RebuildFts", Qt::QueuedConnection);
+}
+
+void LibraryBackend::ScheduleFtsMerge() {
+  // We might be called from any thread, but the timer has to be started from
+  // the one we live in.  Restarting it each time means the merge only happens
+  // once the library has stopped changing for a while.
+  QMetaObject::invokeMethod(fts_merge_timer_, "start", Qt::QueuedConnection);
+}
+
+bool LibraryBackend::ExecFtsCommand(const QString& command, QSqlDatabase& db) {
+  // The special column has the same name as the table, without the database
+  // name in front.
+  const QString column = fts_table_.section('.', -1, -1);
+
+  QSqlQuery q(db);
+  return q.exec(QString("INSERT INTO %1 (%2) VALUES ('%3')")
+                .arg(fts_table_, column, command));
+}
+
+void LibraryBackend::MergeFts() {
+  QTime time;
+  time.start();
+
+  forever {
+    // Let go of the database between each step, so a big merge doesn't block
+    // everyone else.
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db(db_->Connect());
+
+    QSqlQuery changes(db);
+    changes.prepare("SELECT total_changes()");
+    changes.exec();
+    changes.next();
+    const int changes_before = changes.value(0).toInt();
+
+    if (!ExecFtsCommand(QString("merge=%1,2").arg(kFtsMergePages), db)) {
+      // Versions of SQLite before 3.7.17 can only merge everything in one go.
+      if (!ExecFtsCommand("optimize", db))
+        qLog(Warning) << "Failed to optimize" << fts_table_;
+      break;
+    }
+
+    // The merge did nothing if it changed fewer than two rows.
+    changes.exec();
+    changes.next();
+    if (changes.value(0).toInt() - changes_before < 2)
+      break;
+  }
+
+  qLog(Debug) << "Merged" << fts_table_ << "in" << time.elapsed() << "ms";
+}
+
+void LibraryBackend::RebuildFts() {
+  QTime time;
+  time.start();
+
+  {
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db(db_->Connect());
+    ScopedTransaction t(&db);
+
+    QSqlQuery q(db);
+    q.exec("DELETE FROM " + fts_table_);
+    if (db_->CheckErrors(q))
+      return;
+
+    q.exec(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ")"
+                   " SELECT ROWID, " + Song::kFtsSourceColumnSpec +
+                   " FROM %2").arg(fts_table_, songs_table_));
+    if (db_->CheckErrors(q))
+      return;
+
+    if (!ExecFtsCommand("optimize", db)) {
+      qLog(Warning) << "Failed to optimize" << fts_table_;
+      return;
+    }
+
+    t.Commit();
+  }
+
+  qLog(Info) << "Rebuilt" << fts_table_ << "in" << time.elapsed() << "ms";
+}
+
 void LibraryBackend::ReloadSettings() {
   QSettings s;
   s.beginGroup(kSettingsGroup);
@@ -18,6 +18,8 @@
 #ifndef LIBRARYBACKEND_H
 #define LIBRARYBACKEND_H
 
+#include <QHash>
+#include <QMap>
 #include <QObject>
 #include <QSet>
 #include <QUrl>
@@ -28,6 +30,8 @@
 
 class Database;
 
+class QTimer;
+
 namespace smart_playlists { class Search; }
 
 class LibraryBackendInterface : public QObject {
@@ -92,6 +96,9 @@ public:
   // is not present in library, returns invalid song.
   // Using default beginning value is suitable when searching for single-section songs.
   virtual Song GetSongByUrl(const QUrl& url, qint64 beginning = 0) = 0;
+  // Returns all sections of all the songs with the given filenames.  Much
+  // faster than calling GetSongsByUrl for each one.
+  virtual SongList GetSongsByUrls(const QList<QUrl>& urls) = 0;
 
   virtual void AddDirectory(const QString& path) = 0;
   virtual void RemoveDirectory(const Directory& dir) = 0;
@@ -115,6 +122,7 @@ class LibraryBackend : public LibraryBackendInterface {
   QString songs_table() const { return songs_table_; }
   QString dirs_table() const { return dirs_table_; }
   QString subdirs_table() const { return subdirs_table_; }
+  QString fts_table() const { return fts_table_; }
 
   // Get a list of directories in the library.  Emits DirectoriesDiscovered.
   void LoadDirectoriesAsync();
@@ -150,6 +158,7 @@ class LibraryBackend : public LibraryBackendInterface {
 
   SongList GetSongsByUrl(const QUrl& url);
   Song GetSongByUrl(const QUrl& url, qint64 beginning = 0);
+  SongList GetSongsByUrls(const QList<QUrl>& urls);
 
   void AddDirectory(const QString& path);
   void RemoveDirectory(const Directory& dir);
@@ -159,6 +168,20 @@ class LibraryBackend : public LibraryBackendInterface {
   SongList FindSongs(const smart_playlists::Search& search);
   SongList GetAllSongs();
 
+  // Songs whose audio hasn't been hashed yet.  The hash is cleared whenever
+  // the file changes.
+  SongList GetSongsWithoutContentHash(int limit);
+  int CountSongsWithoutContentHash();
+  // Keyed on song ID.  An empty hash means the song couldn't be hashed.
+  void SetContentHashes(const QMap<int, QString>& hashes);
+
+  // Chromaprint fingerprints that were saved by SetFingerprint().  When the
+  // file changes they aren't returned until it has been hashed again, and
+  // they're only kept if the audio is still the same - so editing the tags
+  // doesn't throw them away.
+  QHash<QUrl, QString> GetFingerprints(const QList<QUrl>& urls);
+  void SetFingerprintAsync(const QUrl& url, const QString& fingerprint);
+
   void IncrementPlayCountAsync(int id);
   void IncrementSkipCountAsync(int id, float progress);
   void ResetStatisticsAsync(int id);
@@ -167,6 +190,7 @@ class LibraryBackend : public LibraryBackendInterface {
   void DeleteAll();
 
   void ReloadSettingsAsync();
+  void RebuildFtsAsync();
 
  public slots:
   void LoadDirectories();
@@ -176,15 +200,31 @@ class LibraryBackend : public LibraryBackendInterface {
   void DeleteSongs(const SongList& songs);
   void MarkSongsUnavailable(const SongList& songs);
   void AddOrUpdateSubdirs(const SubdirectoryList& subdirs);
+
+  // Works out which albums are compilations.  Only looks at albums that were
+  // touched by AddOrUpdateSongs(), DeleteSongs() or MarkSongsUnavailable()
+  // since the last time it ran - except the first time, which looks at every
+  // album in case the last session ended before it could do that.
   void UpdateCompilations();
+  // The same, but for every album in the library.
+  void UpdateAllCompilations();
+
   void UpdateManualAlbumArt(const QString& artist, const QString& album, const QString& art);
   void ForceCompilation(const QString& album, const QList<QString>& artists, bool on);
   void IncrementPlayCount(int id);
   void IncrementSkipCount(int id, float progress);
   void ResetStatistics(int id);
   void UpdateSongRating(int id, float rating);
+  void SetFingerprint(const QUrl& url, const QString& fingerprint);
   void ReloadSettings();
 
+  // Merges the segments of the FTS index that were written by small updates.
+  // This is done automatically a while after the library stops changing.
+  void MergeFts();
+
+  // Throws the FTS index away and builds it again from the songs table.
+  void RebuildFts();
+
  signals:
   void DirectoryDiscovered(const Directory& dir, const SubdirectoryList& subdirs);
   void DirectoryDeleted(const Directory& dir);
@@ -211,6 +251,18 @@ class LibraryBackend : public LibraryBackendInterface {
 
   static const char* kNewScoreSql;
 
+  // SQLite won't bind more than 999 values in one statement.
+  static const int kUrlsPerQuery;
+
+  static const int kFtsMergeDelayMs;
+  static const int kFtsMergePages;
+
+  // Adds the rows from a query for effective_albumartist, album, filename and
+  // sampler to the per-album totals.
+  static void AddCompilationInfo(QSqlQuery& q,
+                                 QMap<QString, CompilationInfo>* info);
+  void UpdateCompilations(const QMap<QString, CompilationInfo>& info,
+                          QSqlDatabase& db);
   void UpdateCompilations(QSqlQuery& find_songs, QSqlQuery& update,
                           SongList& deleted_songs, SongList& added_songs,
                           const QString& album, int sampler);
@@ -221,6 +273,10 @@ class LibraryBackend : public LibraryBackendInterface {
   Song GetSongById(int id, QSqlDatabase& db);
   SongList GetSongsById(const QStringList& ids, QSqlDatabase& db);
 
+  // Runs one of the FTS special commands like "optimize".
+  bool ExecFtsCommand(const QString& command, QSqlDatabase& db);
+  void ScheduleFtsMerge();
+
  private:
   Database* db_;
   QString songs_table_;
@@ -229,6 +285,13 @@ class LibraryBackend : public LibraryBackendInterface {
   QString fts_table_;
   bool save_statistics_in_file_;
   bool save_ratings_in_file_;
+
+  QTimer* fts_merge_timer_;
+
+  // Albums that UpdateCompilations() needs to look at again.  Protected by
+  // db_->Mutex().
+  QSet<QString> compilation_albums_changed_;
+  bool all_compilations_checked_;
 };
 
 #endif // LIBRARYBACKEND_H
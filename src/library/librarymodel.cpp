@@ -25,6 +25,7 @@
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/taskmanager.h"
+#include "core/tracer.h"
 #include "covers/albumcoverloader.h"
 #include "playlist/songmimedata.h"
 #include "smartplaylists/generator.h"
@@ -38,6 +39,8 @@
 #include <QPixmapCache>
 #include <QSettings>
 #include <QStringList>
+#include <QTime>
+#include <QTimer>
 #include <QUrl>
 #include <QtConcurrentRun>
 
@@ -52,6 +55,7 @@ const char* LibraryModel::kSmartPlaylistsMimeType = "application/x-clementine-sm
 const char* LibraryModel::kSmartPlaylistsSettingsGroup = "SerialisedSmartPlaylists";
 const int LibraryModel::kSmartPlaylistsVersion = 4;
 const int LibraryModel::kPrettyCoverSize = 32;
+const int LibraryModel::kAddSongsSliceMs = 20;
 
 typedef QFuture<LibraryModel::QueryResult> RootQueryFuture;
 typedef QFutureWatcher<LibraryModel::QueryResult> RootQueryWatcher;
@@ -73,6 +77,7 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
     show_smart_playlists_(false),
     show_various_artists_(true),
     total_song_count_(0),
+    add_songs_timer_(new QTimer(this)),
     artist_icon_(":/icons/22x22/x-clementine-artist.png"),
     album_icon_(":/icons/22x22/x-clementine-album.png"),
     playlists_dir_icon_(IconLoader::Load("folder-sound")),
@@ -87,6 +92,10 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
   group_by_[1] = GroupBy_Album;
   group_by_[2] = GroupBy_None;
 
+  add_songs_timer_->setSingleShot(true);
+  add_songs_timer_->setInterval(0);
+  connect(add_songs_timer_, SIGNAL(timeout()), SLOT(AddSomePendingSongs()));
+
   cover_loader_options_.desired_height_ = kPrettyCoverSize;
   cover_loader_options_.pad_output_image_ = true;
   cover_loader_options_.scale_output_image_ = true;
@@ -145,82 +154,149 @@ void LibraryModel::Init(bool async) {
 }
 
 void LibraryModel::SongsDiscovered(const SongList& songs) {
-  foreach (const Song& song, songs) {
-    // Sanity check to make sure we don't add songs that are outside the user's
-    // filter
-    if (!query_options_.Matches(song))
-      continue;
+  // After scanning a big directory this can be tens of thousands of songs, so
+  // they are added to the tree a slice at a time to keep the GUI responsive.
+  pending_songs_ << songs;
+  if (!add_songs_timer_->isActive())
+    add_songs_timer_->start();
+}
 
-    // Hey, we've already got that one!
-    if (song_nodes_.contains(song.id()))
-      continue;
+void LibraryModel::AddSomePendingSongs() {
+  AddPendingSongs(kAddSongsSliceMs);
 
-    // Before we can add each song we need to make sure the required container
-    // items already exist in the tree.  These depend on which "group by"
-    // settings the user has on the library.  Eg. if the user grouped by
-    // artist and album, we would need to make sure nodes for the song's artist
-    // and album were already in the tree.
-
-    // Find parent containers in the tree
-    LibraryItem* container = root_;
-    for (int i=0 ; i<3 ; ++i) {
-      GroupBy type = group_by_[i];
-      if (type == GroupBy_None) break;
-
-      // Special case: if the song is a compilation and the current GroupBy
-      // level is Artists, then we want the Various Artists node :(
-      if (IsArtistGroupBy(type) && song.is_compilation()) {
-        if (container->compilation_artist_node_ == NULL)
-          CreateCompilationArtistNode(true, container);
-        container = container->compilation_artist_node_;
-      } else {
-        // Otherwise find the proper container at this level based on the
-        // item's key
-        QString key;
-        switch (type) {
-          case GroupBy_Album:       key = song.album(); break;
-          case GroupBy_Artist:      key = song.artist(); break;
-          case GroupBy_Composer:    key = song.composer(); break;
-          case GroupBy_Performer:   key = song.performer(); break;
-          case GroupBy_Grouping:    key = song.grouping(); break;
-          case GroupBy_Genre:       key = song.genre(); break;
-          case GroupBy_AlbumArtist: key = song.effective_albumartist(); break;
-          case GroupBy_Year:
-            key = QString::number(qMax(0, song.year())); break;
-          case GroupBy_YearAlbum:
-            key = PrettyYearAlbum(qMax(0, song.year()), song.album()); break;
-          case GroupBy_FileType:    key = song.filetype(); break;
-          case GroupBy_None:
-            qLog(Error) << "GroupBy_None";
-            break;
-        }
+  if (!pending_songs_.isEmpty())
+    add_songs_timer_->start();
+}
 
-        // Does it exist already?
-        if (!container_nodes_[i].contains(key)) {
-          // Create the container
-          container_nodes_[i][key] =
-              ItemFromSong(type, true, i == 0, container, song, i);
-        }
-        container = container_nodes_[i][key];
+void LibraryModel::AddPendingSongs(int max_msec) {
+  if (pending_songs_.isEmpty())
+    return;
+
+  QTime time;
+  time.start();
+
+  PendingItems pending;
+  while (!pending_songs_.isEmpty()) {
+    if (max_msec != -1 && time.elapsed() >= max_msec)
+      break;
+    AddDiscoveredSong(pending_songs_.takeFirst(), &pending);
+  }
+
+  InsertItems(pending, true);
+}
+
+void LibraryModel::AddDiscoveredSong(const Song& song, PendingItems* pending) {
+  // Sanity check to make sure we don't add songs that are outside the user's
+  // filter
+  if (!query_options_.Matches(song))
+    return;
+
+  // Hey, we've already got that one!
+  if (song_nodes_.contains(song.id()))
+    return;
+
+  // We can't tell which songs have identical audio until they've been hashed.
+  if (query_options_.query_mode() == QueryOptions::QueryMode_IdenticalAudio)
+    return;
+
+  // Before we can add each song we need to make sure the required container
+  // items already exist in the tree.  These depend on which "group by"
+  // settings the user has on the library.  Eg. if the user grouped by
+  // artist and album, we would need to make sure nodes for the song's artist
+  // and album were already in the tree.
+
+  // Find parent containers in the tree
+  LibraryItem* container = root_;
+  for (int i=0 ; i<3 ; ++i) {
+    GroupBy type = group_by_[i];
+    if (type == GroupBy_None) break;
+
+    // Special case: if the song is a compilation and the current GroupBy
+    // level is Artists, then we want the Various Artists node :(
+    if (IsArtistGroupBy(type) && song.is_compilation()) {
+      if (container->compilation_artist_node_ == NULL)
+        CreateCompilationArtistNode(container, pending);
+      container = container->compilation_artist_node_;
+    } else {
+      // Otherwise find the proper container at this level based on the
+      // item's key
+      QString key;
+      switch (type) {
+        case GroupBy_Album:       key = song.album(); break;
+        case GroupBy_Artist:      key = song.artist(); break;
+        case GroupBy_Composer:    key = song.composer(); break;
+        case GroupBy_Performer:   key = song.performer(); break;
+        case GroupBy_Grouping:    key = song.grouping(); break;
+        case GroupBy_Genre:       key = song.genre(); break;
+        case GroupBy_AlbumArtist: key = song.effective_albumartist(); break;
+        case GroupBy_Year:
+          key = QString::number(qMax(0, song.year())); break;
+        case GroupBy_YearAlbum:
+          key = PrettyYearAlbum(qMax(0, song.year()), song.album()); break;
+        case GroupBy_FileType:    key = song.filetype(); break;
+        case GroupBy_IdenticalAudio:
+        case GroupBy_None:
+          qLog(Error) << "GroupBy_None";
+          break;
       }
 
-      // If we just created the damn thing then we don't need to continue into
-      // it any further because it'll get lazy-loaded properly later.
-      if (!container->lazy_loaded)
-        break;
+      // Does it exist already?
+      LibraryItem* existing = container_nodes_[i].value(key);
+      if (!existing) {
+        // Create the container
+        existing = ItemFromSong(type, song, i);
+        FinishItem(type, i == 0, container, existing, pending);
+        container_nodes_[i][key] = existing;
+      }
+      container = existing;
     }
 
+    // If we just created the damn thing then we don't need to continue into
+    // it any further because it'll get lazy-loaded properly later.
     if (!container->lazy_loaded)
+      return;
+  }
+
+  // We've gone all the way down to the deepest level and everything was
+  // already lazy loaded, so now we have to create the song in the container.
+  LibraryItem* item = ItemFromSong(GroupBy_None, song, -1);
+  FinishItem(GroupBy_None, false, container, item, pending);
+  song_nodes_[song.id()] = item;
+}
+
+void LibraryModel::InsertItems(const PendingItems& pending, bool signal) {
+  for (PendingItems::const_iterator it = pending.begin() ;
+       it != pending.end() ; ++it) {
+    LibraryItem* parent = it.key();
+    const QList<LibraryItem*>& items = it.value();
+    if (items.isEmpty())
       continue;
 
-    // We've gone all the way down to the deepest level and everything was
-    // already lazy loaded, so now we have to create the song in the container.
-    song_nodes_[song.id()] =
-        ItemFromSong(GroupBy_None, true, false, container, song, -1);
+    // The parent might be a new item too (this happens for CDs), in which case
+    // the view will see these children when it sees the parent.
+    const bool notify = signal && (parent == root_ || parent->parent);
+
+    const int first_row = parent->children.count();
+    if (notify)
+      beginInsertRows(ItemToIndex(parent), first_row,
+                      first_row + items.count() - 1);
+
+    foreach (LibraryItem* item, items) {
+      item->parent = parent;
+      item->model = this;
+      item->row = parent->children.count();
+      parent->children << item;
+    }
+
+    if (notify)
+      endInsertRows();
   }
 }
 
 void LibraryModel::SongsSlightlyChanged(const SongList& songs) {
+  // Make sure we're not holding on to an old copy of any of these songs.
+  AddPendingSongs(-1);
+
   // This is called if there was a minor change to the songs that will not
   // normally require the library to be restructured.  We can just update our
   // internal cache of Song objects without worrying about resetting the model.
@@ -231,19 +307,16 @@ void LibraryModel::SongsSlightlyChanged(const SongList& songs) {
   }
 }
 
-LibraryItem* LibraryModel::CreateCompilationArtistNode(bool signal, LibraryItem* parent) {
-  if (signal)
-    beginInsertRows(ItemToIndex(parent), parent->children.count(), parent->children.count());
-
+LibraryItem* LibraryModel::CreateCompilationArtistNode(LibraryItem* parent,
+                                                       PendingItems* pending) {
   parent->compilation_artist_node_ =
-      new LibraryItem(LibraryItem::Type_Container, parent);
+      new LibraryItem(LibraryItem::Type_Container);
   parent->compilation_artist_node_->compilation_artist_node_ = NULL;
   parent->compilation_artist_node_->key = tr("Various artists");
   parent->compilation_artist_node_->sort_text = " various";
   parent->compilation_artist_node_->container_level = parent->container_level + 1;
 
-  if (signal)
-    endInsertRows();
+  (*pending)[parent] << parent->compilation_artist_node_;
 
   return parent->compilation_artist_node_;
 }
@@ -263,7 +336,8 @@ QString LibraryModel::DividerKey(GroupBy type, LibraryItem* item) const {
   case GroupBy_Grouping:
   case GroupBy_Genre:
   case GroupBy_AlbumArtist:
-  case GroupBy_FileType: {
+  case GroupBy_FileType:
+  case GroupBy_IdenticalAudio: {
     QChar c = item->sort_text[0];
     if (c.isDigit())
       return "0";
@@ -299,6 +373,7 @@ QString LibraryModel::DividerDisplayText(GroupBy type, const QString& key) const
   case GroupBy_Genre:
   case GroupBy_AlbumArtist:
   case GroupBy_FileType:
+  case GroupBy_IdenticalAudio:
     if (key == "0")
       return "0-9";
     return key.toUpper();
@@ -322,6 +397,9 @@ QString LibraryModel::DividerDisplayText(GroupBy type, const QString& key) const
 }
 
 void LibraryModel::SongsDeleted(const SongList& songs) {
+  // The songs might not have been added to the tree yet.
+  AddPendingSongs(-1);
+
   // Delete the actual song nodes first, keeping track of each parent so we
   // might check to see if they're empty later.
   QSet<LibraryItem*> parents;
@@ -361,7 +439,7 @@ void LibraryModel::SongsDeleted(const SongList& songs) {
 
       // Maybe consider its divider node
       if (node->container_level == 0)
-        divider_keys << DividerKey(group_by_[0], node);
+        divider_keys << DividerKey(active_group_by()[0], node);
 
       // Special case the Various Artists node
       if (IsCompilationArtistNode(node))
@@ -384,7 +462,7 @@ void LibraryModel::SongsDeleted(const SongList& songs) {
     // Look to see if there are any other items still under this divider
     bool found = false;
     foreach (LibraryItem* node, container_nodes_[0].values()) {
-      if (DividerKey(group_by_[0], node) == divider_key) {
+      if (DividerKey(active_group_by()[0], node) == divider_key) {
         found = true;
         break;
       }
@@ -474,7 +552,7 @@ QVariant LibraryModel::data(const QModelIndex& index, int role) const {
   if (use_pretty_covers_) {    
     bool is_album_node = false;
     if (role == Qt::DecorationRole && item->type == LibraryItem::Type_Container) {
-      GroupBy container_type = group_by_[item->container_level];
+      GroupBy container_type = active_group_by()[item->container_level];
       is_album_node = container_type == GroupBy_Album
                    || container_type == GroupBy_YearAlbum;
     }
@@ -490,7 +568,7 @@ QVariant LibraryModel::data(const QModelIndex& index, int role) const {
 QVariant LibraryModel::data(const LibraryItem* item, int role) const {
   GroupBy container_type =
       item->type == LibraryItem::Type_Container ?
-      group_by_[item->container_level] : GroupBy_None;
+      active_group_by()[item->container_level] : GroupBy_None;
 
   switch (role) {
     case Qt::DisplayRole:
@@ -577,12 +655,21 @@ bool LibraryModel::HasCompilations(const LibraryQuery& query) {
   return q.Next();
 }
 
+LibraryModel::Grouping LibraryModel::active_group_by() const {
+  if (query_options_.query_mode() == QueryOptions::QueryMode_IdenticalAudio)
+    return Grouping(GroupBy_IdenticalAudio);
+  return group_by_;
+}
+
 LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
+  TraceScope trace("model", "LibraryModel::RunQuery");
+
   QueryResult result;
 
   // Information about what we want the children to be
+  const Grouping group_by = active_group_by();
   int child_level = parent == root_ ? 0 : parent->container_level + 1;
-  GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
+  GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by[child_level];
 
   // Initialise the query.  child_type says what type of thing we want (artists,
   // songs, etc.)
@@ -592,7 +679,7 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
   // Walk up through the item's parents adding filters as necessary
   LibraryItem* p = parent;
   while (p && p->type == LibraryItem::Type_Container) {
-    FilterQuery(group_by_[p->container_level], p, &q);
+    FilterQuery(group_by[p->container_level], p, &q);
     p = p->parent;
   }
 
@@ -608,12 +695,21 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
   }
 
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
-  if (!backend_->ExecQuery(&q))
-    return result;
+  SqlRowList rows;
+  {
+    QMutexLocker l(backend_->db()->Mutex());
+    if (!backend_->ExecQuery(&q))
+      return result;
+
+    while (q.Next()) {
+      rows << SqlRow(q);
+    }
+  }
 
-  while (q.Next()) {
-    result.rows << SqlRow(q);
+  // Creating the items is the expensive part, so do it here too rather than
+  // in PostQuery.
+  foreach (const SqlRow& row, rows) {
+    result.items << ItemFromQuery(child_type, row, child_level);
   }
   return result;
 }
@@ -623,18 +719,17 @@ void LibraryModel::PostQuery(LibraryItem* parent,
                              bool signal) {
   // Information about what we want the children to be
   int child_level = parent == root_ ? 0 : parent->container_level + 1;
-  GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
+  GroupBy child_type =
+      child_level >= 3 ? GroupBy_None : active_group_by()[child_level];
 
+  PendingItems pending;
   if (result.create_va) {
-    CreateCompilationArtistNode(signal, parent);
+    CreateCompilationArtistNode(parent, &pending);
   }
 
   // Step through the results
-  foreach (const SqlRow& row, result.rows) {
-    // Create the item - it will get inserted into the model here
-    LibraryItem* item =
-        ItemFromQuery(child_type, signal, child_level == 0, parent, row,
-                      child_level);
+  foreach (LibraryItem* item, result.items) {
+    FinishItem(child_type, child_level == 0, parent, item, &pending);
 
     // Save a pointer to it for later
     if (child_type == GroupBy_None)
@@ -642,6 +737,9 @@ void LibraryModel::PostQuery(LibraryItem* parent,
     else
       container_nodes_[child_level][item->key] = item;
   }
+
+  // Add them all to the model at once
+  InsertItems(pending, signal);
 }
 
 void LibraryModel::LazyPopulate(LibraryItem* parent, bool signal) {
@@ -660,6 +758,8 @@ void LibraryModel::ResetAsync() {
   watcher->setFuture(future);
 
   connect(watcher, SIGNAL(finished()), SLOT(ResetAsyncQueryFinished()));
+  Tracer::AddEventUntil(watcher, SIGNAL(finished()), "model",
+                        "LibraryModel async reset");
 }
 
 void LibraryModel::ResetAsyncQueryFinished() {
@@ -667,6 +767,8 @@ void LibraryModel::ResetAsyncQueryFinished() {
   const struct QueryResult result = watcher->result();
   watcher->deleteLater();
 
+  TraceScope trace("model", "LibraryModel::ResetAsyncQueryFinished");
+
   BeginReset();
   root_->lazy_loaded = true;
 
@@ -691,6 +793,10 @@ void LibraryModel::BeginReset() {
   pending_art_.clear();
   smart_playlist_node_ = NULL;
 
+  // The new query will find these songs anyway.
+  pending_songs_.clear();
+  add_songs_timer_->stop();
+
   root_ = new LibraryItem(this);
   root_->compilation_artist_node_ = NULL;
   root_->lazy_loaded = false;
@@ -701,6 +807,8 @@ void LibraryModel::BeginReset() {
 }
 
 void LibraryModel::Reset() {
+  TraceScope trace("model", "LibraryModel::Reset");
+
   BeginReset();
 
   // Populate top level
@@ -710,7 +818,11 @@ void LibraryModel::Reset() {
 }
 
 void LibraryModel::InitQuery(GroupBy type, LibraryQuery* q) {
-  // Say what type of thing we want to get back from the database.
+  // Say what type of thing we want to get back from the database.  Each of
+  // these columns has an index that starts with it and ends with
+  // effective_compilation and unavailable (see schema-49.sql), so the top
+  // level only reads the index and the levels below can look up their parent.
+  // idx_comp_album does the same for the Various artists node.
   switch (type) {
   case GroupBy_Artist:
     q->SetColumnSpec("DISTINCT artist");
@@ -745,6 +857,10 @@ void LibraryModel::InitQuery(GroupBy type, LibraryQuery* q) {
   case GroupBy_FileType:
     q->SetColumnSpec("DISTINCT filetype");
     break;
+  case GroupBy_IdenticalAudio:
+    // These come from the join in LibraryQuery.
+    q->SetColumnSpec("DISTINCT dup_hash, dup_artist, dup_title");
+    break;
   }
 }
 
@@ -796,34 +912,33 @@ void LibraryModel::FilterQuery(GroupBy type, LibraryItem* item, LibraryQuery* q)
   case GroupBy_FileType:
     q->AddWhere("filetype", item->metadata.filetype());
     break;
+  case GroupBy_IdenticalAudio:
+    q->AddWhere("content_hash", item->key);
+    break;
   case GroupBy_None:
     qLog(Error) << "Unknown GroupBy type" << type << "used in filter";
     break;
   }
 }
 
-LibraryItem* LibraryModel::InitItem(GroupBy type, bool signal, LibraryItem *parent,
-                               int container_level) {
+LibraryItem* LibraryModel::InitItem(GroupBy type, int container_level) const {
   LibraryItem::Type item_type =
       type == GroupBy_None ? LibraryItem::Type_Song :
       LibraryItem::Type_Container;
 
-  if (signal)
-    beginInsertRows(ItemToIndex(parent),
-                    parent->children.count(),parent->children.count());
-
-  // Initialise the item depending on what type it's meant to be
-  LibraryItem* item = new LibraryItem(item_type, parent);
+  // Initialise the item depending on what type it's meant to be.  It gets a
+  // parent later, in InsertItems.
+  LibraryItem* item = new LibraryItem(item_type);
   item->compilation_artist_node_ = NULL;
   item->container_level = container_level;
+  if (type == GroupBy_None)
+    item->lazy_loaded = true;
   return item;
 }
 
-LibraryItem* LibraryModel::ItemFromQuery(GroupBy type,
-                                         bool signal, bool create_divider,
-                                         LibraryItem* parent, const SqlRow& row,
-                                         int container_level) {
-  LibraryItem* item = InitItem(type, signal, parent, container_level);
+LibraryItem* LibraryModel::ItemFromQuery(GroupBy type, const SqlRow& row,
+                                         int container_level) const {
+  LibraryItem* item = InitItem(type, container_level);
   int year = 0;
 
   switch (type) {
@@ -863,6 +978,15 @@ LibraryItem* LibraryModel::ItemFromQuery(GroupBy type,
     item->key = item->metadata.TextForFiletype();
     break;
 
+  case GroupBy_IdenticalAudio:
+    item->key = row.value(0).toString();
+    item->metadata.set_artist(row.value(1).toString());
+    item->metadata.set_title(row.value(2).toString());
+    item->display_text = TextOrUnknown(item->metadata.artist()) + " - " +
+                         TextOrUnknown(item->metadata.title());
+    item->sort_text = SortTextForArtist(item->display_text);
+    break;
+
   case GroupBy_None:
     item->metadata.InitFromQuery(row, true);
     item->key = item->metadata.title();
@@ -871,15 +995,12 @@ LibraryItem* LibraryModel::ItemFromQuery(GroupBy type,
     break;
   }
 
-  FinishItem(type, signal, create_divider, parent, item);
   return item;
 }
 
-LibraryItem* LibraryModel::ItemFromSong(GroupBy type,
-                                   bool signal, bool create_divider,
-                                   LibraryItem* parent, const Song& s,
-                                   int container_level) {
-  LibraryItem* item = InitItem(type, signal, parent, container_level);
+LibraryItem* LibraryModel::ItemFromSong(GroupBy type, const Song& s,
+                                        int container_level) const {
+  LibraryItem* item = InitItem(type, container_level);
   int year = 0;
 
   switch (type) {
@@ -918,6 +1039,11 @@ LibraryItem* LibraryModel::ItemFromSong(GroupBy type,
     item->key = s.TextForFiletype();
     break;
 
+  case GroupBy_IdenticalAudio:
+    // Songs don't know their hash, so these are only made by ItemFromQuery.
+    qLog(Error) << "GroupBy_IdenticalAudio used for a discovered song";
+    break;
+
   case GroupBy_None:
     item->metadata = s;
     item->key = s.title();
@@ -926,20 +1052,15 @@ LibraryItem* LibraryModel::ItemFromSong(GroupBy type,
     break;
   }
 
-  FinishItem(type, signal, create_divider, parent, item);
   if (s.url().scheme() == "cdda")
     item->lazy_loaded = true;
   return item;
 }
 
-void LibraryModel::FinishItem(GroupBy type,
-                         bool signal, bool create_divider,
-                         LibraryItem *parent, LibraryItem *item) {
-  if (type == GroupBy_None)
-    item->lazy_loaded = true;
-
-  if (signal)
-    endInsertRows();
+void LibraryModel::FinishItem(GroupBy type, bool create_divider,
+                              LibraryItem* parent, LibraryItem* item,
+                              PendingItems* pending) {
+  (*pending)[parent] << item;
 
   // Create the divider entry if we're supposed to
   if (create_divider && show_dividers_) {
@@ -947,20 +1068,13 @@ void LibraryModel::FinishItem(GroupBy type,
     item->sort_text.prepend(divider_key);
 
     if (!divider_key.isEmpty() && !divider_nodes_.contains(divider_key)) {
-      if (signal)
-        beginInsertRows(ItemToIndex(parent), parent->children.count(),
-                        parent->children.count());
-
-      LibraryItem* divider =
-          new LibraryItem(LibraryItem::Type_Divider, root_);
+      LibraryItem* divider = new LibraryItem(LibraryItem::Type_Divider);
       divider->key = divider_key;
       divider->display_text = DividerDisplayText(type, divider_key);
       divider->lazy_loaded = true;
 
       divider_nodes_[divider_key] = divider;
-
-      if (signal)
-        endInsertRows();
+      (*pending)[root_] << divider;
     }
   }
 }
@@ -1130,6 +1244,11 @@ void LibraryModel::SetFilterQueryMode(QueryOptions::QueryMode query_mode) {
   ResetAsync();
 }
 
+void LibraryModel::ContentHashesChanged() {
+  if (query_options_.query_mode() == QueryOptions::QueryMode_IdenticalAudio)
+    ResetAsync();
+}
+
 bool LibraryModel::canFetchMore(const QModelIndex &parent) const {
   if (!parent.isValid())
     return false;
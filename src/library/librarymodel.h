@@ -34,6 +34,8 @@
 
 #include <boost/scoped_ptr.hpp>
 
+#include "gtest/gtest_prod.h"
+
 class Application;
 class AlbumCoverLoader;
 class LibraryDirectoryModel;
@@ -41,6 +43,7 @@ class LibraryBackend;
 namespace smart_playlists { class Search; }
 
 class QSettings;
+class QTimer;
 
 class LibraryModel : public SimpleTreeModel<LibraryItem> {
   Q_OBJECT
@@ -56,6 +59,7 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   static const char* kSmartPlaylistsArray;
   static const int kSmartPlaylistsVersion;
   static const int kPrettyCoverSize;
+  static const int kAddSongsSliceMs;
 
   enum Role {
     Role_Type = Qt::UserRole + 1,
@@ -82,6 +86,9 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
     GroupBy_FileType = 8,
     GroupBy_Performer = 9,
     GroupBy_Grouping = 10,
+
+    // Used instead of the user's grouping in QueryMode_IdenticalAudio.
+    GroupBy_IdenticalAudio = 11,
   };
 
   struct Grouping {
@@ -106,10 +113,12 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
     }
   };
 
+  // The items are created by RunQuery, possibly in a worker thread, but they
+  // aren't added to the tree until PostQuery.
   struct QueryResult {
     QueryResult() : create_va(false) {}
 
-    SqlRowList rows;
+    QList<LibraryItem*> items;
     bool create_va;
   };
 
@@ -175,6 +184,9 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   void Reset();
   void ResetAsync();
 
+  // Called when the DuplicateFinder has hashed some more songs.
+  void ContentHashesChanged();
+
  protected:
   void LazyPopulate(LibraryItem* item) { LazyPopulate(item, true); }
   void LazyPopulate(LibraryItem* item, bool signal);
@@ -189,6 +201,8 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   // Called after ResetAsync
   void ResetAsyncQueryFinished();
 
+  void AddSomePendingSongs();
+
   void AlbumArtLoaded(quint64 id, const QImage& image);
 
  private:
@@ -198,8 +212,22 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   QueryResult RunQuery(LibraryItem* parent);
   void PostQuery(LibraryItem* parent, const QueryResult& result, bool signal);
 
+  // Items that have been created but not added to the tree yet, grouped by
+  // the parent they will be added to.  InsertItems adds all the children of
+  // each parent with a single beginInsertRows.
+  typedef QMap<LibraryItem*, QList<LibraryItem*> > PendingItems;
+  void InsertItems(const PendingItems& pending, bool signal);
+
+  // Songs from SongsDiscovered are added to the tree a slice at a time.  If
+  // max_msec is -1 they are all added at once.
+  void AddPendingSongs(int max_msec);
+  void AddDiscoveredSong(const Song& song, PendingItems* pending);
+
   bool HasCompilations(const LibraryQuery& query);
 
+  // The grouping that's actually shown, which depends on the query mode.
+  Grouping active_group_by() const;
+
   void BeginReset();
 
   // Functions for working with queries and creating items.
@@ -208,19 +236,19 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   // for each parent item, restricting the songs returned to a particular
   // album or artist for example.
   static void InitQuery(GroupBy type, LibraryQuery* q);
-  void FilterQuery(GroupBy type, LibraryItem* item, LibraryQuery* q);
+  static void FilterQuery(GroupBy type, LibraryItem* item, LibraryQuery* q);
 
   // Items can be created either from a query that's been run to populate a
   // node, or by a spontaneous SongsDiscovered emission from the backend.
-  LibraryItem* ItemFromQuery(GroupBy type, bool signal, bool create_divider,
-                             LibraryItem* parent, const SqlRow& row,
-                             int container_level);
-  LibraryItem* ItemFromSong(GroupBy type, bool signal, bool create_divider,
-                            LibraryItem* parent, const Song& s,
-                            int container_level);
+  // They don't touch the model, so they're safe to call from any thread.
+  LibraryItem* ItemFromQuery(GroupBy type, const SqlRow& row,
+                             int container_level) const;
+  LibraryItem* ItemFromSong(GroupBy type, const Song& s,
+                            int container_level) const;
 
   // The "Various Artists" node is an annoying special case.
-  LibraryItem* CreateCompilationArtistNode(bool signal, LibraryItem* parent);
+  LibraryItem* CreateCompilationArtistNode(LibraryItem* parent,
+                                           PendingItems* pending);
 
   // Smart playlists are shown in another top-level node
   void CreateSmartPlaylists();
@@ -228,10 +256,12 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   void ItemFromSmartPlaylist(const QSettings& s, bool notify) const;
 
   // Helpers for ItemFromQuery and ItemFromSong
-  LibraryItem* InitItem(GroupBy type, bool signal, LibraryItem* parent,
-                        int container_level);
-  void FinishItem(GroupBy type, bool signal, bool create_divider,
-                  LibraryItem* parent, LibraryItem* item);
+  LibraryItem* InitItem(GroupBy type, int container_level) const;
+
+  // Creates the divider for the item if it needs one, and queues both of them
+  // to be added to the tree.  Must be called in the main thread.
+  void FinishItem(GroupBy type, bool create_divider, LibraryItem* parent,
+                  LibraryItem* item, PendingItems* pending);
 
   QString DividerKey(GroupBy type, LibraryItem* item) const;
   QString DividerDisplayText(GroupBy type, const QString& key) const;
@@ -256,14 +286,18 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   Grouping group_by_;
 
   // Keyed on database ID
-  QMap<int, LibraryItem*> song_nodes_;
+  QHash<int, LibraryItem*> song_nodes_;
 
   // Keyed on whatever the key is for that level - artist, album, year, etc.
-  QMap<QString, LibraryItem*> container_nodes_[3];
+  QHash<QString, LibraryItem*> container_nodes_[3];
 
   // Keyed on a letter, a year, a century, etc.
   QMap<QString, LibraryItem*> divider_nodes_;
 
+  // Songs from SongsDiscovered that haven't been added to the tree yet.
+  SongList pending_songs_;
+  QTimer* add_songs_timer_;
+
   // Only applies if smart playlists are set to on
   LibraryItem* smart_playlist_node_;
 
@@ -285,6 +319,10 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   typedef QPair<LibraryItem*, QString> ItemAndCacheKey;
   QMap<quint64, ItemAndCacheKey> pending_art_;
   QSet<QString> pending_cache_keys_;
+
+  FRIEND_TEST(LibraryModelQueriesTest, TopLevel);
+  FRIEND_TEST(LibraryModelQueriesTest, ChildLevels);
+  FRIEND_TEST(LibraryModelQueriesTest, VariousArtists);
 };
 
 Q_DECLARE_METATYPE(LibraryModel::Grouping);
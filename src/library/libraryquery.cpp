@@ -17,6 +17,7 @@
 
 #include "libraryquery.h"
 #include "core/song.h"
+#include "core/tracer.h"
 
 #include <QtDebug>
 #include <QDateTime>
@@ -74,6 +75,8 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
   // remember though that when you fix the Duplicates + FTS cooperation, enable the
   // filtering in both Duplicates and Untagged modes.
   duplicates_only_ = options.query_mode() == QueryOptions::QueryMode_Duplicates;
+  identical_audio_only_ =
+      options.query_mode() == QueryOptions::QueryMode_IdenticalAudio;
 
   if (options.query_mode() == QueryOptions::QueryMode_Untagged) {
     where_clauses_ << "(artist = '' OR album = '' OR title ='')";
@@ -81,6 +84,18 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
 }
 
 QString LibraryQuery::GetInnerQuery() {
+  if (identical_audio_only_) {
+    // An empty hash means the song couldn't be hashed.  The artist and title
+    // are there to label each group of songs.
+    return QString(" INNER JOIN (SELECT content_hash AS dup_hash,"
+                   "                    MAX(artist) AS dup_artist,"
+                   "                    MAX(title) AS dup_title"
+                   "             FROM %songs_table"
+                   "             WHERE content_hash != '' AND unavailable = 0"
+                   "             GROUP BY content_hash HAVING COUNT(*) > 1) dhashes"
+                   " ON %songs_table.content_hash = dhashes.dup_hash");
+  }
+
   return duplicates_only_
              ? QString(" INNER JOIN (select * from duplicated_songs) dsongs        "
                                 "ON (%songs_table.artist = dsongs.dup_artist       "
@@ -146,6 +161,9 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
   sql.replace("%fts_table_noprefix", fts_table.section('.', -1, -1));
   sql.replace("%fts_table", fts_table);
 
+  TraceScope trace("database", "LibraryQuery::Exec");
+  trace.set_detail(sql);
+
   query_ = QSqlQuery(sql, db);
 
   // Bind values
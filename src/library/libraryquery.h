@@ -36,12 +36,15 @@ struct QueryOptions {
   //   in the songs table
   // - use the untagged songs view; by untagged we mean those for which
   //   at least one of the (artist, album, title) tags is empty
+  // - use the identical audio view; songs whose audio data has the same
+  //   content_hash as another song, whatever their tags say
   // Please note that additional filtering based on fts table (the filter
-  // attribute) won't work in Duplicates and Untagged modes.
+  // attribute) won't work in Duplicates, Untagged and IdenticalAudio modes.
   enum QueryMode {
     QueryMode_All,
     QueryMode_Duplicates,
-    QueryMode_Untagged
+    QueryMode_Untagged,
+    QueryMode_IdenticalAudio
   };
 
   QueryOptions();
@@ -104,6 +107,7 @@ class LibraryQuery {
   QVariantList bound_values_;
   int limit_;
   bool duplicates_only_;
+  bool identical_audio_only_;
 
   QSqlQuery query_;
 };
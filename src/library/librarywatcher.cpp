@@ -22,8 +22,9 @@
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
+#include "core/tracer.h"
 #include "core/utilities.h"
-#include "playlistparsers/cueparser.h"
+#include "playlistparsers/cuecache.h"
 
 #include <QDateTime>
 #include <QDirIterator>
@@ -46,6 +47,46 @@
 QStringList LibraryWatcher::sValidImages;
 
 const char* LibraryWatcher::kSettingsGroup = "LibraryWatcher";
+const int LibraryWatcher::kRescanQuietMs = 2000;
+const int LibraryWatcher::kRescanMaxLatencyMs = 30000;
+
+namespace {
+
+// Summarises the entries of a directory: how many there are, their names, and
+// the total size and latest mtime of the files.  If the digest of a directory
+// is the same as when it was last scanned then none of its songs need to be
+// compared with the database.  Subdirectories only contribute their names
+// because they have digests of their own.
+class DirectoryDigest {
+ public:
+  DirectoryDigest() : count_(0), total_size_(0), max_mtime_(0), names_hash_(0) {}
+
+  void Add(const QFileInfo& info) {
+    count_ ++;
+    // Adding the hashes up doesn't depend on the order of the entries.
+    names_hash_ += qHash(info.fileName());
+
+    if (!info.isDir()) {
+      total_size_ += info.size();
+      max_mtime_ = qMax(max_mtime_, info.lastModified().toTime_t());
+    }
+  }
+
+  uint max_mtime() const { return max_mtime_; }
+
+  QString ToString() const {
+    return QString("%1:%2:%3:%4").arg(count_).arg(total_size_).arg(max_mtime_)
+        .arg(names_hash_, 16, 16, QChar('0'));
+  }
+
+ private:
+  int count_;
+  qint64 total_size_;
+  uint max_mtime_;
+  quint64 names_hash_;
+};
+
+}  // namespace
 
 LibraryWatcher::LibraryWatcher(QObject* parent)
   : QObject(parent),
@@ -56,13 +97,12 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
     scan_on_startup_(true),
     monitor_(true),
     rescan_timer_(new QTimer(this)),
+    rescan_due_ms_(0),
     rescan_paused_(false),
-    total_watches_(0),
-    cue_parser_(new CueParser(backend_, this))
+    total_watches_(0)
 {
   Utilities::SetThreadIOPriority(Utilities::IOPRIO_CLASS_IDLE);
 
-  rescan_timer_->setInterval(1000);
   rescan_timer_->setSingleShot(true);
 
   if (sValidImages.isEmpty()) {
@@ -72,6 +112,7 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
   ReloadSettings();
 
   connect(rescan_timer_, SIGNAL(timeout()), SLOT(RescanPathsNow()));
+  connect(fs_watcher_, SIGNAL(EventsLost()), SLOT(FileSystemEventsLost()));
 }
 
 LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher, int dir,
@@ -136,48 +177,52 @@ void LibraryWatcher::ScanTransaction::AddToProgressMax(int n) {
 
 SongList LibraryWatcher::ScanTransaction::FindSongsInSubdirectory(const QString &path) {
   if (cached_songs_dirty_) {
-    cached_songs_ = watcher_->backend_->FindSongsInDirectory(dir_);
+    cached_songs_.clear();
+    foreach (const Song& song, watcher_->backend_->FindSongsInDirectory(dir_)) {
+      cached_songs_[song.url().toLocalFile().section('/', 0, -2)] << song;
+    }
     cached_songs_dirty_ = false;
   }
 
-  // TODO: Make this faster
-  SongList ret;
-  foreach (const Song& song, cached_songs_) {
-    if (song.url().toLocalFile().section('/', 0, -2) == path)
-      ret << song;
-  }
-  return ret;
+  return cached_songs_.value(path);
 }
 
 void LibraryWatcher::ScanTransaction::SetKnownSubdirs(const SubdirectoryList &subdirs) {
   known_subdirs_ = subdirs;
+  known_subdirs_by_path_.clear();
+  known_subdirs_by_parent_.clear();
+
+  foreach (const Subdirectory& subdir, known_subdirs_) {
+    if (subdir.mtime == 0)
+      continue;
+
+    known_subdirs_by_path_[subdir.path] = subdir;
+    known_subdirs_by_parent_[subdir.path.left(
+        subdir.path.lastIndexOf(QDir::separator()))] << subdir;
+  }
+
   known_subdirs_dirty_ = false;
 }
 
+Subdirectory LibraryWatcher::ScanTransaction::KnownSubdir(const QString &path) {
+  if (known_subdirs_dirty_)
+    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
+
+  return known_subdirs_by_path_.value(path);
+}
+
 bool LibraryWatcher::ScanTransaction::HasSeenSubdir(const QString &path) {
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  foreach (const Subdirectory& subdir, known_subdirs_) {
-    if (subdir.path == path && subdir.mtime != 0)
-      return true;
-  }
-  return false;
+  return known_subdirs_by_path_.contains(path);
 }
 
 SubdirectoryList LibraryWatcher::ScanTransaction::GetImmediateSubdirs(const QString &path) {
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  SubdirectoryList ret;
-  foreach (const Subdirectory& subdir, known_subdirs_) {
-    if (subdir.path.left(subdir.path.lastIndexOf(QDir::separator())) == path &&
-        subdir.mtime != 0) {
-      ret << subdir;
-    }
-  }
-
-  return ret;
+  return known_subdirs_by_parent_.value(path);
 }
 
 SubdirectoryList LibraryWatcher::ScanTransaction::GetAllSubdirs() {
@@ -187,6 +232,9 @@ SubdirectoryList LibraryWatcher::ScanTransaction::GetAllSubdirs() {
 }
 
 void LibraryWatcher::AddDirectory(const Directory& dir, const SubdirectoryList& subdirs) {
+  TraceScope trace("library", "LibraryWatcher::AddDirectory");
+  trace.set_detail(dir.path);
+
   watched_dirs_[dir.id] = dir;
 
   if (subdirs.isEmpty()) {
@@ -219,6 +267,23 @@ void LibraryWatcher::AddDirectory(const Directory& dir, const SubdirectoryList&
 void LibraryWatcher::ScanSubdirectory(
     const QString& path, const Subdirectory& subdir, ScanTransaction* t,
     bool force_noincremental) {
+  TraceScope trace("library", "LibraryWatcher::ScanSubdirectory");
+  trace.set_detail(path);
+
+  const bool incremental =
+      !t->ignores_mtime() && !force_noincremental && t->is_incremental();
+
+  // Any change to this directory would have been reported by the filesystem
+  // watcher, so there's no need to look at it at all.
+  if (incremental && clean_subdirs_.contains(path)) {
+    t->AddToProgress(1);
+    return;
+  }
+
+  // If the directory is reliably watched now, it's clean once we've scanned it.
+  const bool reliably_watched =
+      monitor_ && fs_watcher_->IsReliablyWatched(path);
+
   QFileInfo path_info(path);
 
   // Do not scan symlinked dirs that are already in collection
@@ -232,9 +297,10 @@ void LibraryWatcher::ScanSubdirectory(
     }
   }
 
-  if (!t->ignores_mtime() && !force_noincremental && t->is_incremental() &&
-      subdir.mtime == path_info.lastModified().toTime_t()) {
+  if (incremental && subdir.mtime == path_info.lastModified().toTime_t()) {
     // The directory hasn't changed since last time
+    if (reliably_watched)
+      clean_subdirs_ << path;
     t->AddToProgress(1);
     return;
   }
@@ -242,6 +308,7 @@ void LibraryWatcher::ScanSubdirectory(
   QMap<QString, QStringList> album_art;
   QStringList files_on_disk;
   SubdirectoryList my_new_subdirs;
+  DirectoryDigest digest;
 
   // If a directory is moved then only its parent gets a changed notification,
   // so we need to look and see if any of our children don't exist any more.
@@ -263,6 +330,7 @@ void LibraryWatcher::ScanSubdirectory(
 
     QString child(it.next());
     QFileInfo child_info(child);
+    digest.Add(child_info);
 
     if (child_info.isDir()) {
       if (!child_info.isHidden() && !t->HasSeenSubdir(child)) {
@@ -287,93 +355,103 @@ void LibraryWatcher::ScanSubdirectory(
 
   if (stop_requested_) return;
 
-  // Ask the database for a list of files in this directory
-  SongList songs_in_db = t->FindSongsInSubdirectory(path);
+  // If nothing in the directory changed since it was last scanned then its
+  // songs don't need to be compared with the database, even though its mtime
+  // changed.
+  const QString digest_string = digest.ToString();
+  const QString known_digest = t->KnownSubdir(path).digest;
+  const bool unchanged = !t->ignores_mtime() && !known_digest.isEmpty() &&
+                         known_digest == digest_string;
 
-  QSet<QString> cues_processed;
+  if (!unchanged) {
+    // Ask the database for a list of files in this directory
+    SongList songs_in_db = t->FindSongsInSubdirectory(path);
 
-  // Now compare the list from the database with the list of files on disk
-  foreach (const QString& file, files_on_disk) {
-    if (stop_requested_) return;
+    QSet<QString> cues_processed;
 
-    // associated cue
-    QString matching_cue = NoExtensionPart(file) + ".cue";
+    // Now compare the list from the database with the list of files on disk
+    foreach (const QString& file, files_on_disk) {
+      if (stop_requested_) return;
 
-    Song matching_song;
-    if (FindSongByPath(songs_in_db, file, &matching_song)) {
-      uint matching_cue_mtime = GetMtimeForCue(matching_cue);
+      // associated cue
+      QString matching_cue = NoExtensionPart(file) + ".cue";
 
-      // The song is in the database and still on disk.
-      // Check the mtime to see if it's been changed since it was added.
-      QFileInfo file_info(file);
+      Song matching_song;
+      if (FindSongByPath(songs_in_db, file, &matching_song)) {
+        uint matching_cue_mtime = GetMtimeForCue(matching_cue);
 
-      if (!file_info.exists()) {
-        // Partially fixes race condition - if file was removed between being
-        // added to the list and now.
-        files_on_disk.removeAll(file);
-        continue;
-      }
+        // The song is in the database and still on disk.
+        // Check the mtime to see if it's been changed since it was added.
+        QFileInfo file_info(file);
 
-      // cue sheet's path from library (if any)
-      QString song_cue = matching_song.cue_path();
-      uint song_cue_mtime = GetMtimeForCue(song_cue);
-
-      bool cue_deleted = song_cue_mtime == 0 && matching_song.has_cue();
-      bool cue_added = matching_cue_mtime != 0 && !matching_song.has_cue();
-
-      // watch out for cue songs which have their mtime equal to qMax(media_file_mtime, cue_sheet_mtime)
-      bool changed = (matching_song.mtime() != qMax(file_info.lastModified().toTime_t(), song_cue_mtime))
-                     || cue_deleted || cue_added
-                     || matching_song.is_unavailable();
-
-      // Also want to look to see whether the album art has changed
-      QString image = ImageForSong(file, album_art);
-      if ((matching_song.art_automatic().isEmpty() && !image.isEmpty()) ||
-          (!matching_song.art_automatic().isEmpty()
-           && !matching_song.has_embedded_cover()
-           && !QFile::exists(matching_song.art_automatic()))) {
-        changed = true;
-      }
+        if (!file_info.exists()) {
+          // Partially fixes race condition - if file was removed between being
+          // added to the list and now.
+          files_on_disk.removeAll(file);
+          continue;
+        }
 
-      // the song's changed - reread the metadata from file
-      if (t->ignores_mtime() || changed) {
-        qLog(Debug) << file << "changed";
+        // cue sheet's path from library (if any)
+        QString song_cue = matching_song.cue_path();
+        uint song_cue_mtime = GetMtimeForCue(song_cue);
+
+        bool cue_deleted = song_cue_mtime == 0 && matching_song.has_cue();
+        bool cue_added = matching_cue_mtime != 0 && !matching_song.has_cue();
+
+        // watch out for cue songs which have their mtime equal to qMax(media_file_mtime, cue_sheet_mtime)
+        bool changed = (matching_song.mtime() != qMax(file_info.lastModified().toTime_t(), song_cue_mtime))
+                       || cue_deleted || cue_added
+                       || matching_song.is_unavailable();
+
+        // Also want to look to see whether the album art has changed
+        QString image = ImageForSong(file, album_art);
+        if ((matching_song.art_automatic().isEmpty() && !image.isEmpty()) ||
+            (!matching_song.art_automatic().isEmpty()
+             && !matching_song.has_embedded_cover()
+             && !QFile::exists(matching_song.art_automatic()))) {
+          changed = true;
+        }
 
-        // if cue associated...
-        if(!cue_deleted && (matching_song.has_cue() || cue_added)) {
-          UpdateCueAssociatedSongs(file, path, matching_cue, image, t);
-        // if no cue or it's about to lose it...
-        } else {
-          UpdateNonCueAssociatedSong(file, matching_song, image, cue_deleted, t);
+        // the song's changed - reread the metadata from file
+        if (t->ignores_mtime() || changed) {
+          qLog(Debug) << file << "changed";
+
+          // if cue associated...
+          if(!cue_deleted && (matching_song.has_cue() || cue_added)) {
+            UpdateCueAssociatedSongs(file, path, matching_cue, image, t);
+          // if no cue or it's about to lose it...
+          } else {
+            UpdateNonCueAssociatedSong(file, matching_song, image, cue_deleted, t);
+          }
         }
-      }
-    } else {
-      // The song is on disk but not in the DB
-      SongList song_list = ScanNewFile(file, path, matching_cue, &cues_processed);
+      } else {
+        // The song is on disk but not in the DB
+        SongList song_list = ScanNewFile(file, path, matching_cue, &cues_processed);
 
-      if(song_list.isEmpty()) {
-        continue;
-      }
+        if(song_list.isEmpty()) {
+          continue;
+        }
 
-      qLog(Debug) << file << "created";
-      // choose an image for the song(s)
-      QString image = ImageForSong(file, album_art);
+        qLog(Debug) << file << "created";
+        // choose an image for the song(s)
+        QString image = ImageForSong(file, album_art);
 
-      foreach (Song song, song_list) {
-        song.set_directory_id(t->dir());
-        if (song.art_automatic().isEmpty())
-          song.set_art_automatic(image);
+        foreach (Song song, song_list) {
+          song.set_directory_id(t->dir());
+          if (song.art_automatic().isEmpty())
+            song.set_art_automatic(image);
 
-        t->new_songs << song;
+          t->new_songs << song;
+        }
       }
     }
-  }
 
-  // Look for deleted songs
-  foreach (const Song& song, songs_in_db) {
-    if (!song.is_unavailable() && !files_on_disk.contains(song.url().toLocalFile())) {
-      qLog(Debug) << "Song deleted from disk:" << song.url().toLocalFile();
-      t->deleted_songs << song;
+    // Look for deleted songs
+    foreach (const Song& song, songs_in_db) {
+      if (!song.is_unavailable() && !files_on_disk.contains(song.url().toLocalFile())) {
+        qLog(Debug) << "Song deleted from disk:" << song.url().toLocalFile();
+        t->deleted_songs << song;
+      }
     }
   }
 
@@ -383,12 +461,16 @@ void LibraryWatcher::ScanSubdirectory(
   updated_subdir.mtime = path_info.exists() ?
                          path_info.lastModified().toTime_t() : 0;
   updated_subdir.path = path;
+  updated_subdir.digest = digest_string;
 
   if (subdir.directory_id == -1)
     t->new_subdirs << updated_subdir;
   else
     t->touched_subdirs << updated_subdir;
 
+  if (reliably_watched && path_info.exists())
+    clean_subdirs_ << path;
+
   t->AddToProgress(1);
 
   // Recurse into the new subdirs that we found
@@ -402,9 +484,6 @@ void LibraryWatcher::ScanSubdirectory(
 void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file, const QString& path,
                                               const QString& matching_cue, const QString& image,
                                               ScanTransaction* t) {
-  QFile cue(matching_cue);
-  cue.open(QIODevice::ReadOnly);
-
   SongList old_sections = backend_->GetSongsByUrl(QUrl::fromLocalFile(file));
 
   QHash<quint64, Song> sections_map;
@@ -415,7 +494,7 @@ void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file, const QString
   QSet<int> used_ids;
 
   // update every song that's in the cue and library
-  foreach(Song cue_song, cue_parser_->Load(&cue, matching_cue, path)) {
+  foreach(Song cue_song, CueCache::Instance()->Load(matching_cue)) {
     cue_song.set_directory_id(t->dir());
 
     Song matching = sections_map[cue_song.beginning_nanosec()];
@@ -472,13 +551,10 @@ SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
     if(cues_processed->contains(matching_cue))
       return song_list;
 
-    QFile cue(matching_cue);
-    cue.open(QIODevice::ReadOnly);
-
     // Ignore FILEs pointing to other media files. Also, watch out for incorrect
     // media files. Playlist parser for CUEs considers every entry in sheet
     // valid and we don't want invalid media getting into library!
-    foreach(const Song& cue_song, cue_parser_->Load(&cue, matching_cue, path)) {
+    foreach(const Song& cue_song, CueCache::Instance()->Load(matching_cue)) {
       if (cue_song.url().toLocalFile() == file) {
         if (TagReaderClient::Instance()->IsMediaFileBlocking(file)) {
           song_list << cue_song;
@@ -562,13 +638,14 @@ void LibraryWatcher::AddWatch(const Directory& dir, const QString& path) {
 }
 
 void LibraryWatcher::RemoveDirectory(const Directory& dir) {
-  rescan_queue_.remove(dir.id);
   watched_dirs_.remove(dir.id);
 
   // Stop watching the directory's subdirectories
   foreach (const QString& subdir_path, subdir_mapping_.keys(dir)) {
     fs_watcher_->RemovePath(subdir_path);
     subdir_mapping_.remove(subdir_path);
+    clean_subdirs_.remove(subdir_path);
+    rescan_queue_.remove(subdir_path);
   }
 }
 
@@ -593,22 +670,128 @@ void LibraryWatcher::DirectoryChanged(const QString &subdir) {
 
   qLog(Debug) << "Subdir" << subdir << "changed under directory" << dir.path << "id" << dir.id;
 
-  // Queue the subdir for rescanning
-  if (!rescan_queue_[dir.id].contains(subdir))
-    rescan_queue_[dir.id] << subdir;
+  clean_subdirs_.remove(subdir);
 
-  if (!rescan_paused_)
-    rescan_timer_->start();
+  // Queue the subdir for rescanning.  The clock only has to measure how long
+  // the changes have been waiting, so restart it while it's not in use so it
+  // doesn't wrap around.
+  if (rescan_queue_.isEmpty()) {
+    rescan_clock_.start();
+    rescan_timer_->stop();
+  }
+  const int now = rescan_clock_.elapsed();
+
+  PendingRescan& pending = rescan_queue_[subdir];
+  if (pending.directory_id_ == -1) {
+    pending.directory_id_ = dir.id;
+    pending.first_change_ms_ = now;
+  }
+  pending.last_change_ms_ = now;
+  pending.digest_.clear();
+
+  StartRescanTimer(qMin(now + kRescanQuietMs,
+                        pending.first_change_ms_ + kRescanMaxLatencyMs));
+}
+
+void LibraryWatcher::StartRescanTimer(int due_ms) {
+  if (rescan_paused_)
+    return;
+
+  // Don't postpone a check that's already due sooner.
+  if (rescan_timer_->isActive() && rescan_due_ms_ <= due_ms)
+    return;
+
+  rescan_due_ms_ = due_ms;
+  rescan_timer_->start(qMax(0, due_ms - rescan_clock_.elapsed()));
+}
+
+bool LibraryWatcher::HasStableFiles(const QString& path,
+                                    PendingRescan* pending) {
+  // Torrent clients and rsync keep writing to files for a while after
+  // creating them, and we don't want to read tags from half-written files.
+  DirectoryDigest digest;
+  QDirIterator it(path, QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot);
+  while (it.hasNext()) {
+    it.next();
+    digest.Add(it.fileInfo());
+  }
+
+  const QString digest_string = digest.ToString();
+  bool stable;
+  if (pending->digest_.isEmpty()) {
+    // We haven't looked at this directory before, so all we can tell is
+    // whether anything was modified very recently.
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    stable = digest.max_mtime() + kRescanQuietMs / 1000 < now;
+  } else {
+    // The files are stable if they're the same size as last time.
+    stable = digest_string == pending->digest_;
+  }
+
+  pending->digest_ = digest_string;
+  return stable;
+}
+
+void LibraryWatcher::FileSystemEventsLost() {
+  // We don't know which directories changed, so check all their mtimes again.
+  clean_subdirs_.clear();
+  IncrementalScanNow();
 }
 
 void LibraryWatcher::RescanPathsNow() {
-  foreach (int dir, rescan_queue_.keys()) {
+  if (rescan_paused_ || rescan_queue_.isEmpty())
+    return;
+
+  TraceScope trace("library", "LibraryWatcher::RescanPathsNow");
+
+  const int now = rescan_clock_.elapsed();
+  int oldest_change_ms = now;
+  int next_check_ms = now + kRescanMaxLatencyMs;
+  bool all_settled = true;
+
+  // Find the directories that have settled down.
+  QMap<int, QStringList> settled; // dir id -> list of subdirs to be scanned
+  for (QMap<QString, PendingRescan>::iterator it = rescan_queue_.begin() ;
+       it != rescan_queue_.end() ; ++it) {
+    PendingRescan& pending = it.value();
+    oldest_change_ms = qMin(oldest_change_ms, pending.first_change_ms_);
+
+    // Directories that have been waiting for too long are scanned even if
+    // they're still changing, otherwise a busy download directory would never
+    // be scanned at all.
+    const int deadline_ms = pending.first_change_ms_ + kRescanMaxLatencyMs;
+    const int quiet_ms = qMin(pending.last_change_ms_ + kRescanQuietMs,
+                              deadline_ms);
+    if (now >= deadline_ms) {
+      settled[pending.directory_id_] << it.key();
+    } else if (now < quiet_ms) {
+      all_settled = false;
+      next_check_ms = qMin(next_check_ms, quiet_ms);
+    } else if (!HasStableFiles(it.key(), &pending)) {
+      all_settled = false;
+      next_check_ms = qMin(next_check_ms, now + kRescanQuietMs);
+    } else {
+      settled[pending.directory_id_] << it.key();
+    }
+  }
+
+  // Wait for the whole burst of changes to settle down so it's committed in
+  // one go, unless some of them have been waiting for too long already.
+  if (!all_settled && now - oldest_change_ms < kRescanMaxLatencyMs) {
+    StartRescanTimer(qMin(next_check_ms,
+                          oldest_change_ms + kRescanMaxLatencyMs));
+    return;
+  }
+
+  foreach (int dir, settled.keys()) {
     if (stop_requested_) return;
     ScanTransaction transaction(this, dir, false);
-    transaction.AddToProgressMax(rescan_queue_[dir].count());
+    transaction.AddToProgressMax(settled[dir].count());
 
-    foreach (const QString& path, rescan_queue_[dir]) {
+    foreach (const QString& path, settled[dir]) {
       if (stop_requested_) return;
+      rescan_queue_.remove(path);
+
       Subdirectory subdir;
       subdir.directory_id = dir;
       subdir.mtime = 0;
@@ -617,9 +800,11 @@ void LibraryWatcher::RescanPathsNow() {
     }
   }
 
-  rescan_queue_.clear();
+  if (!rescan_queue_.isEmpty())
+    StartRescanTimer(next_check_ms);
 
-  emit CompilationsNeedUpdating();
+  if (!settled.isEmpty())
+    emit CompilationsNeedUpdating();
 }
 
 QString LibraryWatcher::PickBestImage(const QStringList& images) {
@@ -707,6 +892,7 @@ void LibraryWatcher::ReloadSettings() {
 
   if (!monitor_ && was_monitoring_before) {
     fs_watcher_->Clear();
+    clean_subdirs_.clear();
   } else if (monitor_ && !was_monitoring_before) {
     // Add all directories to all QFileSystemWatchers again
     foreach (const Directory& dir, watched_dirs_.values()) {
@@ -746,6 +932,7 @@ void LibraryWatcher::FullScanNow() {
 }
 
 void LibraryWatcher::PerformScan(bool incremental, bool ignore_mtimes) {
+  TraceScope trace("library", "LibraryWatcher::PerformScan");
   foreach (const Directory& dir, watched_dirs_.values()) {
     ScanTransaction transaction(this, dir.id,
                                 incremental, ignore_mtimes);
@@ -23,13 +23,16 @@
 
 #include <QHash>
 #include <QObject>
+#include <QSet>
 #include <QStringList>
 #include <QMap>
+#include <QTime>
+
+#include "gtest/gtest_prod.h"
 
 class QFileSystemWatcher;
 class QTimer;
 
-class CueParser;
 class FileSystemWatcherInterface;
 class LibraryBackend;
 class TaskManager;
@@ -42,6 +45,12 @@ class LibraryWatcher : public QObject {
 
   static const char* kSettingsGroup;
 
+  // A changed directory is rescanned once it has had no changes for
+  // kRescanQuietMs and its files have stopped growing, but changes are never
+  // held back for longer than kRescanMaxLatencyMs.
+  static const int kRescanQuietMs;
+  static const int kRescanMaxLatencyMs;
+
   void set_backend(LibraryBackend* backend) { backend_ = backend; }
   void set_task_manager(TaskManager* task_manager) { task_manager_ = task_manager; }
   void set_device_name(const QString& device_name) { device_name_ = device_name; }
@@ -86,6 +95,7 @@ class LibraryWatcher : public QObject {
     ~ScanTransaction();
 
     SongList FindSongsInSubdirectory(const QString& path);
+    Subdirectory KnownSubdir(const QString& path);
     bool HasSeenSubdir(const QString& path);
     void SetKnownSubdirs(const SubdirectoryList& subdirs);
     SubdirectoryList GetImmediateSubdirs(const QString& path);
@@ -124,15 +134,19 @@ class LibraryWatcher : public QObject {
 
     LibraryWatcher* watcher_;
 
-    SongList cached_songs_;
+    // Songs indexed by the path of the directory they're in.
+    QHash<QString, SongList> cached_songs_;
     bool cached_songs_dirty_;
 
     SubdirectoryList known_subdirs_;
+    QHash<QString, Subdirectory> known_subdirs_by_path_;
+    QHash<QString, SubdirectoryList> known_subdirs_by_parent_;
     bool known_subdirs_dirty_;
   };
 
  private slots:
   void DirectoryChanged(const QString& path);
+  void FileSystemEventsLost();
   void IncrementalScanNow();
   void FullScanNow();
   void RescanPathsNow();
@@ -140,6 +154,19 @@ class LibraryWatcher : public QObject {
                         ScanTransaction* t, bool force_noincremental = false);
 
  private:
+  struct PendingRescan {
+    PendingRescan()
+      : directory_id_(-1), first_change_ms_(0), last_change_ms_(0) {}
+
+    int directory_id_;
+    int first_change_ms_;
+    int last_change_ms_;
+
+    // The directory's digest when we last looked for files that were still
+    // being written.
+    QString digest_;
+  };
+
   static bool FindSongByPath(const SongList& list, const QString& path, Song* out);
   inline static QString NoExtensionPart( const QString &fileName );
   inline static QString ExtensionPart( const QString &fileName );
@@ -149,6 +176,8 @@ class LibraryWatcher : public QObject {
   void AddWatch(const Directory& dir, const QString& path);
   uint GetMtimeForCue(const QString& cue_path);
   void PerformScan(bool incremental, bool ignore_mtimes);
+  void StartRescanTimer(int due_ms);
+  bool HasStableFiles(const QString& path, PendingRescan* pending);
 
   // Updates the sections of a cue associated and altered (according to mtime)
   // media file during a scan.
@@ -178,6 +207,11 @@ class LibraryWatcher : public QObject {
   FileSystemWatcherInterface* fs_watcher_;
   QHash<QString, Directory> subdir_mapping_;
 
+  // Subdirectories that were already reliably watched when they were last
+  // scanned, and haven't changed since.  Incremental scans don't even need to
+  // stat these.
+  QSet<QString> clean_subdirs_;
+
   /* A list of words use to try to identify the (likely) best image 
    * found in an directory to use as cover artwork.
    * e.g. using ["front", "cover"] would identify front.jpg and
@@ -190,15 +224,22 @@ class LibraryWatcher : public QObject {
   bool monitor_;
 
   QMap<int, Directory> watched_dirs_;
+  QTime rescan_clock_;
   QTimer* rescan_timer_;
-  QMap<int, QStringList> rescan_queue_; // dir id -> list of subdirs to be scanned
+  int rescan_due_ms_;
+  QMap<QString, PendingRescan> rescan_queue_; // subdir path -> change times
   bool rescan_paused_;
 
   int total_watches_;
 
-  CueParser* cue_parser_;
-
   static QStringList sValidImages;
+
+  FRIEND_TEST(LibraryWatcherTest, WaitsForQuietPeriod);
+  FRIEND_TEST(LibraryWatcherTest, ScansOldFilesWhenQuiet);
+  FRIEND_TEST(LibraryWatcherTest, WaitsForFilesToStopChanging);
+  FRIEND_TEST(LibraryWatcherTest, RescansAfterMaxLatency);
+  FRIEND_TEST(LibraryWatcherTest, SkipsSubdirWithSameDigest);
+  FRIEND_TEST(LibraryWatcherTest, ScansSubdirWithNewDigest);
 };
 
 inline QString LibraryWatcher::NoExtensionPart( const QString &fileName ) {
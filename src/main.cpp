@@ -35,6 +35,8 @@
 #include "core/networkproxyfactory.h"
 #include "core/potranslator.h"
 #include "core/song.h"
+#include "core/startuptrace.h"
+#include "core/tracer.h"
 #include "core/ubuntuunityhack.h"
 #include "core/utilities.h"
 #include "covers/amazoncoverprovider.h"
@@ -244,6 +246,8 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
+  StartupTrace::Instance()->Start();
+
   CrashReporting crash_reporting;
 
 #ifdef Q_OS_DARWIN
@@ -318,6 +322,10 @@ int main(int argc, char *argv[]) {
   // don't have to tell us which version they're using.
   qLog(Info) << "Clementine" << CLEMENTINE_VERSION_DISPLAY;
 
+  if (!options.trace_filename().isEmpty()) {
+    Tracer::Start();
+  }
+
   // Seed the random number generators.
   time_t t = time(NULL);
   srand(t);
@@ -459,7 +467,10 @@ int main(int argc, char *argv[]) {
 #endif
 
   // Window
+  StartupTrace::Instance()->Begin("MainWindow");
   MainWindow w(&app, tray_icon.get(), &osd);
+  StartupTrace::Instance()->End();
+  StartupTrace::Instance()->WatchForFirstPaint(&w);
 #ifdef Q_OS_DARWIN
   mac::EnableFullScreen(w);
 #endif  // Q_OS_DARWIN
@@ -474,6 +485,11 @@ int main(int argc, char *argv[]) {
 
   int ret = a.exec();
 
+  if (!options.trace_filename().isEmpty() && Tracer::is_enabled()) {
+    Tracer::Stop();
+    Tracer::Save(options.trace_filename());
+  }
+
 #ifdef Q_OS_LINUX
   // The nvidia driver would cause Clementine (or any application that used
   // opengl) to use 100% cpu on shutdown.  See:
@@ -19,6 +19,7 @@
 
 #include <QCoreApplication>
 #include <QNetworkReply>
+#include <QTimer>
 
 #include <qjson/parser.h>
 
@@ -31,11 +32,19 @@ const char* AcoustidClient::kClientId = "qsZGpeLx";
 const char* AcoustidClient::kUrl = "http://api.acoustid.org/v2/lookup";
 const int AcoustidClient::kDefaultTimeout = 5000; // msec
 
+// Acoustid allows 3 requests per second from each client.
+const int AcoustidClient::kRequestInterval = 350; // msec
+const int AcoustidClient::kMaxLookupsPerRequest = 10;
+
 AcoustidClient::AcoustidClient(QObject* parent)
   : QObject(parent),
     network_(new NetworkAccessManager(this)),
-    timeouts_(new NetworkTimeouts(kDefaultTimeout, this))
+    timeouts_(new NetworkTimeouts(kDefaultTimeout, this)),
+    url_(kUrl),
+    send_timer_(new QTimer(this))
 {
+  send_timer_->setSingleShot(true);
+  connect(send_timer_, SIGNAL(timeout()), SLOT(SendRequest()));
 }
 
 void AcoustidClient::SetTimeout(int msec) {
@@ -43,72 +52,137 @@ void AcoustidClient::SetTimeout(int msec) {
 }
 
 void AcoustidClient::Start(int id, const QString& fingerprint, int duration_msec) {
+  Lookup lookup;
+  lookup.id_ = id;
+  lookup.fingerprint_ = fingerprint;
+  lookup.duration_msec_ = duration_msec;
+  queue_ << lookup;
+
+  ScheduleRequest();
+}
+
+void AcoustidClient::ScheduleRequest() {
+  if (queue_.isEmpty() || send_timer_->isActive())
+    return;
+
+  // Wait until the next request is allowed.  Anything else that's started in
+  // the meantime goes in the same request.
+  int delay = 0;
+  if (!last_request_time_.isNull())
+    delay = qMax(0, kRequestInterval - last_request_time_.elapsed());
+  send_timer_->start(delay);
+}
+
+void AcoustidClient::SendRequest() {
+  if (queue_.isEmpty())
+    return;
+
   typedef QPair<QString, QString> Param;
 
   QList<Param> parameters;
   parameters << Param("format", "json")
              << Param("client", kClientId)
-             << Param("duration", QString::number(duration_msec / kMsecPerSec))
-             << Param("meta", "recordingids")
-             << Param("fingerprint", fingerprint);
+             << Param("meta", "recordingids");
 
-  QUrl url(kUrl);
-  url.setQueryItems(parameters);
-  QNetworkRequest req(url);
+  QMap<int, int> ids;
+  for (int i=0 ; i<kMaxLookupsPerRequest && !queue_.isEmpty() ; ++i) {
+    const Lookup lookup = queue_.takeFirst();
+    const QString index = QString::number(i);
+
+    parameters << Param("duration." + index,
+                        QString::number(lookup.duration_msec_ / kMsecPerSec))
+               << Param("fingerprint." + index, lookup.fingerprint_);
+    ids[i] = lookup.id_;
+  }
 
-  QNetworkReply* reply = network_->get(req);
+  // The fingerprints are too big to fit many in a URL, so they're POSTed.
+  QUrl body;
+  body.setQueryItems(parameters);
+
+  QNetworkRequest req(url_);
+  req.setHeader(QNetworkRequest::ContentTypeHeader,
+                "application/x-www-form-urlencoded");
+
+  QNetworkReply* reply = network_->post(req, body.encodedQuery());
   NewClosure(reply, SIGNAL(finished()), this,
-             SLOT(RequestFinished(QNetworkReply*, int)), reply, id);
-  requests_[id] = reply;
+             SLOT(RequestFinished(QNetworkReply*)), reply);
+  requests_[reply] = ids;
 
   timeouts_->AddReply(reply);
+
+  last_request_time_.start();
+  ScheduleRequest();
 }
 
 void AcoustidClient::Cancel(int id) {
-  delete requests_.take(id);
+  for (QList<Lookup>::iterator it = queue_.begin() ; it != queue_.end() ; ) {
+    if (it->id_ == id)
+      it = queue_.erase(it);
+    else
+      ++it;
+  }
+
+  foreach (QNetworkReply* reply, requests_.keys()) {
+    QMap<int, int>& ids = requests_[reply];
+    const int index = ids.key(id, -1);
+    if (index == -1)
+      continue;
+
+    // Leave the other lookups in the request alone.
+    ids.remove(index);
+    if (ids.isEmpty()) {
+      requests_.remove(reply);
+      delete reply;
+    }
+  }
 }
 
 void AcoustidClient::CancelAll() {
-  qDeleteAll(requests_.values());
+  queue_.clear();
+  send_timer_->stop();
+
+  qDeleteAll(requests_.keys());
   requests_.clear();
 }
 
-void AcoustidClient::RequestFinished(QNetworkReply* reply, int id) {
+void AcoustidClient::RequestFinished(QNetworkReply* reply) {
   reply->deleteLater();
-  requests_.remove(id);
-
-  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
-    emit Finished(id, QString());
+  if (!requests_.contains(reply))
     return;
-  }
 
-  QJson::Parser parser;
-  bool ok = false;
-  QVariantMap result = parser.parse(reply, &ok).toMap();
-  if (!ok) {
-    emit Finished(id, QString());
-    return;
-  }
+  const QMap<int, int> ids = requests_.take(reply);
+  QMap<int, QString> mbids;
 
-  QString status = result["status"].toString();
-  if (status != "ok") {
-    emit Finished(id, QString());
-    return;
-  }
-  QVariantList results = result["results"].toList();
-  foreach (const QVariant& v, results) {
-    QVariantMap r = v.toMap();
-    if (r.contains("recordings")) {
-      QVariantList recordings = r["recordings"].toList();
-      foreach (const QVariant& recording, recordings) {
-        QVariantMap o = recording.toMap();
-        if (o.contains("id")) {
-          emit Finished(id, o["id"].toString());
-          return;
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 200) {
+    qLog(Warning) << "Acoustid lookup failed with HTTP status"
+                  << reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  } else {
+    QJson::Parser parser;
+    bool ok = false;
+    QVariantMap result = parser.parse(reply, &ok).toMap();
+
+    if (ok && result["status"].toString() == "ok") {
+      // Each fingerprint gets its own list of results.
+      foreach (const QVariant& f, result["fingerprints"].toList()) {
+        QVariantMap fingerprint = f.toMap();
+        const int index = fingerprint["index"].toInt();
+
+        foreach (const QVariant& v, fingerprint["results"].toList()) {
+          QVariantMap r = v.toMap();
+          QVariantList recordings = r["recordings"].toList();
+          foreach (const QVariant& recording, recordings) {
+            QVariantMap o = recording.toMap();
+            if (o.contains("id") && !mbids.contains(index)) {
+              mbids[index] = o["id"].toString();
+            }
+          }
         }
       }
     }
   }
 
-  emit Finished(id, QString());
+  for (QMap<int, int>::const_iterator it = ids.constBegin() ;
+       it != ids.constEnd() ; ++it) {
+    emit Finished(it.value(), mbids.value(it.key()));
+  }
 }
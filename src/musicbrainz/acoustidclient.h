@@ -18,13 +18,17 @@
 #ifndef ACOUSTIDCLIENT_H
 #define ACOUSTIDCLIENT_H
 
+#include <QList>
 #include <QMap>
 #include <QObject>
+#include <QTime>
+#include <QUrl>
 
 class NetworkTimeouts;
 
 class QNetworkAccessManager;
 class QNetworkReply;
+class QTimer;
 
 class AcoustidClient : public QObject {
   Q_OBJECT
@@ -36,6 +40,8 @@ class AcoustidClient : public QObject {
   // You can create one AcoustidClient and make multiple requests using it.
   // IDs are provided by the caller when a request is started and included in
   // the Finished signal - they have no meaning to AcoustidClient.
+  // Lookups are queued and sent in batches, no more often than Acoustid's
+  // rate limit allows.
 
 public:
   AcoustidClient(QObject* parent = 0);
@@ -43,7 +49,10 @@ public:
   // Network requests will be aborted after this interval.
   void SetTimeout(int msec);
 
-  // Starts a request and returns immediately.  Finished() will be emitted
+  // Sends lookups somewhere other than api.acoustid.org.  Used by tests.
+  void SetUrl(const QUrl& url) { url_ = url; }
+
+  // Queues a request and returns immediately.  Finished() will be emitted
   // later with the same ID.
   void Start(int id, const QString& fingerprint, int duration_msec);
 
@@ -59,16 +68,34 @@ signals:
   void Finished(int id, const QString& mbid);
 
 private slots:
-  void RequestFinished(QNetworkReply* reply, int id);
+  void SendRequest();
+  void RequestFinished(QNetworkReply* reply);
 
 private:
+  struct Lookup {
+    int id_;
+    QString fingerprint_;
+    int duration_msec_;
+  };
+
+  void ScheduleRequest();
+
   static const char* kClientId;
   static const char* kUrl;
   static const int kDefaultTimeout;
+  static const int kRequestInterval;
+  static const int kMaxLookupsPerRequest;
 
   QNetworkAccessManager* network_;
   NetworkTimeouts* timeouts_;
-  QMap<int, QNetworkReply*> requests_;
+  QUrl url_;
+
+  QList<Lookup> queue_;
+  QTimer* send_timer_;
+  QTime last_request_time_;
+
+  // The IDs in each request, keyed on their index in the request.
+  QMap<QNetworkReply*, QMap<int, int> > requests_;
 };
 
 #endif // ACOUSTIDCLIENT_H
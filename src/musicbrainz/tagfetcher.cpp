@@ -21,14 +21,19 @@
 #include "chromaprinter.h"
 #include "musicbrainzclient.h"
 #include "core/timeconstants.h"
+#include "library/librarybackend.h"
 
 #include <QFuture>
 #include <QFutureWatcher>
 #include <QUrl>
 #include <QtConcurrentMap>
+#include <QtConcurrentRun>
 
-TagFetcher::TagFetcher(QObject* parent)
+TagFetcher::TagFetcher(LibraryBackend* library, QObject* parent)
   : QObject(parent),
+    library_(library),
+    fingerprint_function_(GetFingerprint),
+    cached_fingerprints_watcher_(NULL),
     fingerprint_watcher_(NULL),
     acoustid_client_(new AcoustidClient(this)),
     musicbrainz_client_(new MusicBrainzClient(this))
@@ -46,17 +51,74 @@ void TagFetcher::StartFetch(const SongList& songs) {
 
   songs_ = songs;
 
-  QFuture<QString> future = QtConcurrent::mapped(songs_, GetFingerprint);
+  if (!library_) {
+    StartFingerprinting(FingerprintMap());
+    return;
+  }
+
+  // Decoding is the slow part, so look for fingerprints that were saved last
+  // time first.  The library might be busy scanning, so don't wait for it
+  // here.
+  QList<QUrl> urls;
+  foreach (const Song& song, songs_) {
+    urls << song.url();
+  }
+
+  QFuture<FingerprintMap> future = QtConcurrent::run(
+      library_, &LibraryBackend::GetFingerprints, urls);
+  cached_fingerprints_watcher_ = new QFutureWatcher<FingerprintMap>(this);
+  cached_fingerprints_watcher_->setFuture(future);
+  connect(cached_fingerprints_watcher_, SIGNAL(finished()),
+          SLOT(CachedFingerprintsLoaded()));
+}
+
+void TagFetcher::CachedFingerprintsLoaded() {
+  QFutureWatcher<FingerprintMap>* watcher =
+      reinterpret_cast<QFutureWatcher<FingerprintMap>*>(sender());
+  if (!watcher || watcher != cached_fingerprints_watcher_) {
+    return;
+  }
+
+  const FingerprintMap cached_fingerprints = watcher->result();
+  watcher->deleteLater();
+  cached_fingerprints_watcher_ = NULL;
+
+  StartFingerprinting(cached_fingerprints);
+}
+
+void TagFetcher::StartFingerprinting(const FingerprintMap& cached_fingerprints) {
+  SongList songs_to_fingerprint;
+  for (int i=0 ; i<songs_.count() ; ++i) {
+    const Song& song = songs_[i];
+    const QString fingerprint = cached_fingerprints.value(song.url());
+
+    if (fingerprint.isEmpty()) {
+      emit Progress(song, tr("Fingerprinting song"));
+      songs_to_fingerprint << song;
+      fingerprint_indices_ << i;
+    } else {
+      IdentifySong(i, fingerprint);
+    }
+  }
+
+  if (songs_to_fingerprint.isEmpty())
+    return;
+
+  // This decodes one song on each core at a time.
+  QFuture<QString> future = QtConcurrent::mapped(songs_to_fingerprint,
+                                                 fingerprint_function_);
   fingerprint_watcher_ = new QFutureWatcher<QString>(this);
   fingerprint_watcher_->setFuture(future);
   connect(fingerprint_watcher_, SIGNAL(resultReadyAt(int)), SLOT(FingerprintFound(int)));
-
-  foreach (const Song& song, songs) {
-    emit Progress(song, tr("Fingerprinting song"));
-  }
 }
 
 void TagFetcher::Cancel() {
+  // The library query can't be stopped, but its result is ignored.
+  if (cached_fingerprints_watcher_) {
+    delete cached_fingerprints_watcher_;
+    cached_fingerprints_watcher_ = NULL;
+  }
+
   if (fingerprint_watcher_) {
     fingerprint_watcher_->cancel();
 
@@ -67,15 +129,17 @@ void TagFetcher::Cancel() {
   acoustid_client_->CancelAll();
   musicbrainz_client_->CancelAll();
   songs_.clear();
+  fingerprint_indices_.clear();
 }
 
-void TagFetcher::FingerprintFound(int index) {
+void TagFetcher::FingerprintFound(int result_index) {
   QFutureWatcher<QString>* watcher = reinterpret_cast<QFutureWatcher<QString>*>(sender());
-  if (!watcher || index >= songs_.count()) {
+  if (!watcher || result_index >= fingerprint_indices_.count()) {
     return;
   }
 
-  const QString fingerprint = watcher->resultAt(index);
+  const QString fingerprint = watcher->resultAt(result_index);
+  const int index = fingerprint_indices_[result_index];
   const Song& song = songs_[index];
 
   if (fingerprint.isEmpty()) {
@@ -83,6 +147,16 @@ void TagFetcher::FingerprintFound(int index) {
     return;
   }
 
+  if (library_) {
+    library_->SetFingerprintAsync(song.url(), fingerprint);
+  }
+
+  IdentifySong(index, fingerprint);
+}
+
+void TagFetcher::IdentifySong(int index, const QString& fingerprint) {
+  const Song& song = songs_[index];
+
   emit Progress(song, tr("Identifying song"));
   acoustid_client_->Start(index, fingerprint, song.length_nanosec() / kNsecPerMsec);
 }
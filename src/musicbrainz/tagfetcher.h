@@ -22,18 +22,27 @@
 #include "core/song.h"
 
 #include <QFutureWatcher>
+#include <QHash>
 #include <QObject>
+#include <QUrl>
+
+#include <boost/function.hpp>
+
+#include "gtest/gtest_prod.h"
 
 class AcoustidClient;
+class LibraryBackend;
 
 class TagFetcher : public QObject {
   Q_OBJECT
 
   // High level interface to Fingerprinter, AcoustidClient and
   // MusicBrainzClient.
+  // If a LibraryBackend is given, fingerprints of library songs are saved in
+  // the database so they don't have to be decoded again next time.
 
 public:
-  TagFetcher(QObject* parent = 0);
+  TagFetcher(LibraryBackend* library, QObject* parent = 0);
 
   void StartFetch(const SongList& songs);
 
@@ -46,18 +55,38 @@ signals:
                        const SongList& songs_guessed);
 
 private slots:
+  void CachedFingerprintsLoaded();
   void FingerprintFound(int index);
   void PuidFound(int index, const QString& puid);
   void TagsFetched(int index, const MusicBrainzClient::ResultList& result);
 
 private:
+  typedef QHash<QUrl, QString> FingerprintMap;
+
   static QString GetFingerprint(const Song& song);
 
+  void StartFingerprinting(const FingerprintMap& cached_fingerprints);
+  void IdentifySong(int index, const QString& fingerprint);
+
+  LibraryBackend* library_;
+
+  // Makes the fingerprint of one song.  This is GetFingerprint except in
+  // tests, which don't want to decode anything.
+  boost::function<QString (const Song&)> fingerprint_function_;
+
+  QFutureWatcher<FingerprintMap>* cached_fingerprints_watcher_;
   QFutureWatcher<QString>* fingerprint_watcher_;
   AcoustidClient* acoustid_client_;
   MusicBrainzClient* musicbrainz_client_;
 
   SongList songs_;
+
+  // Indices into songs_ of the songs being fingerprinted, in the same order as
+  // the results of fingerprint_watcher_.
+  QList<int> fingerprint_indices_;
+
+  FRIEND_TEST(TagFetcherTest, UsesCachedFingerprints);
+  FRIEND_TEST(TagFetcherTest, MatchesFingerprintsToSongs);
 };
 
 #endif // TAGFETCHER_H
@@ -33,9 +33,15 @@ NetworkRemoteHelper::NetworkRemoteHelper(Application* app)
   connect(this, SIGNAL(SetupServerSig()),
           app_->network_remote(), SLOT(SetupServer()));
 
-  // Start the server once the playlistmanager is initialized
-  connect(app_->playlist_manager(), SIGNAL(PlaylistManagerInitialized()),
-          this, SLOT(StartServer()));
+  // Start the server once the playlistmanager is initialized.  Clementine can
+  // crash if a client connects before that.  The helper is created lazily, so
+  // it might have been initialized already.
+  if (app_->playlist_manager()->playlist_container()) {
+    StartServer();
+  } else {
+    connect(app_->playlist_manager(), SIGNAL(PlaylistManagerInitialized()),
+            this, SLOT(StartServer()));
+  }
 
   sInstance = this;
 }
@@ -31,6 +31,7 @@
 #include "core/qhash_qurl.h"
 #include "core/tagreaderclient.h"
 #include "core/timeconstants.h"
+#include "core/tracer.h"
 #include "internet/jamendoplaylistitem.h"
 #include "internet/jamendoservice.h"
 #include "internet/magnatuneplaylistitem.h"
@@ -53,6 +54,7 @@
 #include <QCoreApplication>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QHash>
 #include <QLinkedList>
 #include <QMimeData>
 #include <QMutableListIterator>
@@ -92,6 +94,7 @@ const char* Playlist::kSettingsGroup = "Playlist";
 
 const int Playlist::kUndoStackSize = 20;
 const int Playlist::kUndoItemLimit = 500;
+const int Playlist::kCueRestoreChunkSize = 200;
 
 Playlist::Playlist(PlaylistBackend* backend,
                    TaskManager* task_manager,
@@ -125,8 +128,6 @@ Playlist::Playlist(PlaylistBackend* backend,
   connect(this, SIGNAL(rowsInserted(const QModelIndex&, int, int)), SIGNAL(PlaylistChanged()));
   connect(this, SIGNAL(rowsRemoved(const QModelIndex&, int, int)), SIGNAL(PlaylistChanged()));
 
-  Restore();
-
   proxy_->setSourceModel(this);
   queue_->setSourceModel(this);
 
@@ -1336,17 +1337,30 @@ void Playlist::Restore() {
   items_.clear();
   virtual_items_.clear();
   library_items_by_id_.clear();
+  pending_cue_items_.clear();
+
+  // Don't let anything overwrite the saved playlist before it's been loaded.
+  is_loading_ = true;
+  restore_time_.start();
 
   PlaylistBackend::PlaylistItemFuture future = backend_->GetPlaylistItems(id_);
   PlaylistItemFutureWatcher* watcher = new PlaylistItemFutureWatcher(this);
   watcher->setFuture(future);
   connect(watcher, SIGNAL(finished()), SLOT(ItemsLoaded()));
+  if (Tracer::is_enabled()) {
+    Tracer::AddEventUntil(watcher, SIGNAL(finished()), "playlist",
+                          "Load playlist items", QString::number(id_));
+  }
 }
 
 void Playlist::ItemsLoaded() {
   PlaylistItemFutureWatcher* watcher = static_cast<PlaylistItemFutureWatcher*>(sender());
   watcher->deleteLater();
 
+  TraceScope trace("playlist", "Playlist::ItemsLoaded");
+  if (trace.is_recording())
+    trace.set_detail(QString::number(id_));
+
   PlaylistItemList items = watcher->future().results();
 
   // backend returns empty elements for library items which it couldn't 
@@ -1357,6 +1371,8 @@ void Playlist::ItemsLoaded() {
 
     if (item->IsLocalLibraryItem() && item->Metadata().url().isEmpty()) {
       it.remove();
+    } else if (item->type() == "File" && item->Metadata().has_cue()) {
+      pending_cue_items_ << item;
     }
   }
 
@@ -1364,6 +1380,9 @@ void Playlist::ItemsLoaded() {
   InsertItems(items, 0);
   is_loading_ = false;
 
+  qLog(Debug) << "Restored" << items.count() << "items in playlist" << id_
+              << "in" << restore_time_.elapsed() << "ms";
+
   PlaylistBackend::Playlist p = backend_->GetPlaylist(id_);
 
   // the newly loaded list of items might be shorter than it was before so
@@ -1401,6 +1420,60 @@ void Playlist::ItemsLoaded() {
   if(s.value("greyoutdeleted", false).toBool()) {
     QtConcurrent::run(this, &Playlist::InvalidateDeletedSongs);
   }
+
+  RestoreMoreCueData();
+}
+
+void Playlist::RestoreMoreCueData() {
+  // Only one chunk at a time, so the other playlists get a turn.
+  if (!restoring_cue_items_.isEmpty() || pending_cue_items_.isEmpty())
+    return;
+
+  restoring_cue_items_ = pending_cue_items_.mid(0, kCueRestoreChunkSize);
+  pending_cue_items_ = pending_cue_items_.mid(restoring_cue_items_.count());
+
+  PlaylistBackend::PlaylistItemFuture future =
+      backend_->RestoreCueData(restoring_cue_items_);
+  PlaylistItemFutureWatcher* watcher = new PlaylistItemFutureWatcher(this);
+  watcher->setFuture(future);
+  connect(watcher, SIGNAL(finished()), SLOT(CueDataRestored()));
+}
+
+void Playlist::CueDataRestored() {
+  PlaylistItemFutureWatcher* watcher = static_cast<PlaylistItemFutureWatcher*>(sender());
+  watcher->deleteLater();
+
+  const PlaylistItemList restored = watcher->future().results();
+  const PlaylistItemList originals = restoring_cue_items_;
+  restoring_cue_items_.clear();
+
+  // The user might have moved or removed some of the items in the meantime,
+  // so look them up again.
+  QHash<PlaylistItem*, int> rows;
+  for (int i=0 ; i<restored.count() && i<originals.count() ; ++i) {
+    if (restored[i] == originals[i])
+      continue;
+
+    if (rows.isEmpty()) {
+      for (int row=0 ; row<items_.count() ; ++row) {
+        rows[items_[row].get()] = row;
+      }
+    }
+
+    const int row = rows.value(originals[i].get(), -1);
+    if (row == -1)
+      continue;
+
+    items_[row] = restored[i];
+    emit dataChanged(index(row, 0), index(row, ColumnCount-1));
+  }
+
+  if (pending_cue_items_.isEmpty()) {
+    qLog(Debug) << "Finished restoring CUE data in playlist" << id_
+                << "after" << restore_time_.elapsed() << "ms";
+  } else {
+    RestoreMoreCueData();
+  }
 }
 
 static bool DescendingIntLessThan(int a, int b) {
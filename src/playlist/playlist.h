@@ -20,6 +20,7 @@
 
 #include <QAbstractItemModel>
 #include <QList>
+#include <QTime>
 
 #include <boost/shared_ptr.hpp>
 
@@ -155,6 +156,7 @@ class Playlist : public QAbstractListModel {
 
   static const int kUndoStackSize;
   static const int kUndoItemLimit;
+  static const int kCueRestoreChunkSize;
 
   static bool CompareItems(int column, Qt::SortOrder order,
                            PlaylistItemPtr a, PlaylistItemPtr b);
@@ -167,6 +169,9 @@ class Playlist : public QAbstractListModel {
 
   // Persistence
   void Save() const;
+
+  // Loads the items from the database.  Metadata from CUE sheets is filled in
+  // afterwards, a chunk of items at a time, so big playlists appear quickly.
   void Restore();
 
   // Accessors
@@ -353,6 +358,8 @@ class Playlist : public QAbstractListModel {
   void SongSaveComplete(TagReaderReply* reply, const QPersistentModelIndex& index);
   void ItemReloadComplete();
   void ItemsLoaded();
+  void RestoreMoreCueData();
+  void CueDataRestored();
   void SongInsertVetoListenerDestroyed();
 
  private:
@@ -401,6 +408,12 @@ class Playlist : public QAbstractListModel {
   QList<SongInsertVetoListener*> veto_listeners_;
 
   QString special_type_;
+
+  // File items with a CUE sheet that still need their metadata restoring, and
+  // the ones being restored at the moment.
+  PlaylistItemList pending_cue_items_;
+  PlaylistItemList restoring_cue_items_;
+  QTime restore_time_;
 };
 
 //QDataStream& operator <<(QDataStream&, const Playlist*);
@@ -19,17 +19,23 @@
 #include "core/application.h"
 #include "core/database.h"
 #include "core/scopedtransaction.h"
+#include "core/logging.h"
 #include "core/song.h"
+#include "core/tracer.h"
+#include "internet/jamendoservice.h"
+#include "internet/magnatuneservice.h"
+#include "library/library.h"
 #include "library/librarybackend.h"
 #include "library/sqlrow.h"
 #include "playlist/songplaylistitem.h"
-#include "playlistparsers/cueparser.h"
+#include "playlistparsers/cuecache.h"
 #include "smartplaylists/generator.h"
 
 #include <QFile>
 #include <QHash>
 #include <QMutexLocker>
 #include <QSqlQuery>
+#include <QTime>
 #include <QtConcurrentMap>
 #include <QtDebug>
 
@@ -39,7 +45,8 @@ using smart_playlists::GeneratorPtr;
 
 using boost::shared_ptr;
 
-const int PlaylistBackend::kSongTableJoins = 4;
+const int PlaylistBackend::kSongTableJoins = 2;
+const int PlaylistBackend::kLibraryIdsPerQuery = 500;
 
 PlaylistBackend::PlaylistBackend(Application* app, QObject* parent)
   : QObject(parent),
@@ -48,6 +55,13 @@ PlaylistBackend::PlaylistBackend(Application* app, QObject* parent)
 {
 }
 
+PlaylistBackend::PlaylistBackend(Database* db, QObject* parent)
+  : QObject(parent),
+    app_(NULL),
+    db_(db)
+{
+}
+
 PlaylistBackend::PlaylistList PlaylistBackend::GetAllPlaylists() {
   return GetPlaylists(GetPlaylists_All);
 }
@@ -136,84 +150,163 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
 }
 
 QList<SqlRow> PlaylistBackend::GetPlaylistRows(int playlist) {
+  TraceScope trace("database", "PlaylistBackend::GetPlaylistRows");
+  if (trace.is_recording())
+    trace.set_detail(QString::number(playlist));
+
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QString query = "SELECT songs.ROWID, " + Song::JoinSpec("songs") + ","
-                  "       magnatune_songs.ROWID, " + Song::JoinSpec("magnatune_songs") + ","
-                  "       jamendo_songs.ROWID, " + Song::JoinSpec("jamendo_songs") + ","
-                  "       p.ROWID, " + Song::JoinSpec("p") + ","
-                  "       p.type, p.radio_service"
-                  " FROM playlist_items AS p"
-                  " LEFT JOIN songs"
-                  "    ON p.library_id = songs.ROWID"
-                  " LEFT JOIN magnatune_songs"
-                  "    ON p.library_id = magnatune_songs.ROWID"
-                  " LEFT JOIN jamendo.songs AS jamendo_songs"
-                  "    ON p.library_id = jamendo_songs.ROWID"
-                  " WHERE p.playlist = :playlist";
-  QSqlQuery q(query, db);
+  QTime t;
+  t.start();
 
+  // Get the items on their own first.  Joining them with all the songs tables
+  // would return a copy of the song columns for each table, and the Jamendo
+  // catalogue is huge.
+  QSqlQuery q("SELECT p.ROWID, " + Song::JoinSpec("p") + ","
+              "       p.type, p.radio_service, p.library_id"
+              " FROM playlist_items AS p"
+              " WHERE p.playlist = :playlist", db);
   q.bindValue(":playlist", playlist);
   q.exec();
   if (db_->CheckErrors(q))
     return QList<SqlRow>();
 
-  QList<SqlRow> rows;
+  const int type_column = Song::kColumns.count() + 1;
+  const int library_id_column = type_column + 2;
+
+  QList<QList<QVariant> > items;
+  QList<QString> tables;
+  QList<int> library_ids;
+  QMap<QString, QList<int> > ids_by_table;
 
   while (q.next()) {
-    rows << SqlRow(q);
+    QList<QVariant> columns;
+    for (int i=0 ; i<library_id_column ; ++i) {
+      columns << q.value(i);
+    }
+
+    // Only these types of item refer to a row in a songs table.
+    const QString type = q.value(type_column).toString();
+    QString table;
+    if (type == "Library")
+      table = Library::kSongsTable;
+    else if (type == "Magnatune")
+      table = MagnatuneService::kSongsTable;
+    else if (type == "Jamendo")
+      table = JamendoService::kSongsTable;
+
+    const int library_id = q.value(library_id_column).toInt();
+    if (!table.isEmpty()) {
+      ids_by_table[table] << library_id;
+    }
+
+    items << columns;
+    tables << table;
+    library_ids << library_id;
+  }
+
+  // Now get the songs from each table in batches.
+  QMap<QString, QHash<int, QList<QVariant> > > library_rows;
+  for (QMap<QString, QList<int> >::const_iterator it = ids_by_table.begin() ;
+       it != ids_by_table.end() ; ++it) {
+    library_rows[it.key()] = GetLibraryRows(it.key(), it.value(), db);
+  }
+
+  // Songs that aren't in their table any more get NULLs, like they did with a
+  // LEFT JOIN.
+  QList<QVariant> missing_song;
+  for (int i=0 ; i<Song::kColumns.count() + 1 ; ++i) {
+    missing_song << QVariant();
+  }
+
+  QList<SqlRow> rows;
+  for (int i=0 ; i<items.count() ; ++i) {
+    QList<QVariant> columns = missing_song;
+    if (!tables[i].isEmpty()) {
+      const QHash<int, QList<QVariant> >& table_rows = library_rows[tables[i]];
+      if (table_rows.contains(library_ids[i]))
+        columns = table_rows[library_ids[i]];
+    }
+
+    rows << SqlRow(columns + items[i]);
   }
 
+  qLog(Debug) << "Fetched" << rows.count() << "items of playlist" << playlist
+              << "in" << t.elapsed() << "ms";
+
   return rows;
 }
 
+QHash<int, QList<QVariant> > PlaylistBackend::GetLibraryRows(
+    const QString& table, const QList<int>& ids, QSqlDatabase& db) {
+  QHash<int, QList<QVariant> > ret;
+
+  for (int i=0 ; i<ids.count() ; i += kLibraryIdsPerQuery) {
+    QStringList str_ids;
+    foreach (int id, ids.mid(i, kLibraryIdsPerQuery)) {
+      str_ids << QString::number(id);
+    }
+
+    QSqlQuery q(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1"
+                        " WHERE ROWID IN (%2)").arg(table, str_ids.join(",")),
+                db);
+    q.exec();
+    if (db_->CheckErrors(q))
+      return ret;
+
+    while (q.next()) {
+      QList<QVariant> columns;
+      for (int j=0 ; j<Song::kColumns.count() + 1 ; ++j) {
+        columns << q.value(j);
+      }
+      ret[q.value(0).toInt()] = columns;
+    }
+  }
+
+  return ret;
+}
+
 QFuture<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
   QMutexLocker l(db_->Mutex());
   QList<SqlRow> rows = GetPlaylistRows(playlist);
 
-  // it's probable that we'll have a few songs associated with the
-  // same CUE so we're caching results of parsing CUEs
-  boost::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
-  return QtConcurrent::mapped(rows, boost::bind(&PlaylistBackend::NewPlaylistItemFromQuery, this, _1, state_ptr));
+  return QtConcurrent::mapped(rows, boost::bind(&PlaylistBackend::NewPlaylistItemFromQuery, this, _1));
+}
+
+QFuture<PlaylistItemPtr> PlaylistBackend::RestoreCueData(const PlaylistItemList& items) {
+  return QtConcurrent::mapped(items, boost::bind(&PlaylistBackend::RestoreCueDataForItem, this, _1));
 }
 
 QFuture<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
   QMutexLocker l(db_->Mutex());
   QList<SqlRow> rows = GetPlaylistRows(playlist);
 
-  // it's probable that we'll have a few songs associated with the
-  // same CUE so we're caching results of parsing CUEs
-  boost::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
-  return QtConcurrent::mapped(rows, boost::bind(&PlaylistBackend::NewSongFromQuery, this, _1, state_ptr));
+  return QtConcurrent::mapped(rows, boost::bind(&PlaylistBackend::NewSongFromQuery, this, _1));
 }
 
-PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(const SqlRow& row, boost::shared_ptr<NewSongFromQueryState> state) {
-  // The song tables get joined first, plus one each for the song ROWIDs
+PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(const SqlRow& row) {
+  // The library song and the item's own song come first, with their ROWIDs
   const int playlist_row = (Song::kColumns.count() + 1) * kSongTableJoins;
 
   PlaylistItemPtr item(PlaylistItem::NewFromType(row.value(playlist_row).toString()));
   if (item) {
     item->InitFromQuery(row);
-    return RestoreCueData(item, state);
-  } else {
-    return item;
   }
+  return item;
 }
 
-Song PlaylistBackend::NewSongFromQuery(const SqlRow& row, boost::shared_ptr<NewSongFromQueryState> state) {
-  return NewPlaylistItemFromQuery(row, state)->Metadata();
+Song PlaylistBackend::NewSongFromQuery(const SqlRow& row) {
+  return RestoreCueDataForItem(NewPlaylistItemFromQuery(row))->Metadata();
 }
 
 // If song had a CUE and the CUE still exists, the metadata from it will
 // be applied here.
-PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, boost::shared_ptr<NewSongFromQueryState> state) {
-  // we need library to run a CueParser; also, this method applies only to
-  // file-type PlaylistItems
-  if(item->type() != "File") {
+PlaylistItemPtr PlaylistBackend::RestoreCueDataForItem(PlaylistItemPtr item) {
+  // this method applies only to file-type PlaylistItems
+  if(!item || item->type() != "File") {
     return item;
   }
-  CueParser cue_parser(app_->library_backend());
 
   Song song = item->Metadata();
   // we're only interested in .cue songs here
@@ -222,26 +315,18 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, boost::sha
   }
 
   QString cue_path = song.cue_path();
-  // if .cue was deleted - reload the song
+  // if .cue was deleted - reload the song.  The item might already be in a
+  // playlist so we reload a copy of it.
   if(!QFile::exists(cue_path)) {
-    item->Reload();
-    return item;
+    PlaylistItemPtr reloaded(new SongPlaylistItem(song));
+    reloaded->Reload();
+    return reloaded;
   }
 
-  SongList song_list;
-  {
-    QMutexLocker locker(&state->mutex_);
-
-    if(!state->cached_cues_.contains(cue_path)) {
-      QFile cue(cue_path);
-      cue.open(QIODevice::ReadOnly);
-
-      song_list = cue_parser.Load(&cue, cue_path, QDir(cue_path.section('/', 0, -2)));
-      state->cached_cues_[cue_path] = song_list;
-    } else {
-      song_list = state->cached_cues_[cue_path];
-    }
-  }
+  // it's probable that we'll have a few songs associated with the
+  // same CUE, and that the CUE was parsed before, so use the shared cache
+  const SongList song_list = CueCache::Instance()->Load(
+      cue_path, app_ ? app_->library_backend() : NULL);
 
   foreach(const Song& from_list, song_list) {
     if(from_list.url().toEncoded() == song.url().toEncoded() &&
@@ -253,8 +338,9 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, boost::sha
   }
 
   // there's no such section in the related .cue -> reload the song
-  item->Reload();
-  return item;
+  PlaylistItemPtr reloaded(new SongPlaylistItem(song));
+  reloaded->Reload();
+  return reloaded;
 }
 
 void PlaylistBackend::SavePlaylistAsync(int playlist, const PlaylistItemList &items,
@@ -268,6 +354,10 @@ void PlaylistBackend::SavePlaylistAsync(int playlist, const PlaylistItemList &it
 
 void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
                                    int last_played, GeneratorPtr dynamic) {
+  TraceScope trace("database", "PlaylistBackend::SavePlaylist");
+  if (trace.is_recording())
+    trace.set_detail(QString::number(playlist));
+
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
@@ -19,9 +19,7 @@
 #define PLAYLISTBACKEND_H
 
 #include <QFuture>
-#include <QHash>
 #include <QList>
-#include <QMutex>
 #include <QObject>
 
 #include "playlistitem.h"
@@ -35,6 +33,7 @@ class PlaylistBackend : public QObject {
 
  public:
   Q_INVOKABLE PlaylistBackend(Application* app, QObject* parent = 0);
+  PlaylistBackend(Database* db, QObject* parent = 0);
 
   struct Playlist {
     Playlist()
@@ -59,15 +58,29 @@ class PlaylistBackend : public QObject {
   typedef QList<Playlist> PlaylistList;
   typedef QFuture<PlaylistItemPtr> PlaylistItemFuture;
 
+  // Rows for playlist items start with the ROWID and columns of the library
+  // song they refer to - empty if they don't refer to one - followed by the
+  // ROWID and song columns of the item itself, its type and radio service.
   static const int kSongTableJoins;
+  static const int kLibraryIdsPerQuery;
 
   PlaylistList GetAllPlaylists();
   PlaylistList GetAllOpenPlaylists();
   PlaylistList GetAllFavoritePlaylists();
   PlaylistBackend::Playlist GetPlaylist(int id);
+
+  // Loads the items without applying any metadata from their CUE sheets, so
+  // big playlists can be shown quickly.  Pass the items to RestoreCueData
+  // afterwards to get the rest.
   PlaylistItemFuture GetPlaylistItems(int playlist);
   QFuture<Song> GetPlaylistSongs(int playlist);
 
+  // Returns the items with the metadata from their CUE sheets applied.  Items
+  // that didn't need changing are returned as they are, the others are
+  // replaced by new items - the ones passed in are never modified, so it's
+  // safe to call this on items that are already in a playlist.
+  PlaylistItemFuture RestoreCueData(const PlaylistItemList& items);
+
   void SetPlaylistOrder(const QList<int>& ids);
   void SetPlaylistUiPath(int id, const QString& path);
 
@@ -83,16 +96,16 @@ class PlaylistBackend : public QObject {
                     int last_played, smart_playlists::GeneratorPtr dynamic);
 
  private:
-  struct NewSongFromQueryState {
-    QHash<QString, SongList> cached_cues_;
-    QMutex mutex_;
-  };
-
   QList<SqlRow> GetPlaylistRows(int playlist);
 
-  Song NewSongFromQuery(const SqlRow& row, boost::shared_ptr<NewSongFromQueryState> state);
-  PlaylistItemPtr NewPlaylistItemFromQuery(const SqlRow& row, boost::shared_ptr<NewSongFromQueryState> state);
-  PlaylistItemPtr RestoreCueData(PlaylistItemPtr item, boost::shared_ptr<NewSongFromQueryState> state);
+  // Returns the ROWID and song columns of these rows of a songs table, keyed
+  // by ROWID.  Must be called with the database mutex held.
+  QHash<int, QList<QVariant> > GetLibraryRows(
+      const QString& table, const QList<int>& ids, QSqlDatabase& db);
+
+  Song NewSongFromQuery(const SqlRow& row);
+  PlaylistItemPtr NewPlaylistItemFromQuery(const SqlRow& row);
+  PlaylistItemPtr RestoreCueDataForItem(PlaylistItemPtr item);
 
   enum GetPlaylistsFlags {
     GetPlaylists_OpenInUi = 1,
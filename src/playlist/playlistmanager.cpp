@@ -34,10 +34,13 @@
 #include <QFuture>
 #include <QFutureWatcher>
 #include <QMessageBox>
+#include <QTimer>
 #include <QtDebug>
 
 using smart_playlists::GeneratorPtr;
 
+const int PlaylistManager::kRestoreBudgetMs = 2000;
+
 PlaylistManager::PlaylistManager(Application* app, QObject *parent)
   : PlaylistManagerInterface(app, parent),
     app_(app),
@@ -75,17 +78,44 @@ void PlaylistManager::Init(LibraryBackend* library_backend,
   connect(library_backend_, SIGNAL(SongsStatisticsChanged(SongList)), SLOT(SongsDiscovered(SongList)));
   connect(library_backend_, SIGNAL(SongsRatingChanged(SongList)), SLOT(SongsDiscovered(SongList)));
 
+  QList<int> restore_ids;
   foreach (const PlaylistBackend::Playlist& p, playlist_backend->GetAllOpenPlaylists()) {
     AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+    restore_ids << p.id;
   }
 
   // If no playlist exists then make a new one
   if (playlists_.isEmpty())
     New(tr("Playlist"));
 
+  RestorePlaylists(restore_ids);
+
   emit PlaylistManagerInitialized();
 }
 
+void PlaylistManager::RestorePlaylists(QList<int> ids) {
+  // Load the active playlist on its own first so it's usable as soon as
+  // possible.  The others don't need to compete with it for the database and
+  // the thread pool.
+  if (ids.removeAll(active_)) {
+    connect(active(), SIGNAL(RestoreFinished()),
+            SLOT(RestoreBackgroundPlaylists()));
+    active()->Restore();
+  }
+
+  background_restore_ids_ = ids;
+  QTimer::singleShot(kRestoreBudgetMs, this, SLOT(RestoreBackgroundPlaylists()));
+}
+
+void PlaylistManager::RestoreBackgroundPlaylists() {
+  foreach (int id, background_restore_ids_) {
+    if (playlists_.contains(id)) {
+      playlist(id)->Restore();
+    }
+  }
+  background_restore_ids_.clear();
+}
+
 QList<Playlist*> PlaylistManager::GetAllPlaylists() const {
   QList<Playlist*> result;
 
@@ -321,6 +351,12 @@ void PlaylistManager::OneOfPlaylistsChanged() {
 
 void PlaylistManager::SetCurrentPlaylist(int id) {
   Q_ASSERT(playlists_.contains(id));
+
+  // The user wants to see this one now, so don't wait for the active playlist.
+  if (background_restore_ids_.removeAll(id)) {
+    playlist(id)->Restore();
+  }
+
   current_ = id;
   emit CurrentChanged(current());
   UpdateSummaryText();
@@ -539,7 +575,8 @@ void PlaylistManager::Open(int id) {
     return;
   }
 
-  AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+  Playlist* ret = AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+  ret->Restore();
 }
 
 void PlaylistManager::SetCurrentOrOpen(int id) {
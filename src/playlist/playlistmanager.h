@@ -157,6 +157,10 @@ public:
   // songs.
   static QString GetNameForNewPlaylist(const SongList& songs);
 
+  // The other playlists are restored after the active one, or after this long
+  // if the active one is taking too much time.
+  static const int kRestoreBudgetMs;
+
   QItemSelection selection(int id) const;
   QItemSelection current_selection() const { return selection(current_id()); }
   QItemSelection active_selection() const { return selection(active_id()); }
@@ -225,10 +229,12 @@ private slots:
   void SongsDiscovered(const SongList& songs);
   void LoadFinished(bool success);
   void ItemsLoadedForSavePlaylist(QFutureWatcher<Song>* watcher, const QString& filename);
+  void RestoreBackgroundPlaylists();
 
 private:
   Playlist* AddPlaylist(int id, const QString& name, const QString& special_type,
                         const QString& ui_path, bool favorite);
+  void RestorePlaylists(QList<int> ids);
 
 private:
   struct Data {
@@ -252,6 +258,9 @@ private:
 
   int current_;
   int active_;
+
+  // Playlists that will be restored once the active one has finished loading.
+  QList<int> background_restore_ids_;
 };
 
 #endif // PLAYLISTMANAGER_H
@@ -51,6 +51,8 @@ const int PlaylistView::kGlowIntensitySteps = 24;
 const int PlaylistView::kAutoscrollGraceTimeout = 30; // seconds
 const int PlaylistView::kDropIndicatorWidth = 2;
 const int PlaylistView::kDropIndicatorGradientWidth = 5;
+const int PlaylistView::kRowCacheSizeKb = 16 * 1024;
+const int PlaylistView::kFrameStatsIntervalMs = 10000;
 const char* PlaylistView::kSettingBackgroundImageType = "playlistview_background_type";
 const char* PlaylistView::kSettingBackgroundImageFilename = "playlistview_background_image_file";
 
@@ -124,6 +126,12 @@ PlaylistView::PlaylistView(QWidget *parent)
     currenttrack_play_(":currenttrack_play.png"),
     currenttrack_pause_(":currenttrack_pause.png"),
     cached_current_row_row_(-1),
+    cached_rows_(kRowCacheSizeKb),
+    frame_count_(0),
+    frame_total_ms_(0),
+    frame_max_ms_(0),
+    rows_drawn_(0),
+    rows_from_cache_(0),
     drop_indicator_row_(-1),
     drag_over_(false),
     dynamic_controls_(new DynamicPlaylistControls(this))
@@ -140,6 +148,9 @@ PlaylistView::PlaylistView(QWidget *parent)
   connect(header_, SIGNAL(sectionResized(int,int,int)), SLOT(InvalidateCachedCurrentPixmap()));
   connect(header_, SIGNAL(sectionMoved(int,int,int)), SLOT(InvalidateCachedCurrentPixmap()));
   connect(header_, SIGNAL(SectionVisibilityChanged(int,bool)), SLOT(InvalidateCachedCurrentPixmap()));
+  connect(header_, SIGNAL(sectionResized(int,int,int)), SLOT(InvalidateCachedRows()));
+  connect(header_, SIGNAL(sectionMoved(int,int,int)), SLOT(InvalidateCachedRows()));
+  connect(header_, SIGNAL(SectionVisibilityChanged(int,bool)), SLOT(InvalidateCachedRows()));
   connect(header_, SIGNAL(StretchEnabledChanged(bool)), SLOT(SaveSettings()));
   connect(header_, SIGNAL(StretchEnabledChanged(bool)), SLOT(StretchChanged(bool)));
   connect(header_, SIGNAL(MouseEntered()), SLOT(RatingHoverOut()));
@@ -258,11 +269,20 @@ void PlaylistView::setModel(QAbstractItemModel *m) {
                this, SLOT(InvalidateCachedCurrentPixmap()));
     disconnect(model(), SIGNAL(layoutAboutToBeChanged()),
                this, SLOT(RatingHoverOut()));
+    disconnect(model(), SIGNAL(rowsRemoved(QModelIndex,int,int)),
+               this, SLOT(InvalidateCachedRows()));
+    disconnect(model(), SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)),
+               this, SLOT(InvalidateCachedRows()));
+    disconnect(model(), SIGNAL(layoutChanged()),
+               this, SLOT(InvalidateCachedRows()));
+    disconnect(model(), SIGNAL(modelReset()),
+               this, SLOT(InvalidateCachedRows()));
     // When changing the model, always invalidate the current pixmap.
     // If a remote client uses "stop after", without invaliding the stop
     // mark would not appear.
     InvalidateCachedCurrentPixmap();
   }
+  InvalidateCachedRows();
 
   QTreeView::setModel(m);
 
@@ -270,6 +290,17 @@ void PlaylistView::setModel(QAbstractItemModel *m) {
           this, SLOT(InvalidateCachedCurrentPixmap()));
   connect(model(), SIGNAL(layoutAboutToBeChanged()),
           this, SLOT(RatingHoverOut()));
+
+  // The row cache is keyed by row number, so anything that moves rows around
+  // makes it useless.
+  connect(model(), SIGNAL(rowsRemoved(QModelIndex,int,int)),
+          this, SLOT(InvalidateCachedRows()));
+  connect(model(), SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)),
+          this, SLOT(InvalidateCachedRows()));
+  connect(model(), SIGNAL(layoutChanged()),
+          this, SLOT(InvalidateCachedRows()));
+  connect(model(), SIGNAL(modelReset()),
+          this, SLOT(InvalidateCachedRows()));
 }
 
 void PlaylistView::LoadGeometry() {
@@ -464,10 +495,111 @@ void PlaylistView::drawRow(QPainter* painter, const QStyleOptionViewItem& option
       }
     }
   } else {
-    QTreeView::drawRow(painter, opt, index);
+    const_cast<PlaylistView*>(this)->DrawCachedRow(painter, opt, index);
   }
 }
 
+void PlaylistView::DrawCachedRow(QPainter* painter,
+                                 const QStyleOptionViewItemV4& option,
+                                 const QModelIndex& index) {
+  rows_drawn_ ++;
+
+  // QTreeView draws these rows differently, and there are only ever a few of
+  // them on screen, so don't bother caching them.
+  const int row = index.row();
+  if (row == hover_index_.row() || row == currentIndex().row() ||
+      selectionModel()->rowIntersectsSelection(row, index.parent())) {
+    QTreeView::drawRow(painter, option, index);
+    return;
+  }
+
+  const QPixmap* cached = cached_rows_.object(row);
+  if (cached && cached->size() == option.rect.size()) {
+    painter->drawPixmap(option.rect.topLeft(), *cached);
+    rows_from_cache_ ++;
+    return;
+  }
+
+  // Like for the current row, we can only fill the cache when QTreeView is
+  // drawing every column.
+  if (current_paint_region_.boundingRect().width() != viewport()->width()) {
+    QTreeView::drawRow(painter, option, index);
+    return;
+  }
+
+  QStyleOptionViewItemV4 opt(option);
+  opt.rect.moveTo(0, 0);
+
+  QPixmap* pixmap = new QPixmap(opt.rect.size());
+  pixmap->fill(Qt::transparent);
+  {
+    QPainter p(pixmap);
+    QTreeView::drawRow(&p, opt, index);
+  }
+  painter->drawPixmap(option.rect.topLeft(), *pixmap);
+
+  // The cache might delete the pixmap straight away if it's too big.
+  const int cost_kb = qMax(1, pixmap->width() * pixmap->height() * 4 / 1024);
+  cached_rows_.insert(row, pixmap, cost_kb);
+}
+
+void PlaylistView::RemoveCachedRows(int first, int last) {
+  if (last - first >= cached_rows_.count()) {
+    foreach (int row, cached_rows_.keys()) {
+      if (row >= first && row <= last)
+        cached_rows_.remove(row);
+    }
+  } else {
+    for (int row = first ; row <= last ; ++row) {
+      cached_rows_.remove(row);
+    }
+  }
+}
+
+void PlaylistView::InvalidateCachedRows() {
+  cached_rows_.clear();
+}
+
+void PlaylistView::dataChanged(const QModelIndex& top_left,
+                               const QModelIndex& bottom_right) {
+  RemoveCachedRows(top_left.row(), bottom_right.row());
+
+  // QAbstractItemView repaints the whole viewport when more than one index
+  // changes, which happens every time the playlist updates a row.  Let it do
+  // that only when it has to: if an editor needs the new data, or if the
+  // first row changed, because QTreeView uses its size for every row.
+  if (top_left == bottom_right || !isVisible() || state() == EditingState ||
+      !uniformRowHeights() || top_left.row() == 0) {
+    QTreeView::dataChanged(top_left, bottom_right);
+    return;
+  }
+
+  // Only repaint the rows that are on screen.
+  const int first_visible = indexAt(QPoint(0, 0)).row();
+  if (first_visible == -1)
+    return;
+  int last_visible = indexAt(QPoint(0, viewport()->height() - 1)).row();
+  if (last_visible == -1)
+    last_visible = model()->rowCount(rootIndex()) - 1;
+
+  const int top = qMax(top_left.row(), first_visible);
+  const int bottom = qMin(bottom_right.row(), last_visible);
+  if (top > bottom)
+    return;
+
+  QRect rect;
+  for (int column = top_left.column() ; column <= bottom_right.column() ; ++column) {
+    if (isColumnHidden(column))
+      continue;
+    rect |= visualRect(top_left.sibling(top, column));
+    rect |= visualRect(top_left.sibling(bottom, column));
+  }
+
+  rect &= viewport()->rect();
+  if (!rect.isEmpty())
+    viewport()->update(rect);
+}
+
 void PlaylistView::UpdateCachedCurrentRowPixmap(QStyleOptionViewItemV4 option,
                                                 const QModelIndex& index) {
   cached_current_row_rect_ = option.rect;
@@ -766,6 +898,7 @@ void PlaylistView::mousePressEvent(QMouseEvent* event) {
 void PlaylistView::scrollContentsBy(int dx, int dy) {
   if (dx) {
     InvalidateCachedCurrentPixmap();
+    InvalidateCachedRows();
   }
   cached_tree_ = QPixmap();
 
@@ -834,7 +967,58 @@ void PlaylistView::JumpToLastPlayedTrack() {
   currently_autoscrolling_ = false;
 }
 
+bool PlaylistView::viewportEvent(QEvent* event) {
+  // Keep track of the row QTreeView highlights under the mouse.
+  switch (event->type()) {
+    case QEvent::HoverEnter:
+    case QEvent::HoverMove:
+      hover_index_ = indexAt(static_cast<QHoverEvent*>(event)->pos());
+      break;
+
+    case QEvent::HoverLeave:
+      hover_index_ = QModelIndex();
+      break;
+
+    default:
+      break;
+  }
+
+  return QTreeView::viewportEvent(event);
+}
+
 void PlaylistView::paintEvent(QPaintEvent* event) {
+  QTime time;
+  time.start();
+
+  PaintViewport(event);
+
+  RecordFrame(time.elapsed());
+}
+
+void PlaylistView::RecordFrame(int elapsed_ms) {
+  if (frame_count_ == 0)
+    frame_stats_time_.start();
+
+  frame_count_ ++;
+  frame_total_ms_ += elapsed_ms;
+  frame_max_ms_ = qMax(frame_max_ms_, elapsed_ms);
+
+  if (frame_stats_time_.elapsed() < kFrameStatsIntervalMs)
+    return;
+
+  qLog(Debug) << "Painted" << frame_count_ << "frames, average"
+              << frame_total_ms_ / frame_count_ << "ms, slowest"
+              << frame_max_ms_ << "ms," << rows_from_cache_ << "of"
+              << rows_drawn_ << "rows from the cache";
+
+  frame_count_ = 0;
+  frame_total_ms_ = 0;
+  frame_max_ms_ = 0;
+  rows_drawn_ = 0;
+  rows_from_cache_ = 0;
+}
+
+void PlaylistView::PaintViewport(QPaintEvent* event) {
   // Reimplemented to draw the background image.
   // Reimplemented also to draw the drop indicator
   // When the user is dragging some stuff over the playlist paintEvent gets
@@ -1070,6 +1254,9 @@ void PlaylistView::ReloadSettings() {
     emit BackgroundPropertyChanged();
     force_background_redraw_ = true;
   }
+
+  // The stylesheet might draw the rows differently now.
+  InvalidateCachedRows();
 }
 
 void PlaylistView::SaveSettings() {
@@ -1121,6 +1308,7 @@ bool PlaylistView::eventFilter(QObject* object, QEvent* event) {
 
 void PlaylistView::rowsInserted(const QModelIndex& parent, int start, int end) {
   const bool at_end = end == model()->rowCount(parent) - 1;
+  InvalidateCachedRows();
 
   QTreeView::rowsInserted(parent, start, end);
 
@@ -21,7 +21,9 @@
 #include "playlist.h"
 
 #include <QBasicTimer>
+#include <QCache>
 #include <QProxyStyle>
+#include <QTime>
 #include <QTreeView>
 
 #include <boost/scoped_ptr.hpp>
@@ -137,10 +139,15 @@ class PlaylistView : public QTreeView {
 
   // QAbstractScrollArea
   void scrollContentsBy(int dx, int dy);
+  bool viewportEvent(QEvent* event);
 
   // QAbstractItemView
   void rowsInserted(const QModelIndex& parent, int start, int end);
 
+ protected slots:
+  // QAbstractItemView
+  void dataChanged(const QModelIndex& top_left, const QModelIndex& bottom_right);
+
  private slots:
   void LoadGeometry();
   void SaveGeometry();
@@ -148,6 +155,7 @@ class PlaylistView : public QTreeView {
   void InhibitAutoscrollTimeout();
   void MaybeAutoscroll();
   void InvalidateCachedCurrentPixmap();
+  void InvalidateCachedRows();
   void PlaylistDestroyed();
 
   void SaveSettings();
@@ -164,6 +172,14 @@ class PlaylistView : public QTreeView {
   void UpdateCachedCurrentRowPixmap(QStyleOptionViewItemV4 option,
                                     const QModelIndex& index);
 
+  // Draws a row that isn't the current one, from the row cache if possible.
+  void DrawCachedRow(QPainter* painter, const QStyleOptionViewItemV4& option,
+                     const QModelIndex& index);
+  void RemoveCachedRows(int first, int last);
+
+  void PaintViewport(QPaintEvent* event);
+  void RecordFrame(int elapsed_ms);
+
   void set_background_image_type(BackgroundImageType bg) { background_image_type_ = bg; emit BackgroundPropertyChanged(); }
   // Save image as the background_image_ after applying some modifications (opacity, ...).
   // Should be used instead of modifying background_image_ directly
@@ -174,6 +190,8 @@ class PlaylistView : public QTreeView {
   static const int kAutoscrollGraceTimeout;
   static const int kDropIndicatorWidth;
   static const int kDropIndicatorGradientWidth;
+  static const int kRowCacheSizeKb;
+  static const int kFrameStatsIntervalMs;
 
   QList<int> GetEditableColumns();
   QModelIndex NextEditableIndex(const QModelIndex& current);
@@ -237,6 +255,19 @@ class PlaylistView : public QTreeView {
   QRect cached_current_row_rect_;
   int cached_current_row_row_;
 
+  // Rendered rows, keyed by row number.  Only rows that don't depend on the
+  // selection, the keyboard focus or the mouse are cached.
+  QCache<int, QPixmap> cached_rows_;
+  QPersistentModelIndex hover_index_;
+
+  // Paint timings, logged every kFrameStatsIntervalMs.
+  QTime frame_stats_time_;
+  int frame_count_;
+  int frame_total_ms_;
+  int frame_max_ms_;
+  int rows_drawn_;
+  int rows_from_cache_;
+
   QPixmap cached_tree_;
   int drop_indicator_row_;
   bool drag_over_;
@@ -37,7 +37,8 @@ SongPlaylistItem::SongPlaylistItem(const Song& song)
 }
 
 bool SongPlaylistItem::InitFromQuery(const SqlRow& query) {
-  song_.InitFromQuery(query, false, (Song::kColumns.count() + 1) * 3);
+  // Skip past the row from the songs table
+  song_.InitFromQuery(query, false, Song::kColumns.count() + 1);
 
   if (type() == "Stream") {
     song_.set_filetype(Song::Type_Stream);
@@ -31,7 +31,7 @@ bool AsxIniParser::TryMagic(const QByteArray &data) const {
 }
 
 SongList AsxIniParser::Load(QIODevice *device, const QString& playlist_path, const QDir &dir) const {
-  SongList ret;
+  QStringList locations;
 
   while (!device->atEnd()) {
     QString line = QString::fromUtf8(device->readLine()).trimmed();
@@ -40,10 +40,14 @@ SongList AsxIniParser::Load(QIODevice *device, const QString& playlist_path, con
     QString value = line.mid(equals + 1);
 
     if (key.startsWith("ref")) {
-      Song song = LoadSong(value, 0, dir);
-      if (song.is_valid()) {
-        ret << song;
-      }
+      locations << value;
+    }
+  }
+
+  SongList ret;
+  foreach (const Song& song, LoadSongs(locations, dir)) {
+    if (song.is_valid()) {
+      ret << song;
     }
   }
 
@@ -71,8 +71,23 @@ SongList ASXParser::Load(QIODevice *device, const QString& playlist_path,
     return ret;
   }
 
+  QStringList locations;
+  SongList metadata;
   while (!reader.atEnd() && Utilities::ParseUntilElement(&reader, "entry")) {
-    Song song = ParseTrack(&reader, dir);
+    QString location;
+    metadata << ParseTrack(&reader, &location);
+    locations << location;
+  }
+
+  SongList songs = LoadSongs(locations, dir);
+  for (int i=0 ; i<songs.count() ; ++i) {
+    Song& song = songs[i];
+
+    // Override metadata with what was in the playlist
+    song.set_title(metadata[i].title());
+    song.set_artist(metadata[i].artist());
+    song.set_album(metadata[i].album());
+
     if (song.is_valid()) {
       ret << song;
     }
@@ -81,8 +96,8 @@ SongList ASXParser::Load(QIODevice *device, const QString& playlist_path,
 }
 
 
-Song ASXParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
-  QString title, artist, album, ref;
+Song ASXParser::ParseTrack(QXmlStreamReader* reader, QString* location) const {
+  QString title, artist, album;
 
   while (!reader->atEnd()) {
     QXmlStreamReader::TokenType type = reader->readNext();
@@ -91,7 +106,7 @@ Song ASXParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
       case QXmlStreamReader::StartElement: {
         QStringRef name = reader->name();
         if (name == "ref") {
-          ref = reader->attributes().value("href").toString();
+          *location = reader->attributes().value("href").toString();
         } else if (name == "title") {
           title = reader->readElementText();
         } else if (name == "author") {
@@ -111,9 +126,7 @@ Song ASXParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
   }
 
 return_song:
-  Song song = LoadSong(ref, 0, dir);
-
-  // Override metadata with what was in the playlist
+  Song song;
   song.set_title(title);
   song.set_artist(artist);
   song.set_album(album);
@@ -0,0 +1,158 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cuecache.h"
+#include "cueparser.h"
+#include "library/librarybackend.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+// A big box set has a few hundred tracks, so this is room for dozens of them
+// at a few MB at most.
+const int CueCache::kMaxCachedSongs = 10000;
+
+Q_GLOBAL_STATIC(CueCache, sCueCache)
+
+CueCache::CueCache(int max_cached_songs) {
+  cache_.setMaxCost(max_cached_songs);
+}
+
+CueCache* CueCache::Instance() {
+  return sCueCache();
+}
+
+uint CueCache::Mtime(const QString& filename) {
+  const QFileInfo info(filename);
+  if (!info.exists())
+    return 0;
+  return info.lastModified().toTime_t();
+}
+
+bool CueCache::IsUpToDate(const Entry& entry, uint cue_mtime) {
+  if (entry.cue_mtime_ != cue_mtime)
+    return false;
+
+  for (QMap<QString, uint>::const_iterator it = entry.media_mtimes_.begin() ;
+       it != entry.media_mtimes_.end() ; ++it) {
+    if (Mtime(it.key()) != it.value())
+      return false;
+  }
+  return true;
+}
+
+SongList CueCache::Load(const QString& cue_path,
+                        LibraryBackendInterface* library) {
+  const uint cue_mtime = Mtime(cue_path);
+  if (!cue_mtime)
+    return SongList();
+
+  // Copy the entry so the files can be checked without holding the lock.
+  Entry cached;
+  bool found = false;
+  {
+    QMutexLocker l(&mutex_);
+    if (Entry* entry = cache_.object(cue_path)) {
+      cached = *entry;
+      found = true;
+    }
+  }
+
+  if (!found || !IsUpToDate(cached, cue_mtime)) {
+    QFile cue(cue_path);
+    if (!cue.open(QIODevice::ReadOnly))
+      return SongList();
+
+    // If two threads get here at the same time for the same sheet it's parsed
+    // twice, which is better than making one of them wait for the other.
+    CueParser parser(NULL);
+    cached = Entry();
+    cached.cue_mtime_ = cue_mtime;
+    cached.songs_ = parser.Load(&cue, cue_path,
+                                QDir(cue_path.section('/', 0, -2)));
+
+    foreach (const Song& song, cached.songs_) {
+      const QString filename = song.url().toLocalFile();
+      if (!cached.media_mtimes_.contains(filename)) {
+        cached.media_mtimes_[filename] = Mtime(filename);
+      }
+    }
+  } else if (!library || cached.has_library_songs_) {
+    return library ? cached.library_songs_ : cached.songs_;
+  }
+
+  if (library) {
+    cached.library_songs_ = AddLibraryData(cached.songs_, library);
+    cached.has_library_songs_ = true;
+  }
+
+  {
+    QMutexLocker l(&mutex_);
+    cache_.insert(cue_path, new Entry(cached), qMax(1, cached.songs_.count()));
+  }
+  return library ? cached.library_songs_ : cached.songs_;
+}
+
+SongList CueCache::AddLibraryData(const SongList& songs,
+                                  LibraryBackendInterface* library) {
+  if (!library || songs.isEmpty())
+    return songs;
+
+  QList<QUrl> urls;
+  foreach (const Song& song, songs) {
+    if (!urls.contains(song.url()))
+      urls << song.url();
+  }
+
+  typedef QPair<QUrl, qint64> Section;
+  QMap<Section, Song> library_songs;
+  foreach (const Song& song, library->GetSongsByUrls(urls)) {
+    library_songs[Section(song.url(), song.beginning_nanosec())] = song;
+  }
+
+  SongList ret;
+  foreach (const Song& song, songs) {
+    const Section section(song.url(), song.beginning_nanosec());
+    if (!library_songs.contains(section)) {
+      ret << song;
+      continue;
+    }
+
+    // Start with the library song, and put back everything that CueParser
+    // takes from the sheet.
+    Song library_song = library_songs[section];
+    library_song.Init(song.title(), song.artist(), song.album(),
+                      song.beginning_nanosec(), song.end_nanosec());
+    library_song.set_albumartist(song.albumartist());
+    library_song.set_composer(song.composer());
+    library_song.set_genre(song.genre());
+    library_song.set_year(song.year());
+    library_song.set_track(song.track());
+    library_song.set_mtime(song.mtime());
+    library_song.set_cue_path(song.cue_path());
+    ret << library_song;
+  }
+  return ret;
+}
+
+void CueCache::Clear() {
+  QMutexLocker l(&mutex_);
+  cache_.clear();
+}
@@ -0,0 +1,82 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CUECACHE_H
+#define CUECACHE_H
+
+#include <QCache>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+#include "core/song.h"
+
+class LibraryBackendInterface;
+
+// Remembers the songs parsed from CUE sheets, so restoring playlists,
+// rescanning the library and loading files dropped on the playlist don't parse
+// the same sheet (and read the tags of the same big media file) over and over.
+//
+// The sheets are parsed without looking anything up in the library, so the
+// cached songs only contain what's in the files.  The first time a sheet is
+// loaded with a library the library data is added to a copy of its songs, and
+// that copy is kept in the same entry, so restoring a playlist with many
+// tracks from one sheet only reads their library rows once.  An entry is used
+// as long as the modification times of the sheet and its media files haven't
+// changed.  The cache is shared by the whole application and can be used from
+// any thread.
+class CueCache {
+ public:
+  CueCache(int max_cached_songs = kMaxCachedSongs);
+
+  static const int kMaxCachedSongs;
+
+  static CueCache* Instance();
+
+  // Returns all the sections in this CUE sheet, or an empty list if it
+  // couldn't be read.  If a library is given, sections that are in the
+  // library get their ID, statistics and so on from there, the same way
+  // CueParser does it.  The library data is as it was when it was first added
+  // to this entry.
+  SongList Load(const QString& cue_path, LibraryBackendInterface* library = NULL);
+
+  void Clear();
+
+ private:
+  struct Entry {
+    Entry() : cue_mtime_(0), has_library_songs_(false) {}
+
+    uint cue_mtime_;
+    QMap<QString, uint> media_mtimes_;
+    SongList songs_;
+
+    // The songs with library data, if they've been loaded with a library.
+    bool has_library_songs_;
+    SongList library_songs_;
+  };
+
+  static uint Mtime(const QString& filename);
+  static bool IsUpToDate(const Entry& entry, uint cue_mtime);
+  static SongList AddLibraryData(const SongList& songs,
+                                 LibraryBackendInterface* library);
+
+ private:
+  QMutex mutex_;
+  QCache<QString, Entry> cache_;
+};
+
+#endif // CUECACHE_H
@@ -224,11 +224,20 @@ SongList CueParser::Load(QIODevice* device, const QString& playlist_path, const
 
   QDateTime cue_mtime = QFileInfo(playlist_path).lastModified();
 
+  // load all the media files at once
+  QStringList files;
+  QList<qint64> beginnings;
+  foreach (const CueEntry& entry, entries) {
+    files << entry.file;
+    beginnings << IndexToMarker(entry.index);
+  }
+  const SongList loaded_songs = LoadSongs(files, dir, beginnings);
+
   // finalize parsing songs
   for(int i = 0; i < entries.length(); i++) {
     CueEntry entry = entries.at(i);
 
-    Song song = LoadSong(entry.file, IndexToMarker(entry.index), dir);
+    Song song = loaded_songs[i];
 
     // cue song has mtime equal to qMax(media_file_mtime, cue_sheet_mtime)
     if(cue_mtime.isValid()) {
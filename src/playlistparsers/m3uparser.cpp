@@ -28,11 +28,12 @@ M3UParser::M3UParser(LibraryBackendInterface* library, QObject* parent)
 }
 
 SongList M3UParser::Load(QIODevice* device, const QString& playlist_path, const QDir& dir) const {
-  SongList ret;
-
   M3UType type = STANDARD;
   Metadata current_metadata;
 
+  QStringList locations;
+  QList<Metadata> metadata;
+
   QString data = QString::fromUtf8(device->readAll());
   data.replace('\r', '\n');
   data.replace("\n\n", "\n");
@@ -56,17 +57,8 @@ SongList M3UParser::Load(QIODevice* device, const QString& playlist_path, const
         }
       }
     } else if (!line.isEmpty()) {
-      Song song = LoadSong(line, 0, dir);
-      if (!current_metadata.title.isEmpty()) {
-        song.set_title(current_metadata.title);
-      }
-      if (!current_metadata.artist.isEmpty()) {
-        song.set_artist(current_metadata.artist);
-      }
-      if (current_metadata.length > 0) {
-        song.set_length_nanosec(current_metadata.length);
-      }
-      ret << song;
+      locations << line;
+      metadata << current_metadata;
 
       current_metadata = Metadata();
     }
@@ -76,6 +68,20 @@ SongList M3UParser::Load(QIODevice* device, const QString& playlist_path, const
     line = QString::fromUtf8(buffer.readLine()).trimmed();
   }
 
+  SongList ret = LoadSongs(locations, dir);
+  for (int i=0 ; i<ret.count() ; ++i) {
+    Song& song = ret[i];
+    if (!metadata[i].title.isEmpty()) {
+      song.set_title(metadata[i].title);
+    }
+    if (!metadata[i].artist.isEmpty()) {
+      song.set_artist(metadata[i].artist);
+    }
+    if (metadata[i].length > 0) {
+      song.set_length_nanosec(metadata[i].length);
+    }
+  }
+
   return ret;
 }
 
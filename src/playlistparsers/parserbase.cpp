@@ -21,18 +21,22 @@
 #include "library/libraryquery.h"
 #include "library/sqlrow.h"
 
+#include <QFile>
+#include <QSet>
 #include <QUrl>
 
+const int ParserBase::kMaxTagReadsInFlight = 16;
+
 ParserBase::ParserBase(LibraryBackendInterface* library, QObject *parent)
   : QObject(parent),
     library_(library)
 {
 }
 
-void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
-                          const QDir& dir, Song* song) const {
+bool ParserBase::ResolveLocation(const QString& filename_or_url,
+                                 const QDir& dir, Song* song) const {
   if (filename_or_url.isEmpty()) {
-    return;
+    return false;
   }
 
   QString filename = filename_or_url;
@@ -45,7 +49,7 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
       song->set_url(QUrl::fromUserInput(filename_or_url));
       song->set_filetype(Song::Type_Stream);
       song->set_valid(true);
-      return;
+      return false;
     }
   }
 
@@ -62,7 +66,17 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
     filename = QFileInfo(filename).canonicalFilePath();
   }
 
-  const QUrl url = QUrl::fromLocalFile(filename);
+  song->set_url(QUrl::fromLocalFile(filename));
+  return true;
+}
+
+void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
+                          const QDir& dir, Song* song) const {
+  if (!ResolveLocation(filename_or_url, dir, song)) {
+    return;
+  }
+
+  const QUrl url = song->url();
 
   // Search in the library
   Song library_song;
@@ -75,8 +89,99 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
   if (library_song.is_valid()) {
     *song = library_song;
   } else {
-    TagReaderClient::Instance()->ReadFileBlocking(filename, song);
+    TagReaderClient::Instance()->ReadFileBlocking(url.toLocalFile(), song);
+  }
+}
+
+namespace {
+
+typedef QPair<QUrl, TagReaderReply*> PendingTagRead;
+
+// Waits for the tagreader and copies the metadata to every entry of the
+// playlist that refers to this file.
+void FinishTagRead(const PendingTagRead& pending,
+                   const QMap<QUrl, QList<int> >& entries, SongList* songs) {
+  TagReaderReply* reply = pending.second;
+  if (reply->WaitForFinished()) {
+    foreach (int i, entries[pending.first]) {
+      (*songs)[i].InitFromProtobuf(
+          reply->message().read_file_response().metadata());
+    }
+  }
+  reply->deleteLater();
+}
+
+}  // namespace
+
+SongList ParserBase::LoadSongs(const QStringList& filenames_or_urls,
+                               const QDir& dir,
+                               const QList<qint64>& beginnings) const {
+  SongList ret;
+  ret.reserve(filenames_or_urls.count());
+
+  // Indices of the local files that still need their metadata.
+  QList<int> files;
+  QList<QUrl> urls;
+  QSet<QUrl> seen_urls;
+
+  for (int i=0 ; i<filenames_or_urls.count() ; ++i) {
+    Song song;
+    if (ResolveLocation(filenames_or_urls[i], dir, &song)) {
+      files << i;
+      if (!seen_urls.contains(song.url())) {
+        seen_urls.insert(song.url());
+        urls << song.url();
+      }
+    }
+    ret << song;
+  }
+
+  // Search for all the files in the library at once.
+  typedef QPair<QUrl, qint64> Section;
+  QMap<Section, Song> library_songs;
+  if (library_ && !urls.isEmpty()) {
+    foreach (const Song& song, library_->GetSongsByUrls(urls)) {
+      library_songs[Section(song.url(), song.beginning_nanosec())] = song;
+    }
+  }
+
+  // Read the rest from disk, once for each file even if it's in the playlist
+  // many times.
+  QMap<QUrl, QList<int> > unknown_files;
+  QList<QUrl> unknown_urls;
+  foreach (int i, files) {
+    const Section section(ret[i].url(), beginnings.value(i, 0));
+    if (library_songs.contains(section)) {
+      ret[i] = library_songs[section];
+      continue;
+    }
+
+    // There's nothing to read if the file has gone away.
+    if (!QFile::exists(section.first.toLocalFile()))
+      continue;
+
+    if (!unknown_files.contains(section.first))
+      unknown_urls << section.first;
+    unknown_files[section.first] << i;
   }
+
+  // Keep a few requests in flight so all the tagreader workers are busy, but
+  // don't flood the queue with thousands of them.
+  QList<PendingTagRead> pending;
+  foreach (const QUrl& url, unknown_urls) {
+    pending << PendingTagRead(
+        url, TagReaderClient::Instance()->ReadFile(url.toLocalFile()));
+
+    if (pending.count() >= kMaxTagReadsInFlight) {
+      FinishTagRead(pending.takeFirst(), unknown_files, &ret);
+    }
+  }
+
+  while (!pending.isEmpty()) {
+    FinishTagRead(pending.takeFirst(), unknown_files, &ret);
+  }
+
+  return ret;
 }
 
 Song ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning, const QDir& dir) const {
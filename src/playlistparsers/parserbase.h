@@ -31,6 +31,8 @@ class ParserBase : public QObject {
 public:
   ParserBase(LibraryBackendInterface* library, QObject* parent = 0);
 
+  static const int kMaxTagReadsInFlight;
+
   virtual QString name() const = 0;
   virtual QStringList file_extensions() const = 0;
   virtual QString mime_type() const { return QString(); }
@@ -57,12 +59,25 @@ protected:
   Song LoadSong(const QString& filename_or_url, qint64 beginning, const QDir& dir) const;
   void LoadSong(const QString& filename_or_url, qint64 beginning, const QDir& dir, Song* song) const;
 
+  // Like LoadSong, but for all the entries of a playlist at once.  The library
+  // is searched with a few big queries instead of one for each song, and the
+  // files that aren't in the library are given to the tagreader workers in
+  // parallel.  The beginnings default to 0 if the list is shorter.  Parsers
+  // should collect all their entries first and then call this.
+  SongList LoadSongs(const QStringList& filenames_or_urls, const QDir& dir,
+                     const QList<qint64>& beginnings = QList<qint64>()) const;
+
   // If the URL is a file:// URL then returns its path relative to the
   // directory.  Otherwise returns the URL as is.
   // This function should always be used when saving a playlist.
   QString URLOrRelativeFilename(const QUrl& url, const QDir& dir) const;
 
 private:
+  // Sets the song's URL.  Returns true if it's a local file that still needs
+  // its metadata loaded, or false if it was a stream or empty.
+  bool ResolveLocation(const QString& filename_or_url, const QDir& dir,
+                       Song* song) const;
+
   LibraryBackendInterface* library_;
 };
 
@@ -19,6 +19,7 @@
 #include "core/logging.h"
 #include "core/timeconstants.h"
 
+#include <QMap>
 #include <QTextStream>
 #include <QtDebug>
 
@@ -28,7 +29,9 @@ PLSParser::PLSParser(LibraryBackendInterface* library, QObject* parent)
 }
 
 SongList PLSParser::Load(QIODevice *device, const QString& playlist_path, const QDir &dir) const {
-  QMap<int, Song> songs;
+  QMap<int, QString> locations;
+  QMap<int, QString> titles;
+  QMap<int, qint64> lengths;
   QRegExp n_re("\\d+$");
 
   while (!device->atEnd()) {
@@ -41,26 +44,32 @@ SongList PLSParser::Load(QIODevice *device, const QString& playlist_path, const
     int n = n_re.cap(0).toInt();
 
     if (key.startsWith("file")) {
-      Song song = LoadSong(value, 0, dir);
-
-      // Use the title and length we've already loaded if any
-      if (!songs[n].title().isEmpty())
-        song.set_title(songs[n].title());
-      if (!songs[n].length_nanosec() != -1)
-        song.set_length_nanosec(songs[n].length_nanosec());
-
-      songs[n] = song;
+      locations[n] = value;
     } else if (key.startsWith("title")) {
-      songs[n].set_title(value);
+      titles[n] = value;
     } else if (key.startsWith("length")) {
       qint64 seconds = value.toLongLong();
       if (seconds > 0) {
-        songs[n].set_length_nanosec(seconds * kNsecPerSec);
+        lengths[n] = seconds * kNsecPerSec;
       }
     }
   }
 
-  return songs.values();
+  // The entries can be in any order, but QMap keeps them sorted by number.
+  SongList ret = LoadSongs(locations.values(), dir);
+  const QList<int> numbers = locations.keys();
+
+  for (int i=0 ; i<ret.count() ; ++i) {
+    const int n = numbers[i];
+
+    // Use the title and length from the playlist if there are any
+    if (!titles.value(n).isEmpty())
+      ret[i].set_title(titles[n]);
+    if (lengths.contains(n))
+      ret[i].set_length_nanosec(lengths[n]);
+  }
+
+  return ret;
 }
 
 void PLSParser::Save(const SongList &songs, QIODevice *device, const QDir &dir) const {
@@ -40,14 +40,21 @@ SongList WplParser::Load(QIODevice* device, const QString& playlist_path,
     return ret;
   }
 
+  QStringList locations;
   while (!reader.atEnd() && Utilities::ParseUntilElement(&reader, "seq")) {
-    ParseSeq(dir, &reader, &ret);
+    ParseSeq(&reader, &locations);
+  }
+
+  foreach (const Song& song, LoadSongs(locations, dir)) {
+    if (song.is_valid()) {
+      ret << song;
+    }
   }
   return ret;
 }
 
-void WplParser::ParseSeq(const QDir& dir, QXmlStreamReader* reader,
-                         SongList* songs) const {
+void WplParser::ParseSeq(QXmlStreamReader* reader,
+                         QStringList* locations) const {
   while (!reader->atEnd()) {
     QXmlStreamReader::TokenType type = reader->readNext();
     switch (type) {
@@ -56,10 +63,7 @@ void WplParser::ParseSeq(const QDir& dir, QXmlStreamReader* reader,
         if (name == "media") {
           QStringRef src = reader->attributes().value("src");
           if (!src.isEmpty()) {
-            Song song = LoadSong(src.toString(), 0, dir);
-            if (song.is_valid()) {
-              songs->append(song);
-            }
+            locations->append(src.toString());
           }
         } else {
           Utilities::ConsumeCurrentElement(reader);
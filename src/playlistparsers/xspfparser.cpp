@@ -41,8 +41,24 @@ SongList XSPFParser::Load(QIODevice *device, const QString& playlist_path,
     return ret;
   }
 
+  QStringList locations;
+  SongList metadata;
   while (!reader.atEnd() && Utilities::ParseUntilElement(&reader, "track")) {
-    Song song = ParseTrack(&reader, dir);
+    QString location;
+    metadata << ParseTrack(&reader, &location);
+    locations << location;
+  }
+
+  SongList songs = LoadSongs(locations, dir);
+  for (int i=0 ; i<songs.count() ; ++i) {
+    Song& song = songs[i];
+
+    // Override metadata with what was in the playlist
+    song.set_title(metadata[i].title());
+    song.set_artist(metadata[i].artist());
+    song.set_album(metadata[i].album());
+    song.set_length_nanosec(metadata[i].length_nanosec());
+
     if (song.is_valid()) {
       ret << song;
     }
@@ -50,8 +66,8 @@ SongList XSPFParser::Load(QIODevice *device, const QString& playlist_path,
   return ret;
 }
 
-Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
-  QString title, artist, album, location;
+Song XSPFParser::ParseTrack(QXmlStreamReader* reader, QString* location) const {
+  QString title, artist, album;
   qint64 nanosec = -1;
 
   while (!reader->atEnd()) {
@@ -60,7 +76,7 @@ Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
       case QXmlStreamReader::StartElement: {
         QStringRef name = reader->name();
         if (name == "location") {
-          location = reader->readElementText();
+          *location = reader->readElementText();
         } else if (name == "title") {
           title = reader->readElementText();
         } else if (name == "creator") {
@@ -92,9 +108,7 @@ Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
   }
 
 return_song:
-  Song song = LoadSong(location, 0, dir);
-
-  // Override metadata with what was in the playlist
+  Song song;
   song.set_title(title);
   song.set_artist(artist);
   song.set_album(album);
@@ -41,7 +41,8 @@ class XSPFParser : public XMLParser {
   void Save(const SongList &songs, QIODevice *device, const QDir &dir = QDir()) const;
 
  private:
-  Song ParseTrack(QXmlStreamReader* reader, const QDir& dir) const;
+  // Returns the metadata from the playlist and sets the track's location.
+  Song ParseTrack(QXmlStreamReader* reader, QString* location) const;
 };
 
 #endif
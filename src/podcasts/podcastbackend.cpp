@@ -21,6 +21,7 @@
 #include "core/logging.h"
 #include "core/scopedtransaction.h"
 
+#include <QDataStream>
 #include <QMutexLocker>
 
 PodcastBackend::PodcastBackend(Application* app, QObject* parent)
@@ -156,6 +157,27 @@ void PodcastBackend::UpdateEpisodes(const PodcastEpisodeList& episodes) {
   emit EpisodesUpdated(episodes);
 }
 
+void PodcastBackend::UpdateSubscription(const Podcast& podcast) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QByteArray extra;
+  QDataStream extra_stream(&extra, QIODevice::WriteOnly);
+  extra_stream << podcast.extra();
+
+  QSqlQuery q("UPDATE podcasts"
+              " SET last_updated = :last_updated,"
+              "     last_update_error = :last_update_error,"
+              "     extra = :extra"
+              " WHERE ROWID = :id", db);
+  q.bindValue(":last_updated", podcast.last_updated().toTime_t());
+  q.bindValue(":last_update_error", podcast.last_update_error());
+  q.bindValue(":extra", extra);
+  q.bindValue(":id", podcast.database_id());
+  q.exec();
+  db_->CheckErrors(q);
+}
+
 PodcastList PodcastBackend::GetAllSubscriptions() {
   PodcastList ret;
 
@@ -221,7 +243,7 @@ PodcastEpisodeList PodcastBackend::GetEpisodes(int podcast_id) {
   QSqlQuery q("SELECT ROWID, " + PodcastEpisode::kColumnSpec +
               " FROM podcast_episodes"
               " WHERE podcast_id = :id", db);
-  q.bindValue(":db", podcast_id);
+  q.bindValue(":id", podcast_id);
   q.exec();
   if (db_->CheckErrors(q))
     return ret;
@@ -235,6 +257,26 @@ PodcastEpisodeList PodcastBackend::GetEpisodes(int podcast_id) {
   return ret;
 }
 
+QSet<QUrl> PodcastBackend::GetEpisodeUrls(int podcast_id) {
+  QSet<QUrl> ret;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q("SELECT url FROM podcast_episodes"
+              " WHERE podcast_id = :id", db);
+  q.bindValue(":id", podcast_id);
+  q.exec();
+  if (db_->CheckErrors(q))
+    return ret;
+
+  while (q.next()) {
+    ret.insert(QUrl::fromEncoded(q.value(0).toByteArray()));
+  }
+
+  return ret;
+}
+
 PodcastEpisode PodcastBackend::GetEpisodeById(int id) {
   PodcastEpisode ret;
 
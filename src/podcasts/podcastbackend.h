@@ -19,8 +19,10 @@
 #define PODCASTBACKEND_H
 
 #include <QObject>
+#include <QSet>
 
 #include "podcast.h"
+#include "core/qhash_qurl.h"
 
 class Application;
 class Database;
@@ -48,9 +50,14 @@ public:
   Podcast GetSubscriptionById(int id);
   Podcast GetSubscriptionByUrl(const QUrl& url);
 
+  // Updates the last_updated, last_update_error and extra fields of a podcast
+  // that must already exist in the database.
+  void UpdateSubscription(const Podcast& podcast);
+
   // Returns podcast episodes that match various keys.  All these queries are
   // indexed.
   PodcastEpisodeList GetEpisodes(int podcast_id);
+  QSet<QUrl> GetEpisodeUrls(int podcast_id);
   PodcastEpisode GetEpisodeById(int id);
   PodcastEpisode GetEpisodeByUrl(const QUrl& url);
   PodcastEpisode GetEpisodeByUrlOrLocalUrl(const QUrl& url);
@@ -28,19 +28,23 @@
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
-#include <QNetworkReply>
 #include <QSettings>
 #include <QTimer>
 
 const char* PodcastDownloader::kSettingsGroup = "Podcasts";
 const int PodcastDownloader::kAutoDeleteCheckIntervalMsec = 15 * 60 * kMsecPerSec; // 15 minutes
 
+const int PodcastDownloader::kDefaultMaxDownloads = 3;
+const int PodcastDownloader::kDefaultMaxDownloadsPerHost = 2;
+
 struct PodcastDownloader::Task {
-  Task() : file(NULL) {}
-  ~Task() { delete file; }
+  Task() : download(NULL), last_progress_signal(0) {}
+  ~Task() { if (download) download->deleteLater(); }
 
   PodcastEpisode episode;
-  QFile* file;
+  QString host;
+  ResumableDownload* download;
+  time_t last_progress_signal;
 };
 
 PodcastDownloader::PodcastDownloader(Application* app, QObject* parent)
@@ -51,8 +55,8 @@ PodcastDownloader::PodcastDownloader(Application* app, QObject* parent)
     disallowed_filename_characters_("[^a-zA-Z0-9_~ -]"),
     auto_download_(false),
     delete_after_secs_(0),
-    current_task_(NULL),
-    last_progress_signal_(0),
+    max_downloads_(kDefaultMaxDownloads),
+    max_downloads_per_host_(kDefaultMaxDownloadsPerHost),
     auto_delete_timer_(new QTimer(this))
 {
   connect(backend_, SIGNAL(EpisodesAdded(QList<PodcastEpisode>)),
@@ -87,6 +91,14 @@ void PodcastDownloader::ReloadSettings() {
   auto_download_ = s.value("auto_download", false).toBool();
   download_dir_ = s.value("download_dir", DefaultDownloadDir()).toString();
   delete_after_secs_ = s.value("delete_after", 0).toInt();
+  max_downloads_ = qMax(1, s.value("max_downloads", kDefaultMaxDownloads).toInt());
+  max_downloads_per_host_ = qMax(1,
+      s.value("max_downloads_per_host", kDefaultMaxDownloadsPerHost).toInt());
+  bandwidth_limiter_.set_bytes_per_sec(
+      s.value("max_download_rate_kb", 0).toInt() * 1024);
+
+  // The limits might have gone up.
+  StartQueuedTasks();
 }
 
 void PodcastDownloader::DownloadEpisode(const PodcastEpisode& episode) {
@@ -96,15 +108,12 @@ void PodcastDownloader::DownloadEpisode(const PodcastEpisode& episode) {
 
   Task* task = new Task;
   task->episode = episode;
+  task->host = episode.url().host();
 
-  if (current_task_) {
-    // Add it to the queue
-    queued_tasks_.enqueue(task);
-    emit ProgressChanged(episode, Queued, 0);
-  } else {
-    // Start downloading now
-    StartDownloading(task);
-  }
+  // Add it to the queue, and start it straight away if there's room.
+  queued_tasks_ << task;
+  emit ProgressChanged(episode, Queued, 0);
+  StartQueuedTasks();
 }
 
 void PodcastDownloader::DeleteEpisode(const PodcastEpisode& episode) {
@@ -125,12 +134,13 @@ void PodcastDownloader::DeleteEpisode(const PodcastEpisode& episode) {
 }
 
 void PodcastDownloader::FinishAndDelete(Task* task) {
+  running_tasks_.removeAll(task);
   downloading_episode_ids_.remove(task->episode.database_id());
   emit ProgressChanged(task->episode, Finished, 0);
 
   delete task;
 
-  NextTask();
+  StartQueuedTasks();
 }
 
 QString PodcastDownloader::FilenameForEpisode(const QString& directory,
@@ -156,7 +166,16 @@ QString PodcastDownloader::FilenameForEpisode(const QString& directory,
             directory, base_filename, QString::number(count), file_extension);
     }
     
-    if (!QFile::exists(filename)) {
+    // Episodes with the same title might be downloading at the same time.
+    bool in_use = false;
+    foreach (Task* task, running_tasks_) {
+      if (task->download->filename() == filename) {
+        in_use = true;
+        break;
+      }
+    }
+
+    if (!in_use && !QFile::exists(filename)) {
       return filename;
     }
     
@@ -165,8 +184,6 @@ QString PodcastDownloader::FilenameForEpisode(const QString& directory,
 }
 
 void PodcastDownloader::StartDownloading(Task* task) {
-  current_task_ = task;
-
   // Need to get the name of the podcast to use in the directory name.
   Podcast podcast =
       backend_->GetSubscriptionById(task->episode.podcast_database_id());
@@ -180,91 +197,97 @@ void PodcastDownloader::StartDownloading(Task* task) {
   const QString directory = download_dir_ + "/" +
       SanitiseFilenameComponent(podcast.title());
   const QString filepath = FilenameForEpisode(directory, task->episode);
-
-  // Open the output file
   QDir().mkpath(directory);
-  task->file = new QFile(filepath);
-  if (!task->file->open(QIODevice::WriteOnly)) {
-    qLog(Warning) << "Could not open the file" << filepath << "for writing";
-    FinishAndDelete(task);
-    return;
-  }
 
   qLog(Info) << "Downloading" << task->episode.url() << "to" << filepath;
 
-  // Get the URL
-  QNetworkRequest req(task->episode.url());
-  RedirectFollower* reply = new RedirectFollower(network_->get(req));
-  connect(reply, SIGNAL(readyRead()), SLOT(ReplyReadyRead()));
-  connect(reply, SIGNAL(finished()), SLOT(ReplyFinished()));
-  connect(reply, SIGNAL(downloadProgress(qint64,qint64)),
-          SLOT(ReplyDownloadProgress(qint64,qint64)));
+  // If this episode was interrupted before, FilenameForEpisode returns the
+  // same name again and the download carries on from its partial file.
+  running_tasks_ << task;
+  task->download = new ResumableDownload(network_, task->episode.url(),
+                                         filepath, this);
+  task->download->set_bandwidth_limiter(&bandwidth_limiter_);
+  connect(task->download, SIGNAL(Finished(bool)), SLOT(DownloadFinished(bool)));
+  connect(task->download, SIGNAL(Progress(qint64,qint64)),
+          SLOT(DownloadProgress(qint64,qint64)));
 
   emit ProgressChanged(task->episode, Downloading, 0);
+  task->download->Start();
 }
 
-void PodcastDownloader::NextTask() {
-  current_task_ = NULL;
-
-  if (!queued_tasks_.isEmpty()) {
-    StartDownloading(queued_tasks_.dequeue());
+int PodcastDownloader::RunningTasksForHost(const QString& host) const {
+  int ret = 0;
+  foreach (Task* task, running_tasks_) {
+    if (task->host == host)
+      ret ++;
   }
+  return ret;
 }
 
-void PodcastDownloader::ReplyReadyRead() {
-  QNetworkReply* reply = qobject_cast<RedirectFollower*>(sender())->reply();
-  if (!reply || !current_task_ || !current_task_->file)
-    return;
+void PodcastDownloader::StartQueuedTasks() {
+  // Start as many queued downloads as we're allowed to, skipping over the ones
+  // whose server already has enough going on.
+  QList<Task*>::iterator it = queued_tasks_.begin();
+  while (it != queued_tasks_.end() &&
+         running_tasks_.count() < max_downloads_) {
+    Task* task = *it;
+    if (RunningTasksForHost(task->host) >= max_downloads_per_host_) {
+      ++it;
+      continue;
+    }
 
-  forever {
-    const qint64 bytes = reply->bytesAvailable();
-    if (bytes <= 0)
-      break;
+    it = queued_tasks_.erase(it);
+    StartDownloading(task);
 
-    current_task_->file->write(reply->read(bytes));
+    // StartDownloading might have finished a task and started others already.
+    it = queued_tasks_.begin();
   }
 }
 
-void PodcastDownloader::ReplyDownloadProgress(qint64 received, qint64 total) {
-  if (!current_task_ || !current_task_->file || total < 1024)
+PodcastDownloader::Task* PodcastDownloader::TaskForDownload(QObject* download) const {
+  foreach (Task* task, running_tasks_) {
+    if (task->download == download)
+      return task;
+  }
+  return NULL;
+}
+
+void PodcastDownloader::DownloadProgress(qint64 received, qint64 total) {
+  Task* task = TaskForDownload(sender());
+  if (!task || total < 1024)
     return;
 
   const time_t current_time = QDateTime::currentDateTime().toTime_t();
-  if (last_progress_signal_ == current_time)
+  if (task->last_progress_signal == current_time)
     return;
-  last_progress_signal_ = current_time;
+  task->last_progress_signal = current_time;
 
-  emit ProgressChanged(current_task_->episode, Downloading,
+  emit ProgressChanged(task->episode, Downloading,
                        float(received) / total * 100);
 }
 
-void PodcastDownloader::ReplyFinished() {
-  RedirectFollower* reply = qobject_cast<RedirectFollower*>(sender());
-  if (!reply || !current_task_ || !current_task_->file)
+void PodcastDownloader::DownloadFinished(bool success) {
+  Task* task = TaskForDownload(sender());
+  if (!task)
     return;
 
-  reply->deleteLater();
-
-  if (reply->error() != QNetworkReply::NoError) {
-    qLog(Warning) << "Error downloading episode:" << reply->errorString();
-
-    // Delete the file
-    current_task_->file->remove();
-
-    FinishAndDelete(current_task_);
+  if (!success) {
+    qLog(Warning) << "Error downloading episode:"
+                  << task->download->error_string();
+    FinishAndDelete(task);
     return;
   }
 
-  qLog(Info) << "Download of" << current_task_->file->fileName() << "finished";
+  qLog(Info) << "Download of" << task->download->filename() << "finished";
 
   // Tell the database the episode has been updated.  Get it from the DB again
   // in case the listened field changed in the mean time.
-  PodcastEpisode episode = backend_->GetEpisodeById(current_task_->episode.database_id());
+  PodcastEpisode episode = backend_->GetEpisodeById(task->episode.database_id());
   episode.set_downloaded(true);
-  episode.set_local_url(QUrl::fromLocalFile(current_task_->file->fileName()));
+  episode.set_local_url(QUrl::fromLocalFile(task->download->filename()));
   backend_->UpdateEpisodes(PodcastEpisodeList() << episode);
 
-  FinishAndDelete(current_task_);
+  FinishAndDelete(task);
 }
 
 QString PodcastDownloader::SanitiseFilenameComponent(const QString& text) const {
@@ -20,10 +20,10 @@
 
 #include "podcast.h"
 #include "podcastepisode.h"
+#include "core/resumabledownload.h"
 
 #include <QList>
 #include <QObject>
-#include <QQueue>
 #include <QRegExp>
 #include <QSet>
 
@@ -47,6 +47,8 @@ public:
 
   static const char* kSettingsGroup;
   static const int kAutoDeleteCheckIntervalMsec;
+  static const int kDefaultMaxDownloads;
+  static const int kDefaultMaxDownloadsPerHost;
 
   QString DefaultDownloadDir() const;
 
@@ -67,9 +69,8 @@ private slots:
   void SubscriptionAdded(const Podcast& podcast);
   void EpisodesAdded(const QList<PodcastEpisode>& episodes);
 
-  void ReplyReadyRead();
-  void ReplyFinished();
-  void ReplyDownloadProgress(qint64 received, qint64 total);
+  void DownloadFinished(bool success);
+  void DownloadProgress(qint64 received, qint64 total);
 
   void AutoDelete();
 
@@ -77,8 +78,10 @@ private:
   struct Task;
 
   void StartDownloading(Task* task);
-  void NextTask();
+  void StartQueuedTasks();
   void FinishAndDelete(Task* task);
+  Task* TaskForDownload(QObject* download) const;
+  int RunningTasksForHost(const QString& host) const;
 
   QString FilenameForEpisode(const QString& directory,
                              const PodcastEpisode& episode) const;
@@ -94,12 +97,14 @@ private:
   bool auto_download_;
   QString download_dir_;
   int delete_after_secs_;
+  int max_downloads_;
+  int max_downloads_per_host_;
 
-  Task* current_task_;
-  QQueue<Task*> queued_tasks_;
-  QSet<int> downloading_episode_ids_;
+  BandwidthLimiter bandwidth_limiter_;
 
-  time_t last_progress_signal_;
+  QList<Task*> running_tasks_;
+  QList<Task*> queued_tasks_;
+  QSet<int> downloading_episode_ids_;
 
   QTimer* auto_delete_timer_;
 };
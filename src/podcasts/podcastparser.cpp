@@ -25,6 +25,7 @@
 
 const char* PodcastParser::kAtomNamespace = "http://www.w3.org/2005/Atom";
 const char* PodcastParser::kItunesNamespace = "http://www.itunes.com/dtds/podcast-1.0.dtd";
+const int PodcastParser::kKnownEpisodesBeforeStopping = 3;
 
 PodcastParser::PodcastParser() {
   supported_mime_types_ << "application/rss+xml"
@@ -53,7 +54,8 @@ bool PodcastParser::TryMagic(const QByteArray& data) const {
          str.contains(QRegExp("<opml\\b"));
 }
 
-QVariant PodcastParser::Load(QIODevice* device, const QUrl& url) const {
+QVariant PodcastParser::Load(QIODevice* device, const QUrl& url,
+                             const QSet<QUrl>& known_episode_urls) const {
   QXmlStreamReader reader(device);
 
   while (!reader.atEnd()) {
@@ -62,7 +64,7 @@ QVariant PodcastParser::Load(QIODevice* device, const QUrl& url) const {
       const QStringRef name = reader.name();
       if (name == "rss") {
         Podcast podcast;
-        if (!ParseRss(&reader, &podcast)) {
+        if (!ParseRss(&reader, &podcast, known_episode_urls)) {
           return QVariant();
         } else {
           podcast.set_url(url);
@@ -89,16 +91,25 @@ QVariant PodcastParser::Load(QIODevice* device, const QUrl& url) const {
   return QVariant();
 }
 
-bool PodcastParser::ParseRss(QXmlStreamReader* reader, Podcast* ret) const {
+bool PodcastParser::ParseRss(QXmlStreamReader* reader, Podcast* ret,
+                             const QSet<QUrl>& known_episode_urls) const {
   if (!Utilities::ParseUntilElement(reader, "channel")) {
     return false;
   }
 
-  ParseChannel(reader, ret);
+  ParseChannel(reader, ret, known_episode_urls);
   return true;
 }
 
-void PodcastParser::ParseChannel(QXmlStreamReader* reader, Podcast* ret) const {
+void PodcastParser::ParseChannel(QXmlStreamReader* reader, Podcast* ret,
+                                 const QSet<QUrl>& known_episode_urls) const {
+  // Feeds usually list their newest episodes first.  If this one does, stop
+  // after a few episodes in a row that we've seen before - everything after
+  // them will be old too.
+  bool newest_first = true;
+  QDateTime previous_date;
+  int known_in_a_row = 0;
+
   while (!reader->atEnd()) {
     QXmlStreamReader::TokenType type = reader->readNext();
     switch (type) {
@@ -120,7 +131,27 @@ void PodcastParser::ParseChannel(QXmlStreamReader* reader, Podcast* ret) const {
                  ret->url().isEmpty() && reader->attributes().value("rel") == "self") {
         ret->set_url(QUrl::fromEncoded(reader->readElementText().toAscii()));
       } else if (name == "item") {
+        const int count = ret->episodes().count();
         ParseItem(reader, ret);
+
+        if (known_episode_urls.isEmpty() || ret->episodes().count() == count)
+          break;
+
+        const PodcastEpisode& episode = ret->episodes().last();
+        const QDateTime& date = episode.publication_date();
+        if (previous_date.isValid() && date.isValid() && date > previous_date)
+          newest_first = false;
+        if (date.isValid())
+          previous_date = date;
+
+        if (known_episode_urls.contains(episode.url())) {
+          known_in_a_row ++;
+        } else {
+          known_in_a_row = 0;
+        }
+
+        if (newest_first && known_in_a_row >= kKnownEpisodesBeforeStopping)
+          return;
       } else {
         Utilities::ConsumeCurrentElement(reader);
       }
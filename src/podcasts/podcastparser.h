@@ -18,9 +18,11 @@
 #ifndef PODCASTPARSER_H
 #define PODCASTPARSER_H
 
+#include <QSet>
 #include <QStringList>
 
 #include "podcast.h"
+#include "core/qhash_qurl.h"
 
 class OpmlContainer;
 
@@ -35,6 +37,7 @@ public:
 
   static const char* kAtomNamespace;
   static const char* kItunesNamespace;
+  static const int kKnownEpisodesBeforeStopping;
 
   const QStringList& supported_mime_types() const { return supported_mime_types_; }
   bool SupportsContentType(const QString& content_type) const;
@@ -42,15 +45,21 @@ public:
   // You should check the type of the returned QVariant to see whether it
   // contains a Podcast or an OpmlContainer.  If the QVariant isNull then an
   // error occurred parsing the XML.
-  QVariant Load(QIODevice* device, const QUrl& url) const;
+  // If known_episode_urls is given and the feed lists its newest episodes
+  // first, parsing stops once it gets to episodes that are already known, so
+  // the returned Podcast might only contain the new ones.
+  QVariant Load(QIODevice* device, const QUrl& url,
+                const QSet<QUrl>& known_episode_urls = QSet<QUrl>()) const;
 
   // Really quick test to see if some data might be supported.  Load() might
   // still return a null QVariant.
   bool TryMagic(const QByteArray& data) const;
 
 private:
-  bool ParseRss(QXmlStreamReader* reader, Podcast* ret) const;
-  void ParseChannel(QXmlStreamReader* reader, Podcast* ret) const;
+  bool ParseRss(QXmlStreamReader* reader, Podcast* ret,
+                const QSet<QUrl>& known_episode_urls) const;
+  void ParseChannel(QXmlStreamReader* reader, Podcast* ret,
+                    const QSet<QUrl>& known_episode_urls) const;
   void ParseImage(QXmlStreamReader* reader, Podcast* ret) const;
   void ParseItunesOwner(QXmlStreamReader* reader, Podcast* ret) const;
   void ParseItem(QXmlStreamReader* reader, Podcast* ret) const;
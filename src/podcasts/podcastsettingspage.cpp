@@ -74,6 +74,12 @@ void PodcastSettingsPage::Load() {
       s.value("download_dir", default_download_dir).toString()));
 
   ui_->auto_download->setChecked(s.value("auto_download", false).toBool());
+  ui_->max_downloads->setValue(
+      s.value("max_downloads", PodcastDownloader::kDefaultMaxDownloads).toInt());
+  ui_->max_downloads_per_host->setValue(
+      s.value("max_downloads_per_host",
+              PodcastDownloader::kDefaultMaxDownloadsPerHost).toInt());
+  ui_->max_download_rate->setValue(s.value("max_download_rate_kb", 0).toInt());
   ui_->delete_after->setValue(s.value("delete_after", 0).toInt() / kSecsPerDay);
   ui_->username->setText(s.value("gpodder_username").toString());
   ui_->device_name->setText(s.value("gpodder_device_name", GPodderSync::DefaultDeviceName()).toString());
@@ -93,6 +99,9 @@ void PodcastSettingsPage::Save() {
              ui_->check_interval->itemData(ui_->check_interval->currentIndex()));
   s.setValue("download_dir", QDir::fromNativeSeparators(ui_->download_dir->text()));
   s.setValue("auto_download", ui_->auto_download->isChecked());
+  s.setValue("max_downloads", ui_->max_downloads->value());
+  s.setValue("max_downloads_per_host", ui_->max_downloads_per_host->value());
+  s.setValue("max_download_rate_kb", ui_->max_download_rate->value());
   s.setValue("delete_after", ui_->delete_after->value() * kSecsPerDay);
   s.setValue("gpodder_device_name", ui_->device_name->text());
 }
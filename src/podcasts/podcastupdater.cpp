@@ -28,6 +28,7 @@
 #include <QTimer>
 
 const char* PodcastUpdater::kSettingsGroup = "Podcasts";
+const int PodcastUpdater::kMaxConcurrentUpdates = 4;
 
 PodcastUpdater::PodcastUpdater(Application* app, QObject* parent)
   : QObject(parent),
@@ -35,7 +36,8 @@ PodcastUpdater::PodcastUpdater(Application* app, QObject* parent)
     update_interval_secs_(0),
     update_timer_(new QTimer(this)),
     loader_(new PodcastUrlLoader(this)),
-    pending_replies_(0)
+    pending_replies_(0),
+    running_updates_(0)
 {
   connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
   connect(update_timer_, SIGNAL(timeout()), SLOT(UpdateAllPodcastsNow()));
@@ -102,21 +104,41 @@ void PodcastUpdater::SubscriptionAdded(const Podcast& podcast) {
 }
 
 void PodcastUpdater::UpdatePodcastNow(const Podcast& podcast) {
-  PodcastUrlLoaderReply* reply = loader_->Load(podcast.url());
-  NewClosure(reply, SIGNAL(Finished(bool)),
-             this, SLOT(PodcastLoaded(PodcastUrlLoaderReply*,Podcast,bool)),
-             reply, podcast, false);
+  StartUpdate(podcast, false);
 }
 
 void PodcastUpdater::UpdateAllPodcastsNow() {
-  foreach (const Podcast& podcast, app_->podcast_backend()->GetAllSubscriptions()) {
-    PodcastUrlLoaderReply* reply = loader_->Load(podcast.url());
-    NewClosure(reply, SIGNAL(Finished(bool)),
-               this, SLOT(PodcastLoaded(PodcastUrlLoaderReply*,Podcast,bool)),
-               reply, podcast, true);
+  if (pending_replies_ > 0) {
+    // The last update hasn't finished yet.
+    return;
+  }
 
+  // Feeds are fetched a few at a time, so an update takes at most
+  // (subscriptions / kMaxConcurrentUpdates) request timeouts.
+  foreach (const Podcast& podcast, app_->podcast_backend()->GetAllSubscriptions()) {
+    queued_updates_ << podcast;
     pending_replies_ ++;
   }
+
+  StartQueuedUpdates();
+}
+
+void PodcastUpdater::StartQueuedUpdates() {
+  while (running_updates_ < kMaxConcurrentUpdates &&
+         !queued_updates_.isEmpty()) {
+    running_updates_ ++;
+    StartUpdate(queued_updates_.takeFirst(), true);
+  }
+}
+
+void PodcastUpdater::StartUpdate(const Podcast& podcast, bool one_of_many) {
+  const QSet<QUrl> known_episode_urls =
+      app_->podcast_backend()->GetEpisodeUrls(podcast.database_id());
+
+  PodcastUrlLoaderReply* reply = loader_->Refresh(podcast, known_episode_urls);
+  NewClosure(reply, SIGNAL(Finished(bool)),
+             this, SLOT(PodcastLoaded(PodcastUrlLoaderReply*,Podcast,bool)),
+             reply, podcast, one_of_many);
 }
 
 void PodcastUpdater::PodcastLoaded(PodcastUrlLoaderReply* reply, const Podcast& podcast,
@@ -124,6 +146,9 @@ void PodcastUpdater::PodcastLoaded(PodcastUrlLoaderReply* reply, const Podcast&
   reply->deleteLater();
 
   if (one_of_many) {
+    running_updates_ --;
+    StartQueuedUpdates();
+
     if (--pending_replies_ == 0) {
       // This was the last reply we were waiting for.  Save this time as being
       // the last sucessful update and restart the timer.
@@ -133,9 +158,20 @@ void PodcastUpdater::PodcastLoaded(PodcastUrlLoaderReply* reply, const Podcast&
     }
   }
 
+  PodcastBackend* backend = app_->podcast_backend();
+
+  // Get the podcast from the DB again in case it was changed in the mean time.
+  Podcast updated_podcast = backend->GetSubscriptionById(podcast.database_id());
+  if (!updated_podcast.is_valid()) {
+    // It was unsubscribed while we were loading it.
+    return;
+  }
+
   if (!reply->is_success()) {
     qLog(Warning) << "Error fetching podcast at" << podcast.url() << ":"
                   << reply->error_text();
+    updated_podcast.set_last_update_error(reply->error_text());
+    backend->UpdateSubscription(updated_podcast);
     return;
   }
 
@@ -144,25 +180,38 @@ void PodcastUpdater::PodcastLoaded(PodcastUrlLoaderReply* reply, const Podcast&
     return;
   }
 
-  // Get the episode URLs we had for this podcast already.
-  QSet<QUrl> existing_urls;
-  foreach (const PodcastEpisode& episode,
-           app_->podcast_backend()->GetEpisodes(podcast.database_id())) {
-    existing_urls.insert(episode.url());
-  }
-
-  // Add any new episodes
-  PodcastEpisodeList new_episodes;
-  foreach (const Podcast& reply_podcast, reply->podcast_results()) {
-    foreach (const PodcastEpisode& episode, reply_podcast.episodes()) {
-      if (!existing_urls.contains(episode.url())) {
-        PodcastEpisode episode_copy(episode);
-        episode_copy.set_podcast_database_id(podcast.database_id());
-        new_episodes.append(episode_copy);
+  if (reply->is_not_modified()) {
+    qLog(Debug) << "Podcast" << podcast.url() << "hasn't changed";
+  } else {
+    // Get the episode URLs we had for this podcast already.  The reply might
+    // only contain the newest episodes.
+    const QSet<QUrl> existing_urls =
+        backend->GetEpisodeUrls(podcast.database_id());
+
+    // Add any new episodes
+    PodcastEpisodeList new_episodes;
+    foreach (const Podcast& reply_podcast, reply->podcast_results()) {
+      foreach (const PodcastEpisode& episode, reply_podcast.episodes()) {
+        if (!existing_urls.contains(episode.url())) {
+          PodcastEpisode episode_copy(episode);
+          episode_copy.set_podcast_database_id(podcast.database_id());
+          new_episodes.append(episode_copy);
+        }
       }
     }
+
+    if (!new_episodes.isEmpty()) {
+      backend->AddEpisodes(&new_episodes);
+    }
+    qLog(Info) << "Added" << new_episodes.count() << "new episodes for" << podcast.url();
+
+    // Only remember the validators once the episodes are safely stored.
+    updated_podcast.set_extra(PodcastUrlLoader::kEtagKey, reply->etag());
+    updated_podcast.set_extra(PodcastUrlLoader::kLastModifiedKey,
+                              reply->last_modified());
   }
 
-  app_->podcast_backend()->AddEpisodes(&new_episodes);
-  qLog(Info) << "Added" << new_episodes.count() << "new episodes for" << podcast.url();
+  updated_podcast.set_last_updated(QDateTime::currentDateTime());
+  updated_podcast.set_last_update_error(QString());
+  backend->UpdateSubscription(updated_podcast);
 }
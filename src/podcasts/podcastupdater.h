@@ -21,8 +21,9 @@
 #include <QDateTime>
 #include <QObject>
 
+#include "podcast.h"
+
 class Application;
-class Podcast;
 class PodcastUrlLoader;
 class PodcastUrlLoaderReply;
 
@@ -37,6 +38,7 @@ public:
   PodcastUpdater(Application* app, QObject* parent = 0);
 
   static const char* kSettingsGroup;
+  static const int kMaxConcurrentUpdates;
 
 public slots:
   void UpdateAllPodcastsNow();
@@ -52,6 +54,8 @@ private slots:
 private:
   void RestartTimer();
   void SaveSettings();
+  void StartUpdate(const Podcast& podcast, bool one_of_many);
+  void StartQueuedUpdates();
 
 private:
   Application* app_;
@@ -62,6 +66,10 @@ private:
   QTimer* update_timer_;
   PodcastUrlLoader* loader_;
   int pending_replies_;
+
+  // Podcasts from a full update that are waiting for their turn.
+  PodcastList queued_updates_;
+  int running_updates_;
 };
 
 #endif // PODCASTUPDATER_H
@@ -26,11 +26,15 @@
 #include "core/utilities.h"
 
 const int PodcastUrlLoader::kMaxRedirects = 5;
+const int PodcastUrlLoader::kRequestTimeoutMsec = 30000;
+const char* PodcastUrlLoader::kEtagKey = "http:etag";
+const char* PodcastUrlLoader::kLastModifiedKey = "http:last_modified";
 
 
 PodcastUrlLoader::PodcastUrlLoader(QObject* parent)
   : QObject(parent),
     network_(new NetworkAccessManager(this)),
+    timeouts_(new NetworkTimeouts(kRequestTimeoutMsec, this)),
     parser_(new PodcastParser),
     html_link_re_("<link (.*)>"),
     html_link_rel_re_("rel\\s*=\\s*['\"]?\\s*alternate"),
@@ -105,6 +109,26 @@ PodcastUrlLoaderReply* PodcastUrlLoader::Load(const QUrl& url) {
   return reply;
 }
 
+PodcastUrlLoaderReply* PodcastUrlLoader::Refresh(
+    const Podcast& podcast, const QSet<QUrl>& known_episode_urls) {
+  PodcastUrlLoaderReply* reply = new PodcastUrlLoaderReply(podcast.url(), this);
+
+  RequestState* state = new RequestState;
+  state->redirects_remaining_ = kMaxRedirects + 1;
+  state->reply_ = reply;
+  state->known_episode_urls_ = known_episode_urls;
+
+  // Without any episodes a 304 would leave us with nothing.
+  if (!known_episode_urls.isEmpty()) {
+    state->etag_ = podcast.extra(kEtagKey).toByteArray();
+    state->last_modified_ = podcast.extra(kLastModifiedKey).toByteArray();
+  }
+
+  NextRequest(podcast.url(), state);
+
+  return reply;
+}
+
 void PodcastUrlLoader::SendErrorAndDelete(const QString& error_text, RequestState* state) {
   state->reply_->SetFinished(error_text);
   delete state;
@@ -121,7 +145,18 @@ void PodcastUrlLoader::NextRequest(const QUrl& url, RequestState* state) {
 
   QNetworkRequest req(url);
   req.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+
+  if (!state->etag_.isEmpty() || !state->last_modified_.isEmpty()) {
+    // Don't let the cache answer a 304 with the old feed, we want to see it.
+    req.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+    if (!state->etag_.isEmpty())
+      req.setRawHeader("If-None-Match", state->etag_);
+    if (!state->last_modified_.isEmpty())
+      req.setRawHeader("If-Modified-Since", state->last_modified_);
+  }
+
   QNetworkReply* network_reply = network_->get(req);
+  timeouts_->AddReply(network_reply);
 
   NewClosure(network_reply, SIGNAL(finished()),
              this, SLOT(RequestFinished(RequestState*, QNetworkReply*)),
@@ -147,6 +182,12 @@ void PodcastUrlLoader::RequestFinished(RequestState* state, QNetworkReply* reply
 
   const QVariant http_status =
       reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+  if (http_status.isValid() && http_status.toInt() == 304) {
+    state->reply_->SetNotModified();
+    delete state;
+    return;
+  }
+
   if (http_status.isValid() && http_status.toInt() != 200) {
     SendErrorAndDelete(QString("HTTP %1: %2").arg(
         reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toString(),
@@ -157,7 +198,10 @@ void PodcastUrlLoader::RequestFinished(RequestState* state, QNetworkReply* reply
   // Check the mime type.
   const QString content_type = reply->header(QNetworkRequest::ContentTypeHeader).toString();
   if (parser_->SupportsContentType(content_type)) {
-    const QVariant ret = parser_->Load(reply, reply->url());
+    state->reply_->SetValidators(reply->rawHeader("ETag"),
+                                 reply->rawHeader("Last-Modified"));
+    const QVariant ret = parser_->Load(reply, reply->url(),
+                                       state->known_episode_urls_);
 
     if (ret.canConvert<Podcast>()) {
       state->reply_->SetFinished(PodcastList() << ret.value<Podcast>());
@@ -203,10 +247,24 @@ void PodcastUrlLoader::RequestFinished(RequestState* state, QNetworkReply* reply
 PodcastUrlLoaderReply::PodcastUrlLoaderReply(const QUrl& url, QObject* parent)
   : QObject(parent),
     url_(url),
-    finished_(false)
+    finished_(false),
+    not_modified_(false)
 {
 }
 
+void PodcastUrlLoaderReply::SetValidators(const QByteArray& etag,
+                                          const QByteArray& last_modified) {
+  etag_ = etag;
+  last_modified_ = last_modified;
+}
+
+void PodcastUrlLoaderReply::SetNotModified() {
+  result_type_ = Type_Podcast;
+  not_modified_ = true;
+  finished_ = true;
+  emit Finished(true);
+}
+
 void PodcastUrlLoaderReply::SetFinished(const PodcastList& results) {
   result_type_ = Type_Podcast;
   podcast_results_ = results;
@@ -20,10 +20,13 @@
 
 #include <QObject>
 #include <QRegExp>
+#include <QSet>
 
 #include "opmlcontainer.h"
 #include "podcast.h"
+#include "core/qhash_qurl.h"
 
+class NetworkTimeouts;
 class PodcastParser;
 
 class QNetworkAccessManager;
@@ -45,6 +48,14 @@ public:
   bool is_success() const { return error_text_.isEmpty(); }
   const QString& error_text() const { return error_text_; }
 
+  // True if this was a refresh and the feed hasn't changed since last time.
+  // There are no results in that case.
+  bool is_not_modified() const { return not_modified_; }
+
+  // The validators the server sent, to be used for the next refresh.
+  const QByteArray& etag() const { return etag_; }
+  const QByteArray& last_modified() const { return last_modified_; }
+
   ResultType result_type() const { return result_type_; }
   const PodcastList& podcast_results() const { return podcast_results_; }
   const OpmlContainer& opml_results() const { return opml_results_; }
@@ -52,6 +63,8 @@ public:
   void SetFinished(const QString& error_text);
   void SetFinished(const PodcastList& results);
   void SetFinished(const OpmlContainer& results);
+  void SetNotModified();
+  void SetValidators(const QByteArray& etag, const QByteArray& last_modified);
 
 signals:
   void Finished(bool success);
@@ -59,7 +72,10 @@ signals:
 private:
   QUrl url_;
   bool finished_;
+  bool not_modified_;
   QString error_text_;
+  QByteArray etag_;
+  QByteArray last_modified_;
 
   ResultType result_type_;
   PodcastList podcast_results_;
@@ -75,10 +91,21 @@ public:
   ~PodcastUrlLoader();
 
   static const int kMaxRedirects;
+  static const int kRequestTimeoutMsec;
+
+  // Keys in Podcast::extra() that hold the validators from the last refresh.
+  static const char* kEtagKey;
+  static const char* kLastModifiedKey;
 
   PodcastUrlLoaderReply* Load(const QString& url_text);
   PodcastUrlLoaderReply* Load(const QUrl& url);
 
+  // Loads a podcast we've loaded before.  This is a conditional request using
+  // the validators saved in the podcast's extra data, and the feed is only
+  // parsed as far as the first few episodes in known_episode_urls.
+  PodcastUrlLoaderReply* Refresh(const Podcast& podcast,
+                                 const QSet<QUrl>& known_episode_urls);
+
   // Both the FixPodcastUrl functions replace common podcatcher URL schemes
   // like itpc:// or zune:// with their http:// equivalents.  The QString
   // overload also cleans up user-entered text a bit - stripping whitespace and
@@ -90,6 +117,10 @@ private:
   struct RequestState {
     int redirects_remaining_;
     PodcastUrlLoaderReply* reply_;
+
+    QSet<QUrl> known_episode_urls_;
+    QByteArray etag_;
+    QByteArray last_modified_;
   };
 
   typedef QPair<QString, QString> QuickPrefix;
@@ -104,6 +135,7 @@ private:
 
 private:
   QNetworkAccessManager* network_;
+  NetworkTimeouts* timeouts_;
   PodcastParser* parser_;
 
   QRegExp html_link_re_;
@@ -0,0 +1,301 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transcodedfilecache.h"
+#include "transcoder.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QSettings>
+#include <QStringList>
+#include <QTextStream>
+
+#include "core/logging.h"
+#include "core/utilities.h"
+
+const char* TranscodedFileCache::kSettingsGroup = "TranscodedFileCache";
+const char* TranscodedFileCache::kIndexFilename = "index";
+const int TranscodedFileCache::kDefaultMaxSizeMb = 2048;
+const int TranscodedFileCache::kChangesBetweenIndexSaves = 32;
+
+namespace {
+
+TranscodedFileCache* sInstance = NULL;
+QMutex sInstanceMutex;
+
+void DeleteInstance() {
+  QMutexLocker l(&sInstanceMutex);
+  delete sInstance;
+  sInstance = NULL;
+}
+
+}  // namespace
+
+
+TranscodedFileCache::TranscodedFileCache(const QString& directory,
+                                         qint64 max_size)
+  : directory_(directory),
+    max_size_(max_size),
+    total_size_(0),
+    next_sequence_(0),
+    unsaved_changes_(0)
+{
+  QDir().mkpath(directory_);
+  LoadIndex();
+}
+
+TranscodedFileCache::~TranscodedFileCache() {
+  SaveIndex();
+}
+
+TranscodedFileCache* TranscodedFileCache::Instance() {
+  QMutexLocker l(&sInstanceMutex);
+  if (!sInstance) {
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    const qint64 max_size_mb =
+        s.value("max_size_mb", kDefaultMaxSizeMb).toLongLong();
+
+    sInstance = new TranscodedFileCache(
+          Utilities::GetConfigPath(Utilities::Path_TranscodeCache),
+          max_size_mb * 1024 * 1024);
+    qAddPostRoutine(DeleteInstance);
+  }
+  return sInstance;
+}
+
+QString TranscodedFileCache::KeyForFile(const QString& filename,
+                                        const TranscoderPreset& preset) {
+  const QFileInfo info(filename);
+
+  QStringList parts;
+  parts << info.canonicalFilePath()
+        << QString::number(info.size())
+        << QString::number(info.lastModified().toTime_t())
+        << QString::number(preset.type_)
+        << preset.extension_
+        << preset.codec_mimetype_
+        << preset.muxer_mimetype_;
+
+  // The encoders are configured from the settings in Transcoder::
+  // SetElementProperties, so changing the bitrate or quality has to give a
+  // different key.
+  QSettings s;
+  s.beginGroup("Transcoder");
+  QStringList groups = s.childGroups();
+  qSort(groups);
+  foreach (const QString& group, groups) {
+    s.beginGroup(group);
+    QStringList keys = s.childKeys();
+    qSort(keys);
+    foreach (const QString& key, keys) {
+      parts << group + "/" + key + "=" + s.value(key).toString();
+    }
+    s.endGroup();
+  }
+
+  return QCryptographicHash::hash(parts.join(QString(QChar(0))).toUtf8(),
+                                  QCryptographicHash::Sha1).toHex();
+}
+
+qint64 TranscodedFileCache::max_size() const {
+  QMutexLocker l(&mutex_);
+  return max_size_;
+}
+
+qint64 TranscodedFileCache::size() const {
+  QMutexLocker l(&mutex_);
+  return total_size_;
+}
+
+int TranscodedFileCache::count() const {
+  QMutexLocker l(&mutex_);
+  return entries_.count();
+}
+
+void TranscodedFileCache::set_max_size(qint64 max_size) {
+  QMutexLocker l(&mutex_);
+  max_size_ = max_size;
+  EvictUntilBelow(max_size_);
+}
+
+QString TranscodedFileCache::EntryPath(const QString& key) const {
+  return directory_ + "/" + key;
+}
+
+bool TranscodedFileCache::CopyTo(const QString& key,
+                                 const QString& destination) {
+  QMutexLocker l(&mutex_);
+  if (max_size_ <= 0 || !entries_.contains(key))
+    return false;
+
+  // QFile::copy refuses to overwrite anything.
+  if (QFile::exists(destination))
+    QFile::remove(destination);
+
+  if (!QFile::copy(EntryPath(key), destination)) {
+    qLog(Warning) << "Failed to copy cached file" << EntryPath(key)
+                  << "to" << destination;
+    Remove(key);
+    return false;
+  }
+
+  Touch(key);
+  return true;
+}
+
+bool TranscodedFileCache::Insert(const QString& key, const QString& filename) {
+  const qint64 size = QFileInfo(filename).size();
+
+  QMutexLocker l(&mutex_);
+  if (max_size_ <= 0 || size > max_size_)
+    return false;
+
+  if (entries_.contains(key))
+    Remove(key);
+
+  // Make room for the new file before copying it in.
+  EvictUntilBelow(max_size_ - size);
+
+  const QString path = EntryPath(key);
+  if (!QFile::copy(filename, path)) {
+    qLog(Warning) << "Failed to add" << filename << "to the transcode cache";
+    QFile::remove(path);
+    return false;
+  }
+
+  Entry entry;
+  entry.size_ = size;
+  entry.sequence_ = next_sequence_++;
+
+  entries_[key] = entry;
+  lru_[entry.sequence_] = key;
+  total_size_ += size;
+  EntriesChanged();
+
+  return true;
+}
+
+void TranscodedFileCache::Clear() {
+  QMutexLocker l(&mutex_);
+  EvictUntilBelow(0);
+  SaveIndexLocked();
+}
+
+void TranscodedFileCache::Touch(const QString& key) {
+  Entry& entry = entries_[key];
+  lru_.remove(entry.sequence_);
+  entry.sequence_ = next_sequence_++;
+  lru_[entry.sequence_] = key;
+  EntriesChanged();
+}
+
+void TranscodedFileCache::Remove(const QString& key) {
+  const Entry entry = entries_.take(key);
+  lru_.remove(entry.sequence_);
+  total_size_ -= entry.size_;
+  QFile::remove(EntryPath(key));
+  EntriesChanged();
+}
+
+void TranscodedFileCache::EvictUntilBelow(qint64 size) {
+  while (!lru_.isEmpty() && total_size_ > size) {
+    const QString key = lru_.begin().value();
+    qLog(Debug) << "Evicting" << key << "from the transcode cache";
+    Remove(key);
+  }
+}
+
+void TranscodedFileCache::EntriesChanged() {
+  if (++unsaved_changes_ >= kChangesBetweenIndexSaves)
+    SaveIndexLocked();
+}
+
+void TranscodedFileCache::LoadIndex() {
+  // The index only records the order the entries were last used in - the
+  // files in the directory are the real contents of the cache.  Anything the
+  // index doesn't know about (because we crashed before saving it) goes in
+  // the order of its modification time.
+  const QFileInfoList files = QDir(directory_).entryInfoList(
+        QDir::Files, QDir::Time | QDir::Reversed);
+
+  QHash<QString, qint64> sizes;
+  foreach (const QFileInfo& info, files) {
+    if (info.fileName() != kIndexFilename)
+      sizes[info.fileName()] = info.size();
+  }
+
+  QStringList ordered_keys;
+  QSet<QString> seen;
+  QFile index(EntryPath(kIndexFilename));
+  if (index.open(QIODevice::ReadOnly)) {
+    QTextStream stream(&index);
+    while (!stream.atEnd()) {
+      const QString key = stream.readLine().trimmed();
+      if (sizes.contains(key) && !seen.contains(key)) {
+        ordered_keys << key;
+        seen << key;
+      }
+    }
+  }
+
+  foreach (const QFileInfo& info, files) {
+    const QString key = info.fileName();
+    if (sizes.contains(key) && !seen.contains(key)) {
+      ordered_keys << key;
+      seen << key;
+    }
+  }
+
+  foreach (const QString& key, ordered_keys) {
+    Entry entry;
+    entry.size_ = sizes[key];
+    entry.sequence_ = next_sequence_++;
+
+    entries_[key] = entry;
+    lru_[entry.sequence_] = key;
+    total_size_ += entry.size_;
+  }
+
+  EvictUntilBelow(max_size_);
+  unsaved_changes_ = 0;
+}
+
+void TranscodedFileCache::SaveIndex() {
+  QMutexLocker l(&mutex_);
+  if (unsaved_changes_)
+    SaveIndexLocked();
+}
+
+void TranscodedFileCache::SaveIndexLocked() {
+  QFile index(EntryPath(kIndexFilename));
+  if (!index.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qLog(Warning) << "Couldn't write transcode cache index" << index.fileName();
+    return;
+  }
+
+  QTextStream stream(&index);
+  foreach (const QString& key, lru_.values()) {
+    stream << key << "\n";
+  }
+  unsaved_changes_ = 0;
+}
@@ -0,0 +1,106 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSCODEDFILECACHE_H
+#define TRANSCODEDFILECACHE_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+struct TranscoderPreset;
+
+// Keeps the output of previous transcoding jobs on disk so the same file
+// doesn't have to be encoded again the next time it's copied to a device.
+// Entries are keyed by a hash of everything that affects the encoder's output,
+// and the least recently used ones are thrown away when the cache grows past
+// its maximum size.  All methods are safe to call from any thread.
+class TranscodedFileCache {
+ public:
+  TranscodedFileCache(const QString& directory, qint64 max_size);
+  ~TranscodedFileCache();
+
+  static const char* kSettingsGroup;
+  static const char* kIndexFilename;
+  static const int kDefaultMaxSizeMb;
+  static const int kChangesBetweenIndexSaves;
+
+  // The cache shared by everything that copies files to devices.  Its size is
+  // read from the settings the first time this is called.
+  static TranscodedFileCache* Instance();
+
+  // Returns a key that identifies the result of transcoding this file with
+  // this preset: it includes the file's path, size and modification time, the
+  // preset's codec and muxer and the user's encoder settings.
+  static QString KeyForFile(const QString& filename,
+                            const TranscoderPreset& preset);
+
+  QString directory() const { return directory_; }
+  qint64 max_size() const;
+  qint64 size() const;
+  int count() const;
+
+  // A maximum size of 0 disables the cache.
+  void set_max_size(qint64 max_size);
+
+  // Copies the cached result for key to destination.  Returns false if nothing
+  // is cached for this key.
+  bool CopyTo(const QString& key, const QString& destination);
+
+  // Adds a copy of filename to the cache under key.
+  bool Insert(const QString& key, const QString& filename);
+
+  void Clear();
+
+  // Writes the order of the entries to disk if it has changed since it was
+  // last saved.
+  void SaveIndex();
+
+ private:
+  struct Entry {
+    Entry() : size_(0), sequence_(0) {}
+
+    qint64 size_;
+    quint64 sequence_;
+  };
+
+  QString EntryPath(const QString& key) const;
+  void LoadIndex();
+  void Touch(const QString& key);
+  void Remove(const QString& key);
+  void EvictUntilBelow(qint64 size);
+  void EntriesChanged();
+  void SaveIndexLocked();
+
+ private:
+  mutable QMutex mutex_;
+
+  QString directory_;
+  qint64 max_size_;
+  qint64 total_size_;
+
+  QHash<QString, Entry> entries_;
+
+  // Keys ordered from least recently used to most recently used.
+  QMap<quint64, QString> lru_;
+  quint64 next_sequence_;
+
+  int unsaved_changes_;
+};
+
+#endif // TRANSCODEDFILECACHE_H
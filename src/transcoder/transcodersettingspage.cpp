@@ -15,16 +15,21 @@
    along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "transcodedfilecache.h"
 #include "transcodersettingspage.h"
 #include "ui_transcodersettingspage.h"
 #include "ui/iconloader.h"
 
+#include <QSettings>
+
 TranscoderSettingsPage::TranscoderSettingsPage(SettingsDialog* dialog)
   : SettingsPage(dialog),
     ui_(new Ui_TranscoderSettingsPage)
 {
   ui_->setupUi(this);
   setWindowIcon(IconLoader::Load("tools-wizard"));
+
+  connect(ui_->clear_cache, SIGNAL(clicked()), SLOT(ClearCache()));
 }
 
 TranscoderSettingsPage::~TranscoderSettingsPage() {
@@ -39,6 +44,11 @@ void TranscoderSettingsPage::Load() {
   ui_->transcoding_vorbis->Load();
   ui_->transcoding_wma->Load();
   ui_->transcoding_opus->Load();
+
+  QSettings s;
+  s.beginGroup(TranscodedFileCache::kSettingsGroup);
+  ui_->cache_size->setValue(
+        s.value("max_size_mb", TranscodedFileCache::kDefaultMaxSizeMb).toInt());
 }
 
 void TranscoderSettingsPage::Save() {
@@ -49,4 +59,15 @@ void TranscoderSettingsPage::Save() {
   ui_->transcoding_vorbis->Save();
   ui_->transcoding_wma->Save();
   ui_->transcoding_opus->Load();
+
+  QSettings s;
+  s.beginGroup(TranscodedFileCache::kSettingsGroup);
+  s.setValue("max_size_mb", ui_->cache_size->value());
+
+  TranscodedFileCache::Instance()->set_max_size(
+        qint64(ui_->cache_size->value()) * 1024 * 1024);
+}
+
+void TranscoderSettingsPage::ClearCache() {
+  TranscodedFileCache::Instance()->Clear();
 }
@@ -32,6 +32,9 @@ public:
   void Load();
   void Save();
 
+private slots:
+  void ClearCache();
+
 private:
   Ui_TranscoderSettingsPage* ui_;
 };
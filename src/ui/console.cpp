@@ -1,13 +1,17 @@
 #include "console.h"
 
+#include <QDir>
+#include <QFileDialog>
 #include <QFont>
 #include <QScrollBar>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlRecord>
+#include <QTextDocument>
 
 #include "core/application.h"
 #include "core/database.h"
+#include "core/tracer.h"
 
 Console::Console(Application* app, QWidget* parent)
     : QDialog(parent),
@@ -15,6 +19,13 @@ Console::Console(Application* app, QWidget* parent)
   ui_.setupUi(this);
   connect(ui_.run, SIGNAL(clicked()), SLOT(RunQuery()));
 
+  ui_.profile->setChecked(app_->database()->profiler()->is_enabled());
+  connect(ui_.profile, SIGNAL(toggled(bool)), SLOT(ProfileToggled(bool)));
+
+  // It might have been started from the command line.
+  ui_.trace->setChecked(Tracer::is_enabled());
+  connect(ui_.trace, SIGNAL(toggled(bool)), SLOT(TraceToggled(bool)));
+
   QFont font("Monospace");
   font.setStyleHint(QFont::TypeWriter);
 
@@ -46,3 +57,57 @@ void Console::RunQuery() {
   ui_.output->verticalScrollBar()->setValue(
       ui_.output->verticalScrollBar()->maximum());
 }
+
+void Console::ProfileToggled(bool enabled) {
+  SqlProfiler* profiler = app_->database()->profiler();
+
+  if (enabled) {
+    profiler->Start();
+    ui_.output->append(tr("Profiling SQL queries"));
+    return;
+  }
+
+  profiler->Stop();
+
+  const SqlProfiler::QueryStatsList stats = app_->database()->ProfileResults();
+  ui_.output->append("<pre>" + Qt::escape(SqlProfiler::FormatReport(
+      stats, profiler->slow_query_msec())) + "</pre>");
+  ui_.output->verticalScrollBar()->setValue(
+      ui_.output->verticalScrollBar()->maximum());
+
+  const QString filename = QFileDialog::getSaveFileName(
+      this, tr("Save SQL profile"),
+      QDir::homePath() + "/clementine-sql-profile.json",
+      tr("JSON files (*.json)"));
+  if (filename.isEmpty())
+    return;
+
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(SqlProfiler::ToJson(stats, profiler->slow_query_msec())) == -1) {
+    ui_.output->append(tr("Couldn't write to %1").arg(filename));
+  }
+}
+
+void Console::TraceToggled(bool enabled) {
+  if (enabled) {
+    Tracer::Start();
+    ui_.output->append(tr("Recording a trace"));
+    return;
+  }
+
+  Tracer::Stop();
+
+  const QString filename = QFileDialog::getSaveFileName(
+      this, tr("Save trace"), QDir::homePath() + "/clementine-trace.json",
+      tr("Chrome trace files (*.json)"));
+  if (filename.isEmpty())
+    return;
+
+  if (Tracer::Save(filename)) {
+    ui_.output->append(tr("Saved %1 events to %2 - open it in chrome://tracing")
+                       .arg(Tracer::event_count()).arg(filename));
+  } else {
+    ui_.output->append(tr("Couldn't write to %1").arg(filename));
+  }
+}
@@ -14,6 +14,8 @@ class Console : public QDialog {
 
  private slots:
   void RunQuery();
+  void ProfileToggled(bool enabled);
+  void TraceToggled(bool enabled);
 
  private:
   Ui::Console ui_;
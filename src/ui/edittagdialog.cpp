@@ -55,7 +55,7 @@ EditTagDialog::EditTagDialog(Application* app, QWidget* parent)
     album_cover_choice_controller_(new AlbumCoverChoiceController(this)),
     loading_(false),
     ignore_edits_(false),
-    tag_fetcher_(new TagFetcher(this)),
+    tag_fetcher_(new TagFetcher(app->library_backend(), this)),
     cover_art_id_(0),
     cover_art_is_set_(false),
     results_dialog_(new TrackSelectionDialog(this))
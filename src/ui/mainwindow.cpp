@@ -352,6 +352,7 @@ MainWindow::MainWindow(Application* app,
   connect(ui_->action_jump, SIGNAL(triggered()), ui_->playlist->view(), SLOT(JumpToCurrentlyPlayingTrack()));
   connect(ui_->action_update_library, SIGNAL(triggered()), app_->library(), SLOT(IncrementalScan()));
   connect(ui_->action_full_library_scan, SIGNAL(triggered()), app_->library(), SLOT(FullScan()));
+  connect(ui_->action_rebuild_library_search_index, SIGNAL(triggered()), app_->library(), SLOT(RebuildSearchIndex()));
   connect(ui_->action_queue_manager, SIGNAL(triggered()), SLOT(ShowQueueManager()));
   connect(ui_->action_add_files_to_transcoder, SIGNAL(triggered()), SLOT(AddFilesToTranscoder()));
 
@@ -460,10 +461,12 @@ MainWindow::MainWindow(Application* app,
   library_show_all_ = library_view_group->addAction(tr("Show all songs"));
   library_show_duplicates_ = library_view_group->addAction(tr("Show only duplicates"));
   library_show_untagged_ = library_view_group->addAction(tr("Show only untagged"));
+  library_show_identical_audio_ = library_view_group->addAction(tr("Show songs with identical audio"));
 
   library_show_all_->setCheckable(true);
   library_show_duplicates_->setCheckable(true);
   library_show_untagged_->setCheckable(true);
+  library_show_identical_audio_->setCheckable(true);
   library_show_all_->setChecked(true);
 
   connect(library_view_group, SIGNAL(triggered(QAction*)), SLOT(ChangeLibraryQueryMode(QAction*)));
@@ -480,6 +483,7 @@ MainWindow::MainWindow(Application* app,
   library_view_->filter()->AddMenuAction(library_show_all_);
   library_view_->filter()->AddMenuAction(library_show_duplicates_);
   library_view_->filter()->AddMenuAction(library_show_untagged_);
+  library_view_->filter()->AddMenuAction(library_show_identical_audio_);
   library_view_->filter()->AddMenuAction(separator);
   library_view_->filter()->AddMenuAction(library_config_action);
 
@@ -656,9 +660,9 @@ MainWindow::MainWindow(Application* app,
 
   ui_->track_slider->SetApplication(app);
 #ifdef HAVE_MOODBAR
-  // Moodbar connections
-  connect(app_->moodbar_controller(), SIGNAL(CurrentMoodbarDataChanged(QByteArray)),
-          ui_->track_slider->moodbar_style(), SLOT(SetMoodbarData(QByteArray)));
+  // Asking for the moodbar controller here would create it before the window
+  // is shown, so wait until the idle services have started it.
+  connect(app_, SIGNAL(IdleServicesStarted()), SLOT(ConnectMoodbarController()));
 #endif
 
   // Now playing widget
@@ -1823,6 +1827,13 @@ void MainWindow::TaskCountChanged(int count) {
   }
 }
 
+#ifdef HAVE_MOODBAR
+void MainWindow::ConnectMoodbarController() {
+  connect(app_->moodbar_controller(), SIGNAL(CurrentMoodbarDataChanged(QByteArray)),
+          ui_->track_slider->moodbar_style(), SLOT(SetMoodbarData(QByteArray)));
+}
+#endif
+
 void MainWindow::NowPlayingWidgetPositionChanged(bool above_status_bar) {
   if (above_status_bar) {
     ui_->status_bar->setParent(ui_->centralWidget);
@@ -1980,6 +1991,9 @@ void MainWindow::ChangeLibraryQueryMode(QAction* action) {
     library_view_->filter()->SetQueryMode(QueryOptions::QueryMode_Duplicates);
   } else if (action == library_show_untagged_) {
     library_view_->filter()->SetQueryMode(QueryOptions::QueryMode_Untagged);
+  } else if (action == library_show_identical_audio_) {
+    library_view_->filter()->SetQueryMode(QueryOptions::QueryMode_IdenticalAudio);
+    app_->library()->FindDuplicates();
   } else {
     library_view_->filter()->SetQueryMode(QueryOptions::QueryMode_All);
   }
@@ -2188,7 +2202,7 @@ void MainWindow::Exit() {
 void MainWindow::AutoCompleteTags() {
   // Create the tag fetching stuff if it hasn't been already
   if (!tag_fetcher_) {
-    tag_fetcher_.reset(new TagFetcher);
+    tag_fetcher_.reset(new TagFetcher(app_->library_backend()));
     track_selection_dialog_.reset(new TrackSelectionDialog);
     track_selection_dialog_->set_save_on_close(true);
 
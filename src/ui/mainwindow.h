@@ -200,6 +200,9 @@ class MainWindow : public QMainWindow, public PlatformInterface {
 #endif
 
   void TaskCountChanged(int count);
+#ifdef HAVE_MOODBAR
+  void ConnectMoodbarController();
+#endif
 
   void ShowLibraryConfig();
   void ReloadSettings();
@@ -317,6 +320,7 @@ class MainWindow : public QMainWindow, public PlatformInterface {
   QAction* library_show_all_;
   QAction* library_show_duplicates_;
   QAction* library_show_untagged_;
+  QAction* library_show_identical_audio_;
 
   QMenu* playlist_menu_;
   QAction* playlist_play_pause_;
@@ -0,0 +1,177 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "gtest/gtest.h"
+
+#include "mock_httpserver.h"
+#include "musicbrainz/acoustidclient.h"
+#include "test_utils.h"
+
+#include <QEventLoop>
+#include <QSignalSpy>
+#include <QStringList>
+#include <QTime>
+#include <QTimer>
+#include <QUrl>
+
+namespace {
+
+class AcoustidClientTest : public ::testing::Test {
+ protected:
+  static const int kTimeoutMsec = 10000;
+
+  void SetUp() {
+    ASSERT_TRUE(server_.listen(QHostAddress::LocalHost));
+    client_.SetUrl(server_.url("/v2/lookup"));
+  }
+
+  // A reply with a recording for each of the first |count| fingerprints in
+  // the request.
+  static QByteArray Reply(int count) {
+    QStringList fingerprints;
+    for (int i=0 ; i<count ; ++i) {
+      fingerprints << QString(
+          "{\"index\": \"%1\", \"results\": [{\"id\": \"result%1\","
+          " \"recordings\": [{\"id\": \"mbid%1\"}]}]}").arg(i);
+    }
+    return QString("{\"status\": \"ok\", \"fingerprints\": [%1]}")
+        .arg(fingerprints.join(", ")).toUtf8();
+  }
+
+  // Waits for |count| Finished signals and returns the MBIDs, keyed on ID.
+  QMap<int, QString> WaitForResults(QSignalSpy* spy, int count) {
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    timeout.start(kTimeoutMsec);
+
+    while (spy->count() < count && timeout.isActive()) {
+      loop.processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    QMap<int, QString> ret;
+    foreach (const QList<QVariant>& args, *spy) {
+      ret[args[0].toInt()] = args[1].toString();
+    }
+    return ret;
+  }
+
+  static QMap<QString, QString> ParseBody(const QByteArray& body) {
+    QUrl url;
+    url.setEncodedQuery(body);
+
+    QMap<QString, QString> ret;
+    typedef QPair<QString, QString> Param;
+    foreach (const Param& param, url.queryItems()) {
+      ret[param.first] = param.second;
+    }
+    return ret;
+  }
+
+  MockHttpServer server_;
+  AcoustidClient client_;
+};
+
+TEST_F(AcoustidClientTest, BatchesLookups) {
+  server_.SetContent(Reply(3));
+  QSignalSpy spy(&client_, SIGNAL(Finished(int,QString)));
+
+  client_.Start(10, "fingerprint-a", 60000);
+  client_.Start(11, "fingerprint-b", 120000);
+  client_.Start(12, "fingerprint-c", 180000);
+
+  QMap<int, QString> results = WaitForResults(&spy, 3);
+  ASSERT_EQ(3, results.count());
+  EXPECT_EQ("mbid0", results[10]);
+  EXPECT_EQ("mbid1", results[11]);
+  EXPECT_EQ("mbid2", results[12]);
+
+  // All three went in one request.
+  ASSERT_EQ(1, server_.request_bodies().count());
+  QMap<QString, QString> params = ParseBody(server_.request_bodies()[0]);
+  EXPECT_EQ("fingerprint-a", params["fingerprint.0"]);
+  EXPECT_EQ("fingerprint-b", params["fingerprint.1"]);
+  EXPECT_EQ("fingerprint-c", params["fingerprint.2"]);
+  EXPECT_EQ("60", params["duration.0"]);
+  EXPECT_EQ("180", params["duration.2"]);
+}
+
+TEST_F(AcoustidClientTest, RateLimitsRequests) {
+  server_.SetContent(Reply(10));
+  QSignalSpy spy(&client_, SIGNAL(Finished(int,QString)));
+
+  QTime time;
+  time.start();
+  for (int i=0 ; i<25 ; ++i) {
+    client_.Start(i, QString("fingerprint-%1").arg(i), 60000);
+  }
+
+  QMap<int, QString> results = WaitForResults(&spy, 25);
+  ASSERT_EQ(25, results.count());
+  EXPECT_EQ("mbid0", results[0]);
+  EXPECT_EQ("mbid9", results[9]);
+  EXPECT_EQ("mbid0", results[10]);
+  EXPECT_EQ("mbid4", results[24]);
+
+  // Ten lookups in each request, and at least a third of a second between
+  // each one.
+  EXPECT_EQ(3, server_.request_bodies().count());
+  EXPECT_GE(time.elapsed(), 600);
+}
+
+TEST_F(AcoustidClientTest, MissingResults) {
+  server_.SetContent(Reply(1));
+  QSignalSpy spy(&client_, SIGNAL(Finished(int,QString)));
+
+  client_.Start(1, "fingerprint-a", 60000);
+  client_.Start(2, "fingerprint-b", 60000);
+
+  QMap<int, QString> results = WaitForResults(&spy, 2);
+  ASSERT_EQ(2, results.count());
+  EXPECT_EQ("mbid0", results[1]);
+  EXPECT_TRUE(results[2].isEmpty());
+}
+
+TEST_F(AcoustidClientTest, HttpError) {
+  server_.SetStatus(503);
+  QSignalSpy spy(&client_, SIGNAL(Finished(int,QString)));
+
+  client_.Start(1, "fingerprint-a", 60000);
+
+  QMap<int, QString> results = WaitForResults(&spy, 1);
+  ASSERT_EQ(1, results.count());
+  EXPECT_TRUE(results[1].isEmpty());
+}
+
+TEST_F(AcoustidClientTest, CancelQueuedLookup) {
+  server_.SetContent(Reply(2));
+  QSignalSpy spy(&client_, SIGNAL(Finished(int,QString)));
+
+  client_.Start(1, "fingerprint-a", 60000);
+  client_.Start(2, "fingerprint-b", 60000);
+  client_.Cancel(1);
+
+  QMap<int, QString> results = WaitForResults(&spy, 1);
+  ASSERT_EQ(1, results.count());
+  EXPECT_EQ("mbid0", results[2]);
+
+  ASSERT_EQ(1, server_.request_bodies().count());
+  EXPECT_EQ("fingerprint-b", ParseBody(server_.request_bodies()[0])["fingerprint.0"]);
+}
+
+}  // namespace
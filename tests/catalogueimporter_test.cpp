@@ -0,0 +1,154 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+#include "core/database.h"
+#include "internet/catalogueimporter.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
+
+#include <boost/scoped_ptr.hpp>
+
+class CatalogueImporterTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    database_.reset(new MemoryDatabase(NULL));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    importer_.reset(new CatalogueImporter(NULL, backend_.get()));
+  }
+
+  SongList MakeSongs(const QString& prefix, int count) {
+    SongList ret;
+    for (int i=0 ; i<count ; ++i) {
+      Song song;
+      song.Init(QString("%1 %2").arg(prefix).arg(i), "Artist", "Album", 100);
+      song.set_url(QUrl(QString("http://example.com/%1/%2").arg(prefix).arg(i)));
+      song.set_valid(true);
+      ret << song;
+    }
+    return ret;
+  }
+
+  // Does everything Import does apart from downloading and parsing the XML.
+  void Import(const SongList& songs) {
+    ASSERT_TRUE(importer_->CreateShadowTables());
+    importer_->AddSongs(songs);
+    importer_->FlushSongs();
+    ASSERT_TRUE(importer_->SwapShadowTables());
+  }
+
+  QStringList Query(const QString& sql) {
+    QMutexLocker l(database_->Mutex());
+    QSqlQuery q(database_->Connect());
+    EXPECT_TRUE(q.exec(sql));
+
+    QStringList ret;
+    while (q.next()) {
+      QStringList row;
+      for (int i=0 ; i<q.record().count() ; ++i) {
+        row << q.value(i).toString();
+      }
+      ret << row.join(" ");
+    }
+    return ret;
+  }
+
+  QStringList Titles() {
+    return Query("SELECT title FROM songs ORDER BY ROWID");
+  }
+
+  // The titles of the songs the FTS index finds.
+  QStringList Search(const QString& match) {
+    return Query("SELECT songs.title FROM songs_fts"
+                 " JOIN songs ON songs.ROWID = songs_fts.ROWID"
+                 " WHERE songs_fts MATCH '" + match + "'");
+  }
+
+  QStringList Indexes() {
+    QStringList ret = Query("SELECT name FROM sqlite_master"
+                            " WHERE type = 'index' AND tbl_name = 'songs'"
+                            " AND sql NOT NULL");
+    ret.sort();
+    return ret;
+  }
+
+  boost::scoped_ptr<Database> database_;
+  boost::scoped_ptr<LibraryBackend> backend_;
+  boost::scoped_ptr<CatalogueImporter> importer_;
+};
+
+TEST_F(CatalogueImporterTest, OldCatalogueUntilSwap) {
+  Import(MakeSongs("Old", 2));
+  ASSERT_EQ(QStringList() << "Old 0" << "Old 1", Titles());
+
+  // The new songs are only in the shadow tables until the swap.
+  ASSERT_TRUE(importer_->CreateShadowTables());
+  importer_->AddSongs(MakeSongs("New", 3));
+  importer_->FlushSongs();
+  EXPECT_EQ(QStringList() << "Old 0" << "Old 1", Titles());
+  EXPECT_EQ(2, backend_->GetAllSongs().count());
+  EXPECT_EQ(QStringList() << "Old 1", Search("old 1"));
+
+  ASSERT_TRUE(importer_->SwapShadowTables());
+  EXPECT_EQ(QStringList() << "New 0" << "New 1" << "New 2", Titles());
+  EXPECT_EQ(QStringList() << "New 1", Search("new 1"));
+  EXPECT_TRUE(Search("old").isEmpty());
+
+  // The shadow tables are gone.
+  EXPECT_TRUE(Query("SELECT name FROM sqlite_master"
+                    " WHERE type = 'table' AND name LIKE '%_import'").isEmpty());
+}
+
+TEST_F(CatalogueImporterTest, FtsMatchesSongs) {
+  // More than one batch.
+  const int count = CatalogueImporter::kBatchSize * 2 + 10;
+  Import(MakeSongs("Title", count));
+
+  const QStringList songs = Query(
+      "SELECT ROWID, title, artist, album FROM songs ORDER BY ROWID");
+  ASSERT_EQ(count, songs.count());
+  EXPECT_EQ(songs, Query("SELECT ROWID, ftstitle, ftsartist, ftsalbum"
+                         " FROM songs_fts ORDER BY ROWID"));
+
+  EXPECT_EQ(QStringList() << "Title 1500", Search("1500"));
+}
+
+TEST_F(CatalogueImporterTest, KeepsIndexes) {
+  const QStringList indexes = Indexes();
+  ASSERT_FALSE(indexes.isEmpty());
+
+  // The indexes made for the shadow table have different names.
+  Import(MakeSongs("First", 2));
+  QStringList shadow_indexes;
+  foreach (const QString& index, indexes) {
+    shadow_indexes << index + CatalogueImporter::kShadowSuffix;
+  }
+  shadow_indexes.sort();
+  EXPECT_EQ(shadow_indexes, Indexes());
+
+  // They go back to the original names the next time.
+  Import(MakeSongs("Second", 2));
+  EXPECT_EQ(indexes, Indexes());
+}
@@ -0,0 +1,201 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+#include "covers/coverprovider.h"
+#include "covers/coverproviderscheduler.h"
+
+#include <QCoreApplication>
+#include <QSignalSpy>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace {
+
+class FakeCoverProvider : public CoverProvider {
+ public:
+  FakeCoverProvider(const QString& name, int max_concurrent,
+                    float per_second)
+    : CoverProvider(name, NULL),
+      max_concurrent_(max_concurrent),
+      per_second_(per_second) {}
+
+  bool StartSearch(const QString&, const QString&, int id) {
+    started_ << id;
+    return true;
+  }
+
+  void CancelSearch(int id) { cancelled_ << id; }
+
+  int max_concurrent_searches() const { return max_concurrent_; }
+  float searches_per_second() const { return per_second_; }
+
+  void Reply(int id, int result_count) {
+    CoverSearchResults results;
+    for (int i=0 ; i<result_count ; ++i) {
+      results << CoverSearchResult();
+    }
+    emit SearchFinished(id, results);
+  }
+
+  QList<int> started_;
+  QList<int> cancelled_;
+
+ private:
+  int max_concurrent_;
+  float per_second_;
+};
+
+class CoverProviderSchedulerTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    qRegisterMetaType<QList<CoverSearchResult> >("QList<CoverSearchResult>");
+  }
+
+  void SetUp() {
+    // No settings group, so the statistics aren't saved anywhere.
+    scheduler_.reset(new CoverProviderScheduler(QString()));
+  }
+
+  void ProcessEvents() {
+    QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+  }
+
+  boost::scoped_ptr<CoverProviderScheduler> scheduler_;
+};
+
+TEST_F(CoverProviderSchedulerTest, ConcurrencyLimit) {
+  FakeCoverProvider provider("foo", 1, 1000.0);
+
+  scheduler_->QueueSearch(&provider, "artist", "album", 1);
+  scheduler_->QueueSearch(&provider, "artist", "album", 2);
+  EXPECT_EQ(QList<int>() << 1, provider.started_);
+  EXPECT_EQ(1, scheduler_->in_flight_count(&provider));
+  EXPECT_EQ(1, scheduler_->queued_count(&provider));
+
+  provider.Reply(1, 0);
+  ProcessEvents();
+  EXPECT_EQ(QList<int>() << 1 << 2, provider.started_);
+  EXPECT_EQ(0, scheduler_->queued_count(&provider));
+}
+
+TEST_F(CoverProviderSchedulerTest, RateLimit) {
+  // The bucket holds two tokens and takes over a minute to refill.
+  FakeCoverProvider provider("foo", 2, 0.01);
+
+  for (int i=0 ; i<4 ; ++i) {
+    scheduler_->QueueSearch(&provider, "artist", "album", i);
+  }
+  EXPECT_EQ(2, provider.started_.count());
+
+  provider.Reply(0, 0);
+  provider.Reply(1, 0);
+  ProcessEvents();
+  EXPECT_EQ(2, provider.started_.count());
+  EXPECT_EQ(0, scheduler_->in_flight_count(&provider));
+  EXPECT_EQ(2, scheduler_->queued_count(&provider));
+}
+
+TEST_F(CoverProviderSchedulerTest, ForwardsResults) {
+  FakeCoverProvider provider("foo", 1, 1000.0);
+  QSignalSpy spy(scheduler_.get(),
+                 SIGNAL(SearchFinished(int,QList<CoverSearchResult>)));
+
+  scheduler_->QueueSearch(&provider, "artist", "album", 42);
+  provider.Reply(42, 3);
+
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(42, spy[0][0].toInt());
+
+  // Replies to searches the scheduler doesn't know about are ignored.
+  provider.Reply(43, 1);
+  EXPECT_EQ(1, spy.count());
+}
+
+TEST_F(CoverProviderSchedulerTest, Cancel) {
+  FakeCoverProvider provider("foo", 1, 1000.0);
+  QSignalSpy spy(scheduler_.get(),
+                 SIGNAL(SearchFinished(int,QList<CoverSearchResult>)));
+
+  scheduler_->QueueSearch(&provider, "artist", "album", 1);
+  scheduler_->QueueSearch(&provider, "artist", "album", 2);
+  scheduler_->QueueSearch(&provider, "artist", "album", 3);
+
+  // Cancelling a queued search means it never starts.
+  scheduler_->CancelSearch(2);
+  EXPECT_EQ(1, scheduler_->queued_count(&provider));
+
+  // Cancelling a running search frees its slot.
+  scheduler_->CancelSearch(1);
+  EXPECT_EQ(QList<int>() << 1, provider.cancelled_);
+  ProcessEvents();
+  EXPECT_EQ(QList<int>() << 1 << 3, provider.started_);
+
+  provider.Reply(1, 1);
+  EXPECT_EQ(0, spy.count());
+}
+
+TEST_F(CoverProviderSchedulerTest, RanksByHitRate) {
+  FakeCoverProvider good("good", 1, 1.0);
+  FakeCoverProvider bad("bad", 1, 1.0);
+
+  for (int i=0 ; i<10 ; ++i) {
+    scheduler_->RecordResult("good", i % 2 == 0, 500);
+    scheduler_->RecordResult("bad", i == 0, 500);
+  }
+
+  EXPECT_GT(scheduler_->Score("good"), scheduler_->Score("bad"));
+  EXPECT_EQ(QList<CoverProvider*>() << &good << &bad,
+            scheduler_->RankProviders(QList<CoverProvider*>() << &bad << &good));
+}
+
+TEST_F(CoverProviderSchedulerTest, RanksByLatency) {
+  for (int i=0 ; i<10 ; ++i) {
+    scheduler_->RecordResult("fast", true, 200);
+    scheduler_->RecordResult("slow", true, 5000);
+  }
+
+  EXPECT_GT(scheduler_->Score("fast"), scheduler_->Score("slow"));
+}
+
+TEST_F(CoverProviderSchedulerTest, UnknownProvidersGetAChance) {
+  for (int i=0 ; i<10 ; ++i) {
+    scheduler_->RecordResult("useless", false, 500);
+  }
+
+  EXPECT_GT(scheduler_->Score("new"), scheduler_->Score("useless"));
+}
+
+TEST_F(CoverProviderSchedulerTest, ResultsUpdateRanking) {
+  FakeCoverProvider provider("foo", 1, 1000.0);
+  const float initial_score = scheduler_->Score("foo");
+
+  scheduler_->QueueSearch(&provider, "artist", "album", 1);
+  provider.Reply(1, 2);
+  const float score_after_hit = scheduler_->Score("foo");
+  EXPECT_GT(score_after_hit, initial_score);
+
+  ProcessEvents();
+  scheduler_->QueueSearch(&provider, "artist", "album", 2);
+  scheduler_->SearchTimedOut(2);
+  EXPECT_LT(scheduler_->Score("foo"), score_after_hit);
+  EXPECT_EQ(QList<int>() << 2, provider.cancelled_);
+}
+
+}  // namespace
@@ -0,0 +1,217 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "mock_librarybackend.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "core/timeconstants.h"
+#include "playlistparsers/cuecache.h"
+
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include <utime.h>
+
+using ::testing::_;
+using ::testing::Return;
+
+namespace {
+
+// The media file doesn't exist, so nothing needs to be read from it.
+const char* kSheetFormat =
+    "PERFORMER \"Artist\"\n"
+    "TITLE \"Album\"\n"
+    "FILE \"missing.flac\" WAVE\n"
+    "  TRACK 01 AUDIO\n"
+    "    TITLE \"%1\"\n"
+    "    INDEX 01 00:00:00\n"
+    "  TRACK 02 AUDIO\n"
+    "    TITLE \"%2\"\n"
+    "    INDEX 01 03:00:00\n";
+
+}  // namespace
+
+class CueCacheTest : public ::testing::Test {
+ protected:
+  // Replaces the contents of the sheet and sets its modification time.
+  void WriteSheet(QTemporaryFile* file, const QString& first,
+                  const QString& second, time_t mtime) {
+    if (!file->isOpen()) {
+      ASSERT_TRUE(file->open());
+    }
+    file->resize(0);
+    file->seek(0);
+    file->write(QString(kSheetFormat).arg(first, second).toUtf8());
+    file->flush();
+
+    utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    ASSERT_EQ(0, utime(QFile::encodeName(file->fileName()).constData(),
+                       &times));
+  }
+
+  QStringList Titles(const SongList& songs) const {
+    QStringList ret;
+    foreach (const Song& song, songs) {
+      ret << song.title();
+    }
+    return ret;
+  }
+};
+
+TEST_F(CueCacheTest, LoadsSheet) {
+  QTemporaryFile sheet;
+  WriteSheet(&sheet, "One", "Two", 1000);
+
+  CueCache cache;
+  SongList songs = cache.Load(sheet.fileName());
+  ASSERT_EQ(2, songs.count());
+  EXPECT_EQ("One", songs[0].title());
+  EXPECT_EQ("Artist", songs[0].artist());
+  EXPECT_EQ("Album", songs[0].album());
+  EXPECT_EQ(0, songs[0].beginning_nanosec());
+  EXPECT_EQ(180 * kNsecPerSec, songs[0].end_nanosec());
+  EXPECT_EQ(sheet.fileName(), songs[0].cue_path());
+  EXPECT_EQ("Two", songs[1].title());
+  EXPECT_EQ(180 * kNsecPerSec, songs[1].beginning_nanosec());
+}
+
+TEST_F(CueCacheTest, MissingSheet) {
+  CueCache cache;
+  EXPECT_TRUE(cache.Load("/nonexistent/sheet.cue").isEmpty());
+}
+
+TEST_F(CueCacheTest, HitWhenUnchanged) {
+  QTemporaryFile sheet;
+  WriteSheet(&sheet, "One", "Two", 1000);
+
+  CueCache cache;
+  cache.Load(sheet.fileName());
+
+  // Same modification time, so the new contents aren't read.
+  WriteSheet(&sheet, "Three", "Four", 1000);
+  EXPECT_EQ(QStringList() << "One" << "Two",
+            Titles(cache.Load(sheet.fileName())));
+}
+
+TEST_F(CueCacheTest, MissWhenSheetChanged) {
+  QTemporaryFile sheet;
+  WriteSheet(&sheet, "One", "Two", 1000);
+
+  CueCache cache;
+  cache.Load(sheet.fileName());
+
+  WriteSheet(&sheet, "Three", "Four", 2000);
+  EXPECT_EQ(QStringList() << "Three" << "Four",
+            Titles(cache.Load(sheet.fileName())));
+}
+
+TEST_F(CueCacheTest, Clear) {
+  QTemporaryFile sheet;
+  WriteSheet(&sheet, "One", "Two", 1000);
+
+  CueCache cache;
+  cache.Load(sheet.fileName());
+  cache.Clear();
+
+  WriteSheet(&sheet, "Three", "Four", 1000);
+  EXPECT_EQ(QStringList() << "Three" << "Four",
+            Titles(cache.Load(sheet.fileName())));
+}
+
+TEST_F(CueCacheTest, EvictsOldestSheet) {
+  QTemporaryFile first;
+  QTemporaryFile second;
+  WriteSheet(&first, "One", "Two", 1000);
+  WriteSheet(&second, "Three", "Four", 1000);
+
+  // Only room for one sheet of two songs.
+  CueCache cache(2);
+  cache.Load(first.fileName());
+  cache.Load(second.fileName());
+
+  WriteSheet(&first, "Five", "Six", 1000);
+  WriteSheet(&second, "Seven", "Eight", 1000);
+  EXPECT_EQ(QStringList() << "Five" << "Six",
+            Titles(cache.Load(first.fileName())));
+  EXPECT_EQ(QStringList() << "Three" << "Four",
+            Titles(cache.Load(second.fileName())));
+}
+
+TEST_F(CueCacheTest, AddsLibraryData) {
+  QTemporaryFile sheet;
+  WriteSheet(&sheet, "One", "Two", 1000);
+
+  Song library_song;
+  library_song.Init("Old title", "Old artist", "Old album",
+                    180 * kNsecPerSec, 200 * kNsecPerSec);
+  library_song.set_id(42);
+  library_song.set_playcount(5);
+  library_song.set_rating(0.6);
+  library_song.set_url(QUrl::fromLocalFile(
+      QFileInfo(sheet.fileName()).path() + "/missing.flac"));
+
+  MockLibraryBackend library;
+  EXPECT_CALL(library, GetSongsByUrls(_))
+      .WillOnce(Return(SongList() << library_song));
+
+  CueCache cache;
+
+  // The library is only asked the first time, after that the songs come from
+  // the cache with their library data.
+  for (int i=0 ; i<3 ; ++i) {
+    SongList songs = cache.Load(sheet.fileName(), &library);
+    ASSERT_EQ(2, songs.count());
+    EXPECT_EQ(-1, songs[0].id());
+    EXPECT_EQ(42, songs[1].id());
+    EXPECT_EQ(5, songs[1].playcount());
+    EXPECT_FLOAT_EQ(0.6, songs[1].rating());
+    EXPECT_EQ("Two", songs[1].title());
+    EXPECT_EQ("Artist", songs[1].artist());
+    EXPECT_EQ(sheet.fileName(), songs[1].cue_path());
+  }
+
+  // Without a library the songs only contain what's in the files.
+  SongList songs = cache.Load(sheet.fileName());
+  ASSERT_EQ(2, songs.count());
+  EXPECT_EQ(-1, songs[1].id());
+}
+
+TEST_F(CueCacheTest, AddsLibraryDataAgainWhenSheetChanged) {
+  QTemporaryFile sheet;
+  WriteSheet(&sheet, "One", "Two", 1000);
+
+  MockLibraryBackend library;
+  EXPECT_CALL(library, GetSongsByUrls(_))
+      .Times(2)
+      .WillRepeatedly(Return(SongList()));
+
+  CueCache cache;
+
+  // Loading without a library first doesn't stop the library data being added
+  // later.
+  cache.Load(sheet.fileName());
+  cache.Load(sheet.fileName(), &library);
+  cache.Load(sheet.fileName(), &library);
+
+  WriteSheet(&sheet, "Three", "Four", 2000);
+  EXPECT_EQ(QStringList() << "Three" << "Four",
+            Titles(cache.Load(sheet.fileName(), &library)));
+}
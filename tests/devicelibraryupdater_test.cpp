@@ -0,0 +1,226 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "core/database.h"
+#include "core/song.h"
+#include "core/taskmanager.h"
+#include "devices/devicelibraryupdater.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include <QSignalSpy>
+
+namespace {
+
+class DeviceLibraryUpdaterTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(NULL));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable,
+                   Library::kDirsTable, Library::kSubdirsTable,
+                   Library::kFtsTable);
+
+    // The device's only directory - this will get ID 1
+    backend_->AddDirectory("/");
+
+    task_manager_.reset(new TaskManager);
+    task_id_ = task_manager_->StartTask("Loading device");
+  }
+
+  // Returns a track as the device's loader would make it.
+  Song MakeTrack(int i) {
+    Song ret;
+    ret.set_url(QUrl(QString("mtp://device/%1").arg(i)));
+    ret.set_title(QString("Title %1").arg(i));
+    ret.set_artist("Artist");
+    ret.set_album("Album");
+    ret.set_mtime(1);
+    ret.set_ctime(1);
+    ret.set_filesize(1000 + i);
+    return ret;
+  }
+
+  // Loads the device's tracks like a loader would, unless the generation is
+  // the same as last time.  Returns false if it was skipped.
+  bool Load(const SongList& tracks, const QString& generation) {
+    DeviceLibraryUpdater updater(backend_.get(), task_manager_.get(),
+                                 task_id_);
+    if (updater.IsUpToDate(generation))
+      return false;
+
+    updater.Start(tracks.count());
+    foreach (const Song& track, tracks) {
+      updater.AddSong(track);
+    }
+    updater.Finish(generation);
+    return true;
+  }
+
+  SongList Tracks(int count) {
+    SongList ret;
+    for (int i=0 ; i<count ; ++i) {
+      ret << MakeTrack(i);
+    }
+    return ret;
+  }
+
+  // The songs in the library indexed by URL.
+  QMap<QUrl, Song> LibrarySongs() {
+    QMap<QUrl, Song> ret;
+    foreach (const Song& song,
+             backend_->FindSongsInDirectory(DeviceLibraryUpdater::kDirectoryId)) {
+      ret[song.url()] = song;
+    }
+    return ret;
+  }
+
+  boost::shared_ptr<Database> database_;
+  boost::scoped_ptr<LibraryBackend> backend_;
+  boost::scoped_ptr<TaskManager> task_manager_;
+  int task_id_;
+};
+
+TEST_F(DeviceLibraryUpdaterTest, AddsSongs) {
+  ASSERT_TRUE(Load(Tracks(3), "1"));
+
+  QMap<QUrl, Song> songs = LibrarySongs();
+  ASSERT_EQ(3, songs.count());
+  EXPECT_EQ("Title 1", songs[MakeTrack(1).url()].title());
+  EXPECT_EQ(DeviceLibraryUpdater::kDirectoryId,
+            songs[MakeTrack(1).url()].directory_id());
+  EXPECT_EQ(3, task_manager_->GetTaskProgress(task_id_));
+}
+
+TEST_F(DeviceLibraryUpdaterTest, KeepsSongIds) {
+  ASSERT_TRUE(Load(Tracks(3), "1"));
+  QMap<QUrl, Song> before = LibrarySongs();
+
+  // Change one of the tracks and load again.
+  SongList tracks = Tracks(3);
+  tracks[1].set_title("New title");
+
+  QSignalSpy deleted_spy(backend_.get(), SIGNAL(SongsDeleted(SongList)));
+  ASSERT_TRUE(Load(tracks, "2"));
+
+  QMap<QUrl, Song> after = LibrarySongs();
+  ASSERT_EQ(3, after.count());
+  foreach (const QUrl& url, before.keys()) {
+    EXPECT_EQ(before[url].id(), after[url].id());
+  }
+  EXPECT_EQ("New title", after[tracks[1].url()].title());
+
+  // Only the changed song was written.
+  ASSERT_EQ(1, deleted_spy.count());
+  SongList deleted = *(reinterpret_cast<SongList*>(deleted_spy[0][0].data()));
+  ASSERT_EQ(1, deleted.count());
+  EXPECT_EQ(before[tracks[1].url()].id(), deleted[0].id());
+}
+
+TEST_F(DeviceLibraryUpdaterTest, DoesNotWriteUnchangedSongs) {
+  ASSERT_TRUE(Load(Tracks(3), "1"));
+
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  QSignalSpy deleted_spy(backend_.get(), SIGNAL(SongsDeleted(SongList)));
+  ASSERT_TRUE(Load(Tracks(3), "2"));
+
+  EXPECT_EQ(0, added_spy.count());
+  EXPECT_EQ(0, deleted_spy.count());
+  EXPECT_EQ(3, LibrarySongs().count());
+}
+
+TEST_F(DeviceLibraryUpdaterTest, SkipsUnchangedGeneration) {
+  ASSERT_TRUE(Load(Tracks(3), "1"));
+
+  // The tracks would be different, but the generation says they aren't.
+  EXPECT_FALSE(Load(Tracks(5), "1"));
+  EXPECT_EQ(3, LibrarySongs().count());
+
+  // Only the newest generation is remembered.
+  ASSERT_TRUE(Load(Tracks(5), "2"));
+  EXPECT_EQ(5, LibrarySongs().count());
+  EXPECT_TRUE(Load(Tracks(5), "1"));
+  EXPECT_FALSE(Load(Tracks(5), "1"));
+}
+
+TEST_F(DeviceLibraryUpdaterTest, EmptyGenerationIsNeverUpToDate) {
+  ASSERT_TRUE(Load(Tracks(3), QString()));
+  EXPECT_TRUE(Load(Tracks(3), QString()));
+}
+
+TEST_F(DeviceLibraryUpdaterTest, DeletesMissingSongs) {
+  ASSERT_TRUE(Load(Tracks(3), "1"));
+  QMap<QUrl, Song> before = LibrarySongs();
+
+  // The first track was deleted from the device.
+  SongList tracks = Tracks(3).mid(1);
+
+  QSignalSpy deleted_spy(backend_.get(), SIGNAL(SongsDeleted(SongList)));
+  ASSERT_TRUE(Load(tracks, "2"));
+
+  QMap<QUrl, Song> after = LibrarySongs();
+  ASSERT_EQ(2, after.count());
+  EXPECT_FALSE(after.contains(MakeTrack(0).url()));
+
+  ASSERT_EQ(1, deleted_spy.count());
+  SongList deleted = *(reinterpret_cast<SongList*>(deleted_spy[0][0].data()));
+  ASSERT_EQ(1, deleted.count());
+  EXPECT_EQ(before[MakeTrack(0).url()].id(), deleted[0].id());
+}
+
+TEST_F(DeviceLibraryUpdaterTest, WritesInBatches) {
+  const int count = DeviceLibraryUpdater::kBatchSize * 2 + 10;
+
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  ASSERT_TRUE(Load(Tracks(count), "1"));
+
+  // One AddOrUpdateSongs call for each full batch and one for the rest.
+  ASSERT_EQ(3, added_spy.count());
+  for (int i=0 ; i<added_spy.count() ; ++i) {
+    SongList added = *(reinterpret_cast<SongList*>(added_spy[i][0].data()));
+    EXPECT_EQ(i < 2 ? DeviceLibraryUpdater::kBatchSize : 10, added.count());
+  }
+
+  EXPECT_EQ(count, LibrarySongs().count());
+  EXPECT_EQ(count, task_manager_->GetTaskProgress(task_id_));
+}
+
+TEST_F(DeviceLibraryUpdaterTest, BatchesAreAvailableBeforeFinish) {
+  DeviceLibraryUpdater updater(backend_.get(), task_manager_.get(), task_id_);
+  updater.Start(DeviceLibraryUpdater::kBatchSize + 1);
+
+  SongList tracks = Tracks(DeviceLibraryUpdater::kBatchSize + 1);
+  for (int i=0 ; i<DeviceLibraryUpdater::kBatchSize ; ++i) {
+    updater.AddSong(tracks[i]);
+  }
+
+  // The first batch is in the library already.
+  EXPECT_EQ(DeviceLibraryUpdater::kBatchSize, LibrarySongs().count());
+  EXPECT_EQ(DeviceLibraryUpdater::kBatchSize,
+            task_manager_->GetTaskProgress(task_id_));
+
+  updater.AddSong(tracks.last());
+  updater.Finish("1");
+  EXPECT_EQ(DeviceLibraryUpdater::kBatchSize + 1, LibrarySongs().count());
+}
+
+}  // namespace
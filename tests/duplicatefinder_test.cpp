@@ -0,0 +1,349 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+#include "core/database.h"
+#include "library/duplicatefinder.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/libraryquery.h"
+
+#include <QTemporaryFile>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace {
+
+class DuplicateFinderTest : public ::testing::Test {
+ protected:
+  QByteArray HashData(const QByteArray& data) {
+    QTemporaryFile file;
+    file.open();
+    file.write(data);
+    file.flush();
+    return DuplicateFinder::HashAudio(file.fileName());
+  }
+
+  static QByteArray Id3v2Tag(const QByteArray& body) {
+    QByteArray ret("ID3\x03\x00\x00", 6);
+    ret.append(char(0));
+    ret.append(char(0));
+    ret.append(char((body.size() >> 7) & 0x7f));
+    ret.append(char(body.size() & 0x7f));
+    return ret + body;
+  }
+
+  static QByteArray Id3v1Tag(const QByteArray& title) {
+    QByteArray ret("TAG" + title);
+    ret.resize(128);
+    return ret;
+  }
+
+  static QByteArray FlacBlock(int type, const QByteArray& body, bool last) {
+    QByteArray ret;
+    ret.append(char(type | (last ? 0x80 : 0)));
+    ret.append(char((body.size() >> 16) & 0xff));
+    ret.append(char((body.size() >> 8) & 0xff));
+    ret.append(char(body.size() & 0xff));
+    return ret + body;
+  }
+
+  static QByteArray Audio(char c) {
+    return QByteArray("\xff\xfb\x90\x00", 4) + QByteArray(1000, c);
+  }
+
+  static QByteArray LittleEndian(quint64 value, int bytes) {
+    QByteArray ret;
+    for (int i=0 ; i<bytes ; ++i) {
+      ret.append(char((value >> (8 * i)) & 0xff));
+    }
+    return ret;
+  }
+
+  static QByteArray BigEndian(quint64 value, int bytes) {
+    QByteArray ret;
+    for (int i=bytes-1 ; i>=0 ; --i) {
+      ret.append(char((value >> (8 * i)) & 0xff));
+    }
+    return ret;
+  }
+
+  // The checksum isn't checked, so it's just different on every page like a
+  // real one would be.
+  static QByteArray OggPage(qint64 granule, int sequence,
+                            const QByteArray& payload) {
+    QByteArray lacing;
+    int remaining = payload.size();
+    do {
+      lacing.append(char(qMin(remaining, 255)));
+      remaining -= 255;
+    } while (remaining >= 0);
+
+    return "OggS" + QByteArray(2, '\0') + LittleEndian(granule, 8) +
+           LittleEndian(0x1234, 4) + LittleEndian(sequence, 4) +
+           LittleEndian(qHash(payload) + sequence, 4) +
+           char(lacing.size()) + lacing + payload;
+  }
+
+  static QByteArray Mp4Box(const char* type, const QByteArray& body) {
+    return BigEndian(8 + body.size(), 4) + type + body;
+  }
+
+  static QByteArray Mp4Box64(const char* type, const QByteArray& body) {
+    return BigEndian(1, 4) + type + BigEndian(16 + body.size(), 8) + body;
+  }
+
+  static QByteArray WavChunk(const char* type, const QByteArray& body) {
+    QByteArray ret = type + LittleEndian(body.size(), 4) + body;
+    if (body.size() & 1)
+      ret.append('\0');
+    return ret;
+  }
+
+  static QByteArray Wav(const QByteArray& chunks) {
+    return "RIFF" + LittleEndian(4 + chunks.size(), 4) + "WAVE" + chunks;
+  }
+
+  static QByteArray AiffChunk(const char* type, const QByteArray& body) {
+    QByteArray ret = type + BigEndian(body.size(), 4) + body;
+    if (body.size() & 1)
+      ret.append('\0');
+    return ret;
+  }
+
+  static QByteArray Aiff(const QByteArray& chunks) {
+    return "FORM" + BigEndian(4 + chunks.size(), 4) + "AIFF" + chunks;
+  }
+};
+
+TEST_F(DuplicateFinderTest, IgnoresId3Tags) {
+  const QByteArray plain = HashData(Audio('a'));
+  ASSERT_FALSE(plain.isEmpty());
+
+  EXPECT_EQ(plain, HashData(Id3v2Tag("Some title") + Audio('a')));
+  EXPECT_EQ(plain, HashData(Audio('a') + Id3v1Tag("Other title")));
+  EXPECT_EQ(plain, HashData(Id3v2Tag(QByteArray(300, 'x')) + Audio('a') +
+                            Id3v1Tag("Title")));
+}
+
+TEST_F(DuplicateFinderTest, DifferentAudio) {
+  EXPECT_NE(HashData(Audio('a')), HashData(Audio('b')));
+  EXPECT_NE(HashData(Id3v2Tag("Title") + Audio('a')),
+            HashData(Id3v2Tag("Title") + Audio('b')));
+}
+
+TEST_F(DuplicateFinderTest, IgnoresFlacMetadata) {
+  const QByteArray streaminfo(34, 's');
+  const QByteArray frames = Audio('f');
+
+  const QByteArray one = HashData(
+      "fLaC" + FlacBlock(0, streaminfo, true) + frames);
+  const QByteArray two = HashData(
+      "fLaC" + FlacBlock(0, streaminfo, false) +
+      FlacBlock(4, "vorbis comments", false) +
+      FlacBlock(6, QByteArray(500, 'p'), true) + frames);
+
+  ASSERT_FALSE(one.isEmpty());
+  EXPECT_EQ(one, two);
+  EXPECT_NE(one, HashData("fLaC" + FlacBlock(0, streaminfo, true) + Audio('g')));
+}
+
+TEST_F(DuplicateFinderTest, IgnoresOggComments) {
+  const QByteArray id_header("\x01vorbis" + QByteArray(23, 'i'));
+  const QByteArray setup_header("\x05vorbis" + QByteArray(400, 's'));
+
+  // A short comment packet that fits in the page with the setup header.
+  const QByteArray one = HashData(
+      OggPage(0, 0, id_header) +
+      OggPage(0, 1, "\x03vorbis short" + setup_header) +
+      OggPage(1024, 2, Audio('a')) +
+      OggPage(2048, 3, Audio('b')));
+
+  // A long comment packet that doesn't end on its first page, so that page
+  // has a granule position of -1.
+  const QByteArray comment("\x03vorbis" + QByteArray(1000, 'c'));
+  const QByteArray two = HashData(
+      OggPage(0, 0, id_header) +
+      OggPage(-1, 1, comment.left(600)) +
+      OggPage(0, 2, comment.mid(600) + setup_header) +
+      OggPage(1024, 3, Audio('a')) +
+      OggPage(2048, 4, Audio('b')));
+
+  ASSERT_FALSE(one.isEmpty());
+  EXPECT_EQ(one, two);
+}
+
+TEST_F(DuplicateFinderTest, DifferentOggAudio) {
+  const QByteArray headers =
+      OggPage(0, 0, "\x01vorbis" + QByteArray(23, 'i')) +
+      OggPage(0, 1, "\x03vorbis comments");
+
+  const QByteArray one = HashData(headers + OggPage(1024, 2, Audio('a')));
+  const QByteArray two = HashData(headers + OggPage(1024, 2, Audio('b')));
+  ASSERT_FALSE(one.isEmpty());
+  EXPECT_NE(one, two);
+
+  // A file with only the headers has no audio to hash.
+  EXPECT_TRUE(HashData(headers).isEmpty());
+}
+
+TEST_F(DuplicateFinderTest, IgnoresMp4Metadata) {
+  const QByteArray ftyp = Mp4Box("ftyp", "M4A mp42");
+  const QByteArray audio = Audio('m');
+
+  const QByteArray one = HashData(
+      ftyp + Mp4Box("moov", Mp4Box("udta", "Title")) + Mp4Box("mdat", audio));
+
+  // Different tags after the audio, in a box with a 64-bit size.
+  const QByteArray two = HashData(
+      ftyp + Mp4Box64("mdat", audio) +
+      Mp4Box("moov", Mp4Box("udta", "A much longer title")) +
+      Mp4Box("free", QByteArray(100, '\0')));
+
+  // A box with a size of 0 goes to the end of the file.
+  const QByteArray three = HashData(
+      ftyp + Mp4Box("moov", Mp4Box("udta", "Other")) +
+      BigEndian(0, 4) + "mdat" + audio);
+
+  ASSERT_FALSE(one.isEmpty());
+  EXPECT_EQ(one, two);
+  EXPECT_EQ(one, three);
+}
+
+TEST_F(DuplicateFinderTest, DifferentMp4Audio) {
+  const QByteArray ftyp = Mp4Box("ftyp", "M4A mp42");
+  const QByteArray moov = Mp4Box("moov", Mp4Box("udta", "Title"));
+
+  const QByteArray one = HashData(ftyp + moov + Mp4Box("mdat", Audio('a')));
+  ASSERT_FALSE(one.isEmpty());
+  EXPECT_NE(one, HashData(ftyp + moov + Mp4Box("mdat", Audio('b'))));
+  EXPECT_NE(one, HashData(ftyp + moov + Mp4Box64("mdat", Audio('b'))));
+  EXPECT_NE(one, HashData(ftyp + moov + BigEndian(0, 4) + "mdat" + Audio('b')));
+
+  // There's no audio without an mdat box.
+  EXPECT_TRUE(HashData(ftyp + moov).isEmpty());
+}
+
+TEST_F(DuplicateFinderTest, IgnoresWavAndAiffChunks) {
+  const QByteArray audio = Audio('w');
+  const QByteArray fmt(16, 'f');
+  const QByteArray comm(18, 'c');
+
+  // The tag chunks have odd sizes, so they're followed by a padding byte.
+  const QByteArray wav_one = HashData(Wav(
+      WavChunk("fmt ", fmt) + WavChunk("LIST", "INFOINAMTitle") +
+      WavChunk("data", audio)));
+  const QByteArray wav_two = HashData(Wav(
+      WavChunk("fmt ", fmt) +
+      WavChunk("LIST", "INFOINAMNew title") +
+      WavChunk("id3 ", Id3v2Tag("Odd")) + WavChunk("data", audio)));
+  ASSERT_FALSE(wav_one.isEmpty());
+  EXPECT_EQ(wav_one, wav_two);
+
+  const QByteArray aiff_one = HashData(Aiff(
+      AiffChunk("COMM", comm) + AiffChunk("NAME", "Title") +
+      AiffChunk("SSND", audio)));
+  const QByteArray aiff_two = HashData(Aiff(
+      AiffChunk("NAME", "New title") + AiffChunk("COMM", comm) +
+      AiffChunk("ANNO", "x") + AiffChunk("SSND", audio)));
+  ASSERT_FALSE(aiff_one.isEmpty());
+  EXPECT_EQ(aiff_one, aiff_two);
+}
+
+TEST_F(DuplicateFinderTest, DifferentWavAndAiffAudio) {
+  const QByteArray fmt(16, 'f');
+  const QByteArray comm(18, 'c');
+  const QByteArray tag = WavChunk("LIST", "INFOINAMTitle");
+
+  const QByteArray wav = HashData(Wav(
+      WavChunk("fmt ", fmt) + tag + WavChunk("data", Audio('a'))));
+  ASSERT_FALSE(wav.isEmpty());
+  EXPECT_NE(wav, HashData(Wav(
+      WavChunk("fmt ", fmt) + tag + WavChunk("data", Audio('b')))));
+
+  const QByteArray aiff = HashData(Aiff(
+      AiffChunk("COMM", comm) + AiffChunk("NAME", "Title") +
+      AiffChunk("SSND", Audio('a'))));
+  ASSERT_FALSE(aiff.isEmpty());
+  EXPECT_NE(aiff, HashData(Aiff(
+      AiffChunk("COMM", comm) + AiffChunk("NAME", "Title") +
+      AiffChunk("SSND", Audio('b')))));
+
+  // There's no audio without a data chunk.
+  EXPECT_TRUE(HashData(Wav(WavChunk("fmt ", fmt) + tag)).isEmpty());
+}
+
+TEST_F(DuplicateFinderTest, MissingFile) {
+  EXPECT_TRUE(DuplicateFinder::HashAudio("/nonexistent/file.mp3").isEmpty());
+}
+
+TEST_F(DuplicateFinderTest, IdenticalAudioQuery) {
+  MemoryDatabase database(NULL);
+  LibraryBackend backend;
+  backend.Init(&database, Library::kSongsTable, Library::kDirsTable,
+               Library::kSubdirsTable, Library::kFtsTable);
+  backend.AddDirectory("/music");
+
+  SongList songs;
+  for (int i = 0 ; i < 3 ; ++i) {
+    Song song;
+    song.set_directory_id(1);
+    song.set_url(QUrl::fromLocalFile(QString("/music/%1.mp3").arg(i)));
+    song.set_title(QString("Title %1").arg(i));
+    song.set_artist("Artist");
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    song.set_valid(true);
+    songs << song;
+  }
+  backend.AddOrUpdateSongs(songs);
+  EXPECT_EQ(3, backend.CountSongsWithoutContentHash());
+
+  songs = backend.GetSongsWithoutContentHash(10);
+  ASSERT_EQ(3, songs.count());
+
+  QMap<int, QString> hashes;
+  hashes[songs[0].id()] = "same";
+  hashes[songs[1].id()] = "same";
+  hashes[songs[2].id()] = QString();
+  backend.SetContentHashes(hashes);
+
+  // Songs that couldn't be hashed aren't tried again.
+  EXPECT_EQ(0, backend.CountSongsWithoutContentHash());
+
+  QueryOptions opt;
+  opt.set_query_mode(QueryOptions::QueryMode_IdenticalAudio);
+  LibraryQuery q(opt);
+  q.SetColumnSpec("%songs_table.ROWID");
+  ASSERT_TRUE(backend.ExecQuery(&q));
+
+  QSet<int> ids;
+  while (q.Next())
+    ids << q.Value(0).toInt();
+  EXPECT_EQ(QSet<int>() << songs[0].id() << songs[1].id(), ids);
+
+  // Changing a file forgets its hash.
+  songs[0].set_mtime(2);
+  backend.AddOrUpdateSongs(SongList() << songs[0]);
+  EXPECT_EQ(1, backend.CountSongsWithoutContentHash());
+}
+
+}  // namespace
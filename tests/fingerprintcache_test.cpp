@@ -0,0 +1,116 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+#include "core/database.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+
+#include <boost/scoped_ptr.hpp>
+
+namespace {
+
+// The Chromaprint fingerprints LibraryBackend keeps for TagFetcher, and when
+// they're thrown away.
+class FingerprintCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    database_.reset(new MemoryDatabase(NULL));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/music");
+
+    Song song;
+    song.set_directory_id(1);
+    song.set_url(QUrl::fromLocalFile("/music/1.mp3"));
+    song.set_title("Title");
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    song.set_valid(true);
+    backend_->AddOrUpdateSongs(SongList() << song);
+
+    SongList songs = backend_->GetSongsWithoutContentHash(10);
+    ASSERT_EQ(1, songs.count());
+    song_ = songs[0];
+  }
+
+  // Saves the song again after its file was modified.
+  void ChangeFile(int mtime) {
+    song_.set_mtime(mtime);
+    backend_->AddOrUpdateSongs(SongList() << song_);
+  }
+
+  void SetContentHash(const QString& hash) {
+    QMap<int, QString> hashes;
+    hashes[song_.id()] = hash;
+    backend_->SetContentHashes(hashes);
+  }
+
+  QString Fingerprint() {
+    return backend_->GetFingerprints(QList<QUrl>() << song_.url())
+        .value(song_.url());
+  }
+
+  boost::scoped_ptr<Database> database_;
+  boost::scoped_ptr<LibraryBackend> backend_;
+  Song song_;
+};
+
+TEST_F(FingerprintCacheTest, KeepsFingerprintOfSameAudio) {
+  SetContentHash("audio");
+  backend_->SetFingerprint(song_.url(), "fingerprint");
+  EXPECT_EQ("fingerprint", Fingerprint());
+
+  // The tags were edited.  The fingerprint isn't used until we know the
+  // audio is the same.
+  song_.set_title("New title");
+  song_.set_filesize(2);
+  ChangeFile(2);
+  EXPECT_TRUE(Fingerprint().isEmpty());
+
+  SetContentHash("audio");
+  EXPECT_EQ("fingerprint", Fingerprint());
+
+  // Now the audio changed.
+  ChangeFile(3);
+  SetContentHash("other audio");
+  EXPECT_TRUE(Fingerprint().isEmpty());
+}
+
+TEST_F(FingerprintCacheTest, FingerprintBeforeHash) {
+  // The file hasn't changed since the fingerprint was made, so it belongs to
+  // whatever audio the hash turns out to be.
+  backend_->SetFingerprint(song_.url(), "fingerprint");
+  EXPECT_EQ("fingerprint", Fingerprint());
+
+  SetContentHash("audio");
+  EXPECT_EQ("fingerprint", Fingerprint());
+
+  // Make another fingerprint before hashing, then change the file.  There's
+  // no way to tell whether it's the same audio, so the fingerprint goes.
+  ChangeFile(2);
+  backend_->SetFingerprint(song_.url(), "new fingerprint");
+  ChangeFile(3);
+  SetContentHash("audio");
+  EXPECT_TRUE(Fingerprint().isEmpty());
+}
+
+}  // namespace
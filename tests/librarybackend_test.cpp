@@ -22,14 +22,20 @@
 #include "library/library.h"
 #include "core/song.h"
 #include "core/database.h"
+#include "playlistparsers/m3uparser.h"
 
 #include <boost/scoped_ptr.hpp>
 
+#include <QBuffer>
 #include <QFileInfo>
 #include <QSignalSpy>
+#include <QSqlQuery>
 #include <QThread>
+#include <QTime>
 #include <QtDebug>
 
+#include <iostream>
+
 namespace {
 
 class LibraryBackendTest : public ::testing::Test {
@@ -98,6 +104,31 @@ TEST_F(LibraryBackendTest, RemoveDirectory) {
   EXPECT_EQ(1, dir.id);
 }
 
+TEST_F(LibraryBackendTest, SubdirDigest) {
+  backend_->AddDirectory("/tmp");
+
+  Subdirectory subdir;
+  subdir.directory_id = 1;
+  subdir.path = "/tmp/foo";
+  subdir.mtime = 100;
+  subdir.digest = "3:1000:100:00000000deadbeef";
+  backend_->AddOrUpdateSubdirs(SubdirectoryList() << subdir);
+
+  SubdirectoryList subdirs = backend_->SubdirsInDirectory(1);
+  ASSERT_EQ(1, subdirs.count());
+  EXPECT_EQ(subdir.digest, subdirs[0].digest);
+
+  // Updating the mtime updates the digest too
+  subdir.mtime = 200;
+  subdir.digest = "4:2000:200:00000000cafebabe";
+  backend_->AddOrUpdateSubdirs(SubdirectoryList() << subdir);
+
+  subdirs = backend_->SubdirsInDirectory(1);
+  ASSERT_EQ(1, subdirs.count());
+  EXPECT_EQ(200u, subdirs[0].mtime);
+  EXPECT_EQ(subdir.digest, subdirs[0].digest);
+}
+
 TEST_F(LibraryBackendTest, AddInvalidSong) {
   // Adding a song without certain fields set should fail
   backend_->AddDirectory("/tmp");
@@ -129,6 +160,109 @@ TEST_F(LibraryBackendTest, AddInvalidSong) {
 TEST_F(LibraryBackendTest, GetAlbumArtNonExistent) {
 }
 
+TEST_F(LibraryBackendTest, GetSongsByUrls) {
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i=0 ; i<3 ; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_title(QString("Song %1").arg(i));
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/%1.mp3").arg(i)));
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  SongList ret = backend_->GetSongsByUrls(QList<QUrl>()
+      << QUrl::fromLocalFile("/tmp/0.mp3")
+      << QUrl::fromLocalFile("/tmp/2.mp3")
+      << QUrl::fromLocalFile("/tmp/missing.mp3"));
+  ASSERT_EQ(2, ret.count());
+
+  QStringList titles;
+  foreach (const Song& song, ret) {
+    titles << song.title();
+  }
+  titles.sort();
+  EXPECT_EQ(QStringList() << "Song 0" << "Song 2", titles);
+}
+
+TEST_F(LibraryBackendTest, DISABLED_LoadLargeM3U) {
+  const int kCount = 50000;
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  QByteArray data = "#EXTM3U\n";
+  for (int i=0 ; i<kCount ; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_title(QString("Song %1").arg(i));
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/benchmark/%1.mp3").arg(i)));
+    songs << song;
+
+    data += song.url().toLocalFile().toUtf8() + "\n";
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  M3UParser parser(backend_.get());
+
+  QTime t;
+  t.start();
+  SongList loaded = parser.Load(&buffer, "", QDir("/tmp"));
+  std::cout << "Loaded " << loaded.count() << " songs from an M3U in "
+            << t.elapsed() << "ms" << std::endl;
+
+  ASSERT_EQ(kCount, loaded.count());
+  EXPECT_EQ("Song 0", loaded.first().title());
+  EXPECT_EQ(QString("Song %1").arg(kCount - 1), loaded.last().title());
+}
+
+TEST_F(LibraryBackendTest, DISABLED_FtsBenchmark) {
+  const int kCount = 50000;
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i=0 ; i<kCount ; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_title(QString("Song %1").arg(i));
+    song.set_artist(QString("Artist %1").arg(i % 500));
+    song.set_album(QString("Album %1").arg(i % 5000));
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/benchmark/%1.mp3").arg(i)));
+    songs << song;
+  }
+
+  QTime t;
+  t.start();
+  backend_->AddOrUpdateSongs(songs);
+  std::cout << "Indexed " << kCount << " songs in " << t.elapsed() << "ms"
+            << std::endl;
+
+  t.restart();
+  backend_->MergeFts();
+  std::cout << "Merged the index in " << t.elapsed() << "ms" << std::endl;
+
+  {
+    QMutexLocker l(database_->Mutex());
+    QSqlDatabase db(database_->Connect());
+    QSqlQuery q(db);
+    ASSERT_TRUE(q.exec("SELECT SUM(LENGTH(block)) FROM songs_fts_segments"));
+    ASSERT_TRUE(q.next());
+    std::cout << "Index size " << q.value(0).toInt() / 1024 << "kB"
+              << std::endl;
+  }
+
+  foreach (const QString& filter,
+           QStringList() << "a" << "ar" << "art" << "artist 12" << "song 4999") {
+    QueryOptions opt;
+    opt.set_filter(filter);
+
+    t.restart();
+    const int count = backend_->GetAllArtists(opt).count();
+    std::cout << "Searched for \"" << filter.toStdString() << "\" in "
+              << t.elapsed() << "ms, " << count << " artists" << std::endl;
+  }
+}
+
 // Test adding a single song to the database, then getting various information
 // back about it.
 class SingleSong : public LibraryBackendTest {
@@ -271,6 +405,40 @@ TEST_F(SingleSong, UpdateSong) {
   EXPECT_EQ(1, songs_added[0].id());
 }
 
+TEST_F(SingleSong, SearchUsesUpdatedTags) {
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  Song new_song(song_);
+  new_song.set_id(1);
+  new_song.set_title("Something else");
+  backend_->AddOrUpdateSongs(SongList() << new_song);
+
+  QueryOptions opt;
+  opt.set_filter("som");
+  EXPECT_EQ(1, backend_->GetAllArtists(opt).size());
+
+  opt.set_filter("tit");
+  EXPECT_EQ(0, backend_->GetAllArtists(opt).size());
+}
+
+TEST_F(SingleSong, RebuildFts) {
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  {
+    QMutexLocker l(database_->Mutex());
+    QSqlDatabase db(database_->Connect());
+    QSqlQuery q(db);
+    ASSERT_TRUE(q.exec("DELETE FROM songs_fts"));
+  }
+
+  QueryOptions opt;
+  opt.set_filter("tit");
+  EXPECT_EQ(0, backend_->GetAllArtists(opt).size());
+
+  backend_->RebuildFts();
+  EXPECT_EQ(1, backend_->GetAllArtists(opt).size());
+}
+
 TEST_F(SingleSong, DeleteSongs) {
   AddDummySong();  if (HasFatalFailure()) return;
 
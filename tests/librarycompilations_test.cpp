@@ -0,0 +1,195 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+#include "core/database.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+
+#include <QSqlQuery>
+#include <QStringList>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace {
+
+class LibraryCompilationsTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    database_.reset(new MemoryDatabase(NULL));
+    library_.reset(new LibraryBackend);
+    library_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    library_->AddDirectory("/music");
+
+    // The first update always looks at every album.
+    library_->UpdateCompilations();
+  }
+
+  Song MakeSong(const QString& filename, const QString& artist,
+                const QString& album) {
+    Song ret;
+    ret.set_directory_id(1);
+    ret.set_url(QUrl::fromLocalFile(filename));
+    ret.set_title(filename.section('/', -1));
+    ret.set_artist(artist);
+    ret.set_album(album);
+    ret.set_mtime(1);
+    ret.set_ctime(1);
+    ret.set_filesize(1);
+    ret.set_valid(true);
+    return ret;
+  }
+
+  Song GetSong(const QString& filename) {
+    SongList songs = library_->GetSongsByUrl(QUrl::fromLocalFile(filename));
+    EXPECT_EQ(1, songs.count());
+    return songs.value(0);
+  }
+
+  // The sampler and effective_compilation columns of every song.
+  QStringList Compilations() {
+    QMutexLocker l(database_->Mutex());
+    QSqlQuery q(database_->Connect());
+    EXPECT_TRUE(q.exec("SELECT ROWID, sampler, effective_compilation"
+                       " FROM songs ORDER BY ROWID"));
+
+    QStringList ret;
+    while (q.next()) {
+      ret << QString("%1 %2 %3").arg(q.value(0).toString(),
+                                     q.value(1).toString(),
+                                     q.value(2).toString());
+    }
+    return ret;
+  }
+
+  // Runs the incremental update, then checks that looking at every album
+  // again doesn't change anything.
+  void UpdateAndCompare() {
+    library_->UpdateCompilations();
+    const QStringList incremental = Compilations();
+
+    library_->UpdateAllCompilations();
+    EXPECT_EQ(Compilations(), incremental);
+  }
+
+  bool IsCompilation(const QString& filename) {
+    return GetSong(filename).is_compilation();
+  }
+
+  boost::scoped_ptr<Database> database_;
+  boost::scoped_ptr<LibraryBackend> library_;
+};
+
+TEST_F(LibraryCompilationsTest, DetectsCompilations) {
+  library_->AddOrUpdateSongs(SongList()
+      << MakeSong("/music/va/1.mp3", "Artist 1", "Best of")
+      << MakeSong("/music/va/2.mp3", "Artist 2", "Best of")
+      << MakeSong("/music/solo/1.mp3", "Artist 3", "Solo")
+      << MakeSong("/music/solo/2.mp3", "Artist 3", "Solo")
+      << MakeSong("/music/split1/1.mp3", "Artist 4", "Split")
+      << MakeSong("/music/split2/1.mp3", "Artist 5", "Split"));
+  UpdateAndCompare();
+
+  EXPECT_TRUE(IsCompilation("/music/va/1.mp3"));
+  EXPECT_TRUE(IsCompilation("/music/va/2.mp3"));
+  EXPECT_FALSE(IsCompilation("/music/solo/1.mp3"));
+  EXPECT_FALSE(IsCompilation("/music/split1/1.mp3"));
+}
+
+TEST_F(LibraryCompilationsTest, UpdatesChangedAlbums) {
+  library_->AddOrUpdateSongs(SongList()
+      << MakeSong("/music/va/1.mp3", "Artist 1", "Best of")
+      << MakeSong("/music/va/2.mp3", "Artist 2", "Best of")
+      << MakeSong("/music/solo/1.mp3", "Artist 3", "Solo")
+      << MakeSong("/music/solo/2.mp3", "Artist 3", "Solo"));
+  UpdateAndCompare();
+
+  // A new artist on an album makes it a compilation.
+  Song song = GetSong("/music/solo/2.mp3");
+  song.set_artist("Artist 4");
+  library_->AddOrUpdateSongs(SongList() << song);
+  UpdateAndCompare();
+  EXPECT_TRUE(IsCompilation("/music/solo/1.mp3"));
+
+  // Moving a song to another album changes the album it came from too.
+  song = GetSong("/music/va/2.mp3");
+  song.set_album("Other");
+  library_->AddOrUpdateSongs(SongList() << song);
+  UpdateAndCompare();
+  EXPECT_FALSE(IsCompilation("/music/va/1.mp3"));
+  EXPECT_FALSE(IsCompilation("/music/va/2.mp3"));
+
+  // So does deleting one.
+  library_->DeleteSongs(SongList() << GetSong("/music/solo/2.mp3"));
+  UpdateAndCompare();
+  EXPECT_FALSE(IsCompilation("/music/solo/1.mp3"));
+}
+
+TEST_F(LibraryCompilationsTest, UnavailableSongs) {
+  library_->AddOrUpdateSongs(SongList()
+      << MakeSong("/music/va/1.mp3", "Artist 1", "Best of")
+      << MakeSong("/music/va/2.mp3", "Artist 2", "Best of")
+      << MakeSong("/music/va/3.mp3", "Artist 3", "Best of"));
+  UpdateAndCompare();
+
+  library_->MarkSongsUnavailable(SongList()
+      << GetSong("/music/va/2.mp3") << GetSong("/music/va/3.mp3"));
+  UpdateAndCompare();
+
+  // Only one artist is left.
+  EXPECT_FALSE(GetSong("/music/va/1.mp3").is_compilation());
+}
+
+TEST_F(LibraryCompilationsTest, NothingChanged) {
+  library_->AddOrUpdateSongs(SongList()
+      << MakeSong("/music/va/1.mp3", "Artist 1", "Best of")
+      << MakeSong("/music/va/2.mp3", "Artist 2", "Best of"));
+  library_->UpdateCompilations();
+
+  // Change the songs behind the backend's back.  UpdateCompilations won't
+  // notice because no songs were added or deleted since it last ran.
+  {
+    QMutexLocker l(database_->Mutex());
+    QSqlQuery q(database_->Connect());
+    ASSERT_TRUE(q.exec("UPDATE songs SET sampler = 0, effective_compilation = 0"));
+  }
+  library_->UpdateCompilations();
+  EXPECT_FALSE(IsCompilation("/music/va/1.mp3"));
+
+  library_->UpdateAllCompilations();
+  EXPECT_TRUE(IsCompilation("/music/va/1.mp3"));
+}
+
+TEST_F(LibraryCompilationsTest, ChecksEverythingAfterRestart) {
+  library_->AddOrUpdateSongs(SongList()
+      << MakeSong("/music/va/1.mp3", "Artist 1", "Best of")
+      << MakeSong("/music/va/2.mp3", "Artist 2", "Best of"));
+
+  // Clementine quit before it got round to updating the compilations.
+  library_.reset(new LibraryBackend);
+  library_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                 Library::kSubdirsTable, Library::kFtsTable);
+  EXPECT_FALSE(IsCompilation("/music/va/1.mp3"));
+
+  library_->UpdateCompilations();
+  EXPECT_TRUE(IsCompilation("/music/va/1.mp3"));
+}
+
+}  // namespace
@@ -23,6 +23,7 @@
 #include "library/librarybackend.h"
 #include "library/library.h"
 
+#include <QCoreApplication>
 #include <QtDebug>
 #include <QThread>
 #include <QSignalSpy>
@@ -302,4 +303,23 @@ TEST_F(LibraryModelTest, RemoveEmptyArtists) {
   ASSERT_EQ(0, model_->rowCount(QModelIndex()));
 }
 
+TEST_F(LibraryModelTest, DiscoveredSongsInsertedTogether) {
+  model_->Init(false);
+  QSignalSpy spy(model_.get(), SIGNAL(rowsInserted(QModelIndex,int,int)));
+
+  AddSong("Title", "Artist 1", "Album", 123);
+  AddSong("Title", "Artist 2", "Album", 123);
+  AddSong("Title", "Artist 3", "Album", 123);
+
+  // The songs are added later, all in one go.
+  EXPECT_EQ(0, spy.count());
+  QCoreApplication::processEvents();
+
+  // Three artists and the "A" divider.
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(0, spy[0][1].toInt());
+  EXPECT_EQ(3, spy[0][2].toInt());
+  EXPECT_EQ(4, model_->rowCount(QModelIndex()));
+}
+
 } // namespace
@@ -0,0 +1,201 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "core/database.h"
+#include "library/library.h"
+#include "library/libraryitem.h"
+#include "library/librarymodel.h"
+#include "library/libraryquery.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
+
+// Checks that the queries LibraryModel makes for each grouping are answered
+// from an index rather than by reading the whole songs table.
+class LibraryModelQueriesTest : public ::testing::Test {
+ protected:
+  typedef LibraryModel::GroupBy GroupBy;
+
+  void SetUp() {
+    database_.reset(new MemoryDatabase(NULL));
+    root_.reset(new LibraryItem(LibraryItem::Type_Root));
+  }
+
+  // A node at the top of the tree, like the ones ItemFromQuery makes.
+  LibraryItem* Container(const QString& key) {
+    LibraryItem* ret = new LibraryItem(LibraryItem::Type_Container,
+                                       root_.get());
+    ret->container_level = 0;
+    ret->key = key;
+    ret->metadata.set_year(2000);
+    ret->metadata.set_album(key);
+    ret->metadata.set_filetype(Song::Type_Mpeg);
+    return ret;
+  }
+
+  // The Various artists node at the top of the tree.
+  LibraryItem* VariousArtists() {
+    LibraryItem* ret = Container("Various artists");
+    root_->compilation_artist_node_ = ret;
+    return ret;
+  }
+
+  // Builds the query for the children of parent the way RunQuery does.  If
+  // compilations is true it's changed the way HasCompilations changes it.
+  QString ChildQuery(GroupBy parent_type, LibraryItem* parent,
+                     GroupBy child_type, bool compilations = false) {
+    LibraryQuery q;
+    LibraryModel::InitQuery(child_type, &q);
+    if (parent)
+      LibraryModel::FilterQuery(parent_type, parent, &q);
+
+    if (compilations) {
+      q.AddCompilationRequirement(true);
+      q.SetLimit(1);
+    } else if (child_type == LibraryModel::GroupBy_Artist ||
+               child_type == LibraryModel::GroupBy_AlbumArtist) {
+      q.AddCompilationRequirement(false);
+    }
+
+    QSqlQuery query = q.Exec(database_->Connect(), Library::kSongsTable,
+                             Library::kFtsTable);
+    EXPECT_FALSE(query.lastError().isValid())
+        << query.lastError().text().toStdString();
+    return query.lastQuery();
+  }
+
+  QStringList QueryPlan(const QString& sql) {
+    QSqlQuery q(database_->Connect());
+    EXPECT_TRUE(q.exec("EXPLAIN QUERY PLAN " + sql));
+
+    QStringList ret;
+    while (q.next()) {
+      ret << q.value(q.record().count() - 1).toString();
+    }
+    return ret;
+  }
+
+  // True if the query never reads the whole table.  If allow_index_scan is
+  // true, reading a whole covering index is fine - that's how the top level
+  // gets its distinct values.  Anything below the top level has to look its
+  // rows up.
+  bool UsesIndex(const QString& sql, bool allow_index_scan) {
+    foreach (const QString& step, QueryPlan(sql)) {
+      bool ok = true;
+      if (step.startsWith("SCAN")) {
+        ok = allow_index_scan && step.contains("COVERING INDEX");
+      } else if (step.startsWith("TABLE")) {
+        // SQLite before 3.7 says "TABLE songs" for a full scan and
+        // "TABLE songs WITH INDEX ..." otherwise.
+        ok = step.contains("INDEX");
+      }
+
+      if (!ok) {
+        ADD_FAILURE() << sql.toStdString() << ": " << step.toStdString();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static const GroupBy kContainerTypes[];
+
+  boost::scoped_ptr<Database> database_;
+  boost::scoped_ptr<LibraryItem> root_;
+};
+
+const LibraryModel::GroupBy LibraryModelQueriesTest::kContainerTypes[] = {
+  LibraryModel::GroupBy_Artist,
+  LibraryModel::GroupBy_Album,
+  LibraryModel::GroupBy_YearAlbum,
+  LibraryModel::GroupBy_Year,
+  LibraryModel::GroupBy_Composer,
+  LibraryModel::GroupBy_Genre,
+  LibraryModel::GroupBy_AlbumArtist,
+  LibraryModel::GroupBy_FileType,
+  LibraryModel::GroupBy_Performer,
+  LibraryModel::GroupBy_Grouping,
+  LibraryModel::GroupBy_None
+};
+
+TEST_F(LibraryModelQueriesTest, TopLevel) {
+  for (int i=0 ; kContainerTypes[i] != LibraryModel::GroupBy_None ; ++i) {
+    const GroupBy type = kContainerTypes[i];
+    SCOPED_TRACE(type);
+    EXPECT_TRUE(UsesIndex(ChildQuery(type, NULL, type), true));
+  }
+
+  // HasCompilations is asked before the top level artists are loaded.
+  EXPECT_TRUE(UsesIndex(ChildQuery(LibraryModel::GroupBy_None, NULL,
+                                   LibraryModel::GroupBy_Artist, true),
+                        false));
+}
+
+TEST_F(LibraryModelQueriesTest, ChildLevels) {
+  for (int i=0 ; kContainerTypes[i] != LibraryModel::GroupBy_None ; ++i) {
+    const GroupBy parent_type = kContainerTypes[i];
+    LibraryItem* parent = Container("a");
+
+    for (int j=0 ; ; ++j) {
+      const GroupBy child_type = kContainerTypes[j];
+      if (child_type == parent_type)
+        continue;
+
+      SCOPED_TRACE(QString("%1 %2").arg(parent_type).arg(child_type)
+                   .toStdString());
+      EXPECT_TRUE(UsesIndex(ChildQuery(parent_type, parent, child_type),
+                            false));
+
+      if (child_type == LibraryModel::GroupBy_Artist ||
+          child_type == LibraryModel::GroupBy_AlbumArtist) {
+        EXPECT_TRUE(UsesIndex(ChildQuery(parent_type, parent, child_type, true),
+                              false));
+      }
+
+      if (child_type == LibraryModel::GroupBy_None)
+        break;
+    }
+  }
+}
+
+TEST_F(LibraryModelQueriesTest, VariousArtists) {
+  LibraryItem* various_artists = VariousArtists();
+
+  const GroupBy kParentTypes[] = {
+    LibraryModel::GroupBy_Artist, LibraryModel::GroupBy_AlbumArtist
+  };
+  const GroupBy kChildTypes[] = {
+    LibraryModel::GroupBy_Album, LibraryModel::GroupBy_YearAlbum,
+    LibraryModel::GroupBy_None
+  };
+
+  for (int i=0 ; i<2 ; ++i) {
+    for (int j=0 ; j<3 ; ++j) {
+      SCOPED_TRACE(QString("%1 %2").arg(kParentTypes[i]).arg(kChildTypes[j])
+                   .toStdString());
+      EXPECT_TRUE(UsesIndex(ChildQuery(kParentTypes[i], various_artists,
+                                       kChildTypes[j]), false));
+    }
+  }
+}
@@ -0,0 +1,254 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "core/database.h"
+#include "core/taskmanager.h"
+#include "core/utilities.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/librarywatcher.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QTimer>
+
+#include <utime.h>
+
+class LibraryWatcherTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(NULL));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable,
+                   Library::kDirsTable, Library::kSubdirsTable,
+                   Library::kFtsTable);
+    task_manager_.reset(new TaskManager);
+
+    {
+      QTemporaryFile temp;
+      temp.open();
+      path_ = temp.fileName();
+    }
+    ASSERT_TRUE(QDir().mkdir(path_));
+
+    // This will get ID 1
+    backend_->AddDirectory(path_);
+    dir_.id = 1;
+    dir_.path = path_;
+
+    Subdirectory subdir;
+    subdir.directory_id = dir_.id;
+    subdir.path = path_;
+    subdir.mtime = QFileInfo(path_).lastModified().toTime_t();
+
+    // The directory is known already, so this only starts watching it.
+    watcher_.reset(new LibraryWatcher);
+    watcher_->set_backend(backend_.get());
+    watcher_->set_task_manager(task_manager_.get());
+    watcher_->AddDirectory(dir_, SubdirectoryList() << subdir);
+  }
+
+  virtual void TearDown() {
+    watcher_.reset();
+    Utilities::RemoveRecursive(path_);
+  }
+
+  // Files starting with a dot aren't read by the scan, but they still count
+  // when the watcher checks whether the directory has stopped changing.
+  void WriteFile(const QString& name, const QByteArray& data,
+                 QIODevice::OpenMode mode = QIODevice::WriteOnly) {
+    QFile file(path_ + "/" + name);
+    ASSERT_TRUE(file.open(mode));
+    file.write(data);
+  }
+
+  void SetMtime(const QString& name, uint mtime) {
+    utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    ASSERT_EQ(0, utime(QFile::encodeName(path_ + "/" + name).constData(),
+                       &times));
+  }
+
+  uint Now() const {
+    return QDateTime::currentDateTime().toTime_t();
+  }
+
+  // Adds a song to the library that isn't on the disk, so scanning the
+  // directory would notice it's gone.
+  Song AddMissingSong() {
+    Song song;
+    song.set_directory_id(dir_.id);
+    song.set_url(QUrl::fromLocalFile(path_ + "/missing.mp3"));
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    backend_->AddOrUpdateSongs(SongList() << song);
+
+    SongList songs = backend_->FindSongsInDirectory(dir_.id);
+    return songs.isEmpty() ? Song() : songs[0];
+  }
+
+  boost::shared_ptr<Database> database_;
+  boost::scoped_ptr<LibraryBackend> backend_;
+  boost::scoped_ptr<TaskManager> task_manager_;
+  boost::scoped_ptr<LibraryWatcher> watcher_;
+
+  QString path_;
+  Directory dir_;
+};
+
+TEST_F(LibraryWatcherTest, WaitsForQuietPeriod) {
+  WriteFile(".old", "data");
+  SetMtime(".old", Now() - 60);
+
+  watcher_->DirectoryChanged(path_);
+  watcher_->RescanPathsNow();
+
+  // It only just changed, so it isn't scanned yet.
+  EXPECT_TRUE(watcher_->rescan_queue_.contains(path_));
+  EXPECT_TRUE(watcher_->rescan_timer_->isActive());
+
+  // Another change doesn't postpone the check that's already due.
+  const int due_ms = watcher_->rescan_due_ms_;
+  watcher_->DirectoryChanged(path_);
+  EXPECT_EQ(due_ms, watcher_->rescan_due_ms_);
+}
+
+TEST_F(LibraryWatcherTest, ScansOldFilesWhenQuiet) {
+  WriteFile(".old", "data");
+  SetMtime(".old", Now() - 60);
+
+  watcher_->DirectoryChanged(path_);
+
+  // Pretend the change happened a while ago.
+  LibraryWatcher::PendingRescan& pending = watcher_->rescan_queue_[path_];
+  pending.first_change_ms_ -= LibraryWatcher::kRescanQuietMs;
+  pending.last_change_ms_ -= LibraryWatcher::kRescanQuietMs;
+
+  // None of the files were modified recently, so they're scanned straight
+  // away.
+  watcher_->RescanPathsNow();
+  EXPECT_FALSE(watcher_->rescan_queue_.contains(path_));
+}
+
+TEST_F(LibraryWatcherTest, WaitsForFilesToStopChanging) {
+  // A file that's still being downloaded.
+  WriteFile(".incoming", "data");
+
+  watcher_->DirectoryChanged(path_);
+  LibraryWatcher::PendingRescan& pending = watcher_->rescan_queue_[path_];
+  pending.first_change_ms_ -= LibraryWatcher::kRescanQuietMs;
+  pending.last_change_ms_ -= LibraryWatcher::kRescanQuietMs;
+
+  // It was modified just now.
+  watcher_->RescanPathsNow();
+  ASSERT_TRUE(watcher_->rescan_queue_.contains(path_));
+
+  // It's still growing.
+  WriteFile(".incoming", "more data", QIODevice::Append);
+  watcher_->RescanPathsNow();
+  ASSERT_TRUE(watcher_->rescan_queue_.contains(path_));
+
+  // It's the same size as last time.
+  watcher_->RescanPathsNow();
+  EXPECT_FALSE(watcher_->rescan_queue_.contains(path_));
+}
+
+TEST_F(LibraryWatcherTest, RescansAfterMaxLatency) {
+  WriteFile(".incoming", "data");
+
+  // The directory has been changing for a long time, and it's still changing.
+  watcher_->DirectoryChanged(path_);
+  watcher_->rescan_queue_[path_].first_change_ms_ -=
+      LibraryWatcher::kRescanMaxLatencyMs;
+
+  // It's scanned anyway.
+  watcher_->RescanPathsNow();
+  EXPECT_FALSE(watcher_->rescan_queue_.contains(path_));
+}
+
+TEST_F(LibraryWatcherTest, SkipsSubdirWithSameDigest) {
+  WriteFile(".old", "data");
+
+  // Scan it once to get its digest.
+  Subdirectory subdir;
+  {
+    LibraryWatcher::ScanTransaction t(watcher_.get(), dir_.id, false);
+    watcher_->ScanSubdirectory(path_, Subdirectory(), &t);
+    ASSERT_EQ(1, t.new_subdirs.count());
+    subdir = t.new_subdirs[0];
+  }
+  ASSERT_FALSE(subdir.digest.isEmpty());
+
+  const Song song = AddMissingSong();
+  ASSERT_NE(-1, song.id());
+
+  // The directory's mtime changed but nothing in it did, so its songs aren't
+  // compared with the disk and the missing one isn't noticed.
+  LibraryWatcher::ScanTransaction t(watcher_.get(), dir_.id, true);
+  t.SetKnownSubdirs(SubdirectoryList() << subdir);
+  subdir.mtime = 0;
+  watcher_->ScanSubdirectory(path_, subdir, &t, true);
+
+  EXPECT_TRUE(t.deleted_songs.isEmpty());
+  ASSERT_EQ(1, t.touched_subdirs.count());
+  EXPECT_EQ(subdir.digest, t.touched_subdirs[0].digest);
+}
+
+TEST_F(LibraryWatcherTest, ScansSubdirWithNewDigest) {
+  WriteFile(".old", "data");
+
+  Subdirectory subdir;
+  {
+    LibraryWatcher::ScanTransaction t(watcher_.get(), dir_.id, false);
+    watcher_->ScanSubdirectory(path_, Subdirectory(), &t);
+    ASSERT_EQ(1, t.new_subdirs.count());
+    subdir = t.new_subdirs[0];
+  }
+
+  const Song song = AddMissingSong();
+  ASSERT_NE(-1, song.id());
+
+  // A file was added, so the directory is compared with the library.
+  WriteFile(".new", "data");
+  {
+    LibraryWatcher::ScanTransaction t(watcher_.get(), dir_.id, true);
+    t.SetKnownSubdirs(SubdirectoryList() << subdir);
+    watcher_->ScanSubdirectory(path_, subdir, &t, true);
+
+    ASSERT_EQ(1, t.deleted_songs.count());
+    EXPECT_EQ(song.id(), t.deleted_songs[0].id());
+    ASSERT_EQ(1, t.touched_subdirs.count());
+    EXPECT_NE(subdir.digest, t.touched_subdirs[0].digest);
+  }
+
+  // Without a digest from last time it has to be compared too.
+  subdir.digest.clear();
+  LibraryWatcher::ScanTransaction t(watcher_.get(), dir_.id, true);
+  t.SetKnownSubdirs(SubdirectoryList() << subdir);
+  watcher_->ScanSubdirectory(path_, subdir, &t, true);
+  EXPECT_EQ(1, t.deleted_songs.count());
+}
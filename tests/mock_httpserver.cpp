@@ -0,0 +1,131 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mock_httpserver.h"
+
+#include <QRegExp>
+#include <QStringList>
+#include <QTcpSocket>
+
+MockHttpServer::MockHttpServer(QObject* parent)
+  : QTcpServer(parent),
+    status_(200),
+    supports_ranges_(true),
+    disconnect_after_(0),
+    disconnects_remaining_(0)
+{
+  connect(this, SIGNAL(newConnection()), SLOT(NewConnection()));
+}
+
+QUrl MockHttpServer::url(const QString& path) const {
+  return QUrl(QString("http://127.0.0.1:%1%2").arg(serverPort()).arg(path));
+}
+
+QByteArray MockHttpServer::etag() const {
+  return "\"" + QByteArray::number(qHash(content_)) + "\"";
+}
+
+void MockHttpServer::DisconnectAfter(int bytes, int times) {
+  disconnect_after_ = bytes;
+  disconnects_remaining_ = times;
+}
+
+void MockHttpServer::NewConnection() {
+  while (hasPendingConnections()) {
+    QTcpSocket* socket = nextPendingConnection();
+    connect(socket, SIGNAL(readyRead()), SLOT(ReadRequest()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+  }
+}
+
+void MockHttpServer::ReadRequest() {
+  QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+  QByteArray& request = requests_[socket];
+  request.append(socket->readAll());
+
+  // Wait for the whole header.
+  const int header_end = request.indexOf("\r\n\r\n");
+  if (header_end == -1)
+    return;
+
+  QByteArray range;
+  QByteArray if_range;
+  int content_length = 0;
+  foreach (const QByteArray& line, request.left(header_end).split('\n')) {
+    if (line.toLower().startsWith("range:"))
+      range = line.mid(6).trimmed();
+    if (line.toLower().startsWith("if-range:"))
+      if_range = line.mid(9).trimmed();
+    if (line.toLower().startsWith("content-length:"))
+      content_length = line.mid(15).trimmed().toInt();
+  }
+
+  // And the whole body.
+  const QByteArray body = request.mid(header_end + 4);
+  if (body.size() < content_length)
+    return;
+
+  requests_.remove(socket);
+  range_headers_ << range;
+  if_range_headers_ << if_range;
+  request_bodies_ << body;
+  SendResponse(socket, range);
+}
+
+void MockHttpServer::SendResponse(QTcpSocket* socket, const QByteArray& range) {
+  QByteArray header;
+  QByteArray body;
+
+  if (status_ != 200) {
+    header = "HTTP/1.1 " + QByteArray::number(status_) + " Error\r\n"
+             "Content-Length: 0\r\n";
+  } else {
+    qint64 start = 0;
+    QRegExp re("bytes=(\\d+)-");
+    if (supports_ranges_ && re.indexIn(range) != -1)
+      start = re.cap(1).toLongLong();
+
+    if (start >= content_.size() && start != 0) {
+      header = "HTTP/1.1 416 Requested Range Not Satisfiable\r\n"
+               "Content-Length: 0\r\n";
+    } else {
+      body = content_.mid(start);
+      if (start == 0) {
+        header = "HTTP/1.1 200 OK\r\n";
+      } else {
+        header = "HTTP/1.1 206 Partial Content\r\n"
+                 "Content-Range: bytes " + QByteArray::number(start) + "-" +
+                 QByteArray::number(content_.size() - 1) + "/" +
+                 QByteArray::number(content_.size()) + "\r\n";
+      }
+
+      if (supports_ranges_)
+        header += "Accept-Ranges: bytes\r\n";
+      header += "ETag: " + etag() + "\r\n"
+                "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    }
+  }
+  header += "Connection: close\r\n\r\n";
+
+  if (disconnects_remaining_ > 0) {
+    disconnects_remaining_ --;
+    body = body.left(disconnect_after_);
+  }
+
+  socket->write(header + body);
+  socket->disconnectFromHost();
+}
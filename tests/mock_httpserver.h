@@ -0,0 +1,81 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOCK_HTTPSERVER_H
+#define MOCK_HTTPSERVER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QTcpServer>
+#include <QUrl>
+
+class QTcpSocket;
+
+// Usage:
+// Create a MockHttpServer and call listen(QHostAddress::LocalHost).
+// Call SetContent() with the file you want it to serve - every path serves the
+// same file.  Range requests are honoured unless you turn them off, and
+// DisconnectAfter() makes the server drop the next few connections part of
+// the way through the body.
+
+class MockHttpServer : public QTcpServer {
+  Q_OBJECT
+ public:
+  MockHttpServer(QObject* parent = 0);
+
+  QUrl url(const QString& path) const;
+
+  void SetContent(const QByteArray& content) { content_ = content; }
+  void SetStatus(int status) { status_ = status; }
+  void SetSupportsRanges(bool supports_ranges) { supports_ranges_ = supports_ranges; }
+
+  // The next |times| responses are cut off after |bytes| bytes of the body.
+  void DisconnectAfter(int bytes, int times = 1);
+
+  // The Range header of every request, in order.  Empty if it had none.
+  const QList<QByteArray>& range_headers() const { return range_headers_; }
+  // The same for the If-Range header.
+  const QList<QByteArray>& if_range_headers() const { return if_range_headers_; }
+
+  // The ETag that's sent with the content.
+  QByteArray etag() const;
+
+  // The body of every request, in order.  Empty for GET requests.
+  const QList<QByteArray>& request_bodies() const { return request_bodies_; }
+
+ private slots:
+  void NewConnection();
+  void ReadRequest();
+
+ private:
+  void SendResponse(QTcpSocket* socket, const QByteArray& range);
+
+  QByteArray content_;
+  int status_;
+  bool supports_ranges_;
+
+  int disconnect_after_;
+  int disconnects_remaining_;
+
+  QMap<QTcpSocket*, QByteArray> requests_;
+  QList<QByteArray> range_headers_;
+  QList<QByteArray> if_range_headers_;
+  QList<QByteArray> request_bodies_;
+};
+
+#endif  // MOCK_HTTPSERVER_H
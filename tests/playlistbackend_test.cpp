@@ -0,0 +1,196 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+#include "core/database.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/libraryplaylistitem.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistbackend.h"
+#include "playlist/songplaylistitem.h"
+#include "smartplaylists/generator.h"
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTime>
+#include <QTimer>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <iostream>
+
+namespace {
+
+class PlaylistBackendTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    database_.reset(new MemoryDatabase(NULL));
+    library_.reset(new LibraryBackend);
+    library_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    library_->AddDirectory("/tmp");
+    backend_.reset(new PlaylistBackend(database_.get()));
+  }
+
+  Song MakeSong(const QString& filename) {
+    Song ret;
+    ret.set_directory_id(1);
+    ret.set_url(QUrl::fromLocalFile(filename));
+    ret.set_title(filename.section('/', -1));
+    ret.set_mtime(1);
+    ret.set_ctime(1);
+    ret.set_filesize(1);
+    ret.set_valid(true);
+    return ret;
+  }
+
+  // Adds songs to the library and returns them with their IDs set.
+  SongList AddLibrarySongs(const QString& prefix, int count) {
+    SongList songs;
+    QList<QUrl> urls;
+    for (int i=0 ; i<count ; ++i) {
+      Song song = MakeSong(QString("/tmp/%1/%2.mp3").arg(prefix).arg(i));
+      songs << song;
+      urls << song.url();
+    }
+    library_->AddOrUpdateSongs(songs);
+    return library_->GetSongsByUrls(urls);
+  }
+
+  PlaylistItemList Restore(int playlist) {
+    return backend_->GetPlaylistItems(playlist).results();
+  }
+
+  // Opens the playlist the way PlaylistManager does.
+  Playlist* Open(int id) {
+    Playlist* ret = new Playlist(backend_.get(), NULL, library_.get(), id);
+
+    QEventLoop loop;
+    QObject::connect(ret, SIGNAL(RestoreFinished()), &loop, SLOT(quit()));
+    QTimer::singleShot(10000, &loop, SLOT(quit()));
+    ret->Restore();
+    loop.exec();
+
+    return ret;
+  }
+
+  boost::scoped_ptr<Database> database_;
+  boost::scoped_ptr<LibraryBackend> library_;
+  boost::scoped_ptr<PlaylistBackend> backend_;
+};
+
+TEST_F(PlaylistBackendTest, RestoresItems) {
+  const SongList library_songs = AddLibrarySongs("library", 2);
+  ASSERT_EQ(2, library_songs.count());
+
+  PlaylistItemList items;
+  items << PlaylistItemPtr(new LibraryPlaylistItem(library_songs[1]));
+  items << PlaylistItemPtr(new SongPlaylistItem(MakeSong("/tmp/file.mp3")));
+  items << PlaylistItemPtr(new LibraryPlaylistItem(library_songs[0]));
+
+  const int id = backend_->CreatePlaylist("Test", QString());
+  backend_->SavePlaylist(id, items, -1, smart_playlists::GeneratorPtr());
+
+  PlaylistItemList restored = Restore(id);
+  ASSERT_EQ(3, restored.count());
+
+  EXPECT_EQ("Library", restored[0]->type());
+  EXPECT_EQ(library_songs[1].id(), restored[0]->Metadata().id());
+  EXPECT_EQ("1.mp3", restored[0]->Metadata().title());
+
+  EXPECT_EQ("File", restored[1]->type());
+  EXPECT_EQ(QUrl::fromLocalFile("/tmp/file.mp3"), restored[1]->Url());
+  EXPECT_EQ("file.mp3", restored[1]->Metadata().title());
+
+  EXPECT_EQ("Library", restored[2]->type());
+  EXPECT_EQ(library_songs[0].id(), restored[2]->Metadata().id());
+}
+
+TEST_F(PlaylistBackendTest, UsesCurrentLibraryMetadata) {
+  SongList library_songs = AddLibrarySongs("library", 1);
+  ASSERT_EQ(1, library_songs.count());
+
+  const int id = backend_->CreatePlaylist("Test", QString());
+  backend_->SavePlaylist(id, PlaylistItemList()
+      << PlaylistItemPtr(new LibraryPlaylistItem(library_songs[0])),
+      -1, smart_playlists::GeneratorPtr());
+
+  // Items in the library are restored from the songs table, not from the copy
+  // in the playlist.
+  library_songs[0].set_title("New title");
+  library_->AddOrUpdateSongs(library_songs);
+
+  PlaylistItemList restored = Restore(id);
+  ASSERT_EQ(1, restored.count());
+  EXPECT_EQ("New title", restored[0]->Metadata().title());
+}
+
+TEST_F(PlaylistBackendTest, ReopenKeepsItems) {
+  const int id = backend_->CreatePlaylist("Test", QString());
+  backend_->SavePlaylist(id, PlaylistItemList()
+      << PlaylistItemPtr(new SongPlaylistItem(MakeSong("/tmp/a.mp3")))
+      << PlaylistItemPtr(new SongPlaylistItem(MakeSong("/tmp/b.mp3"))),
+      -1, smart_playlists::GeneratorPtr());
+
+  // Open it, save it and close it again.
+  boost::scoped_ptr<Playlist> playlist(Open(id));
+  EXPECT_EQ(2, playlist->rowCount(QModelIndex()));
+  playlist->Save();
+  QCoreApplication::processEvents();
+  playlist.reset();
+
+  EXPECT_EQ(2, Restore(id).count());
+
+  playlist.reset(Open(id));
+  EXPECT_EQ(2, playlist->rowCount(QModelIndex()));
+}
+
+TEST_F(PlaylistBackendTest, DISABLED_RestoreLargePlaylists) {
+  const int kPlaylists = 5;
+  const int kItemsPerPlaylist = 20000;
+
+  QList<int> ids;
+  for (int i=0 ; i<kPlaylists ; ++i) {
+    PlaylistItemList items;
+    foreach (const Song& song,
+             AddLibrarySongs(QString::number(i), kItemsPerPlaylist / 2)) {
+      items << PlaylistItemPtr(new LibraryPlaylistItem(song));
+      items << PlaylistItemPtr(new SongPlaylistItem(
+          MakeSong(song.url().toLocalFile() + ".file")));
+    }
+
+    const int id = backend_->CreatePlaylist(QString::number(i), QString());
+    backend_->SavePlaylist(id, items, -1, smart_playlists::GeneratorPtr());
+    ids << id;
+  }
+
+  QTime t;
+  t.start();
+  int count = 0;
+  foreach (int id, ids) {
+    count += Restore(id).count();
+  }
+  std::cout << "Restored " << kPlaylists << " playlists with " << count
+            << " items in " << t.elapsed() << "ms" << std::endl;
+
+  EXPECT_EQ(kPlaylists * kItemsPerPlaylist, count);
+}
+
+}  // namespace
@@ -0,0 +1,106 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "podcasts/podcastparser.h"
+
+#include <QBuffer>
+#include <QUrl>
+
+class PodcastParserTest : public ::testing::Test {
+ protected:
+  // Makes a feed with an episode for each of the given days of January 2013,
+  // in that order.
+  static QByteArray MakeFeed(const QList<int>& days) {
+    // 1st January 2013 was a Tuesday.
+    static const char* kDayNames[] = {
+        "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+
+    QByteArray ret =
+        "<rss version=\"2.0\"><channel><title>Podcast</title>";
+    foreach (int day, days) {
+      ret += "<item>"
+             "<title>Episode " + QByteArray::number(day) + "</title>"
+             "<pubDate>" + QByteArray(kDayNames[day % 7]) + ", " +
+               QByteArray::number(day) + " Jan 2013 12:00:00 +0000</pubDate>"
+             "<enclosure type=\"audio/mpeg\" url=\"" +
+               EpisodeUrl(day).toEncoded() + "\"/>"
+             "</item>";
+    }
+    ret += "</channel></rss>";
+    return ret;
+  }
+
+  static QUrl EpisodeUrl(int day) {
+    return QUrl(QString("http://example.com/%1.mp3").arg(day));
+  }
+
+  Podcast Parse(const QByteArray& data,
+                const QSet<QUrl>& known_episode_urls = QSet<QUrl>()) {
+    QByteArray copy(data);
+    QBuffer buffer(&copy);
+    buffer.open(QIODevice::ReadOnly);
+    return parser_.Load(&buffer, QUrl("http://example.com/feed"),
+                        known_episode_urls).value<Podcast>();
+  }
+
+  PodcastParser parser_;
+};
+
+TEST_F(PodcastParserTest, ParsesAllEpisodes) {
+  Podcast podcast = Parse(MakeFeed(QList<int>() << 5 << 4 << 3 << 2 << 1));
+  EXPECT_EQ("Podcast", podcast.title());
+  ASSERT_EQ(5, podcast.episodes().count());
+  EXPECT_EQ(EpisodeUrl(5), podcast.episodes()[0].url());
+  EXPECT_EQ(EpisodeUrl(1), podcast.episodes()[4].url());
+}
+
+TEST_F(PodcastParserTest, StopsAtKnownEpisodes) {
+  QList<int> days;
+  for (int day=20 ; day>0 ; --day) {
+    days << day;
+  }
+
+  QSet<QUrl> known;
+  for (int day=1 ; day<=18 ; ++day) {
+    known << EpisodeUrl(day);
+  }
+
+  // The two new episodes and the first few known ones.
+  Podcast podcast = Parse(MakeFeed(days), known);
+  EXPECT_EQ(2 + PodcastParser::kKnownEpisodesBeforeStopping,
+            podcast.episodes().count());
+  EXPECT_EQ(EpisodeUrl(20), podcast.episodes()[0].url());
+}
+
+TEST_F(PodcastParserTest, ReadsOldestFirstFeedsToTheEnd) {
+  QList<int> days;
+  for (int day=1 ; day<=20 ; ++day) {
+    days << day;
+  }
+
+  QSet<QUrl> known;
+  for (int day=1 ; day<=18 ; ++day) {
+    known << EpisodeUrl(day);
+  }
+
+  Podcast podcast = Parse(MakeFeed(days), known);
+  ASSERT_EQ(20, podcast.episodes().count());
+  EXPECT_EQ(EpisodeUrl(20), podcast.episodes()[19].url());
+}
@@ -0,0 +1,220 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "core/resumabledownload.h"
+#include "mock_httpserver.h"
+#include "test_utils.h"
+
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QSignalSpy>
+#include <QTemporaryFile>
+#include <QTime>
+#include <QTimer>
+
+namespace {
+
+class ResumableDownloadTest : public ::testing::Test {
+ protected:
+  static const int kTimeoutMsec = 10000;
+
+  void SetUp() {
+    ASSERT_TRUE(server_.listen(QHostAddress::LocalHost));
+
+    for (int i=0 ; i<100 * 1024 ; ++i) {
+      content_.append(char(i * 7 % 251));
+    }
+    server_.SetContent(content_);
+
+    // Just to get a unique name.  The file itself is removed again.
+    QTemporaryFile temp;
+    ASSERT_TRUE(temp.open());
+    filename_ = temp.fileName();
+  }
+
+  void TearDown() {
+    QFile::remove(filename_);
+    QFile::remove(partial_filename());
+    QFile::remove(validator_filename());
+  }
+
+  QString partial_filename() const {
+    return filename_ + ResumableDownload::kPartialSuffix;
+  }
+
+  QString validator_filename() const {
+    return partial_filename() + ResumableDownload::kValidatorSuffix;
+  }
+
+  // A partial file left behind by an earlier download of the server's file.
+  void WritePartial(const QByteArray& data) {
+    WriteFile(partial_filename(), data);
+    WriteFile(validator_filename(), server_.etag());
+  }
+
+  bool Download(BandwidthLimiter* limiter = NULL) {
+    ResumableDownload download(&network_, server_.url("/episode.mp3"),
+                               filename_);
+    download.set_retry_delay_msec(0);
+    download.set_bandwidth_limiter(limiter);
+
+    QSignalSpy spy(&download, SIGNAL(Finished(bool)));
+    QEventLoop loop;
+    QObject::connect(&download, SIGNAL(Finished(bool)), &loop, SLOT(quit()));
+    QTimer::singleShot(kTimeoutMsec, &loop, SLOT(quit()));
+
+    download.Start();
+    if (spy.isEmpty())
+      loop.exec();
+
+    return !spy.isEmpty() && spy[0][0].toBool();
+  }
+
+  static QByteArray ReadFile(const QString& filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+      return QByteArray();
+    return file.readAll();
+  }
+
+  static void WriteFile(const QString& filename, const QByteArray& data) {
+    QFile file(filename);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(data);
+  }
+
+  MockHttpServer server_;
+  QNetworkAccessManager network_;
+  QByteArray content_;
+  QString filename_;
+};
+
+TEST_F(ResumableDownloadTest, DownloadsWholeFile) {
+  ASSERT_TRUE(Download());
+  EXPECT_TRUE(ReadFile(filename_) == content_);
+  EXPECT_FALSE(QFile::exists(partial_filename()));
+
+  ASSERT_EQ(1, server_.range_headers().count());
+  EXPECT_TRUE(server_.range_headers()[0].isEmpty());
+}
+
+TEST_F(ResumableDownloadTest, ResumesPartialFile) {
+  WritePartial(content_.left(1000));
+
+  ASSERT_TRUE(Download());
+  EXPECT_TRUE(ReadFile(filename_) == content_);
+  EXPECT_FALSE(QFile::exists(validator_filename()));
+
+  ASSERT_EQ(1, server_.range_headers().count());
+  EXPECT_EQ("bytes=1000-", QString(server_.range_headers()[0]));
+  EXPECT_EQ(QString(server_.etag()), QString(server_.if_range_headers()[0]));
+}
+
+TEST_F(ResumableDownloadTest, DiscardsPartialFileWithoutValidator) {
+  // This might be from a different file, or an older version of this one.
+  WriteFile(partial_filename(), QByteArray(1000, 'x'));
+
+  ASSERT_TRUE(Download());
+  EXPECT_TRUE(ReadFile(filename_) == content_);
+
+  ASSERT_EQ(1, server_.range_headers().count());
+  EXPECT_TRUE(server_.range_headers()[0].isEmpty());
+}
+
+TEST_F(ResumableDownloadTest, ResumesAfterDisconnect) {
+  server_.DisconnectAfter(30 * 1024, 2);
+
+  ASSERT_TRUE(Download());
+  EXPECT_TRUE(ReadFile(filename_) == content_);
+
+  // The two retries should both carry on from where the last one stopped.
+  ASSERT_EQ(3, server_.range_headers().count());
+  EXPECT_TRUE(server_.range_headers()[0].isEmpty());
+  EXPECT_FALSE(server_.range_headers()[1].isEmpty());
+  EXPECT_FALSE(server_.range_headers()[2].isEmpty());
+  EXPECT_EQ(QString(server_.etag()), QString(server_.if_range_headers()[1]));
+}
+
+TEST_F(ResumableDownloadTest, StartsAgainIfRangesAreUnsupported) {
+  server_.SetSupportsRanges(false);
+  WritePartial(QByteArray(1000, 'x'));
+
+  ASSERT_TRUE(Download());
+  EXPECT_TRUE(ReadFile(filename_) == content_);
+}
+
+TEST_F(ResumableDownloadTest, StartsAgainIfPartialFileIsTooBig) {
+  WritePartial(content_ + "extra");
+
+  ASSERT_TRUE(Download());
+  EXPECT_TRUE(ReadFile(filename_) == content_);
+}
+
+TEST_F(ResumableDownloadTest, GivesUpWithoutProgress) {
+  server_.DisconnectAfter(0, ResumableDownload::kMaxRetries + 1);
+
+  EXPECT_FALSE(Download());
+  EXPECT_FALSE(QFile::exists(filename_));
+  EXPECT_EQ(ResumableDownload::kMaxRetries + 1,
+            server_.range_headers().count());
+}
+
+TEST_F(ResumableDownloadTest, KeepsPartialFileAfterGivingUp) {
+  server_.DisconnectAfter(0, ResumableDownload::kMaxRetries + 1);
+  WritePartial(content_.left(1000));
+
+  EXPECT_FALSE(Download());
+  EXPECT_TRUE(ReadFile(partial_filename()) == content_.left(1000));
+  EXPECT_TRUE(QFile::exists(validator_filename()));
+}
+
+TEST_F(ResumableDownloadTest, RemovesPartialFileOnHttpError) {
+  server_.SetStatus(404);
+  WritePartial(content_.left(1000));
+
+  EXPECT_FALSE(Download());
+  EXPECT_FALSE(QFile::exists(filename_));
+  EXPECT_FALSE(QFile::exists(partial_filename()));
+  EXPECT_FALSE(QFile::exists(validator_filename()));
+}
+
+TEST_F(ResumableDownloadTest, KeepsPartialFileOnServerError) {
+  server_.SetStatus(503);
+  WritePartial(content_.left(1000));
+
+  EXPECT_FALSE(Download());
+  EXPECT_TRUE(ReadFile(partial_filename()) == content_.left(1000));
+  EXPECT_TRUE(QFile::exists(validator_filename()));
+}
+
+TEST_F(ResumableDownloadTest, LimitsBandwidth) {
+  BandwidthLimiter limiter;
+  limiter.set_bytes_per_sec(50 * 1024);
+
+  QTime time;
+  time.start();
+  ASSERT_TRUE(Download(&limiter));
+  EXPECT_TRUE(ReadFile(filename_) == content_);
+
+  // 100KB at 50KB/s shouldn't take much less than two seconds.
+  EXPECT_GE(time.elapsed(), 1500);
+}
+
+}  // namespace
@@ -17,6 +17,7 @@
 
 #include "config.h"
 #include "tagreader.h"
+#include "core/messagehandler.h"
 #include "core/song.h"
 #ifdef HAVE_LIBLASTFM
   #include "internet/lastfmcompat.h"
@@ -32,6 +33,10 @@
 
 #include <id3v2tag.h>
 
+#ifdef __GLIBC__
+# include <malloc.h>
+#endif
+
 namespace {
 
 class SongTest : public ::testing::Test {
@@ -76,6 +81,26 @@ class SongTest : public ::testing::Test {
     song.ToProtobuf(&pb_song);
     tag_reader.SaveSongRatingToFile(filename, pb_song);
   }
+
+  // Makes the i'th song of a library with 10 tracks per album and 200 artists.
+  // Every string is a new copy, like the ones that come out of the database.
+  static void MakeLibrarySong(int i, ::pb::tagreader::SongMetadata* pb) {
+    const QString artist = QString("Artist %1").arg((i / 10) % 200);
+    const QString album = QString("Album %1").arg(i / 10);
+    const QString directory = "/home/user/Music/" + artist + "/" + album;
+
+    pb->set_valid(true);
+    pb->set_title(DataCommaSizeFromQString(QString("Title %1").arg(i)));
+    pb->set_artist(DataCommaSizeFromQString(artist));
+    pb->set_albumartist(DataCommaSizeFromQString(artist));
+    pb->set_album(DataCommaSizeFromQString(album));
+    pb->set_genre(DataCommaSizeFromQString(QString("Genre %1").arg(i % 20)));
+    pb->set_track(i % 10 + 1);
+    pb->set_year(1970 + i % 40);
+    pb->set_art_automatic(DataCommaSizeFromQString(directory + "/cover.jpg"));
+    pb->set_url(QUrl::fromLocalFile(
+        directory + QString("/%1.mp3").arg(i % 10)).toEncoded().constData());
+  }
 };
 
 
@@ -292,4 +317,70 @@ TEST_F(SongTest, StatisticsMP4) {
   EXPECT_EQ(87, new_song.score());
 }
 
+TEST_F(SongTest, InternsRepeatedStrings) {
+  ::pb::tagreader::SongMetadata pb_one;
+  ::pb::tagreader::SongMetadata pb_two;
+  MakeLibrarySong(0, &pb_one);
+  MakeLibrarySong(1, &pb_two);
+
+  Song one;
+  Song two;
+  one.InitFromProtobuf(pb_one);
+  two.InitFromProtobuf(pb_two);
+
+  EXPECT_EQ("Artist 0", one.artist());
+  EXPECT_EQ("Album 0", two.album());
+  EXPECT_TRUE(one.artist().isSharedWith(two.artist()));
+  EXPECT_TRUE(one.album().isSharedWith(two.album()));
+  EXPECT_TRUE(one.art_automatic().isSharedWith(two.art_automatic()));
+  EXPECT_FALSE(one.title().isSharedWith(two.title()));
+
+  // Changing one song mustn't affect the other.
+  one.set_artist("Foo");
+  EXPECT_EQ("Artist 0", two.artist());
+}
+
+#ifdef __GLIBC__
+// Prints how much memory a song in a big library takes, with and without
+// interning.  Run with --gtest_also_run_disabled_tests.
+TEST_F(SongTest, DISABLED_MemoryPerSong) {
+  const int kSizes[] = {10000, 100000, 1000000};
+
+  for (int i=0 ; i<3 ; ++i) {
+    const int count = kSizes[i];
+
+    for (int interned=0 ; interned<2 ; ++interned) {
+      const int before = mallinfo().uordblks;
+      SongList songs;
+
+      for (int j=0 ; j<count ; ++j) {
+        ::pb::tagreader::SongMetadata pb;
+        MakeLibrarySong(j, &pb);
+
+        Song song;
+        if (interned) {
+          song.InitFromProtobuf(pb);
+        } else {
+          // What InitFromProtobuf did before the strings were interned.
+          song.InitFromProtobuf(pb);
+          song.set_artist(QString(song.artist().unicode(), song.artist().size()));
+          song.set_albumartist(QString(song.albumartist().unicode(),
+                                       song.albumartist().size()));
+          song.set_album(QString(song.album().unicode(), song.album().size()));
+          song.set_genre(QString(song.genre().unicode(), song.genre().size()));
+          song.set_art_automatic(QString(song.art_automatic().unicode(),
+                                         song.art_automatic().size()));
+        }
+        songs << song;
+      }
+
+      const int after = mallinfo().uordblks;
+      std::cout << count << " songs, "
+                << (interned ? "interned" : "not interned") << ": "
+                << (after - before) / count << " bytes per song" << std::endl;
+    }
+  }
+}
+#endif // __GLIBC__
+
 }  // namespace
@@ -0,0 +1,132 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "core/sqlprofiler.h"
+
+namespace {
+
+class SqlProfilerTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    profiler_.Start();
+  }
+
+  SqlProfiler profiler_;
+};
+
+TEST_F(SqlProfilerTest, NormalizesLiterals) {
+  EXPECT_EQ("SELECT * FROM songs WHERE artist = ? AND year > ?",
+            SqlProfiler::Normalize(
+                "SELECT * FROM songs\n  WHERE artist = 'Foo''s 99' AND year > 1990"));
+  EXPECT_EQ("UPDATE songs SET rating = ? WHERE ROWID = ?",
+            SqlProfiler::Normalize(
+                "UPDATE songs SET rating = 0.5 WHERE ROWID = :id"));
+  EXPECT_EQ("DELETE FROM songs WHERE ROWID IN (?, ...)",
+            SqlProfiler::Normalize("DELETE FROM songs WHERE ROWID IN (1, 2,3)"));
+  EXPECT_EQ("SELECT ROWID FROM songs_fts3",
+            SqlProfiler::Normalize("SELECT ROWID FROM songs_fts3"));
+}
+
+TEST_F(SqlProfilerTest, AggregatesQueries) {
+  profiler_.AddQuery("SELECT * FROM songs WHERE ROWID = 1", 50, 1);
+  profiler_.AddQuery("SELECT * FROM songs WHERE ROWID = 2", 500, 1);
+  profiler_.AddQuery("SELECT * FROM songs WHERE ROWID = 3", 2000000, 0);
+
+  SqlProfiler::QueryStatsList stats = profiler_.Stats();
+  ASSERT_EQ(1, stats.count());
+
+  const SqlProfiler::QueryStats& query = stats[0];
+  EXPECT_EQ("SELECT * FROM songs WHERE ROWID = ?", query.normalized_sql_);
+  EXPECT_EQ("SELECT * FROM songs WHERE ROWID = 3", query.slowest_sql_);
+  EXPECT_EQ(3, query.calls_);
+  EXPECT_EQ(2000550, query.total_usec_);
+  EXPECT_EQ(2000000, query.max_usec_);
+  EXPECT_EQ(2, query.rows_);
+
+  ASSERT_EQ(SqlProfiler::kHistogramBucketCount, query.histogram_.count());
+  EXPECT_EQ(1, query.histogram_[0]);
+  EXPECT_EQ(1, query.histogram_[1]);
+  EXPECT_EQ(1, query.histogram_.last());
+}
+
+TEST_F(SqlProfilerTest, UnknownRowCountIsSticky) {
+  profiler_.AddQuery("SELECT 1", 10, 5);
+  profiler_.AddQuery("SELECT 1", 10, -1);
+  profiler_.AddQuery("SELECT 1", 10, 5);
+
+  EXPECT_EQ(-1, profiler_.Stats()[0].rows_);
+}
+
+TEST_F(SqlProfilerTest, SortsByTotalTime) {
+  profiler_.AddQuery("SELECT a FROM songs", 100, 0);
+  profiler_.AddQuery("SELECT b FROM songs", 300, 0);
+  profiler_.AddQuery("SELECT a FROM songs", 100, 0);
+
+  SqlProfiler::QueryStatsList stats = profiler_.Stats();
+  ASSERT_EQ(2, stats.count());
+  EXPECT_EQ("SELECT b FROM songs", stats[0].normalized_sql_);
+  EXPECT_EQ("SELECT a FROM songs", stats[1].normalized_sql_);
+}
+
+TEST_F(SqlProfilerTest, IgnoresQueriesWhenStopped) {
+  profiler_.Stop();
+  profiler_.AddQuery("SELECT 1", 10, 1);
+  EXPECT_TRUE(profiler_.Stats().isEmpty());
+}
+
+TEST_F(SqlProfilerTest, IgnoresExplain) {
+  profiler_.AddQuery("EXPLAIN QUERY PLAN SELECT 1", 10, 1);
+  EXPECT_TRUE(profiler_.Stats().isEmpty());
+}
+
+TEST_F(SqlProfilerTest, AttributesLockWait) {
+  profiler_.LockRequested();
+  profiler_.LockAcquired();
+  profiler_.AddQuery("SELECT 1", 10, 1);
+  profiler_.AddQuery("SELECT 1", 10, 1);
+
+  const SqlProfiler::QueryStats query = profiler_.Stats()[0];
+  EXPECT_GE(query.total_wait_usec_, 0);
+  EXPECT_EQ(query.total_wait_usec_, query.max_wait_usec_);
+}
+
+TEST_F(SqlProfilerTest, CountsRows) {
+  int statement;
+  profiler_.RowReturned(&statement);
+  profiler_.RowReturned(&statement);
+  EXPECT_EQ(2, profiler_.TakeRowCount(&statement));
+  EXPECT_EQ(0, profiler_.TakeRowCount(&statement));
+}
+
+TEST_F(SqlProfilerTest, WritesJson) {
+  profiler_.AddQuery("SELECT * FROM songs WHERE ROWID = 1", 100000, 1);
+
+  SqlProfiler::QueryStatsList stats = profiler_.Stats();
+  stats[0].query_plan_ << "SEARCH TABLE songs USING INTEGER PRIMARY KEY";
+
+  const QString json = QString::fromUtf8(SqlProfiler::ToJson(stats, 50));
+  EXPECT_TRUE(json.contains("\"queries\""));
+  EXPECT_TRUE(json.contains("\"histogram_limits_usec\""));
+  EXPECT_TRUE(json.contains("\"calls\""));
+  EXPECT_TRUE(json.contains("\"query_plan\""));
+  EXPECT_TRUE(json.contains("INTEGER PRIMARY KEY"));
+}
+
+}  // namespace
@@ -0,0 +1,69 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+#include "core/stringpool.h"
+
+namespace {
+
+TEST(StringPoolTest, SharesEqualStrings) {
+  StringPool pool;
+
+  const QString one = pool.Intern(QString("foo"));
+  const QString two = pool.Intern(QString("foo"));
+  const QString three = pool.Intern(QString("bar"));
+
+  EXPECT_EQ("foo", two);
+  EXPECT_TRUE(one.isSharedWith(two));
+  EXPECT_FALSE(one.isSharedWith(three));
+  EXPECT_EQ(2, pool.count());
+}
+
+TEST(StringPoolTest, IgnoresEmptyStrings) {
+  StringPool pool;
+
+  EXPECT_TRUE(pool.Intern(QString()).isNull());
+  EXPECT_TRUE(pool.Intern(QString("")).isEmpty());
+  EXPECT_EQ(0, pool.count());
+}
+
+TEST(StringPoolTest, PurgesUnusedStrings) {
+  StringPool pool;
+
+  const QString kept = pool.Intern(QString("kept"));
+  pool.Intern(QString("dropped"));
+  EXPECT_EQ(2, pool.count());
+
+  pool.Purge();
+  EXPECT_EQ(1, pool.count());
+  EXPECT_TRUE(kept.isSharedWith(pool.Intern(QString("kept"))));
+}
+
+TEST(StringPoolTest, PurgesWhenFull) {
+  StringPool pool;
+
+  for (int i=0 ; i<StringPool::kMinPurgeSize * 4 ; ++i) {
+    pool.Intern(QString::number(i));
+  }
+
+  // Nothing was holding on to those strings, so they shouldn't all be there.
+  EXPECT_LT(pool.count(), StringPool::kMinPurgeSize * 2);
+}
+
+}  // namespace
@@ -0,0 +1,184 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+#include "mock_httpserver.h"
+
+#include "core/database.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "musicbrainz/acoustidclient.h"
+#include "musicbrainz/tagfetcher.h"
+
+#include <QEventLoop>
+#include <QSet>
+#include <QSignalSpy>
+#include <QTimer>
+#include <QUrl>
+
+#include <boost/scoped_ptr.hpp>
+
+class TagFetcherTest : public ::testing::Test {
+ protected:
+  static const int kTimeoutMsec = 10000;
+
+  void SetUp() {
+    qRegisterMetaType<Song>("Song");
+
+    // Acoustid doesn't know any of the songs, so each one gets an empty
+    // result.
+    ASSERT_TRUE(server_.listen(QHostAddress::LocalHost));
+    server_.SetContent("{\"status\": \"ok\", \"fingerprints\": []}");
+
+    database_.reset(new MemoryDatabase(NULL));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/music");
+
+    const char* kTitles[] = { "a", "b", "c", NULL };
+    for (int i=0 ; kTitles[i] ; ++i) {
+      Song song;
+      song.set_directory_id(1);
+      song.set_url(QUrl::fromLocalFile(QString("/music/%1.mp3").arg(kTitles[i])));
+      song.set_title(kTitles[i]);
+      song.set_mtime(1);
+      song.set_ctime(1);
+      song.set_filesize(1);
+      song.set_valid(true);
+      songs_ << song;
+    }
+    backend_->AddOrUpdateSongs(songs_);
+  }
+
+  // Stands in for Chromaprint.
+  static QString MakeFingerprint(const Song& song) {
+    return "made " + song.title();
+  }
+
+  // Waits until every song has a result.
+  void WaitForResults(QSignalSpy* spy) {
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    timeout.start(kTimeoutMsec);
+
+    while (spy->count() < songs_.count() && timeout.isActive()) {
+      loop.processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    // Let the fingerprints be saved.
+    loop.processEvents();
+  }
+
+  // The titles of the songs that got to this stage.
+  static QStringList Stage(const QSignalSpy& spy, const QString& stage) {
+    QStringList ret;
+    foreach (const QList<QVariant>& args, spy) {
+      if (args[1].toString() == stage)
+        ret << args[0].value<Song>().title();
+    }
+    ret.sort();
+    return ret;
+  }
+
+  // Every fingerprint that was sent to Acoustid.
+  QSet<QString> SentFingerprints() const {
+    QSet<QString> ret;
+    foreach (const QByteArray& body, server_.request_bodies()) {
+      QUrl url;
+      url.setEncodedQuery(body);
+
+      typedef QPair<QString, QString> Param;
+      foreach (const Param& param, url.queryItems()) {
+        if (param.first.startsWith("fingerprint."))
+          ret << param.second;
+      }
+    }
+    return ret;
+  }
+
+  QString SavedFingerprint(const Song& song) {
+    return backend_->GetFingerprints(QList<QUrl>() << song.url())
+        .value(song.url());
+  }
+
+  MockHttpServer server_;
+  boost::scoped_ptr<Database> database_;
+  boost::scoped_ptr<LibraryBackend> backend_;
+  SongList songs_;
+};
+
+// These start after the cached fingerprints were loaded from the library.  In
+// tests the library's in-memory database only exists in the main thread, so
+// the worker thread that StartFetch uses wouldn't find them.
+
+TEST_F(TagFetcherTest, UsesCachedFingerprints) {
+  TagFetcher::FingerprintMap cached;
+  foreach (const Song& song, songs_) {
+    cached[song.url()] = "cached " + song.title();
+  }
+
+  TagFetcher fetcher(backend_.get());
+  fetcher.acoustid_client_->SetUrl(server_.url("/v2/lookup"));
+  fetcher.fingerprint_function_ = MakeFingerprint;
+
+  QSignalSpy progress_spy(&fetcher, SIGNAL(Progress(Song,QString)));
+  QSignalSpy result_spy(&fetcher, SIGNAL(ResultAvailable(Song,SongList)));
+  fetcher.songs_ = songs_;
+  fetcher.StartFingerprinting(cached);
+  WaitForResults(&result_spy);
+
+  ASSERT_EQ(songs_.count(), result_spy.count());
+
+  // Nothing was decoded.
+  EXPECT_TRUE(Stage(progress_spy, "Fingerprinting song").isEmpty());
+  EXPECT_EQ(QStringList() << "a" << "b" << "c",
+            Stage(progress_spy, "Identifying song"));
+  EXPECT_EQ(QSet<QString>() << "cached a" << "cached b" << "cached c",
+            SentFingerprints());
+}
+
+TEST_F(TagFetcherTest, MatchesFingerprintsToSongs) {
+  // Only the first song has a fingerprint already, so the results of
+  // fingerprinting the others don't line up with the indices of the songs.
+  TagFetcher::FingerprintMap cached;
+  cached[songs_[0].url()] = "cached a";
+
+  TagFetcher fetcher(backend_.get());
+  fetcher.acoustid_client_->SetUrl(server_.url("/v2/lookup"));
+  fetcher.fingerprint_function_ = MakeFingerprint;
+
+  QSignalSpy progress_spy(&fetcher, SIGNAL(Progress(Song,QString)));
+  QSignalSpy result_spy(&fetcher, SIGNAL(ResultAvailable(Song,SongList)));
+  fetcher.songs_ = songs_;
+  fetcher.StartFingerprinting(cached);
+  WaitForResults(&result_spy);
+
+  ASSERT_EQ(songs_.count(), result_spy.count());
+
+  EXPECT_EQ(QStringList() << "b" << "c",
+            Stage(progress_spy, "Fingerprinting song"));
+  EXPECT_EQ(QSet<QString>() << "cached a" << "made b" << "made c",
+            SentFingerprints());
+
+  // The new fingerprints were saved for the right songs.
+  EXPECT_TRUE(SavedFingerprint(songs_[0]).isEmpty());
+  EXPECT_EQ("made b", SavedFingerprint(songs_[1]));
+  EXPECT_EQ("made c", SavedFingerprint(songs_[2]));
+}
@@ -0,0 +1,105 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "core/tracer.h"
+
+#include <QTemporaryFile>
+
+namespace {
+
+class TracerTest : public ::testing::Test {
+ protected:
+  void TearDown() {
+    Tracer::Stop();
+  }
+
+  QString SaveTrace() {
+    QTemporaryFile file;
+    file.open();
+    EXPECT_TRUE(Tracer::Save(file.fileName()));
+    return QString::fromUtf8(file.readAll());
+  }
+};
+
+TEST_F(TracerTest, DisabledByDefault) {
+  EXPECT_FALSE(Tracer::is_enabled());
+
+  TraceScope trace("test", "Nothing");
+  EXPECT_FALSE(trace.is_recording());
+}
+
+TEST_F(TracerTest, RecordsScopes) {
+  Tracer::Start();
+  {
+    TraceScope outer("test", "Outer");
+    TraceScope inner("test", "Inner");
+    inner.set_detail("some \"detail\"");
+    EXPECT_TRUE(inner.is_recording());
+  }
+  Tracer::Stop();
+
+  EXPECT_EQ(2, Tracer::event_count());
+
+  const QString json = SaveTrace();
+  EXPECT_TRUE(json.startsWith("{"));
+  EXPECT_TRUE(json.contains("\"traceEvents\""));
+  EXPECT_TRUE(json.contains("\"name\":\"Outer\""));
+  EXPECT_TRUE(json.contains("\"name\":\"Inner\""));
+  EXPECT_TRUE(json.contains("\"ph\":\"X\""));
+  EXPECT_TRUE(json.contains("\"detail\":\"some \\\"detail\\\"\""));
+  EXPECT_TRUE(json.contains("\"name\":\"thread_name\""));
+}
+
+TEST_F(TracerTest, IgnoresEventsAfterStop) {
+  Tracer::Start();
+  {
+    TraceScope trace("test", "Stopped");
+    Tracer::Stop();
+  }
+  Tracer::AddInstantEvent("test", "Instant");
+
+  EXPECT_EQ(0, Tracer::event_count());
+}
+
+TEST_F(TracerTest, StartClearsOldEvents) {
+  Tracer::Start();
+  Tracer::AddInstantEvent("test", "Instant");
+  EXPECT_EQ(1, Tracer::event_count());
+
+  Tracer::Start();
+  EXPECT_EQ(0, Tracer::event_count());
+}
+
+TEST_F(TracerTest, EventUntilSignal) {
+  Tracer::Start();
+
+  QObject* object = new QObject;
+  Tracer::AddEventUntil(object, SIGNAL(destroyed()), "test", "Lifetime");
+  delete object;
+  Tracer::Stop();
+
+  EXPECT_EQ(1, Tracer::event_count());
+
+  const QString json = SaveTrace();
+  EXPECT_TRUE(json.contains("\"ph\":\"b\""));
+  EXPECT_TRUE(json.contains("\"ph\":\"e\""));
+}
+
+}  // namespace
@@ -0,0 +1,158 @@
+/* This file is part of Clementine.
+   Copyright 2013, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include "test_utils.h"
+
+#include "transcoder/transcodedfilecache.h"
+#include "transcoder/transcoder.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+
+#include <boost/scoped_ptr.hpp>
+
+namespace {
+
+class TranscodedFileCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    QTemporaryFile temp;
+    temp.open();
+    directory_ = temp.fileName() + "-cache";
+
+    cache_.reset(new TranscodedFileCache(directory_, 100));
+  }
+
+  void TearDown() {
+    cache_.reset();
+    qDeleteAll(files_);
+
+    QDir dir(directory_);
+    foreach (const QString& name, dir.entryList(QDir::Files)) {
+      dir.remove(name);
+    }
+    QDir().rmdir(directory_);
+  }
+
+  // Writes a file containing size bytes and returns its name.
+  QString MakeFile(int size) {
+    QTemporaryFile* file = new QTemporaryFile;
+    file->open();
+    file->write(QByteArray(size, 'x'));
+    file->flush();
+    files_ << file;
+    return file->fileName();
+  }
+
+  QString Read(const QString& filename) {
+    QFile file(filename);
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+  }
+
+  QString directory_;
+  boost::scoped_ptr<TranscodedFileCache> cache_;
+  QList<QTemporaryFile*> files_;
+};
+
+TEST_F(TranscodedFileCacheTest, Empty) {
+  EXPECT_EQ(0, cache_->count());
+  EXPECT_EQ(0, cache_->size());
+  EXPECT_FALSE(cache_->CopyTo("foo", directory_ + "/out"));
+}
+
+TEST_F(TranscodedFileCacheTest, InsertAndCopy) {
+  ASSERT_TRUE(cache_->Insert("foo", MakeFile(10)));
+  EXPECT_EQ(1, cache_->count());
+  EXPECT_EQ(10, cache_->size());
+
+  const QString destination = MakeFile(1);
+  ASSERT_TRUE(cache_->CopyTo("foo", destination));
+  EXPECT_EQ(QString(10, 'x'), Read(destination));
+}
+
+TEST_F(TranscodedFileCacheTest, TooBig) {
+  EXPECT_FALSE(cache_->Insert("foo", MakeFile(101)));
+  EXPECT_EQ(0, cache_->count());
+}
+
+TEST_F(TranscodedFileCacheTest, EvictsLeastRecentlyUsed) {
+  ASSERT_TRUE(cache_->Insert("one", MakeFile(40)));
+  ASSERT_TRUE(cache_->Insert("two", MakeFile(40)));
+
+  // Using "one" makes "two" the oldest entry.
+  ASSERT_TRUE(cache_->CopyTo("one", MakeFile(1)));
+
+  ASSERT_TRUE(cache_->Insert("three", MakeFile(40)));
+  EXPECT_EQ(2, cache_->count());
+  EXPECT_EQ(80, cache_->size());
+
+  EXPECT_TRUE(cache_->CopyTo("one", MakeFile(1)));
+  EXPECT_FALSE(cache_->CopyTo("two", MakeFile(1)));
+  EXPECT_TRUE(cache_->CopyTo("three", MakeFile(1)));
+}
+
+TEST_F(TranscodedFileCacheTest, Shrink) {
+  ASSERT_TRUE(cache_->Insert("one", MakeFile(40)));
+  ASSERT_TRUE(cache_->Insert("two", MakeFile(40)));
+
+  cache_->set_max_size(50);
+  EXPECT_EQ(1, cache_->count());
+  EXPECT_TRUE(cache_->CopyTo("two", MakeFile(1)));
+
+  cache_->set_max_size(0);
+  EXPECT_EQ(0, cache_->count());
+}
+
+TEST_F(TranscodedFileCacheTest, Reload) {
+  ASSERT_TRUE(cache_->Insert("one", MakeFile(40)));
+  ASSERT_TRUE(cache_->Insert("two", MakeFile(40)));
+  ASSERT_TRUE(cache_->CopyTo("one", MakeFile(1)));
+
+  cache_.reset(new TranscodedFileCache(directory_, 100));
+  EXPECT_EQ(2, cache_->count());
+  EXPECT_EQ(80, cache_->size());
+
+  // The order should have survived, so "two" gets evicted first.
+  cache_->set_max_size(50);
+  EXPECT_TRUE(cache_->CopyTo("one", MakeFile(1)));
+  EXPECT_FALSE(cache_->CopyTo("two", MakeFile(1)));
+}
+
+TEST_F(TranscodedFileCacheTest, KeyDependsOnPreset) {
+  const QString filename = MakeFile(10);
+
+  const QString mp3 = TranscodedFileCache::KeyForFile(
+        filename, Transcoder::PresetForFileType(Song::Type_Mpeg));
+  const QString vorbis = TranscodedFileCache::KeyForFile(
+        filename, Transcoder::PresetForFileType(Song::Type_OggVorbis));
+
+  EXPECT_EQ(mp3, TranscodedFileCache::KeyForFile(
+        filename, Transcoder::PresetForFileType(Song::Type_Mpeg)));
+  EXPECT_NE(mp3, vorbis);
+}
+
+TEST_F(TranscodedFileCacheTest, KeyDependsOnFile) {
+  const TranscoderPreset preset = Transcoder::PresetForFileType(Song::Type_Mpeg);
+
+  EXPECT_NE(TranscodedFileCache::KeyForFile(MakeFile(10), preset),
+            TranscodedFileCache::KeyForFile(MakeFile(10), preset));
+}
+
+}  // namespace